@@ -0,0 +1,143 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+
+/**
+ * @file distributed_test.cpp
+ * @brief Distributed rendering check: a small graph is rendered by two spawned
+ * worker processes and the stitched export is compared with the out-of-core
+ * export of the same graph in a single process.
+ *
+ * Usage: hesiod --distributed-test work_dir
+ */
+#include "distributed_test.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "gnode.hpp"
+#include "macrologger.h"
+
+#include "hesiod/attribute.hpp"
+#include "hesiod/control_node.hpp"
+#include "hesiod/distributed.hpp"
+#include "hesiod/gui.hpp"
+#include "hesiod/view_node.hpp"
+#include "hesiod/view_tree.hpp"
+
+#if ENABLE_DISTRIBUTED_TEST
+// largest difference allowed between the two exports (16 bit steps, blending
+// weights only introducing rounding differences)
+#define DISTRIBUTED_TEST_TOLERANCE 1
+
+static bool read_raw_16bit(const std::string     &fname,
+                           std::vector<uint16_t> &data)
+{
+  std::ifstream f(fname, std::ios::binary | std::ios::ate);
+
+  if (!f.is_open())
+    return false;
+
+  data.resize((size_t)f.tellg() / sizeof(uint16_t));
+  f.seekg(0);
+  f.read((char *)data.data(), sizeof(uint16_t) * data.size());
+
+  return f.good();
+}
+
+int distributed_test(const std::string &executable, const std::string &dir)
+{
+  std::filesystem::path work_dir = std::filesystem::absolute(dir);
+  std::string           fname_export = (work_dir / "export.raw").string();
+  std::string           fname_reference = (work_dir / "reference.raw").string();
+
+  std::filesystem::remove_all(work_dir);
+  std::filesystem::create_directories(work_dir);
+
+  // invisible window, the nodes still need an OpenGL context
+  GLFWwindow *window = hesiod::gui::init_gui(64, 64, "Hesiod", false);
+  if (!window)
+    return 1;
+
+  hesiod::vnode::ViewTree tree =
+      hesiod::vnode::ViewTree("tree_1", {128, 128}, {4, 4}, 0.25f);
+
+  std::string id_noise = tree.add_view_node("FbmPerlin");
+  std::string id_export = tree.add_view_node("Export");
+
+  tree.new_link(id_noise, "output", id_export, "input");
+
+  tree.get_node_ref_by_id<hesiod::cnode::Export>(id_export)
+      ->attr.at("fname")
+      ->get_ref<hesiod::FilenameAttribute>()
+      ->value = fname_export;
+
+  tree.get_node_ref_by_id<hesiod::cnode::Export>(id_export)
+      ->attr.at("export_format")
+      ->get_ref<hesiod::MapEnumAttribute>()
+      ->set("raw (16 bit, Unity)");
+
+  hesiod::distributed::RenderSettings settings;
+  settings.state_fname = (work_dir / "state.json").string();
+  settings.shape = {320, 192};
+  settings.super_tile = 64;
+  settings.overlap = 8;
+  settings.nworkers = 2;
+  settings.dir = (work_dir / "tiles").string();
+
+  tree.save_state(settings.state_fname);
+
+  // single process reference
+  bool success = tree.export_out_of_core(settings.shape, settings.super_tile);
+  if (success)
+    std::filesystem::rename(fname_export, fname_reference);
+
+  // two local workers
+  success = success && tree.render_distributed(executable, settings);
+
+  glfwDestroyWindow(window);
+  glfwTerminate();
+
+  if (!success)
+  {
+    LOG_ERROR("distributed test, rendering failed");
+    return 1;
+  }
+
+  std::vector<uint16_t> data, reference;
+
+  if (!read_raw_16bit(fname_export, data) ||
+      !read_raw_16bit(fname_reference, reference))
+  {
+    LOG_ERROR("distributed test, could not read the exports");
+    return 1;
+  }
+
+  if (data.size() != (size_t)settings.shape.x * settings.shape.y ||
+      data.size() != reference.size())
+  {
+    LOG_ERROR("distributed test, export sizes differ (%ld, %ld)",
+              data.size(),
+              reference.size());
+    return 1;
+  }
+
+  int dmax = 0;
+  for (size_t k = 0; k < data.size(); k++)
+    dmax = std::max(dmax, std::abs((int)data[k] - (int)reference[k]));
+
+  // the tiles of the run are removed once stitched
+  bool tiles_left = std::filesystem::exists(settings.dir) &&
+                    !std::filesystem::is_empty(settings.dir);
+
+  std::cout << "distributed test, largest difference: " << dmax
+            << ", tiles left: " << tiles_left << std::endl;
+
+  return (dmax <= DISTRIBUTED_TEST_TOLERANCE && !tiles_left) ? 0 : 1;
+}
+#endif
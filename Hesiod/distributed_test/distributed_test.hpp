@@ -0,0 +1,6 @@
+#pragma once
+#include <string>
+
+#if ENABLE_DISTRIBUTED_TEST
+int distributed_test(const std::string &executable, const std::string &dir);
+#endif
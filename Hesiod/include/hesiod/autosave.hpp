@@ -0,0 +1,63 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+
+/**
+ * @file autosave.hpp
+ * @brief Background autosave of the tree state.
+ *
+ * The state is captured as an immutable snapshot: the serialized data of each
+ * node is held by a shared pointer and only replaced when the node changes,
+ * unchanged nodes being shared by successive snapshots, the cheap parts
+ * (storage settings, node positions, links) being serialized at every
+ * snapshot. Snapshots are written by the I/O thread of the export queue, the
+ * file being written under a temporary name, synced to disk and then
+ * swapped with the previous one, older versions being kept as rotating
+ * backups.
+ */
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+// time budget (in ms) per frame for serializing the nodes of a snapshot
+#define AUTOSAVE_FRAME_BUDGET_MS 1.f
+
+// default time interval (in s) between two autosaves
+#define AUTOSAVE_INTERVAL_S 60.f
+
+// default number of backups kept ('fname.1', 'fname.2'...)
+#define AUTOSAVE_NBACKUPS 3
+
+namespace hesiod::io
+{
+
+struct StateSnapshot
+{
+  /**
+   * @brief Tree data without the nodes ("data" field of a state file).
+   */
+  nlohmann::json header = nlohmann::json();
+
+  /**
+   * @brief Serialized data of the nodes, shared between snapshots.
+   */
+  std::vector<std::shared_ptr<const nlohmann::json>> nodes = {};
+};
+
+/**
+ * @brief Write a snapshot as a state file (same format as
+ * @link hesiod::vnode::ViewTree::save_state), synced to disk before replacing
+ * the previous file, which becomes the first backup.
+ *
+ * @param fname File name.
+ * @param snapshot State snapshot.
+ * @param nbackups Number of backups kept.
+ */
+void write_state_snapshot(const std::string   &fname,
+                          const StateSnapshot &snapshot,
+                          int                  nbackups = AUTOSAVE_NBACKUPS);
+
+} // namespace hesiod::io
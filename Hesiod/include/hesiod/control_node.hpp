@@ -2,11 +2,18 @@
  * Public License. The full license is in the file LICENSE, distributed with
  * this software. */
 #pragma once
+#include <functional>
+#include <map>
+#include <memory>
 #include <string>
 
 #include "gnode.hpp"
 
 #include "hesiod/attribute.hpp"
+#include "hesiod/heightmap_writer.hpp"
+#include "hesiod/import_cache.hpp"
+#include "hesiod/path_finding.hpp"
+#include "hesiod/region.hpp"
 #include "hesiod/serialization.hpp"
 
 // clang-format off
@@ -14,6 +21,10 @@
 #define DEFAULT_KW 2.f
 #define DEFAULT_SEED 1
 
+// evaluation version of the primitives, saved with the nodes: 0 for the
+// per-tile HighMap functions, 1 for the batched kernels (hesiod/noise.hpp)
+#define PRIMITIVE_KERNEL_VERSION 1
+
 #define CAST_PORT_REF(type, port_id)  static_cast<type *>(this->get_p_data(port_id))
 
 namespace hesiod::cnode
@@ -227,6 +238,151 @@ public:
   bool deserialize_json_v2(std::string field_name, nlohmann::json& input_data);
 
   void post_process_heightmap(hmap::HeightMap &h);
+
+  /**
+   * @brief Growth of the changed regions through the node, global by default
+   * (any input change requires a full recomputation).
+   */
+  hesiod::region::Halo halo = {};
+
+  /**
+   * @brief Integer attribute scaling the halo radius (radius halos depending on
+   * the node settings), none if empty.
+   */
+  std::string halo_ir_attr = "";
+
+  /**
+   * @brief Integer attributes given in cells (radii, widths...), scaled with
+   * the resolution during region of interest evaluations.
+   */
+  std::vector<std::string> cell_attrs = {"ir",
+                                         "ir_smoothing",
+                                         "irmin",
+                                         "irmax",
+                                         "c_radius"};
+
+  /**
+   * @brief Integer attributes counting iterations of a cell-based process,
+   * which have no equivalent at another resolution.
+   */
+  std::vector<std::string> iteration_attrs = {"iterations",
+                                              "thermal_subiterations"};
+
+  /**
+   * @brief Region of the output to recompute during the next update, the whole
+   * domain by default (set by the tree for incremental updates).
+   */
+  hmap::Vec4<float> dirty_region = hesiod::region::full();
+
+  /**
+   * @brief Return the node halo, including the post-processing steps.
+   */
+  virtual hesiod::region::Halo get_effective_halo();
+
+  /**
+   * @brief Return the node halo during region of interest evaluations, the
+   * operations reusing the statistics recorded during the last whole domain
+   * update (saturation and remapping ranges, equalization transfer) being
+   * pointwise.
+   */
+  virtual hesiod::region::Halo get_roi_halo();
+
+  /**
+   * @brief Whether the node records statistics during whole domain updates
+   * (saturation and remapping ranges...), saved along with the outputs in the
+   * output cache.
+   */
+  virtual bool records_statistics();
+
+  /**
+   * @brief Save the statistics recorded during the last whole domain update.
+   */
+  virtual void serialize_statistics(nlohmann::json &data);
+
+  /**
+   * @brief Restore the statistics saved by 'serialize_statistics'.
+   *
+   * @return false Missing or invalid statistics, nothing restored.
+   */
+  virtual bool deserialize_statistics(const nlohmann::json &data);
+
+  /**
+   * @brief Hash of the outputs of a frozen node, identifying them in the output
+   * cache (set when the cache is saved, empty while unknown).
+   */
+  std::string frozen_key = "";
+
+  /**
+   * @brief Return the region of the outputs that the next update will change
+   * given the current settings, the whole domain by default (nodes able to
+   * tell which part of their outputs an edit affects override this).
+   */
+  virtual hmap::Vec4<float> get_changed_region();
+
+  /**
+   * @brief Recompute the output only within the dirty region, 'fct' being
+   * applied to the blocks of tiles of the inputs covering it (same tiles and
+   * overlap buffers as the whole domain computation, see
+   * hesiod::region::extract_tiles), so that the result matches the whole
+   * domain one.
+   *
+   * @param h_out Output heightmap, already computed over the whole domain.
+   * @param p_inputs Input heightmaps, the first one being mandatory.
+   * @param fct Computation on the crops (output, inputs).
+   * @return true The output has been updated.
+   * @return false A full recomputation is required.
+   */
+  bool compute_in_region(
+      hmap::HeightMap                &h_out,
+      std::vector<hmap::HeightMap *>  p_inputs,
+      std::function<void(hmap::HeightMap &, std::vector<hmap::HeightMap *> &)>
+          fct);
+
+  /**
+   * @brief Return the indices of the output tiles intersecting the dirty
+   * region, for the incremental update of tile-wise computations.
+   *
+   * @param h_out Output heightmap, already computed over the whole domain.
+   * @param p_ref Reference input heightmap (same storage expected), or nullptr.
+   * @param tiles Tile indices (output).
+   * @return true Only the returned tiles need to be recomputed.
+   * @return false A full recomputation is required.
+   */
+  bool get_dirty_tiles(hmap::HeightMap  &h_out,
+                       hmap::HeightMap  *p_ref,
+                       std::vector<int> &tiles);
+
+  /**
+   * @brief Scale the cell-based settings (attributes listed in 'cell_attrs')
+   * by the ratio of the region of interest resolution to the tree resolution,
+   * the original values being restored first (a scale of 1 only restores
+   * them).
+   *
+   * @param scale Resolution ratio.
+   * @return true The node settings have been rescaled.
+   * @return false The node has settings that cannot be rescaled (attributes
+   * listed in 'iteration_attrs'), the output will differ from the whole domain
+   * one.
+   */
+  bool set_roi_scale(float scale);
+
+  /**
+   * @brief Whether the node is evaluated over a region of interest instead of
+   * the whole domain (set by the tree), the global post-processing steps then
+   * reuse the value ranges of the last whole domain evaluation so that the
+   * result matches the whole domain one.
+   */
+  bool roi_evaluation = false;
+
+private:
+  // value ranges used by the post-processing (saturation input, saturation
+  // output, remapping input), recorded during whole domain evaluations
+  hmap::Vec2<float> range_saturate_in = {0.f, 1.f};
+  hmap::Vec2<float> range_saturate_out = {0.f, 1.f};
+  hmap::Vec2<float> range_remap_in = {0.f, 1.f};
+
+  // original values of the attributes rescaled by 'set_roi_scale'
+  std::map<std::string, int> cell_attr_values = {};
 };
 
 //----------------------------------------
@@ -358,11 +514,19 @@ public:
 
   void post_compute();
 
+  bool serialize_json_v2(std::string     field_name,
+                         nlohmann::json &output_data) override;
+
+  bool deserialize_json_v2(std::string     field_name,
+                           nlohmann::json &input_data) override;
 
 protected:
   hmap::HeightMap value_out = hmap::HeightMap();
 
- 
+  // nodes loaded from projects saved before the batched kernels keep the
+  // HighMap functions (version 0) so that their output does not change
+  int kernel_version = PRIMITIVE_KERNEL_VERSION;
+
 
 private:
   hmap::Vec2<int> shape;
@@ -527,6 +691,10 @@ public:
 
   void compute();
 
+  hesiod::region::Halo get_effective_halo();
+
+  hesiod::region::Halo get_roi_halo();
+
   void update_inner_bindings();
 
 protected:
@@ -582,6 +750,8 @@ public:
 
   void compute();
 
+  hmap::Vec4<float> get_changed_region();
+
   void update_inner_bindings();
 
 protected:
@@ -692,6 +862,10 @@ public:
 
   void compute();
 
+  hesiod::region::Halo get_effective_halo();
+
+  hesiod::region::Halo get_roi_halo();
+
   void update_inner_bindings();
 
 protected:
@@ -707,6 +881,9 @@ public:
 
   void update_inner_bindings();
 
+  bool deserialize_json_v2(std::string     field_name,
+                           nlohmann::json &input_data) override;
+
 protected:
   hmap::HeightMap value_out = hmap::HeightMap();
 };
@@ -718,6 +895,24 @@ public:
 
   void compute_filter(hmap::HeightMap &h, hmap::HeightMap *p_mask);
 
+  hesiod::region::Halo get_roi_halo();
+
+  bool records_statistics();
+
+  void serialize_statistics(nlohmann::json &data);
+
+  bool deserialize_statistics(const nlohmann::json &data);
+
+protected:
+  void record_transfer(const hmap::Array &z_in, const hmap::Array &z_out);
+
+  void apply_transfer(hmap::Array &z, hmap::Array *p_mask);
+
+  // equalization transfer function (input values to output values, sampled
+  // per value bin), recorded during whole domain evaluations and applied to
+  // regions
+  std::vector<float> transfer_in = {};
+  std::vector<float> transfer_out = {};
 };
 
 class ErosionMaps : virtual public ControlNode
@@ -767,6 +962,19 @@ public:
 
   void write_file();
 
+  /**
+   * @brief Create a writer of the export file fed by blocks of cells
+   * (out-of-core evaluation), downsampled levels ('lod_levels') being not
+   * written.
+   *
+   * @param shape Export resolution.
+   * @param range Value range of the export (image formats).
+   * @return std::unique_ptr<hesiod::io::BlockWriter> Writer.
+   */
+  std::unique_ptr<hesiod::io::BlockWriter> create_block_writer(
+      hmap::Vec2<int>   shape,
+      hmap::Vec2<float> range);
+
 protected:
   std::map<std::string, int> format_map = {
       // {"binary", hesiod::cnode::export_type::binary},
@@ -1074,13 +1282,21 @@ public:
 
   void compute();
 
+  /**
+   * @brief Return true if file watching is enabled and the imported file has
+   * been modified since it was loaded (hot reload).
+   */
+  bool has_file_changed();
+
 protected:
   hmap::HeightMap value_out = hmap::HeightMap();
 
 private:
-  hmap::Vec2<int> shape;
-  hmap::Vec2<int> tiling;
-  float           overlap;
+  hmap::Vec2<int>                                shape;
+  hmap::Vec2<int>                                tiling;
+  float                                          overlap;
+  std::shared_ptr<const hesiod::io::MappedImage> image = nullptr;
+  hesiod::io::FileKey                            file_key;
 };
 
 class Inverse : public Unary
@@ -1253,6 +1469,8 @@ public:
 
   void compute();
 
+  hmap::Vec4<float> get_changed_region();
+
   void update_inner_bindings();
 
 protected:
@@ -1270,6 +1488,9 @@ public:
 
 protected:
   hmap::Path value_out = hmap::Path();
+
+private:
+  path_finding::CostField cost_field;
 };
 
 class PathToHeightmap : virtual public ControlNode
@@ -1483,6 +1704,16 @@ public:
 
   void compute_in_out(hmap::HeightMap &h_out, hmap::HeightMap *p_h_in);
 
+  bool records_statistics();
+
+  void serialize_statistics(nlohmann::json &data);
+
+  bool deserialize_statistics(const nlohmann::json &data);
+
+protected:
+  // input value range, recorded during whole domain evaluations and reused
+  // for regions
+  hmap::Vec2<float> range_in = {0.f, 1.f};
 };
 
 class Rescale : public Unary
@@ -0,0 +1,55 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+
+/**
+ * @file distance_transform.hpp
+ * @brief Exact Euclidean distance transform (separable algorithm of Meijster
+ * et al.), rows and columns being processed concurrently.
+ */
+#pragma once
+#include "highmap.hpp"
+
+namespace hesiod::distance_transform
+{
+
+/**
+ * @brief Return the distance (in pixels) to the closest feature cell, feature
+ * cells being the cells with a value larger than 0 (or smaller than or equal
+ * to 0 if reverse is true).
+ *
+ * @param array Input array.
+ * @param reverse Swap feature and background cells.
+ * @return hmap::Array Distance (0 everywhere if there is no feature cell).
+ */
+hmap::Array edt(const hmap::Array &array, bool reverse = false);
+
+/**
+ * @brief Return the signed distance to the feature boundaries: positive
+ * outside the features and negative inside.
+ *
+ * @param array Input array.
+ * @param reverse Swap feature and background cells.
+ * @return hmap::Array Signed distance.
+ */
+hmap::Array signed_edt(const hmap::Array &array, bool reverse = false);
+
+/**
+ * @brief Replace the heightmap by its (signed or unsigned) distance transform,
+ * computed over the whole domain. At full resolution, the cells are read from
+ * and written back to the tiles directly (no gathering of the heightmap).
+ *
+ * @param h Heightmap (in/out).
+ * @param reverse Swap feature and background cells.
+ * @param signed_distance Return a signed distance.
+ * @param shape Working resolution, the transform being computed on the
+ * heightmap resampled at this resolution (distances in pixels of the working
+ * resolution) and interpolated back, full resolution if {0, 0} or larger than
+ * the heightmap shape.
+ */
+void edt(hmap::HeightMap &h,
+         bool             reverse,
+         bool             signed_distance,
+         hmap::Vec2<int>  shape = {0, 0});
+
+} // namespace hesiod::distance_transform
@@ -0,0 +1,127 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+
+/**
+ * @file distributed.hpp
+ * @brief Distributed rendering of a graph over several processes.
+ *
+ * The domain is partitioned into super-tiles. Worker processes load the graph,
+ * render the super-tiles of their rank (super-tile index modulo the number of
+ * workers) as regions of interest, grown by a blending overlap, and write
+ * them to the directory of the run within the tile directory, one file per
+ * export and super-tile (renamed once complete). The coordinator spawns local
+ * workers, or waits for the tiles of workers started on other machines sharing
+ * the tile directory, and then stitches the tiles into the files of the Export
+ * nodes, the overlaps being blended with linear weights.
+ *
+ * Each run has its own directory so that the tiles left by a previous run are
+ * never stitched: the coordinator generates the run identifier of the workers
+ * it spawns, and the same '--run-id' has to be given to the coordinator and
+ * the workers started by hand ('--no-spawn').
+ *
+ * Command line (coordinator, or worker with '--rank'):
+ *
+ * hesiod --render state.json [--shape nx ny] [--super-tile n] [--overlap n]
+ *        [--workers n] [--dir path] [--run-id id] [--no-spawn] [--rank k]
+ */
+#pragma once
+#include <string>
+#include <vector>
+
+#include "highmap.hpp"
+
+namespace hesiod::distributed
+{
+
+struct RenderSettings
+{
+  std::string     state_fname = "";
+  hmap::Vec2<int> shape = {4096, 4096};
+  int             super_tile = 1024;
+  int             overlap = 16; ///< Blending overlap (in cells).
+  int             nworkers = 4; ///< Number of workers.
+  int             rank = -1;    ///< Worker rank, -1 for the coordinator.
+  bool            spawn = true; ///< Spawn local workers (coordinator).
+  std::string     dir = "render_tiles";
+  std::string     run_id = ""; ///< Run identifier (tiles sub-directory).
+};
+
+/**
+ * @brief Parse the command line arguments ('--render' mode).
+ *
+ * @return true Success.
+ * @return false Invalid arguments.
+ */
+bool parse_arguments(int argc, char *argv[], RenderSettings &settings);
+
+/**
+ * @brief Return a new run identifier (time and process based).
+ */
+std::string new_run_id();
+
+/**
+ * @brief Return the directory of the tiles of the run.
+ */
+std::string run_dir(const RenderSettings &settings);
+
+/**
+ * @brief Return the name of the file of a super-tile.
+ */
+std::string tile_fname(const RenderSettings &settings,
+                       int                   export_index,
+                       int                   tile_index);
+
+/**
+ * @brief Return the cell range of a super-tile grown by the blending overlap
+ * (clamped to the grid).
+ */
+hmap::Vec4<int> grow_cells(const hmap::Vec4<int> &cells,
+                           int                    overlap,
+                           hmap::Vec2<int>        shape);
+
+/**
+ * @brief Return the blending weight of a grown super-tile at a cell, linearly
+ * decreasing over the overlap towards the edges of the super-tile (edges on
+ * the grid boundary excepted).
+ */
+float blending_weight(const hmap::Vec4<int> &cells_grown,
+                      int                    overlap,
+                      hmap::Vec2<int>        shape,
+                      int                    i,
+                      int                    j);
+
+/**
+ * @brief Write a super-tile file (written under a temporary name and renamed
+ * once complete).
+ */
+void write_tile(const std::string     &fname,
+                const hmap::Array     &array,
+                const hmap::Vec4<int> &cells);
+
+/**
+ * @brief Read a super-tile file.
+ *
+ * @return true Success.
+ * @return false Missing or invalid file.
+ */
+bool read_tile(const std::string &fname,
+               hmap::Array       &array,
+               hmap::Vec4<int>   &cells);
+
+/**
+ * @brief Start the local workers and wait for their completion.
+ *
+ * @param executable Executable of the workers (this program).
+ * @param settings Render settings.
+ * @return true All the workers succeeded.
+ */
+bool run_workers(const std::string &executable, const RenderSettings &settings);
+
+/**
+ * @brief Wait for the files of all the super-tiles (workers not spawned by
+ * the coordinator).
+ */
+void wait_tiles(const RenderSettings &settings, int nexports, int ntiles);
+
+} // namespace hesiod::distributed
@@ -0,0 +1,113 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+
+/**
+ * @file export_queue.hpp
+ * @brief Background file writes for the export nodes.
+ *
+ * Export nodes snapshot their input and push a write job, the job being
+ * executed by a dedicated I/O thread so that graph updates are not blocked by
+ * array gathering, encoding and disk writes. Jobs are identified by their
+ * target file: a job pushed while another one for the same file is still
+ * queued replaces it (latest wins), only the last snapshot is written.
+ */
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace hesiod::io
+{
+
+enum export_state : int
+{
+  none,    ///< No job for this file.
+  queued,  ///< Waiting for the I/O thread.
+  writing, ///< Being written.
+  done,    ///< Written.
+  failed,  ///< Write failed.
+};
+
+struct ExportStatus
+{
+  int         state = export_state::none;
+  float       progress = 0.f; ///< Progress of the write in [0, 1].
+  float       elapsed = 0.f;  ///< Duration of the last write (in ms).
+  int         coalesced = 0;  ///< Number of jobs replaced by a newer one.
+  std::string message = "";   ///< Error message for failed writes.
+};
+
+class ExportQueue
+{
+public:
+  /**
+   * @brief Job function, executed on the I/O thread, the argument being a
+   * progress reporting function (progress in [0, 1]).
+   */
+  typedef std::function<void(std::function<void(float)>)> Job;
+
+  /**
+   * @brief Return the application-wide export queue (the I/O thread is
+   * started on first use).
+   */
+  static ExportQueue &get_instance();
+
+  ~ExportQueue();
+
+  /**
+   * @brief Push a write job (any thread).
+   *
+   * @param fname Target file, a queued job for the same file is replaced.
+   * @param job Job function, should only use data it owns (snapshots).
+   */
+  void push(const std::string &fname, Job job);
+
+  /**
+   * @brief Return the status of the last job for a file.
+   */
+  ExportStatus get_status(const std::string &fname);
+
+  /**
+   * @brief Return the number of jobs queued or being written.
+   */
+  int get_pending_count();
+
+  /**
+   * @brief Return true if jobs are queued or being written.
+   */
+  bool is_busy();
+
+  /**
+   * @brief Block until all the jobs are written.
+   */
+  void wait();
+
+  /**
+   * @brief Set a function called on the I/O thread once a job is over
+   * (written or failed), for instance to wake the GUI up so that the status
+   * is displayed (nullptr to remove it).
+   */
+  void set_on_job_done(std::function<void()> fct);
+
+private:
+  ExportQueue();
+
+  std::thread                         thread;
+  std::mutex                          mutex;
+  std::condition_variable             cv;
+  std::deque<std::string>             order = {};
+  std::map<std::string, Job>          jobs = {};
+  std::map<std::string, ExportStatus> status = {};
+  std::string                         current_fname = "";
+  bool                                stop = false;
+  std::function<void()>               on_job_done = nullptr;
+
+  void run();
+};
+
+} // namespace hesiod::io
@@ -15,6 +15,13 @@
 
 #include "hesiod/view_tree.hpp"
 
+// number of frames rendered after an event before going idle (lets ImGui
+// settle hovering states, window layouts...)
+#define GUI_IDLE_FRAMES 3
+
+// maximum waiting time (in seconds) of the event loop when idle
+#define GUI_IDLE_TIMEOUT 0.5
+
 namespace hesiod::gui
 {
 
@@ -26,10 +33,34 @@ enum icon_type : int
 
 void glfw_error_callback(int error, const char *description);
 
-GLFWwindow *init_gui(int width, int height, std::string window_title);
+/**
+ * @brief Create the window and initialize the GUI.
+ *
+ * @param visible Window visibility (an invisible window still provides the
+ * OpenGL context, e.g. for command line rendering).
+ */
+GLFWwindow *init_gui(int         width,
+                     int         height,
+                     std::string window_title,
+                     bool        visible = true);
 
 void save_screenshot(std::string fname);
 
+/**
+ * @brief Wake the GUI event loop up when it is idle, can be called from any
+ * thread (for instance when a background task completes).
+ */
+void request_redraw();
+
+/**
+ * @brief Wait for the next event (input, redraw request or timeout) when the
+ * GUI is idle, otherwise only process the pending events.
+ *
+ * @param animated Whether some content is animated and needs to be rendered
+ * continuously.
+ */
+void wait_events(bool animated);
+
 // main GUI
 void main_dock(hesiod::vnode::ViewTree &view_tree);
 
@@ -59,11 +90,15 @@ bool drag_float_vector(std::vector<float> &vector,
 
 void draw_icon(int icon_type, ImVec2 size, ImU32 color, bool filled);
 
+void export_status(std::string fname, float width = 0.f);
+
 void flip_vertically(int width, int height, uint8_t *data);
 
 void help_marker(std::string text);
 
-bool hmap_brush_editor(hmap::HeightMap &h, float width = 0.f);
+bool hmap_brush_editor(hmap::HeightMap   &h,
+                       float              width = 0.f,
+                       hmap::Vec4<float> *p_region = nullptr);
 
 bool listbox_map_enum(std::map<std::string, int> &map,
                       int                        &selected,
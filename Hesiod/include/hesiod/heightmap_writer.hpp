@@ -0,0 +1,192 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+
+/**
+ * @file heightmap_writer.hpp
+ * @brief Heightmap file writers streaming directly from the tiles.
+ *
+ * The full array is never assembled: the heightmap is written band by band
+ * (contiguous rows of the output image), the cells of a band being read from
+ * the tiles (overlaps resolved by the tile lookup of the region module).
+ * Bands are processed concurrently, the memory footprint being a few bands
+ * per thread whatever the heightmap size.
+ *
+ * Output layouts are those of the hmap::Array writers: images (PNG and raw 16
+ * bit) are normalized in [0, 1], the first image row being the top of the
+ * heightmap (largest j index), binary files contain the raw float values in
+ * the array storage order.
+ *
+ * @link BlockWriter writes the same files from blocks of cells produced one
+ * after the other (out-of-core evaluation), without ever holding the whole
+ * heightmap.
+ *
+ * @link write_mip_chain writes downsampled versions of a heightmap (mip chain,
+ * level l having a resolution divided by 2^l) in a single pass over the
+ * tiles, each level being computed from the previous one as the rows are
+ * streamed.
+ */
+#pragma once
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "highmap.hpp"
+
+// number of image rows per band
+#define WRITER_BAND_ROWS 64
+
+// zlib compression level of the PNG writer
+#define WRITER_PNG_LEVEL 6
+
+namespace hesiod::io
+{
+
+// same values as hesiod::cnode::export_type
+enum file_format : int
+{
+  binary,
+  png8bit,
+  png16bit,
+  raw16bit,
+};
+
+/**
+ * @brief Write a heightmap as a grayscale PNG image, PNG compression being
+ * done in parallel (each band is deflated independently, the zlib stream
+ * being the concatenation of the flushed band streams).
+ *
+ * @param h Heightmap.
+ * @param fname File name.
+ * @param bit_depth Bit depth, 8 or 16.
+ * @param progress Progress reporting function (progress in [0, 1]).
+ */
+void write_png_grayscale(const hmap::HeightMap     &h,
+                         const std::string         &fname,
+                         int                        bit_depth = 16,
+                         std::function<void(float)> progress = nullptr);
+
+/**
+ * @brief Write a heightmap as a raw 16 bit image (little endian, no header),
+ * bands being written concurrently at their offset in the preallocated file.
+ *
+ * @param h Heightmap.
+ * @param fname File name.
+ * @param progress Progress reporting function (progress in [0, 1]).
+ */
+void write_raw_16bit(const hmap::HeightMap     &h,
+                     const std::string         &fname,
+                     std::function<void(float)> progress = nullptr);
+
+/**
+ * @brief Write the heightmap values as raw floats (same layout as
+ * hmap::Array::to_file), bands being written concurrently at their offset in
+ * the preallocated file.
+ *
+ * @param h Heightmap.
+ * @param fname File name.
+ * @param progress Progress reporting function (progress in [0, 1]).
+ */
+void write_binary(const hmap::HeightMap     &h,
+                  const std::string         &fname,
+                  std::function<void(float)> progress = nullptr);
+
+class PngStream;
+
+class BlockWriter
+{
+public:
+  /**
+   * @brief Create the file, blocks being then written with @link write_block.
+   *
+   * @param fname File name.
+   * @param format File format (see @link file_format).
+   * @param shape Shape of the whole heightmap.
+   * @param range Value range mapped to [0, 1] for image formats (values
+   * outside are clamped), the global range being not known before the end of
+   * the evaluation.
+   */
+  BlockWriter(const std::string &fname,
+              int                format,
+              hmap::Vec2<int>    shape,
+              hmap::Vec2<float>  range);
+
+  ~BlockWriter();
+
+  /**
+   * @brief Write a block of cells.
+   *
+   * Blocks can be written in any order for the raw formats. PNG images being
+   * written row by row, the blocks of a given band of j indices must be
+   * written before the next one, from the top band (largest j) to the bottom
+   * one, the blocks of a band being buffered until it is complete.
+   *
+   * @param block Cell values.
+   * @param ij0 Index of the first cell of the block in the whole heightmap.
+   */
+  void write_block(const hmap::Array &block, hmap::Vec2<int> ij0);
+
+  /**
+   * @brief Finalize the file, all the cells are expected to be written.
+   */
+  void close();
+
+private:
+  std::string                fname;
+  int                        format;
+  hmap::Vec2<int>            shape;
+  hmap::Vec2<float>          range;
+  int                        fd = -1;
+  std::unique_ptr<PngStream> png;
+  hmap::Array                band;           // PNG band being assembled
+  int                        band_j0 = 0;    // first j index of the band
+  size_t                     band_count = 0; // number of cells received
+  int                        j_top;          // top of the bands not written
+
+  float normalize(float v) const;
+};
+
+/**
+ * @brief Return the file name of a mip level, the level index being appended
+ * to the file stem ('export.png' becomes 'export_lod2.png' for level 2, level
+ * 0 keeping the file name).
+ */
+std::string mip_level_fname(const std::string &fname, int level);
+
+/**
+ * @brief Return the shape of a mip level (shape divided by 2^level, rounded
+ * up).
+ */
+hmap::Vec2<int> mip_level_shape(hmap::Vec2<int> shape, int level);
+
+/**
+ * @brief Return the number of levels of the full mip chain (down to a single
+ * cell, full resolution level included).
+ */
+int mip_chain_length(hmap::Vec2<int> shape);
+
+/**
+ * @brief Write mip levels of a heightmap, one file per level (see @link
+ * mip_level_fname), in a single pass over the tiles.
+ *
+ * Base rows are read band by band from the top, each level being obtained
+ * from the previous one with a 2x2 box filter (area average, cells outside
+ * the domain excluded for odd shapes) as the rows are received, so that the
+ * memory footprint remains a few bands per level. The completed blocks of the
+ * levels are written concurrently. All the levels share the value range of
+ * the heightmap for image formats.
+ *
+ * @param h Heightmap.
+ * @param fname File name (level 0).
+ * @param format File format (see @link file_format).
+ * @param levels Levels written (0 being the full resolution).
+ * @param progress Progress reporting function (progress in [0, 1]).
+ */
+void write_mip_chain(const hmap::HeightMap     &h,
+                     const std::string         &fname,
+                     int                        format,
+                     const std::vector<int>    &levels,
+                     std::function<void(float)> progress = nullptr);
+
+} // namespace hesiod::io
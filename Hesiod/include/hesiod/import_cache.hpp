@@ -0,0 +1,130 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+
+/**
+ * @file import_cache.hpp
+ * @brief Decoded image cache of the Import nodes.
+ *
+ * Source images are decoded once and stored as raw floats in a cache file of
+ * the temporary directory, the file being then memory-mapped: node
+ * recomputes resample the mapped values directly into the heightmap tiles,
+ * without reading or decoding the image again, and the decoded data are
+ * shared by the nodes importing the same file (and by later sessions). An
+ * image is identified by its path, size and modification time, the image
+ * being decoded again whenever it changes on disk.
+ *
+ * The modification time of a cache file is refreshed each time it is used.
+ * Files unused for @link IMPORT_CACHE_MAX_AGE_DAYS are removed, the least
+ * recently used ones being also removed while the cache directory exceeds
+ * @link IMPORT_CACHE_MAX_SIZE_MB.
+ */
+#pragma once
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "highmap.hpp"
+
+// decoded images cache directory (within the temporary directory)
+#define IMPORT_CACHE_DIR "hesiod_import_cache"
+
+// cache files unused for longer are removed
+#define IMPORT_CACHE_MAX_AGE_DAYS 30
+
+// maximum size of the cache directory (in MB)
+#define IMPORT_CACHE_MAX_SIZE_MB 4096
+
+namespace hesiod::io
+{
+
+struct FileKey
+{
+  std::string path = "";
+  uintmax_t   size = 0;
+  long long   mtime = 0; ///< Modification time (file clock ticks).
+
+  bool operator==(const FileKey &other) const = default;
+};
+
+/**
+ * @brief Get the key of a file (canonical path, size and modification time).
+ *
+ * @return true Success.
+ * @return false Missing file.
+ */
+bool get_file_key(const std::string &fname, FileKey &key);
+
+class MappedImage
+{
+public:
+  /**
+   * @brief Map a decoded image cache file (read-only).
+   */
+  MappedImage(const std::string &cache_fname);
+
+  ~MappedImage();
+
+  MappedImage(const MappedImage &) = delete;
+
+  MappedImage &operator=(const MappedImage &) = delete;
+
+  hmap::Vec2<int> get_shape() const;
+
+  /**
+   * @brief Return the bilinear interpolation of the values at a position, in
+   * cell units of the image.
+   */
+  float interp(float x, float y) const;
+
+  /**
+   * @brief Resample the image to the heightmap tiles (bilinear
+   * interpolation, tiles processed concurrently), the image spanning the
+   * whole domain.
+   */
+  void resample(hmap::HeightMap &h) const;
+
+private:
+  hmap::Vec2<int>    shape = {0, 0};
+  const float       *data = nullptr;
+  void              *p_map = nullptr; // whole mapped file
+  size_t             map_size = 0;
+  std::vector<float> buffer = {}; // platforms without mmap
+};
+
+class ImageCache
+{
+public:
+  /**
+   * @brief Return the application-wide decoded image cache.
+   */
+  static ImageCache &get_instance();
+
+  /**
+   * @brief Return the decoded image of a file, decoding it only if not
+   * cached yet or changed on disk.
+   *
+   * @param fname Image file.
+   * @param key Key of the file when decoded (output).
+   * @return std::shared_ptr<const MappedImage> Image, nullptr if the file
+   * does not exist or cannot be decoded.
+   */
+  std::shared_ptr<const MappedImage> get(const std::string &fname,
+                                         FileKey           &key);
+
+private:
+  ImageCache() = default;
+
+  std::mutex mutex;
+  std::map<std::string, std::pair<FileKey, std::shared_ptr<const MappedImage>>>
+       entries = {}; // by canonical path
+  bool is_evicted = false; // eviction done at least once during the session
+
+  // remove the old cache files and the least recently used ones above the
+  // size limit, the files used by the session being kept (lock held)
+  void evict();
+};
+
+} // namespace hesiod::io
@@ -0,0 +1,200 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+
+/**
+ * @file live_link.hpp
+ * @brief Live link, node outputs published in a POSIX shared-memory segment
+ * for external tools (game engines...).
+ *
+ * Segment layout: a @link LiveLinkHeader followed by @link LIVE_LINK_NSLOTS
+ * data slots used as a ring buffer, generation g being written in the slot
+ * g % nslots. Data are stored as float32 values in the HighMap storage order
+ * (value (i, j) at index i * ny + j), channels being stored one after the
+ * other (RGB). Heightmaps are copied tile by tile, each tile writing its own
+ * cells by contiguous runs, without gathering the whole array first.
+ *
+ * Synchronization is lock-free: a slot generation is set to zero while the
+ * slot is written and to its generation once complete (sequence lock), the
+ * header generation being the last complete one. Readers copy the slot of
+ * the last generation and check that the slot generation did not change
+ * during the copy. When the data do not fit in the slots anymore, the segment
+ * grows (all slots invalidated), readers remapping it when needed.
+ *
+ * The segment only relies on the layout below, any process mapping it can
+ * read the data (see @link LiveLinkReader and the sample consumer in
+ * 'live_link_consumer').
+ *
+ * A restarted publisher replaces the segment by a new one with the same name,
+ * readers still mapping the previous one detect it with
+ * @link LiveLinkReader::is_stale and reopen the segment.
+ */
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "highmap.hpp"
+
+// default name of the shared-memory segment
+#define LIVE_LINK_NAME "/hesiod_live_link"
+
+// number of slots of the ring buffer
+#define LIVE_LINK_NSLOTS 3
+
+#define LIVE_LINK_MAGIC 0x4c4c5348 // "HSLL"
+#define LIVE_LINK_VERSION 1
+
+namespace hesiod::io
+{
+
+enum live_link_dtype : int32_t
+{
+  live_heightmap = 0,     ///< 1 channel (elevation).
+  live_heightmap_rgb = 1, ///< 3 channels (red, green, blue in [0, 1]).
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "live link requires lock-free 64 bit atomics");
+
+struct LiveLinkSlot
+{
+  std::atomic<uint64_t> generation; ///< 0 while being written.
+  int64_t               timestamp;  ///< Publication (steady clock, in ns).
+  int32_t               dtype;      ///< See @link live_link_dtype.
+  int32_t               nchannels;
+  int32_t               nx;
+  int32_t               ny;
+  float                 vmin; ///< Value range (first channel).
+  float                 vmax;
+  uint64_t              offset; ///< Data offset from the segment start.
+};
+
+struct LiveLinkHeader
+{
+  uint32_t              magic;
+  uint32_t              version;
+  std::atomic<uint64_t> generation;    ///< Last complete generation (0: none).
+  std::atomic<uint64_t> segment_size;  ///< Current segment size (in bytes).
+  uint64_t              slot_capacity; ///< Data size of a slot (in bytes).
+  uint32_t              nslots;
+  uint32_t              padding;
+  LiveLinkSlot          slots[LIVE_LINK_NSLOTS];
+};
+
+struct LiveLinkFrame
+{
+  uint64_t           generation = 0;
+  int64_t            timestamp = 0;
+  int                dtype = live_heightmap;
+  int                nchannels = 0;
+  hmap::Vec2<int>    shape = {0, 0};
+  hmap::Vec2<float>  range = {0.f, 0.f};
+  std::vector<float> data = {};
+};
+
+/**
+ * @brief Return the current time of the steady clock used for the frame
+ * timestamps (in ns).
+ */
+int64_t live_link_now();
+
+class LiveLinkPublisher
+{
+public:
+  /**
+   * @brief Create the shared-memory segment (replacing any previous segment
+   * with the same name).
+   *
+   * @param name Segment name.
+   */
+  LiveLinkPublisher(const std::string &name = LIVE_LINK_NAME);
+
+  /**
+   * @brief Unmap and remove the segment, readers keeping their mapping until
+   * they close it.
+   */
+  ~LiveLinkPublisher();
+
+  /**
+   * @brief Publish a heightmap (tiles copied concurrently).
+   *
+   * @return uint64_t Generation of the published data.
+   */
+  uint64_t publish(const hmap::HeightMap &h);
+
+  /**
+   * @brief Publish an RGB heightmap (3 channels).
+   *
+   * @return uint64_t Generation of the published data.
+   */
+  uint64_t publish(const hmap::HeightMapRGB &c);
+
+private:
+  std::string     name;
+  int             fd = -1;
+  LiveLinkHeader *p_header = nullptr;
+  size_t          mapped_size = 0;
+
+  // start writing the next slot, the segment growing if needed
+  LiveLinkSlot &begin_slot(int             dtype,
+                           int             nchannels,
+                           hmap::Vec2<int> shape,
+                           uint64_t       &generation);
+
+  // publish the slot written
+  void end_slot(LiveLinkSlot &slot, uint64_t generation);
+
+  void map(size_t size);
+
+  float *get_data(const LiveLinkSlot &slot);
+};
+
+class LiveLinkReader
+{
+public:
+  /**
+   * @brief Open an existing segment.
+   *
+   * @param name Segment name.
+   */
+  LiveLinkReader(const std::string &name = LIVE_LINK_NAME);
+
+  ~LiveLinkReader();
+
+  /**
+   * @brief Return the last complete generation (0 if none).
+   */
+  uint64_t get_generation() const;
+
+  /**
+   * @brief Copy the last complete frame if it is newer than a given
+   * generation.
+   *
+   * @param frame Frame (output).
+   * @param last_generation Generation already read.
+   * @return true A newer frame has been read.
+   * @return false No newer frame.
+   */
+  bool read(LiveLinkFrame &frame, uint64_t last_generation = 0);
+
+  /**
+   * @brief Return true if the segment mapped by the reader has been removed or
+   * replaced by a new one (publisher restarted), the reader then has to be
+   * reopened to get the new frames (generations starting over).
+   */
+  bool is_stale() const;
+
+private:
+  std::string     name;
+  int             fd = -1;
+  LiveLinkHeader *p_header = nullptr;
+  size_t          mapped_size = 0;
+  uint64_t        device = 0; ///< Identification of the segment mapped.
+  uint64_t        inode = 0;
+
+  void map(size_t size);
+};
+
+} // namespace hesiod::io
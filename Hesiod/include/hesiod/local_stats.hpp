@@ -0,0 +1,100 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+
+/**
+ * @file local_stats.hpp
+ * @brief Sliding window statistics with a per-pixel cost independent of the
+ * window radius.
+ *
+ * Mean, variance and skewness are computed with summed-area tables, minimum
+ * and maximum with the van Herk/Gil-Werman algorithm. Windows are square, of
+ * size 2 * ir + 1, and truncated at the array borders.
+ */
+#pragma once
+#include "highmap.hpp"
+
+namespace hesiod::local_stats
+{
+
+/**
+ * @brief Window statistic type.
+ */
+enum stat_type : int
+{
+  mean,     ///< mean
+  variance, ///< variance
+  skewness, ///< skewness
+  minimum,  ///< minimum
+  maximum   ///< maximum
+};
+
+/**
+ * @brief Return the local mean of the array.
+ *
+ * @param array Input array.
+ * @param ir Window radius (in pixels), the input being returned if ir <= 0.
+ * @return hmap::Array Local mean.
+ */
+hmap::Array mean_local(const hmap::Array &array, int ir);
+
+/**
+ * @brief Return the local variance of the array.
+ *
+ * @param array Input array.
+ * @param ir Window radius (in pixels).
+ * @return hmap::Array Local variance.
+ */
+hmap::Array variance_local(const hmap::Array &array, int ir);
+
+/**
+ * @brief Return the local skewness of the array (0 where the local variance
+ * vanishes).
+ *
+ * @param array Input array.
+ * @param ir Window radius (in pixels).
+ * @return hmap::Array Local skewness.
+ */
+hmap::Array skewness_local(const hmap::Array &array, int ir);
+
+/**
+ * @brief Return the local minimum of the array.
+ *
+ * @param array Input array.
+ * @param ir Window radius (in pixels).
+ * @return hmap::Array Local minimum.
+ */
+hmap::Array minimum_local(const hmap::Array &array, int ir);
+
+/**
+ * @brief Return the local maximum of the array.
+ *
+ * @param array Input array.
+ * @param ir Window radius (in pixels).
+ * @return hmap::Array Local maximum.
+ */
+hmap::Array maximum_local(const hmap::Array &array, int ir);
+
+/**
+ * @brief Return a window statistic, reusing a previous result when the same
+ * statistic has already been computed for an identical array and radius
+ * (for instance when several nodes share the same input). Arrays are
+ * identified by their shape and a checksum of their values, a sample of the
+ * values being compared before a result is reused.
+ *
+ * @param stat Statistic type.
+ * @param array Input array.
+ * @param ir Window radius (in pixels).
+ * @return hmap::Array Statistic.
+ *
+ * @see stat_type
+ */
+hmap::Array get_cached(int stat, const hmap::Array &array, int ir);
+
+/**
+ * @brief Drop every cached result (called when nodes are removed or the tree
+ * is reset).
+ */
+void clear_cache();
+
+} // namespace hesiod::local_stats
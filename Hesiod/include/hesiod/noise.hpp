@@ -0,0 +1,169 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+
+/**
+ * @file noise.hpp
+ * @brief Batched coherent noise, cellular noise and sine wave kernels.
+ *
+ * Samples are evaluated row by row on contiguous coordinate buffers, with
+ * branch-free kernels (integer hashing, structure-of-arrays gradient tables)
+ * the compiler turns into SIMD code. On x86 with GCC, each kernel is compiled
+ * for several instruction sets (SSE4.2, AVX2/FMA, AVX-512) and the best one
+ * is selected at runtime.
+ *
+ * Perlin and simplex noises, and their fractal layerings, perform the same
+ * operations as the FastNoiseLite code used by the HighMap functions (hashing,
+ * gradient table, simplex skewing, octave weighting), multiply-adds not being
+ * fused. Worley noises use their own jittered-grid feature points and do not
+ * reproduce the HighMap point distribution. Primitives of projects saved
+ * before these kernels still use the HighMap functions (see
+ * PRIMITIVE_KERNEL_VERSION).
+ *
+ * Noise coordinates of the cell (i, j) of a tile are:
+ *
+ * X = kw.x * x_i * stretching(i, j) + dx(i, j)
+ * Y = kw.y * y_j * stretching(i, j) + dy(i, j)
+ *
+ * with (x_i, y_j) the cell position in the unit square (the warping and
+ * stretching heightmaps being optional). Positions are derived from the
+ * global cell indices, so the output does not depend on the tiling.
+ *
+ * Cellular (Worley) noises use a jittered grid: each integer cell of the
+ * noise domain holds one feature point, generated on the fly from a hash of
+ * the cell indices, and the jitter is bounded so that the closest point is
+ * always found within the 3 x 3 neighboring cells.
+ */
+#pragma once
+#include "highmap.hpp"
+
+namespace hesiod::noise
+{
+
+enum noise_type : int
+{
+  perlin,
+  simplex,
+  value_linear,
+  worley,        ///< Distance to the closest feature point.
+  worley_double, ///< Smooth maximum of two Worley noises.
+  worley_value   ///< Value of the closest feature point.
+};
+
+enum fractal_type : int
+{
+  none,     ///< Single octave.
+  fbm,      ///< Fractional Brownian motion.
+  ridged,   ///< Ridged multifractal.
+  billow,   ///< Single octave, absolute value.
+  pingpong, ///< Ping-pong fractal.
+  iq        ///< Fbm damped by the accumulated gradient (Inigo Quilez).
+};
+
+/**
+ * @brief Fractal layering parameters.
+ */
+struct FractalParameters
+{
+  int   octaves = 1;
+  float weight = 0.f;      ///< Octave amplitude weighting by the octave value.
+  float persistence = 0.5f;
+  float lacunarity = 2.f;
+  float gradient_weight = 0.f; ///< Gradient damping ('iq' only).
+  float value_weight = 0.f;    ///< Value damping ('iq' only).
+};
+
+/**
+ * @brief Cellular noise parameters ('worley_double' only).
+ */
+struct CellularParameters
+{
+  float ratio = 0.5f; ///< Amplitude ratio between the two noises.
+  float k = 0.05f;    ///< Smoothing parameter of the maximum.
+};
+
+/**
+ * @brief Evaluate a base noise for n samples.
+ *
+ * @param type Noise type.
+ * @param x Noise coordinates, x component.
+ * @param y Noise coordinates, y component.
+ * @param out Output values, roughly in [-1, 1].
+ * @param n Number of samples.
+ * @param seed Random seed number.
+ * @param cellular Cellular noise parameters.
+ */
+void noise_batch(noise_type                type,
+                 const float              *x,
+                 const float              *y,
+                 float                    *out,
+                 int                       n,
+                 uint                      seed,
+                 const CellularParameters &cellular = CellularParameters());
+
+/**
+ * @brief Evaluate a fractal noise for n samples.
+ *
+ * @param type Base noise type ('iq' fractals always use Perlin noise).
+ * @param fractal Fractal type.
+ * @param x Noise coordinates, x component.
+ * @param y Noise coordinates, y component.
+ * @param out Output values.
+ * @param n Number of samples.
+ * @param seed Random seed number (incremented at each octave).
+ * @param params Fractal parameters.
+ * @param cellular Cellular noise parameters.
+ */
+void fractal_batch(noise_type                type,
+                   fractal_type              fractal,
+                   const float              *x,
+                   const float              *y,
+                   float                    *out,
+                   int                       n,
+                   uint                      seed,
+                   const FractalParameters  &params,
+                   const CellularParameters &cellular = CellularParameters());
+
+/**
+ * @brief Fill the heightmap with a (fractal) noise, tiles rows being
+ * processed concurrently.
+ *
+ * @param h Heightmap (output).
+ * @param type Base noise type.
+ * @param fractal Fractal type.
+ * @param kw Noise wavenumbers.
+ * @param seed Random seed number.
+ * @param params Fractal parameters.
+ * @param p_dx Warping along x (can be nullptr).
+ * @param p_dy Warping along y (can be nullptr).
+ * @param p_stretching Local coordinate stretching (can be nullptr).
+ * @param cellular Cellular noise parameters.
+ */
+void fill_noise(hmap::HeightMap          &h,
+                noise_type                type,
+                fractal_type              fractal,
+                hmap::Vec2<float>         kw,
+                uint                      seed,
+                const FractalParameters  &params = FractalParameters(),
+                hmap::HeightMap          *p_dx = nullptr,
+                hmap::HeightMap          *p_dy = nullptr,
+                hmap::HeightMap          *p_stretching = nullptr,
+                const CellularParameters &cellular = CellularParameters());
+
+/**
+ * @brief Fill the heightmap with a sine wave (cosine profile, crest at a zero
+ * phase).
+ *
+ * @param h Heightmap (output).
+ * @param kw Wavenumber.
+ * @param angle Wave direction (in degrees).
+ * @param phase_shift Phase shift (in degrees).
+ * @param p_dx Phase warping, in periods (can be nullptr).
+ */
+void fill_wave_sine(hmap::HeightMap &h,
+                    float            kw,
+                    float            angle,
+                    float            phase_shift,
+                    hmap::HeightMap *p_dx = nullptr);
+
+} // namespace hesiod::noise
@@ -0,0 +1,118 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+
+/**
+ * @file output_cache.hpp
+ * @brief Node output files of the on-disk output cache.
+ *
+ * The outputs of the nodes are stored in a cache directory next to the
+ * project file, one file per output port, named after a key identifying the
+ * computation (hash of the node type, attributes, input keys and storage
+ * settings, see @link hesiod::vnode::ViewTree::get_output_cache_keys). A file
+ * holds its key, the storage settings and the raw values of each tile, files
+ * being memory-mapped when read back.
+ *
+ * Frozen nodes are keyed by a hash of their outputs instead. Statistics
+ * recorded by the nodes during whole domain updates (value ranges of the
+ * remapping...) are stored in a JSON file along with the outputs.
+ *
+ * Keys are 64 bit FNV-1a hashes (stable across builds and platforms) salted
+ * with @link OUTPUT_CACHE_VERSION, to be incremented whenever a change of the
+ * node computations invalidates the outputs already cached.
+ */
+#pragma once
+#include <string>
+
+#include <nlohmann/json.hpp>
+
+#include "highmap.hpp"
+
+// sidecar cache directory suffix (appended to the project file name)
+#define OUTPUT_CACHE_SUFFIX ".cache"
+
+// implementation version, part of the keys
+#define OUTPUT_CACHE_VERSION 2
+
+namespace hesiod::io
+{
+
+/**
+ * @brief Return a hash of a string salted with the cache version, as a 16
+ * digit hexadecimal string.
+ */
+std::string hash_string(const std::string &str);
+
+/**
+ * @brief Return a hash of the storage settings and the values of a heightmap
+ * (see hash_string).
+ */
+std::string hash_heightmap(const hmap::HeightMap &h);
+
+/**
+ * @brief Return the cache file of a node output.
+ */
+std::string output_cache_fname(const std::string &dir,
+                               const std::string &key,
+                               const std::string &port_id);
+
+/**
+ * @brief Write a heightmap to a cache file (written under a temporary name and
+ * renamed once complete, nothing done if the file already exists).
+ *
+ * @param fname File name.
+ * @param key Key of the output, stored in the file header.
+ * @param h Heightmap.
+ */
+void write_heightmap_cache(const std::string     &fname,
+                           const std::string     &key,
+                           const hmap::HeightMap &h);
+
+/**
+ * @brief Read a heightmap from a cache file.
+ *
+ * @param fname File name.
+ * @param key Key of the output, must match the one stored in the file.
+ * @param h Heightmap, its storage settings (shape, tiling, overlap) must match
+ * the ones of the file.
+ * @return true Success.
+ * @return false Missing file, key or storage mismatch, the heightmap is left
+ * untouched.
+ */
+bool read_heightmap_cache(const std::string &fname,
+                          const std::string &key,
+                          hmap::HeightMap   &h);
+
+/**
+ * @brief Return the cache file of the statistics recorded by a node.
+ */
+std::string statistics_cache_fname(const std::string &dir,
+                                   const std::string &key);
+
+/**
+ * @brief Write the statistics recorded by a node to a cache file (written
+ * under a temporary name and renamed once complete, nothing done if the file
+ * already exists).
+ *
+ * @param fname File name.
+ * @param key Key of the node, stored in the file.
+ * @param data Statistics.
+ */
+void write_statistics_cache(const std::string    &fname,
+                            const std::string    &key,
+                            const nlohmann::json &data);
+
+/**
+ * @brief Read the statistics recorded by a node from a cache file.
+ *
+ * @param fname File name.
+ * @param key Key of the node, must match the one stored in the file.
+ * @param data Statistics (output).
+ * @return true Success.
+ * @return false Missing or unreadable file, or key mismatch.
+ */
+bool read_statistics_cache(const std::string &fname,
+                           const std::string &key,
+                           nlohmann::json    &data);
+
+} // namespace hesiod::io
@@ -0,0 +1,46 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+#pragma once
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace hesiod
+{
+
+/**
+ * @brief Split the index range [0, n) into contiguous chunks and process them
+ * concurrently, 'fct(k_start, k_end)' being called once per chunk.
+ *
+ * @param n Range size.
+ * @param fct Function processing the indices [k_start, k_end).
+ * @param nthreads Number of threads (hardware concurrency if 0).
+ */
+inline void parallel_for(int                           n,
+                         std::function<void(int, int)> fct,
+                         int                           nthreads = 0)
+{
+  if (nthreads <= 0)
+    nthreads = (int)std::max(1u, std::thread::hardware_concurrency());
+  nthreads = std::min(nthreads, n);
+
+  if (nthreads <= 1)
+  {
+    if (n > 0)
+      fct(0, n);
+    return;
+  }
+
+  std::vector<std::thread> threads = {};
+  int                      chunk = (n + nthreads - 1) / nthreads;
+
+  for (int k = 0; k < n; k += chunk)
+    threads.push_back(std::thread(fct, k, std::min(n, k + chunk)));
+
+  for (auto &t : threads)
+    t.join();
+}
+
+} // namespace hesiod
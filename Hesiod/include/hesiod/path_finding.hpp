@@ -0,0 +1,135 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+
+/**
+ * @file path_finding.hpp
+ * @brief Coarse-to-fine A* path finding on heightmaps.
+ *
+ * The lowest cost path is first solved on the coarsest level of an elevation
+ * pyramid and then refined level by level, at each level within a corridor
+ * around the path found at the level above, up to the full resolution.
+ *
+ * The cost of a step between two neighboring cells is:
+ *
+ * (1 - elevation_ratio) * (step length in cells)^distance_exponent * l +
+ * elevation_ratio * |dz|
+ *
+ * with l the length of a cell of the level in cells of the reference shape
+ * (the 'shape' attribute of the node) and dz the normalized elevation
+ * difference. At the reference resolution this is the cost of the former
+ * single-resolution Dijkstra search (distances in cells), so that a given
+ * elevation_ratio keeps the same trade-off. The A* heuristic combines an octile distance and the
+ * elevation difference to the goal, which is admissible for
+ * distance_exponent <= 2.
+ */
+#pragma once
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+#include "highmap.hpp"
+
+namespace hesiod::path_finding
+{
+
+/**
+ * @brief Multi-resolution cost field, built from the input heightmap and kept
+ * between two computations as long as the heightmap does not change.
+ */
+struct CostField
+{
+  /**
+   * @brief Elevation pyramid (level 0 is the full resolution, normalized
+   * elevation in [0, 1]).
+   */
+  std::vector<hmap::Array> z_levels = {};
+
+  /**
+   * @brief No-go mask pyramid (empty if no mask is used).
+   */
+  std::vector<hmap::Array> mask_levels = {};
+
+  /**
+   * @brief Checksum of the data the field has been built from.
+   */
+  uint64_t checksum = 0;
+
+  /**
+   * @brief Shape distances are measured in (see the cost definition).
+   */
+  hmap::Vec2<int> shape_reference = {0, 0};
+
+  /**
+   * @brief Solved segments at full resolution, by start / end cell indices.
+   */
+  std::map<std::tuple<int, int, int, int>, std::vector<hmap::Vec2<int>>>
+      segments = {};
+
+  /**
+   * @brief Parameters used to solve the segments.
+   */
+  float elevation_ratio = -1.f;
+  float distance_exponent = -1.f;
+
+  std::mutex mutex;
+};
+
+/**
+ * @brief Return a checksum of the heightmap data (tile by tile, no gathering).
+ *
+ * @param h Heightmap.
+ * @return uint64_t Checksum.
+ */
+uint64_t heightmap_checksum(hmap::HeightMap &h);
+
+/**
+ * @brief (Re)build the cost field pyramid if the input data have changed.
+ *
+ * @param field Cost field.
+ * @param h Input heightmap.
+ * @param p_mask No-go mask (cells with a value larger than 0.5 are avoided),
+ * can be nullptr.
+ * @param shape_coarse Maximum shape of the coarsest level.
+ */
+void update_cost_field(CostField       &field,
+                       hmap::HeightMap &h,
+                       hmap::HeightMap *p_mask,
+                       hmap::Vec2<int>  shape_coarse);
+
+/**
+ * @brief Find the lowest cost path between two cells of the full resolution
+ * level.
+ *
+ * @param field Cost field.
+ * @param ij_start Start cell.
+ * @param ij_end End cell.
+ * @param elevation_ratio Weight of the elevation difference in the cost.
+ * @param distance_exponent Exponent applied to the step lengths.
+ * @return std::vector<hmap::Vec2<int>> Cells of the path, start and end
+ * included (empty if no path exists).
+ */
+std::vector<hmap::Vec2<int>> find_path(const CostField &field,
+                                       hmap::Vec2<int>  ij_start,
+                                       hmap::Vec2<int>  ij_end,
+                                       float            elevation_ratio,
+                                       float            distance_exponent);
+
+/**
+ * @brief Replace the path by the lowest cost paths joining its points, each
+ * segment being solved in parallel and segments already known by the cost
+ * field being reused.
+ *
+ * @param field Cost field (updated with the new segments).
+ * @param path Path (in/out), coordinates in the unit square.
+ * @param elevation_ratio Weight of the elevation difference in the cost.
+ * @param distance_exponent Exponent applied to the step lengths.
+ */
+void find_path(CostField  &field,
+               hmap::Path &path,
+               float       elevation_ratio,
+               float       distance_exponent);
+
+} // namespace hesiod::path_finding
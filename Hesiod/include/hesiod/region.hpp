@@ -0,0 +1,257 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+
+/**
+ * @file region.hpp
+ * @brief Spatial regions of the domain and region-restricted heightmap
+ * operations, used to recompute only the part of the outputs affected by a
+ * local change.
+ *
+ * Regions are bounding boxes {xmin, xmax, ymin, ymax} in the unit square (same
+ * convention as the tile bounding boxes), x along the first array index and y
+ * along the second one. Cell ranges are stored as {i0, i1, j0, j1}, end
+ * indices being excluded.
+ */
+#pragma once
+#include <vector>
+
+#include "highmap.hpp"
+
+namespace hesiod::region
+{
+
+enum halo_type : int
+{
+  pointwise, ///< Output cells only depend on the same input cells.
+  radius,    ///< Output cells depend on the input cells within 'ir' cells.
+  global     ///< Output cells depend on the whole input.
+};
+
+/**
+ * @brief Growth of a region through a node: a change of the inputs within a
+ * region changes the output within the region grown by 'ir' cells, or
+ * everywhere for global nodes.
+ */
+struct Halo
+{
+  halo_type type = halo_type::global;
+  int       ir = 0;
+};
+
+hmap::Vec4<float> full();
+
+hmap::Vec4<float> empty();
+
+bool is_empty(const hmap::Vec4<float> &region);
+
+bool is_full(const hmap::Vec4<float> &region);
+
+/**
+ * @brief Return the bounding box of two regions.
+ */
+hmap::Vec4<float> merge(const hmap::Vec4<float> &a, const hmap::Vec4<float> &b);
+
+bool intersects(const hmap::Vec4<float> &a, const hmap::Vec4<float> &b);
+
+/**
+ * @brief Return true if the region 'a' contains the region 'b'.
+ */
+bool contains(const hmap::Vec4<float> &a, const hmap::Vec4<float> &b);
+
+/**
+ * @brief Return the region grown by a halo (clamped to the unit square).
+ *
+ * @param region Region.
+ * @param halo Halo.
+ * @param shape Global shape, used to convert the halo radius.
+ * @return hmap::Vec4<float> Grown region.
+ */
+hmap::Vec4<float> grow(const hmap::Vec4<float> &region,
+                       const Halo              &halo,
+                       hmap::Vec2<int>          shape);
+
+/**
+ * @brief Return the halo of two nodes applied successively.
+ */
+Halo combine(const Halo &a, const Halo &b);
+
+/**
+ * @brief Return the widest of two halos (halos of parallel branches).
+ */
+Halo widest(const Halo &a, const Halo &b);
+
+/**
+ * @brief Return the cell range covering a region (with a one-cell margin).
+ */
+hmap::Vec4<int> to_cells(const hmap::Vec4<float> &region,
+                         hmap::Vec2<int>          shape);
+
+/**
+ * @brief Return the region covered by a cell range.
+ */
+hmap::Vec4<float> to_region(const hmap::Vec4<int> &cells,
+                            hmap::Vec2<int>        shape);
+
+/**
+ * @brief Return the region covering the points of a cloud that differ between
+ * two versions of the cloud (whole domain if the number of points changed).
+ */
+hmap::Vec4<float> changed_region(const hmap::Cloud &before,
+                                 const hmap::Cloud &after);
+
+/**
+ * @brief Return the region covering the segments of a path that differ
+ * between two versions of the path (whole domain if the number of points or
+ * the path closure changed).
+ */
+hmap::Vec4<float> changed_region(const hmap::Path &before,
+                                 const hmap::Path &after);
+
+/**
+ * @brief Return the index range [start, end) of the global grid covered by a
+ * tile along one direction, false if the tile is not aligned with the grid.
+ */
+bool tile_range(float shift,
+                float scale,
+                int   n,
+                int   n_global,
+                int  &start,
+                int  &end);
+
+/**
+ * @brief Return the indices of the tiles intersecting a region.
+ */
+std::vector<int> tiles_in_region(const hmap::HeightMap   &h,
+                                 const hmap::Vec4<float> &region);
+
+/**
+ * @brief Partition a cell grid into blocks, listed band by band from the top
+ * band (largest j indices) to the bottom one, from left to right within a
+ * band (the order in which images are written).
+ *
+ * @param shape Grid shape.
+ * @param block_size Block size (in cells), blocks of the last row and column
+ * being smaller if needed.
+ * @return std::vector<hmap::Vec4<int>> Cell ranges of the blocks.
+ */
+std::vector<hmap::Vec4<int>> partition(hmap::Vec2<int> shape, int block_size);
+
+/**
+ * @brief Random access to the heightmap cells through the global cell indices,
+ * each cell being read from the tile owning it (overlap buffers excluded).
+ */
+class TileLookup
+{
+public:
+  TileLookup(const hmap::HeightMap &h);
+
+  /**
+   * @brief Return false if the tiles are not aligned with the global grid (the
+   * lookup cannot be used).
+   */
+  bool is_valid() const;
+
+  /**
+   * @brief Return the index of the tile owning a cell.
+   */
+  inline int get_tile(int i, int j) const
+  {
+    return this->tile_of[(size_t)this->kx[i] * this->ny_tiles + this->ky[j]];
+  }
+
+  inline float get(int i, int j) const
+  {
+    int               k = this->tile_of[(size_t)this->kx[i] * this->ny_tiles +
+                                  this->ky[j]];
+    const hmap::Tile &tile = this->p_h->tiles[k];
+    return tile.vector[(size_t)(i - this->ti[k]) * tile.shape.y + j -
+                       this->tj[k]];
+  }
+
+  /**
+   * @brief Return the cell range {i0, i1, j0, j1} (end excluded) owned by the
+   * tile of index k, and the indices of its first cell (overlap buffers
+   * included) in the global grid, to copy the tile data by contiguous runs.
+   */
+  void get_tile_cells(int k, hmap::Vec4<int> &cells, hmap::Vec2<int> &ij0)
+      const;
+
+private:
+  const hmap::HeightMap *p_h;
+  bool                   valid = true;
+  int                    ny_tiles;
+  std::vector<int>       kx, ky, tile_of, ti, tj, tpx, tpy;
+};
+
+/**
+ * @brief Copy the cells of a heightmap to a float buffer (HighMap storage
+ * order), tiles being copied concurrently by contiguous runs of their own
+ * cells.
+ */
+void blit_heightmap(const hmap::HeightMap &h, float *data);
+
+/**
+ * @brief Return the cell range {i0, i1, j0, j1} (end excluded) covered by a
+ * tile, overlap buffers included, false if the tile is not aligned with the
+ * global grid.
+ */
+bool tile_extent(const hmap::Tile &tile,
+                 hmap::Vec2<int>   shape,
+                 hmap::Vec4<int>  &extent);
+
+/**
+ * @brief Extract a block of tiles as a heightmap with the same tile layout:
+ * the tiles keep their shape, overlap buffers, position and values, except
+ * the tiles of the block border not lying on the domain border, which are cut
+ * (no overlap buffer outside the block) and filled from the cells they cover.
+ *
+ * @param h Heightmap, its shape being a multiple of its tiling.
+ * @param block Range of tile indices {p0, p1, q0, q1} (end excluded) along
+ * each direction.
+ * @param h_sub Sub-heightmap (output).
+ * @return true Success.
+ * @return false The tile layout cannot be reproduced.
+ */
+bool extract_tiles(const hmap::HeightMap &h,
+                   const hmap::Vec4<int> &block,
+                   hmap::HeightMap       &h_sub);
+
+/**
+ * @brief Copy the cells of a block of tiles (see @link extract_tiles) back
+ * into the tiles they come from, within a cell range (overlap buffers
+ * included, cut tiles being skipped).
+ *
+ * @param h Heightmap (in/out).
+ * @param h_sub Block of tiles of the heightmap.
+ * @param cells Cell range to be copied.
+ */
+void paste_tiles(hmap::HeightMap       &h,
+                 const hmap::HeightMap &h_sub,
+                 const hmap::Vec4<int> &cells);
+
+/**
+ * @brief Move the tiles of a heightmap from a region of the domain to another
+ * one (tile shift, scale and bounding box), for instance to make a heightmap
+ * span only a part of the domain: the heightmap cells then sample the target
+ * region, at a higher resolution if the region is smaller.
+ *
+ * @param h Heightmap (in/out).
+ * @param from Region currently spanned by the heightmap.
+ * @param to Region spanned by the heightmap after the transformation.
+ */
+void remap_domain(hmap::HeightMap         &h,
+                  const hmap::Vec4<float> &from,
+                  const hmap::Vec4<float> &to);
+
+/**
+ * @brief Fill a heightmap by bilinear interpolation of another heightmap
+ * spanning the whole domain, the cell positions being given by the tiles of
+ * the output heightmap (see @link remap_domain).
+ *
+ * @param h_src Source heightmap, spanning the whole domain.
+ * @param h_dst Output heightmap, storage already set.
+ */
+void resample(const hmap::HeightMap &h_src, hmap::HeightMap &h_dst);
+
+} // namespace hesiod::region
@@ -0,0 +1,134 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+
+/**
+ * @file texture_streamer.hpp
+ * @brief Asynchronous texture uploads through a pool of pixel buffer objects
+ * (PBO).
+ *
+ * Staging buffers are acquired on the GUI thread, filled from any thread
+ * (worker threads typically) and committed along with the upload function to
+ * be executed. Committed uploads are performed on the GUI thread by @link
+ * TextureStreamer::process, within a per-frame byte budget, the buffer being
+ * bound to GL_PIXEL_UNPACK_BUFFER (texture data pointers are then offsets in
+ * the buffer). A fence is inserted after each upload and a buffer is only
+ * reused once the GPU is done with it.
+ *
+ * Buffers are persistently mapped when the driver supports it
+ * (ARB_buffer_storage), otherwise they are mapped on acquisition and unmapped
+ * before the upload.
+ */
+#pragma once
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// number of staging buffers
+#define TEXTURE_STREAMER_SLOTS 32
+
+// maximum number of bytes uploaded per frame
+#define TEXTURE_STREAMER_BYTES_PER_FRAME (8 << 20)
+
+namespace hesiod::viewer
+{
+
+class TextureStreamer
+{
+public:
+  TextureStreamer() = default;
+
+  /**
+   * @brief Reserve a staging buffer (GUI thread).
+   *
+   * @param nbytes Buffer size.
+   * @return int Slot index, -1 if no buffer is available (the upload should
+   * then be done synchronously).
+   */
+  int acquire(size_t nbytes);
+
+  /**
+   * @brief Return the address of the staging buffer of a slot, which can be
+   * written from any thread until the slot is committed or cancelled.
+   */
+  void *get_ptr(int slot);
+
+  /**
+   * @brief Schedule the upload of a filled staging buffer (any thread).
+   *
+   * @param slot Slot index.
+   * @param owner Owner of the upload (see @link cancel).
+   * @param upload_fct Upload function, executed on the GUI thread with the
+   * buffer bound to GL_PIXEL_UNPACK_BUFFER.
+   */
+  void commit(int slot, const void *owner, std::function<void()> upload_fct);
+
+  /**
+   * @brief Release a slot without uploading anything (any thread).
+   */
+  void release(int slot);
+
+  /**
+   * @brief Drop the pending uploads of an owner (GUI thread), for instance
+   * before the owner is destroyed.
+   *
+   * @param owner Owner, all the pending uploads are dropped if nullptr.
+   */
+  void cancel(const void *owner);
+
+  /**
+   * @brief Perform the pending uploads, in the order of their commitment, up
+   * to a byte budget (at least one upload is done) and recycle the buffers
+   * the GPU is done with (GUI thread, once per frame).
+   *
+   * @param max_bytes Byte budget.
+   */
+  void process(size_t max_bytes = TEXTURE_STREAMER_BYTES_PER_FRAME);
+
+  /**
+   * @brief Return true if uploads are still waiting to be processed.
+   */
+  bool has_pending();
+
+  /**
+   * @brief Release all the OpenGL resources (GUI thread, to be called while
+   * the OpenGL context is still alive).
+   */
+  void clear();
+
+private:
+  enum slot_state : int
+  {
+    free,      ///< Available.
+    writing,   ///< Acquired, being filled.
+    ready,     ///< Filled, waiting for the upload.
+    in_flight, ///< Uploaded, waiting for the GPU to be done with it.
+  };
+
+  struct Slot
+  {
+    unsigned int          pbo = 0;
+    size_t                capacity = 0;
+    size_t                nbytes = 0;
+    void                 *ptr = nullptr;
+    void                 *fence = nullptr;
+    int                   state = slot_state::free;
+    const void           *owner = nullptr;
+    std::function<void()> upload_fct = nullptr;
+    int                   order = 0;
+  };
+
+  std::vector<Slot> slots = {};
+  std::mutex        mutex;
+  int               order_count = 0;
+  bool              initialized = false;
+  bool              persistent = false;
+
+  void init();
+
+  void recycle();
+
+  void allocate(Slot &slot, size_t nbytes);
+};
+
+} // namespace hesiod::viewer
@@ -0,0 +1,142 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+
+/**
+ * @file tile_compression.hpp
+ * @brief In-memory compression of the heightmap tiles of idle node outputs.
+ *
+ * Lossless mode: the bit pattern of each value is XOR-ed with the one of the
+ * previous value (storage order), the resulting words are split into byte
+ * planes and deflated (fast zlib level), smooth fields leaving mostly zero
+ * high-order planes. Lossy mode: values are quantized with a step twice the
+ * error bound before the same delta / byte plane / deflate chain, the
+ * reconstruction error being bounded by the requested maximum error.
+ *
+ * @link TileStore keeps the compressed tiles of the heightmaps, the tile
+ * buffers being released: any code reading a heightmap that may have been
+ * compressed calls @link TileStore::ensure first (node updates, previews,
+ * exports...), which restores the tiles if needed. Heightmaps compressed with
+ * a loss, or computed from such heightmaps, are marked as lossy until they are
+ * computed again (see @link hesiod::vnode::ViewTree::restore_exact_data).
+ */
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#include "highmap.hpp"
+
+// zlib compression level of the tiles (speed over ratio)
+#define TILE_COMPRESSION_LEVEL 1
+
+namespace hesiod::io
+{
+
+struct CompressedArray
+{
+  hmap::Vec2<int>      shape = {0, 0};
+  bool                 lossy = false;
+  float                vmin = 0.f; ///< Quantization offset (lossy).
+  float                step = 0.f; ///< Quantization step (lossy).
+  std::vector<uint8_t> data = {};
+};
+
+/**
+ * @brief Compress an array.
+ *
+ * @param array Input array.
+ * @param max_error Maximum absolute reconstruction error, lossless
+ * compression if zero.
+ * @return CompressedArray Compressed array.
+ */
+CompressedArray compress_array(const hmap::Array &array, float max_error = 0.f);
+
+/**
+ * @brief Decompress an array, the output array being resized if needed.
+ */
+void decompress_array(const CompressedArray &compressed, hmap::Array &array);
+
+class TileStore
+{
+public:
+  /**
+   * @brief Return the application-wide tile store.
+   */
+  static TileStore &get_instance();
+
+  /**
+   * @brief Compress the tiles of a heightmap (tiles processed concurrently)
+   * and release their buffers.
+   *
+   * @param p_h Heightmap.
+   * @param max_error Maximum absolute error, lossless if zero.
+   * @return true Compressed.
+   * @return false Already compressed or empty.
+   */
+  bool compress(hmap::HeightMap *p_h, float max_error = 0.f);
+
+  /**
+   * @brief Restore the tiles of a heightmap if compressed, and mark it as
+   * accessed. To be called before reading a heightmap (any thread).
+   */
+  void ensure(hmap::HeightMap *p_h);
+
+  /**
+   * @brief Restore all the compressed heightmaps.
+   */
+  void ensure_all();
+
+  /**
+   * @brief Mark a heightmap as accessed (after an update for instance).
+   */
+  void touch(const hmap::HeightMap *p_h);
+
+  /**
+   * @brief Return the time (in ms) since the last access of a heightmap.
+   */
+  float get_idle_time(const hmap::HeightMap *p_h);
+
+  /**
+   * @brief Return true if the heightmap tiles are compressed.
+   */
+  bool is_compressed(const hmap::HeightMap *p_h);
+
+  /**
+   * @brief Return true if the heightmap values are approximations (lossy
+   * compression, or computation from lossy data).
+   */
+  bool is_lossy(const hmap::HeightMap *p_h);
+
+  /**
+   * @brief Mark the heightmap values as approximations or not (after an
+   * update).
+   */
+  void set_lossy(const hmap::HeightMap *p_h, bool lossy);
+
+  /**
+   * @brief Drop the data of a heightmap about to be destroyed (compressed
+   * tiles are discarded).
+   */
+  void forget(const hmap::HeightMap *p_h);
+
+  /**
+   * @brief Return the memory (in bytes) of the compressed tiles and of the
+   * tiles they replace.
+   */
+  void get_memory_usage(size_t &compressed_bytes, size_t &raw_bytes);
+
+private:
+  TileStore() = default;
+
+  std::mutex mutex;
+  std::map<const hmap::HeightMap *, std::vector<CompressedArray>> tiles = {};
+  std::map<const hmap::HeightMap *, std::chrono::steady_clock::time_point>
+      access = {};
+  std::set<const hmap::HeightMap *> lossy = {};
+};
+
+} // namespace hesiod::io
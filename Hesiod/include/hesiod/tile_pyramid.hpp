@@ -0,0 +1,185 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+
+/**
+ * @file tile_pyramid.hpp
+ * @brief Multi-resolution (mip) pyramid of a heightmap, split into square
+ * pages that can be streamed independently to the GPU.
+ *
+ * Level 0 is the heightmap at its native resolution, each following level
+ * being a 2 x 2 box average of the previous one, down to a level fitting in a
+ * single page. When built from a heightmap, level 0 is read from the
+ * heightmap tiles (no full resolution copy), the heightmap then having to
+ * outlive the pyramid or to be rebuilt. Pages are indexed by their level and their position (pi, pj)
+ * in the page grid of the level, a page covering the cells [pi * size, (pi +
+ * 1) * size) x [pj * size, (pj + 1) * size) of the level. Domain coordinates
+ * are in the unit square, x along the first array index and y along the
+ * second one.
+ */
+#pragma once
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "highmap.hpp"
+
+#include "hesiod/region.hpp"
+
+// page size (in cells, without border) of the tiled pyramid
+#define TILE_PYRAMID_PAGE_SIZE 256
+
+// maximum number of samples per direction averaged by the box downsampling
+#define BOX_DOWNSAMPLE_MAX_SAMPLES 4
+
+namespace hesiod::viewer
+{
+
+// page key (level, pi, pj)
+typedef std::array<int, 3> PageKey;
+
+// GPU copy of a page
+struct PageTexture
+{
+  unsigned int texture_id = 0; ///< OpenGL texture id.
+  int          last_used = 0;  ///< Last frame the page was drawn.
+};
+
+class TilePyramid
+{
+public:
+  TilePyramid() = default;
+
+  /**
+   * @brief Build the pyramid, the native resolution level being read
+   * directly from the heightmap tiles (a copy is only made if the tiles are
+   * not aligned with the global grid).
+   *
+   * @param h Heightmap, referenced by the pyramid until it is cleared or
+   * rebuilt.
+   */
+  void build(hmap::HeightMap &h);
+
+  /**
+   * @brief Build the pyramid from an array.
+   *
+   * @param array Input array.
+   */
+  void build(const hmap::Array &array);
+
+  /**
+   * @brief Update the pyramid within a region of the domain after a local
+   * change of the heightmap (the value range is only expanded).
+   *
+   * @param h Heightmap, with the same shape as the one used to build the
+   * pyramid (the same heightmap if level 0 is read from its tiles).
+   * @param region Changed region {xmin, xmax, ymin, ymax}.
+   * @return true Success.
+   * @return false The pyramid needs to be rebuilt.
+   */
+  bool update(hmap::HeightMap &h, const hmap::Vec4<float> &region);
+
+  void clear();
+
+  bool is_empty() const;
+
+  int get_nlevels() const;
+
+  hmap::Vec2<int> get_shape(int level) const;
+
+  hmap::Vec2<int> get_npages(int level) const;
+
+  // value range at native resolution
+  hmap::Vec2<float> get_range() const;
+
+  /**
+   * @brief Return the finest level having at least one cell per pixel.
+   *
+   * @param pixels Number of pixels spanned by the whole domain, for each
+   * direction.
+   * @return int Level index.
+   */
+  int select_level(hmap::Vec2<float> pixels) const;
+
+  /**
+   * @brief Return the pages of a level intersecting a domain window.
+   *
+   * @param level Level index.
+   * @param xmin Window bounding box, 'xmin'...
+   * @param xmax 'xmax'...
+   * @param ymin 'ymin'...
+   * @param ymax ...and 'ymax'.
+   * @return std::vector<PageKey> Page keys.
+   */
+  std::vector<PageKey> visible_pages(int   level,
+                                     float xmin,
+                                     float xmax,
+                                     float ymin,
+                                     float ymax) const;
+
+  /**
+   * @brief Return the domain bounding box {xmin, xmax, ymin, ymax} of a page.
+   */
+  hmap::Vec4<float> get_page_bbox(const PageKey &key) const;
+
+  /**
+   * @brief Extract a page with a one-cell border (borders are clamped at the
+   * domain boundaries), for seamless filtering and gradients across pages.
+   *
+   * @param key Page key.
+   * @return hmap::Array Page values, shape (page shape + 2).
+   */
+  hmap::Array get_page(const PageKey &key) const;
+
+  /**
+   * @brief Return the cells {i0, i1, j0, j1} of a page (border included, see
+   * 'get_page') affected by a change within a region, empty if the page does
+   * not intersect the region.
+   */
+  hmap::Vec4<int> get_page_cells(const PageKey           &key,
+                                 const hmap::Vec4<float> &region) const;
+
+private:
+  std::vector<hmap::Array> levels = {};
+
+  hmap::Vec2<float> range = {0.f, 0.f};
+
+  // native resolution level read from the heightmap tiles, 'levels[0]' then
+  // only holding the level shape (no values)
+  const hmap::HeightMap                      *p_h = nullptr;
+  std::unique_ptr<hesiod::region::TileLookup> p_lookup = nullptr;
+
+  // value of the cell (i, j) of a level
+  float get_value(int level, int i, int j) const;
+
+  void build_levels();
+
+  // 2 x 2 box average of the level 'level - 1' within the cells {i0, i1, j0,
+  // j1} of the level 'level'
+  void downsample_level(int level, int i0, int i1, int j0, int j1);
+};
+
+/**
+ * @brief Return a box-filtered low resolution version of a heightmap, sampled
+ * directly from the tiles (no full resolution array is assembled).
+ *
+ * Each output cell is the average of up to BOX_DOWNSAMPLE_MAX_SAMPLES x
+ * BOX_DOWNSAMPLE_MAX_SAMPLES samples evenly spread over its footprint. The
+ * method is thread-safe as long as the heightmap is not modified.
+ *
+ * @param h Heightmap.
+ * @param shape Output shape.
+ * @return hmap::Array Downsampled array.
+ */
+hmap::Array box_downsample(hmap::HeightMap &h, hmap::Vec2<int> shape);
+
+/**
+ * @brief Return a box-filtered low resolution version of an array.
+ *
+ * @param array Input array.
+ * @param shape Output shape.
+ * @return hmap::Array Downsampled array.
+ */
+hmap::Array box_downsample(const hmap::Array &array, hmap::Vec2<int> shape);
+
+} // namespace hesiod::viewer
@@ -12,6 +12,7 @@
 #include "gnode.hpp"
 
 #include "hesiod/control_node.hpp"
+#include "hesiod/tile_compression.hpp"
 #include "hesiod/timer.hpp"
 
 namespace hesiod::vnode
@@ -27,6 +28,16 @@ enum preview_type : int
   histogram  ///< histogram
 };
 
+/**
+ * @brief Preview image, generated off the main thread and uploaded to the GPU
+ * afterwards.
+ */
+struct PreviewImage
+{
+  std::vector<uint8_t> img = {}; ///< 8-bit image, empty if there is no data.
+  bool                 rgb = false;
+};
+
 struct viewnode_color_set
 {
   uint32_t base;
@@ -112,6 +123,19 @@ public:
    */
   ViewNode(std::string id);
 
+  /**
+   * @brief Destroy the View Node object, releasing the compressed tiles of
+   * its outputs (see @link hesiod::io::TileStore).
+   */
+  ~ViewNode();
+
+  /**
+   * @brief Restore the tiles of the heightmaps of the node (inputs and
+   * outputs) that may have been compressed while idle, to be called before
+   * reading them.
+   */
+  void ensure_data();
+
   /**
    * @brief Get the view3d port id.
    *
@@ -133,6 +157,13 @@ public:
    */
   std::string get_view3d_color_port_id();
 
+  /**
+   * @brief Get the preview shape.
+   *
+   * @return hmap::Vec2<int> Shape.
+   */
+  hmap::Vec2<int> get_shape_preview();
+
   /**
    * @brief Set the preview port id.
    *
@@ -188,6 +219,18 @@ public:
 
   void render_node_minimalist();
 
+  /**
+   * @brief Render a lightweight stand-in of the node (pins and size only),
+   * used for the nodes outside the node editor viewport.
+   */
+  void render_node_placeholder();
+
+  /**
+   * @brief Return true if the node, as rendered during the previous frame, is
+   * visible in the node editor (or has never been rendered).
+   */
+  bool is_visible_in_editor();
+
   /**
    * @brief Render any specific content after rendering the node base boyd
    * (@link render_node).
@@ -220,11 +263,56 @@ public:
   bool trigger_update_after_edit();
 
   /**
-   * @brief Update the node preview (regenerate the content displayed in the
-   * node body).
+   * @brief Mark the node preview as stale, it is regenerated the next time the
+   * node is visible in the node editor (see @link compute_preview_image and
+   * @link upload_preview_image).
    */
   void update_preview();
 
+  /**
+   * @brief Return true if the preview is stale and visible.
+   */
+  bool is_preview_requested();
+
+  /**
+   * @brief Return true if the preview is displayed in the node editor (node
+   * visible during the last frame).
+   */
+  bool is_preview_shown();
+
+  /**
+   * @brief Generate the preview image, does not call any OpenGL function so
+   * that it can run on a worker thread (the preview is not stale anymore once
+   * generated, even if it has not been uploaded yet).
+   *
+   * @return PreviewImage Preview image.
+   */
+  PreviewImage compute_preview_image();
+
+  /**
+   * @brief Upload the preview image to the preview texture.
+   *
+   * @param preview Preview image.
+   * @param from_pixel_buffer Whether the image data are read from the pixel
+   * buffer currently bound to GL_PIXEL_UNPACK_BUFFER instead of the image
+   * vector (the image format is still given by 'preview').
+   */
+  void upload_preview_image(const PreviewImage &preview,
+                            bool                from_pixel_buffer = false);
+
+  /**
+   * @brief Region of the outputs modified in place by the settings widgets
+   * (brush painting for instance), empty if none. The tree propagates the
+   * change downstream and then resets the region.
+   */
+  hmap::Vec4<float> edited_region = hesiod::region::empty();
+
+  /**
+   * @brief True if the node has been modified (settings edited or node
+   * updated) since its data were last serialized for an autosave.
+   */
+  bool autosave_stale = true;
+
 protected:
   /**
    * @brief Port id of the data displayed in the preview.
@@ -277,6 +365,17 @@ private:
    */
   GLuint image_texture_preview = 0;
 
+  /**
+   * @brief Defines whether the preview texture is outdated.
+   */
+  bool preview_stale = true;
+
+  /**
+   * @brief Defines whether the node was visible in the node editor during the
+   * last frame.
+   */
+  bool preview_visible = false;
+
   /**
    * @brief Set the control node post-update callback to the view node
    * post-update method.
@@ -2097,12 +2196,14 @@ public:
 
 // // HELPERS
 
-void img_to_texture(std::vector<uint8_t> img,
-                    hmap::Vec2<int>      shape,
-                    GLuint              &image_texture);
+// 'p_data' is an offset in the bound pixel buffer if a buffer is bound to
+// GL_PIXEL_UNPACK_BUFFER (nullptr for the buffer start)
+void img_to_texture(const uint8_t  *p_data,
+                    hmap::Vec2<int> shape,
+                    GLuint         &image_texture);
 
-void img_to_texture_rgb(std::vector<uint8_t> img,
-                        hmap::Vec2<int>      shape,
-                        GLuint              &image_texture);
+void img_to_texture_rgb(const uint8_t  *p_data,
+                        hmap::Vec2<int> shape,
+                        GLuint         &image_texture);
 
 } // namespace hesiod::vnode
@@ -3,18 +3,50 @@
  * this software. */
 #pragma once
 #include <GL/glut.h>
+#include <set>
 #include <string>
 
 #include "highmap.hpp"
 #include <imgui_node_editor.h>
 
+#include "hesiod/autosave.hpp"
 #include "hesiod/control_node.hpp"
+#include "hesiod/distributed.hpp"
+#include "hesiod/live_link.hpp"
+#include "hesiod/output_cache.hpp"
 #include "hesiod/serialization.hpp"
+#include "hesiod/texture_streamer.hpp"
+#include "hesiod/tile_pyramid.hpp"
 #include "hesiod/view_node.hpp"
 
+// time budget (in ms) for rendering the nodes of the node editor, the
+// remaining visible nodes are rendered as placeholders and get priority during
+// the next frame
+#define NODE_EDITOR_FRAME_BUDGET_MS 8.f
+
+// maximum resolution (per direction) of the region of interest of the 2D
+// viewer
+#define VIEWER_ROI_MAX_SIZE 4096
+
+// time interval (in ms) between two checks of the files watched by the Import
+// nodes
+#define FILE_WATCH_INTERVAL_MS 1000.f
+
+// time (in ms) without access after which the outputs of a node are
+// compressed in memory
+#define TILE_COMPRESSION_IDLE_MS 30000.f
+
 namespace hesiod::vnode
 {
 
+// update priority of the nodes after an edit
+enum update_priority : int
+{
+  viewer,  ///< Ancestors of the viewer node (viewer node included).
+  preview, ///< Ancestors of the nodes with a preview shown.
+  deferred ///< Other nodes, updated during the next idle frames.
+};
+
 struct Link
 {
   // related to GNode and Hesiod
@@ -37,6 +69,15 @@ struct Link
   SERIALIZATION_V2_IMPLEMENT_BASE();
 };
 
+// cached link drawing data, rebuilt only when the graph changes
+struct LinkDrawData
+{
+  int    link_id;
+  int    port_hash_id_from;
+  int    port_hash_id_to;
+  ImVec4 color;
+};
+
 class ViewTree : public gnode::Tree, public serialization::SerializationBase
 {
 public:
@@ -83,6 +124,192 @@ public:
 
   void post_update();
 
+  /**
+   * @brief Publish the data of the viewer node through the live link, if
+   * enabled (see @link hesiod::io::LiveLinkPublisher).
+   */
+  void publish_live_link();
+
+  /**
+   * @brief Enable or disable the live link (shared-memory segment created or
+   * removed).
+   */
+  void set_live_link(bool state);
+
+  /**
+   * @brief Update the nodes downstream a node whose output has only changed
+   * within a region, each node only recomputing the part of its output
+   * affected by the change (see @link hesiod::cnode::ControlNode::halo).
+   *
+   * @param node_id Node id.
+   * @param region Changed region of the node output.
+   */
+  void update_node_region(std::string node_id, hmap::Vec4<float> region);
+
+  /**
+   * @brief Return the update priority of each node (see @link
+   * update_priority), the priority of a node being the highest priority of
+   * its descendants.
+   */
+  std::map<std::string, int> get_update_priorities();
+
+  /**
+   * @brief Block the update of the low priority nodes, to be called before an
+   * edit so that the update propagation only reaches the nodes whose result
+   * is displayed (see @link end_priority_update, and @link
+   * PriorityUpdateScope to pair both calls).
+   */
+  void begin_priority_update();
+
+  /**
+   * @brief Unblock the nodes blocked by @link begin_priority_update, the ones
+   * that have been left outdated by the edit being queued for a deferred
+   * update.
+   */
+  void end_priority_update();
+
+  /**
+   * @brief Update the upstream-most deferred node (the update propagating
+   * downstream), when the user is not interacting with a widget.
+   */
+  void update_deferred_nodes();
+
+  /**
+   * @brief Update the Import nodes whose watched file has been modified (hot
+   * reload), files being checked at most every @link FILE_WATCH_INTERVAL_MS.
+   */
+  void update_watched_files();
+
+  /**
+   * @brief Compress in memory the outputs of one node idle for more than
+   * @link TILE_COMPRESSION_IDLE_MS (viewer node and nodes with non-heightmap
+   * outputs excluded), lossy compression being only used for preview-only
+   * nodes (see @link hesiod::io::TileStore).
+   */
+  void update_idle_compression();
+
+  /**
+   * @brief Compute again the nodes whose outputs are approximations (lossy
+   * compression) and the nodes downstream, to be called before any read of
+   * the data other than a preview (exports, region evaluations...).
+   */
+  void restore_exact_data();
+
+  /**
+   * @brief Take a snapshot of the tree state when the autosave interval has
+   * elapsed and hand it over to the I/O thread (see @link
+   * hesiod::io::write_state_snapshot), nodes being serialized within a frame
+   * budget of @link AUTOSAVE_FRAME_BUDGET_MS, over several frames if needed.
+   */
+  void update_autosave();
+
+  /**
+   * @brief Evaluate the subgraph upstream a node over a region of interest, at
+   * a resolution independent of the tree resolution, without altering the
+   * node outputs.
+   *
+   * The node outputs of the subgraph are temporarily replaced by heightmaps
+   * spanning the region (grown by the halos of the subgraph) at the requested
+   * resolution: primitives sample their functions directly within the region
+   * (see the 'shift' and 'scale' arguments of 'hmap::fill'), the other nodes
+   * process their inputs at the region resolution. Node settings given in
+   * cells (filter radii...) are scaled by the ratio of the region resolution
+   * to the tree resolution, so that filters keep their extent. Iteration counts
+   * of cell-based processes (erosion, diffusion...) cannot be scaled, such
+   * nodes are only exact at the tree resolution.
+   *
+   * @param node_id Node id.
+   * @param port_id Output port id (heightmap data).
+   * @param roi Region of interest {xmin, xmax, ymin, ymax}.
+   * @param shape_roi Resolution of the region of interest.
+   * @param array Node output over the region of interest (output).
+   * @return true Success.
+   * @return false The evaluation is not possible (data type, unconnected
+   * inputs...).
+   */
+  bool evaluate_roi(std::string       node_id,
+                    std::string       port_id,
+                    hmap::Vec4<float> roi,
+                    hmap::Vec2<int>   shape_roi,
+                    hmap::Array      &array);
+
+  /**
+   * @brief Evaluate the subgraph upstream several node outputs over a region
+   * of interest in a single pass (see above).
+   *
+   * @param targets Node and output port ids.
+   * @param roi Region of interest {xmin, xmax, ymin, ymax}.
+   * @param shape_roi Resolution of the region of interest.
+   * @param arrays Outputs over the region of interest, in the order of the
+   * targets (output).
+   * @param exact Refuse the evaluation if a node of the subgraph depends on
+   * the whole domain (no margin can cover its halo) or counts iterations in
+   * cells at another resolution than the tree one, the region being otherwise
+   * approximated.
+   * @return true Success.
+   */
+  bool evaluate_roi(
+      std::vector<std::pair<std::string, std::string>> targets,
+      hmap::Vec4<float>                                roi,
+      hmap::Vec2<int>                                  shape_roi,
+      std::vector<hmap::Array>                        &arrays,
+      bool                                             exact = false);
+
+  /**
+   * @brief Out-of-core export: evaluate the graph at a resolution exceeding
+   * the memory budget and stream the results to the files of the Export
+   * nodes.
+   *
+   * The domain is partitioned into super-tiles evaluated one after the other
+   * as regions of interest (halos honoured), each result being written to
+   * the export files before the next super-tile is evaluated: the memory
+   * footprint is the one of a super-tile per node output. Global operations
+   * (remapping, equalization, post-processing normalizations) use the
+   * statistics of a first whole domain pass at the tree resolution, as do
+   * the value ranges of the image exports.
+   *
+   * @param shape Export resolution.
+   * @param super_tile_size Super-tile size (in cells).
+   * @return true Success.
+   */
+  bool export_out_of_core(hmap::Vec2<int> shape, int super_tile_size);
+
+  /**
+   * @brief Distributed rendering, worker side: evaluate the super-tiles of
+   * the worker rank, grown by the blending overlap, and write them to the
+   * tile directory (see @link hesiod::distributed).
+   *
+   * @param settings Render settings.
+   * @return true Success.
+   */
+  bool render_tiles(const hesiod::distributed::RenderSettings &settings);
+
+  /**
+   * @brief Distributed rendering, coordinator side: stitch the super-tiles
+   * rendered by the workers into the files of the Export nodes, overlaps
+   * being blended, and remove the tile files.
+   *
+   * @param settings Render settings.
+   * @param wait_for_tiles Wait for the tiles to be available (workers not
+   * started by the coordinator).
+   * @return true Success.
+   */
+  bool stitch_tiles(const hesiod::distributed::RenderSettings &settings,
+                    bool wait_for_tiles = false);
+
+  /**
+   * @brief Distributed rendering, coordinator side: spawn the local workers
+   * (or wait for the tiles of the workers started by hand with '--no-spawn'),
+   * stitch their tiles and remove the directory of the run.
+   *
+   * @param executable Executable of the workers (this program).
+   * @param settings Render settings (a run identifier is generated for the
+   * spawned workers if none is given).
+   * @return true Success.
+   */
+  bool render_distributed(const std::string                  &executable,
+                          hesiod::distributed::RenderSettings settings);
+
   void remove_link(int link_id);
 
   void remove_view_node(std::string node_id);
@@ -103,12 +330,35 @@ public:
 
   void render_view_nodes();
 
+  // regenerate the stale previews of the nodes visible in the node editor
+  void update_previews();
+
   void render_view2d();
 
+  void render_image_view2d(hmap::Vec2<int> shape_fbo);
+
+  void clear_pages_view2d();
+
+  // evaluate the region of interest of the 2D viewer and upload it
+  void update_roi_view2d();
+
   void render_view3d();
 
+  // render the 3D view in its frame buffer, only if the camera, the mesh or
+  // the colors have changed
+  void render_image_view3d();
+
+  /**
+   * @brief Return true if the tree needs to be rendered at every frame
+   * (animation, pending uploads...), false if the GUI can go idle.
+   */
+  bool is_animated();
+
   void update_image_texture_view2d();
 
+  // partial update of the 2D viewer after a local change of the viewed data
+  void update_image_texture_view2d(hmap::Vec4<float> region);
+
   void update_image_texture_view3d(bool vertex_array_update = true);
 
   void update_view3d_basemesh();
@@ -133,10 +383,40 @@ public:
 
   // serialization
 
+  /**
+   * @brief Load a project, the node outputs being restored from the output
+   * cache of the project (see @link save_state) instead of being recomputed
+   * when the cache is enabled.
+   */
   void load_state(std::string fname);
 
+  /**
+   * @brief Save a project, and the node outputs to the output cache of the
+   * project if enabled (sidecar directory named after the project file, see
+   * @link OUTPUT_CACHE_SUFFIX).
+   */
   void save_state(std::string fname);
 
+  /**
+   * @brief Return the output cache key of each node, hash of the node type,
+   * attributes, storage settings and input keys (node id and storage
+   * settings only for the nodes with frozen outputs).
+   */
+  std::map<std::string, std::string> get_output_cache_keys();
+
+  /**
+   * @brief Write the outputs of the up-to-date nodes to an output cache
+   * directory (files of unchanged outputs are kept as is, files no longer
+   * used are removed). Only nodes whose outputs are all heightmaps are cached.
+   */
+  void save_output_cache(std::string dir);
+
+  /**
+   * @brief Update the whole tree, the nodes whose outputs are found in an
+   * output cache directory being restored instead of recomputed.
+   */
+  void update_from_output_cache(std::string dir);
+
   SERIALIZATION_V2_IMPLEMENT_BASE();
 
 private:
@@ -147,6 +427,43 @@ private:
   std::map<int, Link> links = {};
   int                 id_counter = 0;
 
+  // node editor draw lists, to avoid string map lookups for each node and link
+  // at every frame (rebuilt after a graph mutation, see 'draw_lists_stale')
+  std::vector<ViewNode *>   draw_list_nodes = {};
+  std::vector<LinkDrawData> draw_list_links = {};
+  bool                      draw_lists_stale = true;
+  size_t                    render_nodes_start = 0;
+  bool                      render_nodes_over_budget = false;
+
+  void update_draw_lists();
+
+  std::vector<std::string> get_node_ids();
+
+  // tree data without the nodes (storage settings, node positions, links) and
+  // data of a single node, the parts of a state file
+  nlohmann::json serialize_header_json_v2();
+
+  nlohmann::json serialize_node_json_v2(std::string node_id);
+
+  // true if no Export node is downstream the node (included)
+  bool is_preview_only(std::string node_id);
+
+  // nodes whose data are approximations: nodes with lossy outputs and the
+  // nodes downstream
+  std::set<std::string> get_lossy_nodes();
+
+  // export nodes of the graph, evaluated outputs they are connected to and
+  // value ranges of these outputs over the whole domain (tree updated if
+  // needed, pending exports written)
+  bool prepare_exports(
+      std::vector<hesiod::cnode::Export *>             &exports,
+      std::vector<std::pair<std::string, std::string>> &targets,
+      std::vector<hmap::Vec2<float>>                   &ranges);
+
+  // staging buffers of the node previews, filled by the worker threads
+  // generating the previews and uploaded within a per-frame budget
+  hesiod::viewer::TextureStreamer texture_streamer;
+
   std::vector<ax::NodeEditor::NodeId> selected_node_hid = {};
 
   ax::NodeEditor::EditorContext *p_node_editor_context = nullptr;
@@ -155,14 +472,91 @@ private:
 
   std::string viewer_node_id = "";
 
-  // 2D viewer
-  bool            open_view2d_window = false;
-  GLuint          image_texture_view2d;
-  hmap::Vec2<int> shape_view2d = {512, 512};
-  int             cmap_view2d = hmap::cmap::inferno;
-  bool            hillshade_view2d = false;
-  float           view2d_zoom = 100.f;
-  ImVec2          view2d_uv0 = {0.f, 0.f};
+  // priority scheduling of the updates, nodes blocked during the current edit
+  // (with their 'auto_update' state) and nodes waiting for a deferred update
+  bool                        priority_update = true;
+  int                         priority_update_depth = 0;
+  std::map<std::string, bool> held_nodes = {};
+  std::vector<std::string>    deferred_nodes = {};
+
+  // last check of the files watched by the Import nodes
+  Timer file_watch_timer = Timer();
+
+  // in-memory compression of the idle outputs (disabled by default, the
+  // compression running on the GUI thread), maximum error of the lossy
+  // compression (preview-only nodes) relative to the data amplitude, lossless
+  // if zero
+  bool  idle_compression = false;
+  float compression_max_error = 0.f;
+
+  // live link publisher (enabled if not null) and shared-memory segment name
+  std::unique_ptr<hesiod::io::LiveLinkPublisher> live_link = nullptr;
+  std::string live_link_name = LIVE_LINK_NAME;
+
+  // on-disk output cache of the project, and cache directory of the project
+  // being loaded
+  bool        output_cache = false;
+  std::string output_cache_dir = "";
+
+  // autosave, serialized data of the nodes (shared by the successive
+  // snapshots) and header of the last snapshot
+  bool        autosave = true;
+  float       autosave_interval = AUTOSAVE_INTERVAL_S;
+  std::string autosave_fname = "tree_state.autosave.json";
+  Timer       autosave_timer = Timer();
+  std::map<std::string, std::shared_ptr<const nlohmann::json>> autosave_nodes =
+      {};
+  nlohmann::json autosave_header = nlohmann::json();
+  size_t         autosave_nnodes = 0;
+
+  // out-of-core export settings
+  hmap::Vec2<int> out_of_core_shape = {8192, 8192};
+  int             out_of_core_super_tile = 2048;
+
+  // changed region of the viewer node data during the current update (whole
+  // domain by default)
+  hmap::Vec4<float> update_region = hesiod::region::full();
+
+  // 2D viewer, the data are uploaded once as a texture (float elevation or
+  // RGB colors) and rendered by a shader (colormap and hillshading) in a
+  // frame buffer, only when the view changes
+  bool              open_view2d_window = false;
+  GLuint            image_texture_view2d = 0;
+  GLuint            data_texture_view2d = 0;
+  GLuint            shader_id_view2d;
+  GLuint            vertex_array_id_view2d;
+  GLuint            vertex_buffer_view2d;
+  GLuint            FBO_view2d = 0;
+  GLuint            RBO_view2d = 0;
+  hmap::Vec2<int>   shape_view2d = {512, 512};
+  hmap::Vec2<int>   shape_fbo_view2d = {0, 0};
+  hmap::Vec2<float> zrange_view2d = {0.f, 1.f};
+  bool              rgb_view2d = false;
+  bool              data_view2d = false;
+  bool              redraw_view2d = true;
+  bool              update_pending_view2d = false;
+  int               cmap_view2d = hmap::cmap::inferno;
+  bool              hillshade_view2d = false;
+  float             view2d_zoom = 100.f;
+  ImVec2            view2d_uv0 = {0.f, 0.f};
+
+  std::map<int, GLuint> cmap_textures_view2d = {};
+
+  // region of interest, evaluated at a higher resolution (see 'evaluate_roi')
+  // and drawn over the pyramid pages
+  bool              roi_select_view2d = false;
+  hmap::Vec4<float> roi_view2d = hesiod::region::empty();
+  hmap::Vec2<float> roi_anchor_view2d = {0.f, 0.f};
+  int               roi_factor_view2d = 4;
+  GLuint            roi_texture_view2d = 0;
+  hmap::Vec2<int>   roi_shape_view2d = {0, 0};
+
+  // mip pyramid of the elevation data, pages are streamed to the GPU when
+  // they become visible
+  hesiod::viewer::TilePyramid                                  pyramid_view2d;
+  std::map<hesiod::viewer::PageKey, hesiod::viewer::PageTexture> pages_view2d =
+      {};
+  int frame_view2d = 0;
 
   std::map<std::string, int> cmap_map = {
       {"gray", hmap::cmap::gray},
@@ -192,12 +586,32 @@ private:
   float delta_y = 0.f;
   bool  wireframe = false;
   bool  auto_rotate = false;
+  bool  redraw_view3d = true;
 
   bool                     show_settings = false;
   ax::NodeEditor::NodeId   context_menu_node_hid;
   std::vector<std::string> key_sort;
 };
 
+/**
+ * @brief Edit scope with priority scheduling of the updates, calling @link
+ * ViewTree::begin_priority_update on construction and @link
+ * ViewTree::end_priority_update on destruction (also when the edit throws).
+ */
+class PriorityUpdateScope
+{
+public:
+  PriorityUpdateScope(ViewTree *p_tree);
+
+  ~PriorityUpdateScope();
+
+  PriorityUpdateScope(const PriorityUpdateScope &) = delete;
+  PriorityUpdateScope &operator=(const PriorityUpdateScope &) = delete;
+
+private:
+  ViewTree *p_tree;
+};
+
 // HELPERS
 std::string node_type_from_id(std::string node_id);
 
@@ -7,6 +7,18 @@
 
 #include "highmap.hpp"
 
+// number of entries of the colormap lookup tables
+#define VIEWER_CMAP_LUT_SIZE 256
+
+// maximum number of pyramid pages kept on the GPU by the 2D viewer
+#define VIEWER_PAGE_CACHE_SIZE 256
+
+// maximum number of pyramid pages uploaded per frame by the 2D viewer
+#define VIEWER_PAGE_UPLOADS_PER_FRAME 16
+
+// auto-rotation speed of the 3D viewer (in degrees per second)
+#define VIEWER_AUTO_ROTATE_SPEED 6.f
+
 namespace hesiod::viewer
 {
 
@@ -34,6 +46,11 @@ void update_vertex_colors(hmap::Array          &z,
                           hmap::Array          &b,
                           std::vector<GLfloat> &colors);
 
+// upload vertex data to an array buffer, the buffer storage is only
+// reallocated when its size changes, otherwise it is invalidated, mapped and
+// filled concurrently (no driver-side copy of the whole data)
+void upload_array_buffer(GLuint buffer, const std::vector<GLfloat> &data);
+
 //----------------------------------------
 // frame buffers
 //----------------------------------------
@@ -58,4 +75,31 @@ void rescale_framebuffer(GLuint &RBO,
 GLuint load_shaders(const char *vertex_file_path,
                     const char *fragment_file_path);
 
+// colormapping and hillshading shader of the 2D viewer
+GLuint load_shaders_view2d();
+
+//----------------------------------------
+// textures
+//----------------------------------------
+
+// screen-filling quad (two triangles), vertex positions at location 0
+void create_quad(GLuint &vertex_array_id, GLuint &vertex_buffer);
+
+// single channel float texture, width shape.y and height shape.x (the texture
+// id is generated if it is 0)
+void upload_array_texture(GLuint &texture_id, const hmap::Array &array);
+
+// partial update of a texture created by 'upload_array_texture', only the
+// cells {i0, i1, j0, j1} (end excluded) of the array are uploaded
+void update_array_texture(GLuint             texture_id,
+                          const hmap::Array &array,
+                          hmap::Vec4<int>    cells);
+
+void upload_rgb_texture(GLuint                     &texture_id,
+                        const std::vector<uint8_t> &img,
+                        hmap::Vec2<int>             shape);
+
+// 1D lookup table of a HighMap colormap
+void upload_cmap_texture(GLuint &texture_id, int cmap);
+
 } // namespace hesiod::viewer
@@ -0,0 +1,98 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+
+/**
+ * @file live_link_consumer.cpp
+ * @brief Sample consumer of the live link: waits for the frames published by
+ * Hesiod and prints their properties and the publication-to-read latency.
+ *
+ * Usage: hesiod_live_link_consumer [segment name] [number of frames]
+ *
+ * With a number of frames, the consumer exits once that number of frames has
+ * been read. The segment is reopened when Hesiod restarts the live link.
+ */
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "hesiod/live_link.hpp"
+
+int main(int argc, char *argv[])
+{
+  std::string name = argc > 1 ? argv[1] : LIVE_LINK_NAME;
+  int         nframes = argc > 2 ? std::stoi(argv[2]) : -1;
+
+  std::unique_ptr<hesiod::io::LiveLinkReader> reader = nullptr;
+  hesiod::io::LiveLinkFrame                   frame;
+  uint64_t                                    generation = 0;
+  int                                         count = 0;
+  auto time_check = std::chrono::steady_clock::now();
+
+  while (nframes < 0 || count < nframes)
+  {
+    // the segment is created by Hesiod when the live link is enabled
+    if (!reader)
+    {
+      try
+      {
+        reader = std::make_unique<hesiod::io::LiveLinkReader>(name);
+        generation = 0;
+        std::printf("live link [%s] opened\n", name.c_str());
+      }
+      catch (const std::runtime_error &)
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        continue;
+      }
+    }
+
+    // polling, a real consumer would check once per engine frame
+    if (!reader->read(frame, generation))
+    {
+      // no new frame for a while, the live link may have been restarted
+      auto now = std::chrono::steady_clock::now();
+      if (now - time_check > std::chrono::milliseconds(500))
+      {
+        time_check = now;
+        if (reader->is_stale())
+        {
+          std::printf("live link [%s] closed\n", name.c_str());
+          reader = nullptr;
+          continue;
+        }
+      }
+
+      std::this_thread::sleep_for(std::chrono::microseconds(200));
+      continue;
+    }
+
+    time_check = std::chrono::steady_clock::now();
+
+    float latency = 1e-6f *
+                    (float)(hesiod::io::live_link_now() - frame.timestamp);
+
+    std::printf("generation %lu: %s, %dx%d, range [%g, %g], latency %.3f ms",
+                (unsigned long)frame.generation,
+                frame.dtype == hesiod::io::live_heightmap_rgb ? "rgb"
+                                                              : "heightmap",
+                frame.shape.x,
+                frame.shape.y,
+                frame.range.x,
+                frame.range.y,
+                latency);
+
+    if (frame.generation > generation + 1 && generation > 0)
+      std::printf(" (%lu skipped)",
+                  (unsigned long)(frame.generation - generation - 1));
+    std::printf("\n");
+
+    generation = frame.generation;
+    count++;
+  }
+
+  return 0;
+}
@@ -0,0 +1,204 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+
+/**
+ * @file live_link_test.cpp
+ * @brief Live link check: frames of known content are published while a
+ * reader running in a child process checks their shape, generation and data.
+ *
+ * The publisher is restarted mid-way with a larger shape, the reader having to
+ * reopen the new segment and to grow its mapping.
+ *
+ * Usage: hesiod_live_link_test [number of frames]
+ */
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "highmap.hpp"
+
+#include "hesiod/live_link.hpp"
+#include "hesiod/region.hpp"
+
+#define LIVE_LINK_TEST_NAME "/hesiod_live_link_test"
+#define LIVE_LINK_TEST_TIMEOUT_MS 20000
+
+// storage of the heightmaps published before and after the restart
+static const hmap::Vec2<int> shapes[2] = {{64, 48}, {96, 80}};
+static const hmap::Vec2<int> tiling = {2, 2};
+
+// exact (integer) value of the cell (i, j)
+static float pattern(int i, int j, uint64_t generation, int phase)
+{
+  return (float)((i * 31 + j * 17 + generation * 7 + phase * 13) % 1024);
+}
+
+static hmap::HeightMap make_heightmap(uint64_t generation, int phase)
+{
+  hmap::HeightMap            h = hmap::HeightMap(shapes[phase], tiling, 0.f);
+  hesiod::region::TileLookup lookup = hesiod::region::TileLookup(h);
+
+  for (size_t k = 0; k < h.tiles.size(); k++)
+  {
+    hmap::Tile     &tile = h.tiles[k];
+    hmap::Vec4<int> cells;
+    hmap::Vec2<int> ij0;
+
+    lookup.get_tile_cells((int)k, cells, ij0);
+
+    for (int i = 0; i < tile.shape.x; i++)
+      for (int j = 0; j < tile.shape.y; j++)
+        tile.vector[(size_t)i * tile.shape.y + j] = pattern(ij0.x + i,
+                                                            ij0.y + j,
+                                                            generation,
+                                                            phase);
+  }
+
+  return h;
+}
+
+// check a frame, returns its phase (-1 if invalid)
+static int check_frame(const hesiod::io::LiveLinkFrame &frame)
+{
+  int phase = -1;
+  for (int p = 0; p < 2; p++)
+    if (frame.shape == shapes[p])
+      phase = p;
+
+  if (phase < 0 || frame.dtype != hesiod::io::live_heightmap ||
+      frame.nchannels != 1 ||
+      frame.data.size() != (size_t)frame.shape.x * frame.shape.y)
+    return -1;
+
+  for (int i = 0; i < frame.shape.x; i++)
+    for (int j = 0; j < frame.shape.y; j++)
+      if (frame.data[(size_t)i * frame.shape.y + j] !=
+          pattern(i, j, frame.generation, phase))
+        return -1;
+
+  return phase;
+}
+
+// reader process, returns the exit status
+static int run_reader(uint64_t nframes)
+{
+  std::unique_ptr<hesiod::io::LiveLinkReader> reader = nullptr;
+  hesiod::io::LiveLinkFrame                   frame;
+  uint64_t                                    generation = 0;
+  int                                         phase = 0;
+  int                                         count = 0;
+
+  auto t0 = std::chrono::steady_clock::now();
+
+  while (std::chrono::steady_clock::now() - t0 <
+         std::chrono::milliseconds(LIVE_LINK_TEST_TIMEOUT_MS))
+  {
+    if (!reader)
+    {
+      try
+      {
+        reader = std::make_unique<hesiod::io::LiveLinkReader>(
+            LIVE_LINK_TEST_NAME);
+        generation = 0;
+      }
+      catch (const std::runtime_error &)
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        continue;
+      }
+    }
+
+    if (!reader->read(frame, generation))
+    {
+      if (reader->is_stale())
+        reader = nullptr;
+      else
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+      continue;
+    }
+
+    int frame_phase = check_frame(frame);
+
+    if (frame_phase < phase)
+    {
+      std::fprintf(stderr,
+                   "invalid frame, generation %lu\n",
+                   (unsigned long)frame.generation);
+      return 1;
+    }
+
+    phase = frame_phase;
+    generation = frame.generation;
+    count++;
+
+    // last frame after the restart
+    if (phase == 1 && generation == nframes)
+    {
+      std::printf("%d frame(s) read and checked\n", count);
+      return 0;
+    }
+  }
+
+  std::fprintf(stderr,
+               "timeout, last generation read %lu (phase %d)\n",
+               (unsigned long)generation,
+               phase);
+  return 1;
+}
+
+int main(int argc, char *argv[])
+{
+  uint64_t nframes = argc > 1 ? (uint64_t)std::stoi(argv[1]) : 100;
+
+  pid_t pid = fork();
+
+  if (pid < 0)
+  {
+    std::fprintf(stderr, "could not start the reader process\n");
+    return 1;
+  }
+
+  if (pid == 0)
+  {
+    int status = run_reader(nframes);
+    std::fflush(stdout);
+    _exit(status);
+  }
+
+  for (int phase = 0; phase < 2; phase++)
+  {
+    // restart of the publisher, new segment
+    hesiod::io::LiveLinkPublisher publisher(LIVE_LINK_TEST_NAME);
+
+    for (uint64_t g = 1; g <= nframes; g++)
+    {
+      if (publisher.publish(make_heightmap(g, phase)) != g)
+      {
+        std::fprintf(stderr, "unexpected generation\n");
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+        return 1;
+      }
+
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // segment kept until the reader is done with it
+    if (phase == 1)
+    {
+      int status;
+      waitpid(pid, &status, 0);
+      return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+    }
+  }
+
+  return 1;
+}
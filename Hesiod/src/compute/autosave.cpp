@@ -0,0 +1,72 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+#include <cstdio>
+#include <filesystem>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "macrologger.h"
+
+#include "hesiod/autosave.hpp"
+
+namespace hesiod::io
+{
+
+void write_state_snapshot(const std::string   &fname,
+                          const StateSnapshot &snapshot,
+                          int                  nbackups)
+{
+  nlohmann::json data = nlohmann::json();
+
+  data["data"] = snapshot.header;
+  data["data"]["nodes"] = nlohmann::json::array();
+
+  for (auto &p_node : snapshot.nodes)
+    data["data"]["nodes"].push_back(*p_node);
+
+  std::string str = data.dump(1) + "\n";
+
+  // written and synced under a temporary name, the previous file remains
+  // valid until the new one is complete
+  std::string fname_tmp = fname + ".tmp";
+  FILE       *f = std::fopen(fname_tmp.c_str(), "wb");
+
+  bool success = f && std::fwrite(str.data(), 1, str.size(), f) == str.size() &&
+                 std::fflush(f) == 0;
+#ifdef _WIN32
+  success = success && _commit(_fileno(f)) == 0;
+#else
+  success = success && fsync(fileno(f)) == 0;
+#endif
+
+  if (f)
+    std::fclose(f);
+
+  if (!success)
+  {
+    LOG_ERROR("could not write autosave file [%s]", fname_tmp.c_str());
+    throw std::runtime_error("could not write file " + fname_tmp);
+  }
+
+  // rotating backups, 'fname.1' being the most recent
+  std::error_code ec;
+
+  for (int k = nbackups - 1; k >= 1; k--)
+    if (std::filesystem::exists(fname + "." + std::to_string(k)))
+      std::filesystem::rename(fname + "." + std::to_string(k),
+                              fname + "." + std::to_string(k + 1),
+                              ec);
+
+  if (nbackups > 0 && std::filesystem::exists(fname))
+    std::filesystem::rename(fname, fname + ".1", ec);
+
+  std::filesystem::rename(fname_tmp, fname);
+}
+
+} // namespace hesiod::io
@@ -0,0 +1,295 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "highmap.hpp"
+#include "macrologger.h"
+
+#include "hesiod/distance_transform.hpp"
+#include "hesiod/parallel.hpp"
+#include "hesiod/region.hpp"
+
+namespace hesiod::distance_transform
+{
+
+// initial distances of the transform: 0 for the feature cells, 'inf'
+// (nx + ny) elsewhere, arrays are stored row-major with index i * ny + j
+static std::vector<int> get_features(const hmap::Array &array,
+                                     bool               reverse,
+                                     bool              &has_features)
+{
+  const int inf = array.shape.x + array.shape.y;
+
+  std::vector<int> g(array.vector.size());
+
+  has_features = false;
+  for (size_t r = 0; r < g.size(); r++)
+  {
+    bool is_feature = (array.vector[r] > 0.f) != reverse;
+    g[r] = is_feature ? 0 : inf;
+    has_features |= is_feature;
+  }
+
+  return g;
+}
+
+// same, read directly from the cells owned by each tile
+static std::vector<int> get_features(const hmap::HeightMap            &h,
+                                     const hesiod::region::TileLookup &lookup,
+                                     bool                              reverse,
+                                     bool &has_features)
+{
+  const int ny = h.shape.y;
+  const int inf = h.shape.x + h.shape.y;
+
+  std::vector<int>  g((size_t)h.shape.x * ny);
+  std::vector<char> has_features_tile(h.tiles.size(), 0);
+
+  parallel_for(
+      (int)h.tiles.size(),
+      [&](int k_start, int k_end)
+      {
+        for (int k = k_start; k < k_end; k++)
+        {
+          const hmap::Tile &tile = h.tiles[k];
+          hmap::Vec4<int>   cells;
+          hmap::Vec2<int>   ij0;
+
+          lookup.get_tile_cells(k, cells, ij0);
+
+          for (int i = cells.a; i < cells.b; i++)
+            for (int j = cells.c; j < cells.d; j++)
+            {
+              float v = tile.vector[(size_t)(i - ij0.x) * tile.shape.y + j -
+                                    ij0.y];
+              bool  is_feature = (v > 0.f) != reverse;
+
+              g[(size_t)i * ny + j] = is_feature ? 0 : inf;
+              has_features_tile[k] |= is_feature;
+            }
+        }
+      });
+
+  has_features = std::find(has_features_tile.begin(),
+                           has_features_tile.end(),
+                           1) != has_features_tile.end();
+
+  return g;
+}
+
+// squared distance transform of the initial distances 'g' (modified)
+static std::vector<float> edt_squared(std::vector<int> &g, int nx, int ny)
+{
+  // phase 1, along i for every column j
+  parallel_for(
+      ny,
+      [&](int j_start, int j_end)
+      {
+        for (int j = j_start; j < j_end; j++)
+        {
+          for (int i = 1; i < nx; i++)
+            if (g[(size_t)i * ny + j] > 0)
+              g[(size_t)i * ny + j] = std::min(g[(size_t)i * ny + j],
+                                               1 + g[(size_t)(i - 1) * ny + j]);
+
+          for (int i = nx - 2; i >= 0; i--)
+            if (g[(size_t)(i + 1) * ny + j] < g[(size_t)i * ny + j])
+              g[(size_t)i * ny + j] = 1 + g[(size_t)(i + 1) * ny + j];
+        }
+      });
+
+  // phase 2, lower envelope of the parabolas along j for every row i
+  std::vector<float> dt((size_t)nx * ny);
+
+  parallel_for(
+      nx,
+      [&](int i_start, int i_end)
+      {
+        std::vector<int> s(ny), t(ny);
+
+        for (int i = i_start; i < i_end; i++)
+        {
+          const int *gi = &g[(size_t)i * ny];
+
+          auto f = [&gi](int x, int q)
+          { return (int64_t)(x - q) * (x - q) + (int64_t)gi[q] * gi[q]; };
+
+          auto sep = [&gi](int p, int q)
+          {
+            return (int)(((int64_t)q * q - (int64_t)p * p +
+                          (int64_t)gi[q] * gi[q] - (int64_t)gi[p] * gi[p]) /
+                         (2 * (int64_t)(q - p)));
+          };
+
+          int k = 0;
+          s[0] = 0;
+          t[0] = 0;
+
+          for (int q = 1; q < ny; q++)
+          {
+            while (k >= 0 && f(t[k], s[k]) > f(t[k], q))
+              k--;
+
+            if (k < 0)
+            {
+              k = 0;
+              s[0] = q;
+            }
+            else
+            {
+              int w = 1 + sep(s[k], q);
+              if (w < ny)
+              {
+                k++;
+                s[k] = q;
+                t[k] = w;
+              }
+            }
+          }
+
+          for (int j = ny - 1; j >= 0; j--)
+          {
+            dt[(size_t)i * ny + j] = (float)f(j, s[k]);
+            if (j == t[k])
+              k--;
+          }
+        }
+      });
+
+  return dt;
+}
+
+hmap::Array edt(const hmap::Array &array, bool reverse)
+{
+  hmap::Array out = hmap::Array(array.shape);
+  bool        has_features;
+
+  std::vector<int>   g = get_features(array, reverse, has_features);
+  std::vector<float> dt2 = edt_squared(g, array.shape.x, array.shape.y);
+
+  if (has_features)
+    for (size_t r = 0; r < dt2.size(); r++)
+      out.vector[r] = std::sqrt(dt2[r]);
+
+  return out;
+}
+
+hmap::Array signed_edt(const hmap::Array &array, bool reverse)
+{
+  hmap::Array out = hmap::Array(array.shape);
+  bool        has_features_out, has_features_in;
+
+  std::vector<int>   g_out = get_features(array, reverse, has_features_out);
+  std::vector<float> dt2_out = edt_squared(g_out,
+                                           array.shape.x,
+                                           array.shape.y);
+  std::vector<int>   g_in = get_features(array, !reverse, has_features_in);
+  std::vector<float> dt2_in = edt_squared(g_in, array.shape.x, array.shape.y);
+
+  for (size_t r = 0; r < out.vector.size(); r++)
+  {
+    float d_out = has_features_out ? std::sqrt(dt2_out[r]) : 0.f;
+    float d_in = has_features_in ? std::sqrt(dt2_in[r]) : 0.f;
+    out.vector[r] = d_out - d_in;
+  }
+
+  return out;
+}
+
+void edt(hmap::HeightMap &h,
+         bool             reverse,
+         bool             signed_distance,
+         hmap::Vec2<int>  shape)
+{
+  hesiod::region::TileLookup lookup = hesiod::region::TileLookup(h);
+
+  bool working_shape = shape.x > 0 && shape.y > 0 &&
+                       (shape.x < h.shape.x || shape.y < h.shape.y);
+
+  // reduced working resolution (or tiles not aligned with the global
+  // grid), the domain is assembled and interpolated back
+  if (working_shape || !lookup.is_valid())
+  {
+    hmap::Array z;
+
+    if (working_shape)
+      z = h.to_array(hmap::Vec2<int>(std::min(shape.x, h.shape.x),
+                                     std::min(shape.y, h.shape.y)));
+    else
+      z = h.to_array();
+
+    if (signed_distance)
+      z = signed_edt(z, reverse);
+    else
+      z = edt(z, reverse);
+
+    h.from_array_interp(z);
+    return;
+  }
+
+  // full resolution, the features are read from the tiles and the
+  // distances written back to every tile cell (overlap buffers included)
+  // from its global cell, no gathering of the heightmap
+  const int nx = h.shape.x;
+  const int ny = h.shape.y;
+
+  auto write_tiles = [&h, &lookup, ny](const std::vector<float> &dt2,
+                                       bool                      has_features,
+                                       float                     sign,
+                                       bool                      add)
+  {
+    parallel_for(
+        (int)h.tiles.size(),
+        [&](int k_start, int k_end)
+        {
+          for (int k = k_start; k < k_end; k++)
+          {
+            hmap::Tile     &tile = h.tiles[k];
+            hmap::Vec4<int> cells;
+            hmap::Vec2<int> ij0;
+
+            lookup.get_tile_cells(k, cells, ij0);
+
+            for (int i = 0; i < tile.shape.x; i++)
+              for (int j = 0; j < tile.shape.y; j++)
+              {
+                size_t r = (size_t)(ij0.x + i) * ny + ij0.y + j;
+                float  d = has_features ? sign * std::sqrt(dt2[r]) : 0.f;
+                float &v = tile.vector[(size_t)i * tile.shape.y + j];
+
+                v = add ? v + d : d;
+              }
+          }
+        });
+  };
+
+  bool               has_features_out;
+  std::vector<float> dt2;
+  {
+    std::vector<int> g = get_features(h, lookup, reverse, has_features_out);
+    dt2 = edt_squared(g, nx, ny);
+  }
+
+  if (!signed_distance)
+  {
+    write_tiles(dt2, has_features_out, 1.f, false);
+    return;
+  }
+
+  // signed distance, both transforms are computed before the tiles are
+  // overwritten
+  bool               has_features_in;
+  std::vector<float> dt2_in;
+  {
+    std::vector<int> g = get_features(h, lookup, !reverse, has_features_in);
+    dt2_in = edt_squared(g, nx, ny);
+  }
+
+  write_tiles(dt2, has_features_out, 1.f, false);
+  write_tiles(dt2_in, has_features_in, -1.f, true);
+}
+
+} // namespace hesiod::distance_transform
@@ -0,0 +1,318 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+#ifndef _WIN32
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+extern char **environ;
+#endif
+
+#include "macrologger.h"
+
+#include "hesiod/distributed.hpp"
+
+// tile file signature
+#define TILE_MAGIC "HSDT"
+
+namespace hesiod::distributed
+{
+
+bool parse_arguments(int argc, char *argv[], RenderSettings &settings)
+{
+  // hesiod --render state.json [options]
+  if (argc < 3)
+    return false;
+
+  settings.state_fname = argv[2];
+
+  try
+  {
+    for (int k = 3; k < argc; k++)
+    {
+      std::string arg = argv[k];
+      int         nvalues = 1;
+
+      if (arg == "--shape")
+        nvalues = 2;
+      else if (arg == "--no-spawn")
+        nvalues = 0;
+
+      if (k + nvalues >= argc)
+      {
+        LOG_ERROR("missing value for argument [%s]", arg.c_str());
+        return false;
+      }
+
+      if (arg == "--shape")
+        settings.shape = {std::stoi(argv[k + 1]), std::stoi(argv[k + 2])};
+      else if (arg == "--super-tile")
+        settings.super_tile = std::stoi(argv[k + 1]);
+      else if (arg == "--overlap")
+        settings.overlap = std::stoi(argv[k + 1]);
+      else if (arg == "--workers")
+        settings.nworkers = std::stoi(argv[k + 1]);
+      else if (arg == "--dir")
+        settings.dir = argv[k + 1];
+      else if (arg == "--run-id")
+        settings.run_id = argv[k + 1];
+      else if (arg == "--rank")
+        settings.rank = std::stoi(argv[k + 1]);
+      else if (arg == "--no-spawn")
+        settings.spawn = false;
+      else
+      {
+        LOG_ERROR("unknown argument [%s]", arg.c_str());
+        return false;
+      }
+
+      k += nvalues;
+    }
+  }
+  catch (const std::exception &e)
+  {
+    LOG_ERROR("invalid argument value: %s", e.what());
+    return false;
+  }
+
+  // workers and coordinator have to agree on the run when the workers are
+  // not spawned by the coordinator
+  if (settings.run_id.empty() && (settings.rank >= 0 || !settings.spawn))
+  {
+    LOG_ERROR("'--run-id' is required for workers and with '--no-spawn'");
+    return false;
+  }
+
+  return settings.shape.x > 0 && settings.shape.y > 0 &&
+         settings.super_tile > 0 && settings.overlap >= 0 &&
+         settings.nworkers > 0 && settings.rank < settings.nworkers;
+}
+
+std::string new_run_id()
+{
+  std::string id = std::to_string(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count());
+#ifndef _WIN32
+  id += "_" + std::to_string((int)getpid());
+#endif
+  return id;
+}
+
+std::string run_dir(const RenderSettings &settings)
+{
+  return (std::filesystem::path(settings.dir) / ("run_" + settings.run_id))
+      .string();
+}
+
+std::string tile_fname(const RenderSettings &settings,
+                       int                   export_index,
+                       int                   tile_index)
+{
+  return (std::filesystem::path(run_dir(settings)) /
+          ("export_" + std::to_string(export_index) + "_tile_" +
+           std::to_string(tile_index) + ".bin"))
+      .string();
+}
+
+hmap::Vec4<int> grow_cells(const hmap::Vec4<int> &cells,
+                           int                    overlap,
+                           hmap::Vec2<int>        shape)
+{
+  return hmap::Vec4<int>(std::max(0, cells.a - overlap),
+                         std::min(shape.x, cells.b + overlap),
+                         std::max(0, cells.c - overlap),
+                         std::min(shape.y, cells.d + overlap));
+}
+
+float blending_weight(const hmap::Vec4<int> &cells_grown,
+                      int                    overlap,
+                      hmap::Vec2<int>        shape,
+                      int                    i,
+                      int                    j)
+{
+  if (overlap == 0)
+    return 1.f;
+
+  // distance to the closest edge not on the grid boundary
+  auto ramp = [overlap](int k, int k0, int k1, int n)
+  {
+    int d = 2 * overlap; // no ramp
+
+    if (k0 > 0)
+      d = std::min(d, k - k0);
+    if (k1 < n)
+      d = std::min(d, k1 - 1 - k);
+
+    return std::min(1.f, (float)(d + 1) / (float)(2 * overlap + 1));
+  };
+
+  return ramp(i, cells_grown.a, cells_grown.b, shape.x) *
+         ramp(j, cells_grown.c, cells_grown.d, shape.y);
+}
+
+void write_tile(const std::string     &fname,
+                const hmap::Array     &array,
+                const hmap::Vec4<int> &cells)
+{
+  std::string   fname_tmp = fname + ".tmp";
+  std::ofstream f(fname_tmp, std::ios::binary);
+
+  if (!f.is_open())
+  {
+    LOG_ERROR("could not open file [%s]", fname_tmp.c_str());
+    throw std::runtime_error("could not open file " + fname_tmp);
+  }
+
+  int32_t header[4] = {cells.a, cells.b, cells.c, cells.d};
+
+  f.write(TILE_MAGIC, 4);
+  f.write((const char *)header, sizeof(header));
+  f.write((const char *)array.vector.data(),
+          sizeof(float) * array.vector.size());
+  f.close();
+
+  if (!f.good())
+  {
+    LOG_ERROR("error while writing file [%s]", fname_tmp.c_str());
+    throw std::runtime_error("error while writing file " + fname_tmp);
+  }
+
+  // the tile only becomes visible to the coordinator once complete
+  std::filesystem::rename(fname_tmp, fname);
+}
+
+bool read_tile(const std::string &fname,
+               hmap::Array       &array,
+               hmap::Vec4<int>   &cells)
+{
+  std::ifstream f(fname, std::ios::binary);
+
+  if (!f.is_open())
+    return false;
+
+  char    magic[4];
+  int32_t header[4];
+
+  f.read(magic, 4);
+  f.read((char *)header, sizeof(header));
+
+  if (!f.good() || std::strncmp(magic, TILE_MAGIC, 4) != 0 ||
+      header[1] <= header[0] || header[3] <= header[2])
+  {
+    LOG_ERROR("invalid tile file [%s]", fname.c_str());
+    return false;
+  }
+
+  cells = hmap::Vec4<int>(header[0], header[1], header[2], header[3]);
+  array = hmap::Array(hmap::Vec2<int>(cells.b - cells.a, cells.d - cells.c));
+
+  f.read((char *)array.vector.data(), sizeof(float) * array.vector.size());
+
+  if (!f.good())
+  {
+    LOG_ERROR("truncated tile file [%s]", fname.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+bool run_workers(const std::string &executable, const RenderSettings &settings)
+{
+#ifdef _WIN32
+  LOG_ERROR("local workers not available on this platform, use '--no-spawn' "
+            "and start the workers manually");
+  return false;
+#else
+  std::vector<pid_t> pids = {};
+
+  for (int rank = 0; rank < settings.nworkers; rank++)
+  {
+    std::vector<std::string> args = {executable,
+                                     "--render",
+                                     settings.state_fname,
+                                     "--shape",
+                                     std::to_string(settings.shape.x),
+                                     std::to_string(settings.shape.y),
+                                     "--super-tile",
+                                     std::to_string(settings.super_tile),
+                                     "--overlap",
+                                     std::to_string(settings.overlap),
+                                     "--workers",
+                                     std::to_string(settings.nworkers),
+                                     "--dir",
+                                     settings.dir,
+                                     "--run-id",
+                                     settings.run_id,
+                                     "--rank",
+                                     std::to_string(rank)};
+
+    std::vector<char *> argv = {};
+    for (auto &arg : args)
+      argv.push_back(arg.data());
+    argv.push_back(nullptr);
+
+    pid_t pid;
+    if (posix_spawnp(&pid,
+                     executable.c_str(),
+                     nullptr,
+                     nullptr,
+                     argv.data(),
+                     environ) != 0)
+    {
+      LOG_ERROR("could not start worker %d", rank);
+      continue;
+    }
+
+    LOG_DEBUG("worker %d started (pid %d)", rank, (int)pid);
+    pids.push_back(pid);
+  }
+
+  bool success = (int)pids.size() == settings.nworkers;
+
+  for (auto pid : pids)
+  {
+    int status = 0;
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) ||
+        WEXITSTATUS(status) != 0)
+    {
+      LOG_ERROR("worker (pid %d) failed", (int)pid);
+      success = false;
+    }
+  }
+
+  return success;
+#endif
+}
+
+void wait_tiles(const RenderSettings &settings, int nexports, int ntiles)
+{
+  int nmissing = 0;
+
+  do
+  {
+    nmissing = 0;
+    for (int e = 0; e < nexports; e++)
+      for (int k = 0; k < ntiles; k++)
+        if (!std::filesystem::exists(tile_fname(settings, e, k)))
+          nmissing++;
+
+    if (nmissing > 0)
+    {
+      LOG_DEBUG("waiting for %d tile file(s)", nmissing);
+      std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+  } while (nmissing > 0);
+}
+
+} // namespace hesiod::distributed
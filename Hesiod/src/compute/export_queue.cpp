@@ -0,0 +1,186 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+#include <stdexcept>
+
+#include "macrologger.h"
+
+#include "hesiod/export_queue.hpp"
+#include "hesiod/timer.hpp"
+
+namespace hesiod::io
+{
+
+ExportQueue &ExportQueue::get_instance()
+{
+  static ExportQueue instance;
+  return instance;
+}
+
+ExportQueue::ExportQueue()
+{
+  this->thread = std::thread(&ExportQueue::run, this);
+}
+
+ExportQueue::~ExportQueue()
+{
+  // queued jobs are still written before leaving
+  {
+    const std::lock_guard<std::mutex> lock(this->mutex);
+    this->stop = true;
+  }
+  this->cv.notify_all();
+
+  if (this->thread.joinable())
+    this->thread.join();
+}
+
+void ExportQueue::push(const std::string &fname, Job job)
+{
+  {
+    const std::lock_guard<std::mutex> lock(this->mutex);
+
+    ExportStatus &status = this->status[fname];
+
+    if (this->jobs.contains(fname))
+    {
+      // latest wins, the job keeps its place in the queue
+      status.coalesced++;
+      LOG_DEBUG("export queue, [%s] coalesced", fname.c_str());
+    }
+    else
+      this->order.push_back(fname);
+
+    this->jobs[fname] = job;
+
+    // a write in progress for this file is left as is, it will be followed
+    // by the new one
+    if (fname != this->current_fname)
+    {
+      status.state = export_state::queued;
+      status.progress = 0.f;
+    }
+  }
+  this->cv.notify_all();
+}
+
+ExportStatus ExportQueue::get_status(const std::string &fname)
+{
+  const std::lock_guard<std::mutex> lock(this->mutex);
+
+  if (this->status.contains(fname))
+    return this->status.at(fname);
+  else
+    return ExportStatus();
+}
+
+int ExportQueue::get_pending_count()
+{
+  const std::lock_guard<std::mutex> lock(this->mutex);
+  return (int)this->jobs.size() + (this->current_fname == "" ? 0 : 1);
+}
+
+bool ExportQueue::is_busy()
+{
+  return this->get_pending_count() > 0;
+}
+
+void ExportQueue::wait()
+{
+  std::unique_lock<std::mutex> lock(this->mutex);
+  this->cv.wait(lock,
+                [this]()
+                { return this->jobs.empty() && this->current_fname == ""; });
+}
+
+void ExportQueue::set_on_job_done(std::function<void()> fct)
+{
+  const std::lock_guard<std::mutex> lock(this->mutex);
+  this->on_job_done = fct;
+}
+
+void ExportQueue::run()
+{
+  std::unique_lock<std::mutex> lock(this->mutex);
+
+  while (true)
+  {
+    this->cv.wait(lock,
+                  [this]() { return this->stop || !this->order.empty(); });
+
+    if (this->order.empty())
+      break; // stop requested and nothing left to write
+
+    std::string fname = this->order.front();
+    this->order.pop_front();
+
+    Job job = std::move(this->jobs.at(fname));
+    this->jobs.erase(fname);
+
+    this->current_fname = fname;
+    this->status[fname].state = export_state::writing;
+    this->status[fname].progress = 0.f;
+    this->status[fname].message = "";
+
+    auto set_progress = [this, fname](float progress)
+    {
+      const std::lock_guard<std::mutex> lock(this->mutex);
+      this->status[fname].progress = progress;
+    };
+
+    // the write itself is done without holding the lock
+    lock.unlock();
+
+    LOG_DEBUG("export queue, writing [%s]", fname.c_str());
+
+    Timer       timer = Timer();
+    int         state = export_state::done;
+    std::string message = "";
+
+    try
+    {
+      job(set_progress);
+    }
+    catch (const std::exception &e)
+    {
+      LOG_ERROR("export of [%s] failed: %s", fname.c_str(), e.what());
+      state = export_state::failed;
+      message = e.what();
+    }
+
+    float elapsed = timer.stop();
+
+    lock.lock();
+
+    ExportStatus &status = this->status[fname];
+
+    // a newer job for this file may have been queued in the meantime
+    if (this->jobs.contains(fname))
+    {
+      status.state = export_state::queued;
+      status.progress = 0.f;
+    }
+    else
+    {
+      status.state = state;
+      status.progress = state == export_state::done ? 1.f : status.progress;
+    }
+
+    status.elapsed = elapsed;
+    status.message = message;
+
+    this->current_fname = "";
+    this->cv.notify_all();
+
+    // called without holding the lock
+    if (this->on_job_done)
+    {
+      std::function<void()> fct = this->on_job_done;
+      lock.unlock();
+      fct();
+      lock.lock();
+    }
+  }
+}
+
+} // namespace hesiod::io
@@ -0,0 +1,923 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <exception>
+#include <filesystem>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <zlib.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <mutex>
+#else
+#include <unistd.h>
+#endif
+
+#include "macrologger.h"
+
+#include "hesiod/heightmap_writer.hpp"
+#include "hesiod/parallel.hpp"
+#include "hesiod/region.hpp"
+
+namespace hesiod::io
+{
+
+// cell values read from the tiles, the whole array being gathered only if
+// the tiles are not aligned with the global grid
+class CellReader
+{
+public:
+  CellReader(const hmap::HeightMap &h) : lookup(h)
+  {
+    if (!this->lookup.is_valid())
+    {
+      LOG_DEBUG("tiles not aligned, heightmap gathered before writing");
+      this->array = hmap::HeightMap(h).to_array();
+    }
+
+    this->vmin = std::numeric_limits<float>::max();
+    this->vmax = -std::numeric_limits<float>::max();
+
+    for (auto &tile : h.tiles)
+    {
+      this->vmin = std::min(this->vmin, tile.min());
+      this->vmax = std::max(this->vmax, tile.max());
+    }
+
+    this->norm = this->vmax > this->vmin ? 1.f / (this->vmax - this->vmin)
+                                         : 0.f;
+  }
+
+  inline float get(int i, int j) const
+  {
+    return this->lookup.is_valid() ? this->lookup.get(i, j)
+                                   : this->array(i, j);
+  }
+
+  // value normalized in [0, 1]
+  inline float get_normalized(int i, int j) const
+  {
+    return std::clamp((this->get(i, j) - this->vmin) * this->norm, 0.f, 1.f);
+  }
+
+  hmap::Vec2<float> get_range() const
+  {
+    return hmap::Vec2<float>(this->vmin, this->vmax);
+  }
+
+private:
+  hesiod::region::TileLookup lookup;
+  hmap::Array                array;
+  float                      vmin, vmax, norm;
+};
+
+// bands are processed by groups of one band per thread, the group results
+// being consumed in order by 'write_fct(band, slot)' on the calling thread
+static void for_each_band_group(int                           nbands,
+                                std::function<bool(int, int)> encode_fct,
+                                std::function<void(int, int)> write_fct,
+                                std::function<void(float)>    progress)
+{
+  int nthreads = (int)std::max(1u, std::thread::hardware_concurrency());
+
+  for (int b0 = 0; b0 < nbands; b0 += nthreads)
+  {
+    int               nb = std::min(nthreads, nbands - b0);
+    std::atomic<bool> success = true;
+
+    hesiod::parallel_for(
+        nb,
+        [&encode_fct, &success, b0](int k_start, int k_end)
+        {
+          for (int k = k_start; k < k_end; k++)
+            if (!encode_fct(b0 + k, k))
+              success = false;
+        },
+        nb);
+
+    if (!success)
+    {
+      LOG_ERROR("band encoding failed");
+      throw std::runtime_error("band encoding failed");
+    }
+
+    for (int k = 0; k < nb; k++)
+      write_fct(b0 + k, k);
+
+    if (progress)
+      progress((float)(b0 + nb) / (float)nbands);
+  }
+}
+
+//----------------------------------------
+// PNG
+//----------------------------------------
+
+static void put_uint32_be(std::vector<uint8_t> &data, uint32_t v)
+{
+  data.push_back((uint8_t)(v >> 24));
+  data.push_back((uint8_t)(v >> 16));
+  data.push_back((uint8_t)(v >> 8));
+  data.push_back((uint8_t)v);
+}
+
+static void write_png_chunk(std::ofstream              &f,
+                            const char                 *type,
+                            const std::vector<uint8_t> &data)
+{
+  std::vector<uint8_t> header = {};
+  put_uint32_be(header, (uint32_t)data.size());
+  header.insert(header.end(), type, type + 4);
+
+  uLong crc = crc32(0L, Z_NULL, 0);
+  crc = crc32(crc, (const Bytef *)type, 4);
+  if (!data.empty())
+    crc = crc32_z(crc, data.data(), data.size());
+
+  std::vector<uint8_t> footer = {};
+  put_uint32_be(footer, (uint32_t)crc);
+
+  f.write((const char *)header.data(), header.size());
+  f.write((const char *)data.data(), data.size());
+  f.write((const char *)footer.data(), footer.size());
+}
+
+// PNG stream, the image rows being pushed from top to bottom
+class PngStream
+{
+public:
+  PngStream(const std::string &fname, int nx, int ny, int bit_depth)
+      : fname(fname), nx(nx), ny(ny), bit_depth(bit_depth)
+  {
+    if (bit_depth != 8 && bit_depth != 16)
+    {
+      LOG_ERROR("unsupported bit depth: %d", bit_depth);
+      throw std::runtime_error("unsupported bit depth");
+    }
+
+    this->f.open(fname, std::ios::binary);
+
+    if (!this->f.is_open())
+    {
+      LOG_ERROR("could not open file [%s]", fname.c_str());
+      throw std::runtime_error("could not open file " + fname);
+    }
+
+    this->bpp = (size_t)bit_depth / 8;
+    this->row_bytes = 1 + (size_t)nx * this->bpp; // filter type + samples
+
+    int nthreads = (int)std::max(1u, std::thread::hardware_concurrency());
+    this->compressed.resize(nthreads);
+    this->band_adler.resize(nthreads);
+    this->band_size.resize(nthreads);
+    this->adler = adler32(0L, Z_NULL, 0);
+
+    // signature and header
+    const uint8_t signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+    this->f.write((const char *)signature, 8);
+
+    std::vector<uint8_t> ihdr = {};
+    put_uint32_be(ihdr, (uint32_t)nx);
+    put_uint32_be(ihdr, (uint32_t)ny);
+    ihdr.insert(ihdr.end(), {(uint8_t)bit_depth, 0, 0, 0, 0}); // grayscale
+    write_png_chunk(this->f, "IHDR", ihdr);
+
+    // image data, a single zlib stream (header, raw deflate data of each
+    // band and Adler-32 checksum) split into IDAT chunks
+    write_png_chunk(this->f, "IDAT", {0x78, 0x9c});
+  }
+
+  /**
+   * Push the image rows [r0, r1), 'value(i, r)' returning the normalized
+   * value of the pixel i of the row r.
+   */
+  template <typename F>
+  void write_rows(int                        r0,
+                  int                        r1,
+                  F                          value,
+                  std::function<void(float)> progress = nullptr)
+  {
+    if (r0 != this->row_next || r1 > this->ny)
+    {
+      LOG_ERROR("PNG rows not written in order");
+      throw std::runtime_error("PNG rows not written in order");
+    }
+
+    int nbands = (r1 - r0 + WRITER_BAND_ROWS - 1) / WRITER_BAND_ROWS;
+
+    auto encode_fct = [this, &value, r0, r1](int band, int slot)
+    {
+      int rb0 = r0 + band * WRITER_BAND_ROWS;
+      int rb1 = std::min(r1, rb0 + WRITER_BAND_ROWS);
+
+      std::vector<uint8_t> raw((size_t)(rb1 - rb0) * this->row_bytes);
+      std::vector<uint8_t> row(this->nx * this->bpp);
+
+      for (int r = rb0; r < rb1; r++)
+      {
+        if (this->bit_depth == 8)
+          for (int i = 0; i < this->nx; i++)
+            row[i] = (uint8_t)(255.f * value(i, r));
+        else
+          for (int i = 0; i < this->nx; i++)
+          {
+            uint16_t v = (uint16_t)(65535.f * value(i, r));
+            row[2 * i] = (uint8_t)(v >> 8); // big endian
+            row[2 * i + 1] = (uint8_t)v;
+          }
+
+        // 'Sub' filter, only depends on the current row so that bands can be
+        // encoded independently
+        uint8_t *p = raw.data() + (size_t)(r - rb0) * this->row_bytes;
+        p[0] = 1;
+        for (size_t k = 0; k < row.size(); k++)
+          p[k + 1] = k < this->bpp ? row[k]
+                                   : (uint8_t)(row[k] - row[k - this->bpp]);
+      }
+
+      this->band_adler[slot] = adler32_z(adler32(0L, Z_NULL, 0),
+                                         raw.data(),
+                                         raw.size());
+      this->band_size[slot] = raw.size();
+
+      // raw deflate, flushed to a byte boundary so that the band streams can
+      // be concatenated, the last band of the image terminating the stream
+      return deflate_band(raw,
+                          this->compressed[slot],
+                          rb1 == this->ny ? Z_FINISH : Z_SYNC_FLUSH);
+    };
+
+    auto write_fct = [this](int, int slot)
+    {
+      this->adler = adler32_combine(this->adler,
+                                    this->band_adler[slot],
+                                    this->band_size[slot]);
+      write_png_chunk(this->f, "IDAT", this->compressed[slot]);
+    };
+
+    for_each_band_group(nbands, encode_fct, write_fct, progress);
+
+    this->row_next = r1;
+  }
+
+  void close()
+  {
+    if (this->row_next != this->ny)
+    {
+      LOG_ERROR("incomplete PNG image [%s]", this->fname.c_str());
+      throw std::runtime_error("incomplete PNG image " + this->fname);
+    }
+
+    std::vector<uint8_t> checksum = {};
+    put_uint32_be(checksum, (uint32_t)this->adler);
+    write_png_chunk(this->f, "IDAT", checksum);
+
+    write_png_chunk(this->f, "IEND", {});
+    this->f.close();
+
+    if (!this->f.good())
+    {
+      LOG_ERROR("error while writing file [%s]", this->fname.c_str());
+      throw std::runtime_error("error while writing file " + this->fname);
+    }
+  }
+
+private:
+  std::string                       fname;
+  std::ofstream                     f;
+  int                               nx, ny, bit_depth;
+  size_t                            bpp, row_bytes;
+  int                               row_next = 0;
+  uLong                             adler;
+  std::vector<std::vector<uint8_t>> compressed;
+  std::vector<uLong>                band_adler;
+  std::vector<size_t>               band_size;
+
+  static bool deflate_band(std::vector<uint8_t> &raw,
+                           std::vector<uint8_t> &out,
+                           int                   flush)
+  {
+    z_stream zs = {};
+
+    if (deflateInit2(&zs,
+                     WRITER_PNG_LEVEL,
+                     Z_DEFLATED,
+                     -15,
+                     8,
+                     Z_DEFAULT_STRATEGY) != Z_OK)
+      return false;
+
+    out.resize(deflateBound(&zs, raw.size()) + 16);
+
+    zs.next_in = raw.data();
+    zs.avail_in = (uInt)raw.size();
+    zs.next_out = out.data();
+    zs.avail_out = (uInt)out.size();
+
+    int  ret = deflate(&zs, flush);
+    bool success = flush == Z_FINISH ? ret == Z_STREAM_END
+                                     : ret == Z_OK && zs.avail_in == 0 &&
+                                           zs.avail_out > 0;
+
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+
+    return success;
+  }
+};
+
+void write_png_grayscale(const hmap::HeightMap     &h,
+                         const std::string         &fname,
+                         int                        bit_depth,
+                         std::function<void(float)> progress)
+{
+  PngStream  png = PngStream(fname, h.shape.x, h.shape.y, bit_depth);
+  CellReader reader = CellReader(h);
+  int        ny = h.shape.y;
+
+  // image rows, from top (largest j) to bottom
+  auto value = [&reader, ny](int i, int r)
+  { return reader.get_normalized(i, ny - 1 - r); };
+
+  png.write_rows(0, ny, value, progress);
+
+  png.close();
+}
+
+//----------------------------------------
+// raw formats
+//----------------------------------------
+
+#ifdef _WIN32
+static std::mutex write_at_mutex;
+#endif
+
+// file of a given size, bands being written at their offset
+static int open_preallocated(const std::string &fname, size_t size)
+{
+#ifdef _WIN32
+  int fd = _open(fname.c_str(),
+                 _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY,
+                 _S_IREAD | _S_IWRITE);
+  bool success = fd >= 0 && _chsize_s(fd, (long long)size) == 0;
+#else
+  int  fd = open(fname.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  bool success = fd >= 0 && ftruncate(fd, (off_t)size) == 0;
+#endif
+
+  if (!success)
+  {
+    LOG_ERROR("could not create file [%s]", fname.c_str());
+    throw std::runtime_error("could not create file " + fname);
+  }
+
+  return fd;
+}
+
+static bool write_at(int fd, const void *data, size_t nbytes, size_t offset)
+{
+#ifdef _WIN32
+  const std::lock_guard<std::mutex> lock(write_at_mutex);
+
+  if (_lseeki64(fd, (long long)offset, SEEK_SET) < 0)
+    return false;
+  return _write(fd, data, (unsigned int)nbytes) == (int)nbytes;
+#else
+  const uint8_t *p = (const uint8_t *)data;
+
+  while (nbytes > 0)
+  {
+    ssize_t n = pwrite(fd, p, nbytes, (off_t)offset);
+    if (n <= 0)
+      return false;
+
+    p += n;
+    offset += n;
+    nbytes -= n;
+  }
+  return true;
+#endif
+}
+
+static void close_file(int fd, const std::string &fname)
+{
+#ifdef _WIN32
+  bool success = _close(fd) == 0;
+#else
+  bool success = close(fd) == 0;
+#endif
+
+  if (!success)
+  {
+    LOG_ERROR("error while closing file [%s]", fname.c_str());
+    throw std::runtime_error("error while closing file " + fname);
+  }
+}
+
+// bands written directly by the encoding threads
+static void write_bands(
+    const std::string                                 &fname,
+    size_t                                             size,
+    int                                                nbands,
+    std::function<size_t(int, std::vector<uint8_t> &)> fill_fct,
+    std::function<void(float)>                         progress)
+{
+  int fd = open_preallocated(fname, size);
+
+  int nthreads = (int)std::max(1u, std::thread::hardware_concurrency());
+  std::vector<std::vector<uint8_t>> buffers(nthreads);
+
+  auto encode_fct = [&](int band, int slot)
+  {
+    size_t offset = fill_fct(band, buffers[slot]);
+    return write_at(fd, buffers[slot].data(), buffers[slot].size(), offset);
+  };
+
+  try
+  {
+    for_each_band_group(nbands, encode_fct, [](int, int) {}, progress);
+  }
+  catch (...)
+  {
+    close_file(fd, fname);
+    throw;
+  }
+
+  close_file(fd, fname);
+}
+
+void write_raw_16bit(const hmap::HeightMap     &h,
+                     const std::string         &fname,
+                     std::function<void(float)> progress)
+{
+  CellReader reader = CellReader(h);
+
+  int    nx = h.shape.x;
+  int    ny = h.shape.y;
+  size_t row_bytes = 2 * (size_t)nx;
+  int    nbands = (ny + WRITER_BAND_ROWS - 1) / WRITER_BAND_ROWS;
+
+  // image rows, from top (largest j) to bottom, little endian samples
+  auto fill_fct = [&](int band, std::vector<uint8_t> &buffer)
+  {
+    int r0 = band * WRITER_BAND_ROWS;
+    int r1 = std::min(ny, r0 + WRITER_BAND_ROWS);
+
+    buffer.resize((size_t)(r1 - r0) * row_bytes);
+
+    for (int r = r0; r < r1; r++)
+    {
+      uint8_t *p = buffer.data() + (size_t)(r - r0) * row_bytes;
+      int      j = ny - 1 - r;
+
+      for (int i = 0; i < nx; i++)
+      {
+        uint16_t v = (uint16_t)(65535.f * reader.get_normalized(i, j));
+        p[2 * i] = (uint8_t)v;
+        p[2 * i + 1] = (uint8_t)(v >> 8);
+      }
+    }
+
+    return (size_t)r0 * row_bytes;
+  };
+
+  write_bands(fname, (size_t)ny * row_bytes, nbands, fill_fct, progress);
+}
+
+void write_binary(const hmap::HeightMap     &h,
+                  const std::string         &fname,
+                  std::function<void(float)> progress)
+{
+  CellReader reader = CellReader(h);
+
+  int    nx = h.shape.x;
+  int    ny = h.shape.y;
+  size_t row_bytes = sizeof(float) * (size_t)ny;
+  int    nbands = (nx + WRITER_BAND_ROWS - 1) / WRITER_BAND_ROWS;
+
+  // array storage order, a band being a range of i indices
+  auto fill_fct = [&](int band, std::vector<uint8_t> &buffer)
+  {
+    int i0 = band * WRITER_BAND_ROWS;
+    int i1 = std::min(nx, i0 + WRITER_BAND_ROWS);
+
+    buffer.resize((size_t)(i1 - i0) * row_bytes);
+    float *p = (float *)buffer.data();
+
+    for (int i = i0; i < i1; i++)
+      for (int j = 0; j < ny; j++)
+        *p++ = reader.get(i, j);
+
+    return (size_t)i0 * row_bytes;
+  };
+
+  write_bands(fname, (size_t)nx * row_bytes, nbands, fill_fct, progress);
+}
+
+//----------------------------------------
+// block writer
+//----------------------------------------
+
+BlockWriter::BlockWriter(const std::string &fname,
+                         int                format,
+                         hmap::Vec2<int>    shape,
+                         hmap::Vec2<float>  range)
+    : fname(fname), format(format), shape(shape), range(range),
+      j_top(shape.y)
+{
+  switch (format)
+  {
+  case file_format::png8bit:
+    this->png = std::make_unique<PngStream>(fname, shape.x, shape.y, 8);
+    break;
+
+  case file_format::png16bit:
+    this->png = std::make_unique<PngStream>(fname, shape.x, shape.y, 16);
+    break;
+
+  case file_format::raw16bit:
+    this->fd = open_preallocated(fname, 2 * (size_t)shape.x * shape.y);
+    break;
+
+  case file_format::binary:
+    this->fd = open_preallocated(fname,
+                                 sizeof(float) * (size_t)shape.x * shape.y);
+    break;
+
+  default:
+    LOG_ERROR("unknown file format: %d", format);
+    throw std::runtime_error("unknown file format");
+  }
+}
+
+BlockWriter::~BlockWriter()
+{
+  // files not closed explicitly (error while writing), left as is
+  if (this->fd >= 0)
+  {
+#ifdef _WIN32
+    _close(this->fd);
+#else
+    ::close(this->fd);
+#endif
+  }
+}
+
+float BlockWriter::normalize(float v) const
+{
+  float norm = this->range.y > this->range.x
+                   ? 1.f / (this->range.y - this->range.x)
+                   : 0.f;
+  return std::clamp((v - this->range.x) * norm, 0.f, 1.f);
+}
+
+void BlockWriter::write_block(const hmap::Array &block, hmap::Vec2<int> ij0)
+{
+  int i0 = ij0.x;
+  int j0 = ij0.y;
+  int nx = block.shape.x;
+  int ny = block.shape.y;
+
+  if (i0 < 0 || j0 < 0 || i0 + nx > this->shape.x || j0 + ny > this->shape.y)
+  {
+    LOG_ERROR("block outside the heightmap");
+    throw std::runtime_error("block outside the heightmap");
+  }
+
+  std::atomic<bool> success = true;
+
+  switch (this->format)
+  {
+  case file_format::png8bit:
+  case file_format::png16bit:
+  {
+    // blocks are gathered into a band spanning the whole image width
+    if (this->band_count == 0)
+    {
+      if (j0 + ny != this->j_top)
+      {
+        LOG_ERROR("PNG blocks not written from top to bottom");
+        throw std::runtime_error("PNG blocks not written from top to bottom");
+      }
+
+      this->band = hmap::Array(hmap::Vec2<int>(this->shape.x, ny));
+      this->band_j0 = j0;
+    }
+    else if (j0 != this->band_j0 || ny != this->band.shape.y)
+    {
+      LOG_ERROR("PNG block not aligned with the current band");
+      throw std::runtime_error("PNG block not aligned with the current band");
+    }
+
+    for (int i = 0; i < nx; i++)
+      for (int j = 0; j < ny; j++)
+        this->band(i0 + i, j) = block(i, j);
+
+    this->band_count += (size_t)nx * ny;
+
+    if (this->band_count == (size_t)this->shape.x * ny)
+    {
+      // image rows, from top (largest j) to bottom
+      int  r0 = this->shape.y - j0 - ny;
+      auto value = [this, r0, ny](int i, int r)
+      { return this->normalize(this->band(i, ny - 1 - (r - r0))); };
+
+      this->png->write_rows(r0, r0 + ny, value);
+
+      this->j_top = j0;
+      this->band_count = 0;
+      this->band = hmap::Array();
+    }
+  }
+  break;
+
+  case file_format::raw16bit:
+  {
+    // one image row segment per j index
+    size_t row_bytes = 2 * (size_t)this->shape.x;
+
+    hesiod::parallel_for(
+        ny,
+        [&](int k_start, int k_end)
+        {
+          std::vector<uint8_t> buffer(2 * (size_t)nx);
+
+          for (int j = k_start; j < k_end; j++)
+          {
+            for (int i = 0; i < nx; i++)
+            {
+              uint16_t v = (uint16_t)(65535.f * this->normalize(block(i, j)));
+              buffer[2 * i] = (uint8_t)v; // little endian
+              buffer[2 * i + 1] = (uint8_t)(v >> 8);
+            }
+
+            size_t r = (size_t)(this->shape.y - 1 - j0 - j);
+            if (!write_at(this->fd,
+                          buffer.data(),
+                          buffer.size(),
+                          r * row_bytes + 2 * (size_t)i0))
+              success = false;
+          }
+        });
+  }
+  break;
+
+  case file_format::binary:
+  {
+    // one segment per i index (array storage order)
+    hesiod::parallel_for(
+        nx,
+        [&](int k_start, int k_end)
+        {
+          std::vector<float> buffer(ny);
+
+          for (int i = k_start; i < k_end; i++)
+          {
+            for (int j = 0; j < ny; j++)
+              buffer[j] = block(i, j);
+
+            size_t offset = ((size_t)(i0 + i) * this->shape.y + j0) *
+                            sizeof(float);
+            if (!write_at(this->fd,
+                          buffer.data(),
+                          sizeof(float) * ny,
+                          offset))
+              success = false;
+          }
+        });
+  }
+  break;
+  }
+
+  if (!success)
+  {
+    LOG_ERROR("error while writing file [%s]", this->fname.c_str());
+    throw std::runtime_error("error while writing file " + this->fname);
+  }
+}
+
+void BlockWriter::close()
+{
+  if (this->png)
+    this->png->close();
+
+  if (this->fd >= 0)
+  {
+    int fd = this->fd;
+    this->fd = -1;
+    close_file(fd, this->fname);
+  }
+}
+
+//----------------------------------------
+// mip chain
+//----------------------------------------
+
+std::string mip_level_fname(const std::string &fname, int level)
+{
+  if (level == 0)
+    return fname;
+
+  std::filesystem::path path = fname;
+  std::string           stem = path.stem().string();
+
+  return path.replace_filename(stem + "_lod" + std::to_string(level) +
+                               path.extension().string())
+      .string();
+}
+
+hmap::Vec2<int> mip_level_shape(hmap::Vec2<int> shape, int level)
+{
+  for (int l = 0; l < level; l++)
+    shape = hmap::Vec2<int>((shape.x + 1) / 2, (shape.y + 1) / 2);
+  return shape;
+}
+
+int mip_chain_length(hmap::Vec2<int> shape)
+{
+  int nlevels = 1;
+  while (shape.x > 1 || shape.y > 1)
+  {
+    shape = mip_level_shape(shape, 1);
+    nlevels++;
+  }
+  return nlevels;
+}
+
+// level of the chain, rows being received from top (largest j) to bottom
+struct MipLevel
+{
+  hmap::Vec2<int>              shape;
+  std::unique_ptr<BlockWriter> writer = nullptr; // level not written if null
+  std::vector<float>           sum = {};   // pending row (finer rows sum)
+  int                          count = 0;  // number of finer rows summed
+  hmap::Array                  block;      // block being filled
+  int                          block_j0 = 0;
+  bool                         block_empty = true;
+  std::vector<std::pair<hmap::Array, int>> ready = {}; // blocks to write
+};
+
+void write_mip_chain(const hmap::HeightMap     &h,
+                     const std::string         &fname,
+                     int                        format,
+                     const std::vector<int>    &levels,
+                     std::function<void(float)> progress)
+{
+  if (levels.empty())
+    return;
+
+  int level_max = *std::max_element(levels.begin(), levels.end());
+
+  if (*std::min_element(levels.begin(), levels.end()) < 0 ||
+      level_max >= mip_chain_length(h.shape))
+  {
+    LOG_ERROR("invalid mip level");
+    throw std::runtime_error("invalid mip level");
+  }
+
+  CellReader reader = CellReader(h);
+
+  // blocks of one band per thread so that the PNG encoding of a block is
+  // done in parallel
+  int nthreads = (int)std::max(1u, std::thread::hardware_concurrency());
+  int block_rows = WRITER_BAND_ROWS * nthreads;
+
+  // all the levels share the range of the heightmap (the filter does not
+  // extend it)
+  std::vector<MipLevel> chain(level_max + 1);
+
+  for (int l = 0; l <= level_max; l++)
+  {
+    chain[l].shape = mip_level_shape(h.shape, l);
+    chain[l].sum.resize(chain[l].shape.x);
+
+    if (std::find(levels.begin(), levels.end(), l) != levels.end())
+      chain[l].writer = std::make_unique<BlockWriter>(mip_level_fname(fname, l),
+                                                      format,
+                                                      chain[l].shape,
+                                                      reader.get_range());
+  }
+
+  // row j of level l: stored in the block of the level if written, and
+  // accumulated in the pending row of the next level, the 2x2 box (area
+  // average, cells outside the domain excluded) being complete once its
+  // bottom row (even j) is received
+  std::function<void(int, int, const float *)> push_row =
+      [&chain, &push_row, block_rows, level_max](int l, int j, const float *row)
+  {
+    MipLevel &level = chain[l];
+    int       nx = level.shape.x;
+
+    if (level.writer)
+    {
+      if (level.block_empty)
+      {
+        int nrows = std::min(block_rows, j + 1);
+        level.block = hmap::Array(hmap::Vec2<int>(nx, nrows));
+        level.block_j0 = j + 1 - nrows;
+        level.block_empty = false;
+      }
+
+      for (int i = 0; i < nx; i++)
+        level.block(i, j - level.block_j0) = row[i];
+
+      if (j == level.block_j0)
+      {
+        level.ready.push_back({std::move(level.block), level.block_j0});
+        level.block_empty = true;
+      }
+    }
+
+    if (l == level_max)
+      return;
+
+    MipLevel &next = chain[l + 1];
+
+    for (int i = 0; i < next.shape.x; i++)
+      next.sum[i] += 2 * i + 1 < nx ? 0.5f * (row[2 * i] + row[2 * i + 1])
+                                    : row[2 * i];
+    next.count++;
+
+    if (j % 2 == 0)
+    {
+      float norm = 1.f / (float)next.count;
+      for (auto &v : next.sum)
+        v *= norm;
+
+      push_row(l + 1, j / 2, next.sum.data());
+
+      std::fill(next.sum.begin(), next.sum.end(), 0.f);
+      next.count = 0;
+    }
+  };
+
+  int nx = h.shape.x;
+  int ny = h.shape.y;
+  int nbands = (ny + block_rows - 1) / block_rows;
+
+  std::vector<std::vector<float>> rows(block_rows, std::vector<float>(nx));
+
+  for (int band = 0; band < nbands; band++)
+  {
+    // base rows read from the tiles, from top to bottom
+    int j1 = ny - band * block_rows;
+    int nrows = std::min(block_rows, j1);
+
+    hesiod::parallel_for(nrows,
+                         [&reader, &rows, j1, nx](int k0, int k1)
+                         {
+                           for (int k = k0; k < k1; k++)
+                             for (int i = 0; i < nx; i++)
+                               rows[k][i] = reader.get(i, j1 - 1 - k);
+                         });
+
+    for (int k = 0; k < nrows; k++)
+      push_row(0, j1 - 1 - k, rows[k].data());
+
+    // completed blocks of all the levels written concurrently, one thread
+    // per level to keep the blocks of a level in order
+    std::vector<std::thread>        threads = {};
+    std::vector<std::exception_ptr> errors(chain.size());
+
+    for (size_t l = 0; l < chain.size(); l++)
+      if (!chain[l].ready.empty())
+        threads.push_back(std::thread(
+            [&chain, &errors, l]()
+            {
+              try
+              {
+                for (auto &[block, j0] : chain[l].ready)
+                  chain[l].writer->write_block(block, hmap::Vec2<int>(0, j0));
+              }
+              catch (...)
+              {
+                errors[l] = std::current_exception();
+              }
+              chain[l].ready.clear();
+            }));
+
+    for (auto &thread : threads)
+      thread.join();
+
+    for (auto &error : errors)
+      if (error)
+        std::rethrow_exception(error);
+
+    if (progress)
+      progress((float)(band + 1) / (float)nbands);
+  }
+
+  for (auto &level : chain)
+    if (level.writer)
+      level.writer->close();
+}
+
+} // namespace hesiod::io
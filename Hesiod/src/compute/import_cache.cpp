@@ -0,0 +1,420 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "macrologger.h"
+
+#include "hesiod/import_cache.hpp"
+#include "hesiod/parallel.hpp"
+
+// cache file signature
+#define CACHE_MAGIC "HSIC"
+
+// header size of the cache files (signature and shape)
+#define CACHE_HEADER_SIZE 12
+
+// temporary files older than this are left over by an interrupted write
+#define CACHE_TMP_MAX_AGE_HOURS 1
+
+namespace hesiod::io
+{
+
+bool get_file_key(const std::string &fname, FileKey &key)
+{
+  std::error_code ec;
+
+  std::filesystem::path path = std::filesystem::canonical(fname, ec);
+  if (ec || !std::filesystem::is_regular_file(path, ec))
+    return false;
+
+  uintmax_t size = std::filesystem::file_size(path, ec);
+  if (ec)
+    return false;
+
+  auto mtime = std::filesystem::last_write_time(path, ec);
+  if (ec)
+    return false;
+
+  key.path = path.string();
+  key.size = size;
+  key.mtime = (long long)mtime.time_since_epoch().count();
+
+  return true;
+}
+
+static std::filesystem::path cache_dir()
+{
+  return std::filesystem::temp_directory_path() / IMPORT_CACHE_DIR;
+}
+
+static std::string cache_fname(const FileKey &key)
+{
+  std::stringstream ss;
+  ss << std::hex
+     << std::hash<std::string>{}(key.path + "|" + std::to_string(key.size) +
+                                 "|" + std::to_string(key.mtime))
+     << ".bin";
+
+  return (cache_dir() / ss.str()).string();
+}
+
+// temporary name unique to the writer (process, thread and write)
+static std::string tmp_fname(const std::string &cache_fname)
+{
+  static std::atomic<unsigned> count = 0;
+
+#ifdef _WIN32
+  int pid = _getpid();
+#else
+  int pid = (int)getpid();
+#endif
+
+  std::stringstream ss;
+  ss << cache_fname << "." << pid << "." << std::hex
+     << std::hash<std::thread::id>{}(std::this_thread::get_id()) << "."
+     << count++ << ".tmp";
+
+  return ss.str();
+}
+
+// decode the image and store the raw values in the cache file
+static void write_cache_file(const std::string &fname,
+                             const std::string &cache_fname)
+{
+  hmap::Array z = hmap::Array(fname);
+
+  std::filesystem::create_directories(
+      std::filesystem::path(cache_fname).parent_path());
+
+  // written under a temporary name unique to the writer, several threads or
+  // processes may decode the same image
+  std::string   fname_tmp = tmp_fname(cache_fname);
+  std::ofstream f(fname_tmp, std::ios::binary);
+
+  int32_t shape[2] = {z.shape.x, z.shape.y};
+
+  f.write(CACHE_MAGIC, 4);
+  f.write((const char *)shape, sizeof(shape));
+  f.write((const char *)z.vector.data(), sizeof(float) * z.vector.size());
+  f.close();
+
+  if (!f.good())
+  {
+    std::error_code ec;
+    std::filesystem::remove(fname_tmp, ec);
+
+    LOG_ERROR("could not write import cache file [%s]", fname_tmp.c_str());
+    throw std::runtime_error("could not write file " + fname_tmp);
+  }
+
+  std::filesystem::rename(fname_tmp, cache_fname);
+}
+
+// --- MappedImage
+
+MappedImage::MappedImage(const std::string &cache_fname)
+{
+  char    magic[4];
+  int32_t shape[2];
+
+#ifdef _WIN32
+  std::ifstream f(cache_fname, std::ios::binary);
+
+  f.read(magic, 4);
+  f.read((char *)shape, sizeof(shape));
+
+  if (f.good() && std::strncmp(magic, CACHE_MAGIC, 4) == 0 && shape[0] > 0 &&
+      shape[1] > 0)
+  {
+    this->buffer.resize((size_t)shape[0] * shape[1]);
+    f.read((char *)this->buffer.data(), sizeof(float) * this->buffer.size());
+  }
+
+  if (!f.good() || this->buffer.empty())
+  {
+    LOG_ERROR("invalid import cache file [%s]", cache_fname.c_str());
+    throw std::runtime_error("invalid file " + cache_fname);
+  }
+
+  this->data = this->buffer.data();
+#else
+  int fd = open(cache_fname.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    LOG_ERROR("could not open import cache file [%s]", cache_fname.c_str());
+    throw std::runtime_error("could not open file " + cache_fname);
+  }
+
+  off_t size = lseek(fd, 0, SEEK_END);
+  bool  valid = size >= CACHE_HEADER_SIZE &&
+               pread(fd, magic, 4, 0) == 4 &&
+               pread(fd, shape, sizeof(shape), 4) == sizeof(shape) &&
+               std::strncmp(magic, CACHE_MAGIC, 4) == 0 && shape[0] > 0 &&
+               shape[1] > 0 &&
+               (size_t)size == CACHE_HEADER_SIZE + sizeof(float) *
+                                                       (size_t)shape[0] *
+                                                       (size_t)shape[1];
+
+  if (valid)
+  {
+    this->p_map = mmap(nullptr, (size_t)size, PROT_READ, MAP_SHARED, fd, 0);
+    if (this->p_map == MAP_FAILED)
+    {
+      this->p_map = nullptr;
+      valid = false;
+    }
+  }
+
+  // the mapping remains valid once the file is closed
+  close(fd);
+
+  if (!valid)
+  {
+    LOG_ERROR("invalid import cache file [%s]", cache_fname.c_str());
+    throw std::runtime_error("invalid file " + cache_fname);
+  }
+
+  this->map_size = (size_t)size;
+  this->data = (const float *)((const char *)this->p_map + CACHE_HEADER_SIZE);
+#endif
+
+  this->shape = hmap::Vec2<int>(shape[0], shape[1]);
+}
+
+MappedImage::~MappedImage()
+{
+#ifndef _WIN32
+  if (this->p_map)
+    munmap(this->p_map, this->map_size);
+#endif
+}
+
+hmap::Vec2<int> MappedImage::get_shape() const
+{
+  return this->shape;
+}
+
+float MappedImage::interp(float x, float y) const
+{
+  x = std::clamp(x, 0.f, (float)(this->shape.x - 1));
+  y = std::clamp(y, 0.f, (float)(this->shape.y - 1));
+
+  int i = std::min((int)x, std::max(0, this->shape.x - 2));
+  int j = std::min((int)y, std::max(0, this->shape.y - 2));
+  int ip = std::min(i + 1, this->shape.x - 1);
+  int jp = std::min(j + 1, this->shape.y - 1);
+
+  float u = x - (float)i;
+  float v = y - (float)j;
+
+  auto value = [this](int i, int j)
+  { return this->data[(size_t)i * this->shape.y + j]; };
+
+  return (1.f - u) * ((1.f - v) * value(i, j) + v * value(i, jp)) +
+         u * ((1.f - v) * value(ip, j) + v * value(ip, jp));
+}
+
+void MappedImage::resample(hmap::HeightMap &h) const
+{
+  // global cell index to image cell units, first and last cells of the
+  // heightmap matching the ones of the image
+  float rx = h.shape.x > 1 ? (float)(this->shape.x - 1) / (h.shape.x - 1) : 0.f;
+  float ry = h.shape.y > 1 ? (float)(this->shape.y - 1) / (h.shape.y - 1) : 0.f;
+
+  auto resample_fct = [this, &h, rx, ry](int k0, int k1)
+  {
+    for (int k = k0; k < k1; k++)
+    {
+      hmap::Tile &tile = h.tiles[k];
+
+      for (int i = 0; i < tile.shape.x; i++)
+      {
+        float x = (tile.shift.x + tile.scale.x * i / tile.shape.x) * h.shape.x;
+
+        for (int j = 0; j < tile.shape.y; j++)
+        {
+          float y = (tile.shift.y + tile.scale.y * j / tile.shape.y) *
+                    h.shape.y;
+          tile(i, j) = this->interp(x * rx, y * ry);
+        }
+      }
+    }
+  };
+
+  hesiod::parallel_for((int)h.tiles.size(), resample_fct);
+}
+
+// --- ImageCache
+
+ImageCache &ImageCache::get_instance()
+{
+  static ImageCache instance;
+  return instance;
+}
+
+std::shared_ptr<const MappedImage> ImageCache::get(const std::string &fname,
+                                                   FileKey           &key)
+{
+  if (!get_file_key(fname, key))
+    return nullptr;
+
+  const std::lock_guard<std::mutex> lock(this->mutex);
+
+  if (this->entries.contains(key.path) &&
+      this->entries.at(key.path).first == key)
+    return this->entries.at(key.path).second;
+
+  std::string cache_fname_key = cache_fname(key);
+
+  try
+  {
+    // decoded by a previous session if the cache file already exists, its
+    // modification time then being refreshed (last use, for the eviction)
+    bool is_decoded = false;
+
+    if (std::filesystem::exists(cache_fname_key))
+    {
+      std::error_code ec;
+      std::filesystem::last_write_time(
+          cache_fname_key,
+          std::filesystem::file_time_type::clock::now(),
+          ec);
+    }
+    else
+    {
+      LOG_DEBUG("decoding image [%s]", fname.c_str());
+      write_cache_file(fname, cache_fname_key);
+      is_decoded = true;
+    }
+
+    std::shared_ptr<const MappedImage> image = std::make_shared<MappedImage>(
+        cache_fname_key);
+
+    // previous version of the file, mapped by the nodes still using it
+    // (unlinking a mapped file is safe)
+    if (this->entries.contains(key.path))
+    {
+      std::error_code ec;
+      std::filesystem::remove(cache_fname(this->entries.at(key.path).first),
+                              ec);
+    }
+
+    this->entries[key.path] = {key, image};
+
+    // once per session, and whenever the cache grows
+    if (is_decoded || !this->is_evicted)
+      this->evict();
+
+    return image;
+  }
+  catch (const std::exception &e)
+  {
+    LOG_ERROR("could not load image [%s]: %s", fname.c_str(), e.what());
+
+    // possibly a corrupted cache file, decoded again next time
+    std::error_code ec;
+    std::filesystem::remove(cache_fname_key, ec);
+
+    return nullptr;
+  }
+}
+
+void ImageCache::evict()
+{
+  namespace fs = std::filesystem;
+
+  this->is_evicted = true;
+
+  // files used by the session
+  std::set<std::string> used = {};
+  for (auto &[path, entry] : this->entries)
+    used.insert(fs::path(cache_fname(entry.first)).filename().string());
+
+  struct CacheFile
+  {
+    fs::path           path;
+    uintmax_t          size;
+    fs::file_time_type mtime;
+  };
+
+  std::vector<CacheFile> files = {};
+  uintmax_t              total_size = 0;
+
+  auto now = fs::file_time_type::clock::now();
+  auto max_age = std::chrono::hours(24 * IMPORT_CACHE_MAX_AGE_DAYS);
+  auto tmp_max_age = std::chrono::hours(CACHE_TMP_MAX_AGE_HOURS);
+
+  std::error_code ec;
+  for (auto &entry : fs::directory_iterator(cache_dir(), ec))
+  {
+    std::error_code ec_file;
+
+    if (!entry.is_regular_file(ec_file))
+      continue;
+
+    CacheFile file = {entry.path(),
+                      entry.file_size(ec_file),
+                      entry.last_write_time(ec_file)};
+    if (ec_file)
+      continue;
+
+    std::string ext = file.path.extension().string();
+
+    // interrupted writes and files unused for too long
+    if ((ext == ".tmp" && now - file.mtime > tmp_max_age) ||
+        (ext == ".bin" && now - file.mtime > max_age &&
+         !used.contains(file.path.filename().string())))
+    {
+      LOG_DEBUG("removing import cache file [%s]", file.path.string().c_str());
+      fs::remove(file.path, ec_file);
+      continue;
+    }
+
+    total_size += file.size;
+
+    if (ext == ".bin" && !used.contains(file.path.filename().string()))
+      files.push_back(file);
+  }
+
+  // least recently used first, until the size limit is met (mapped files can
+  // safely be removed, other sessions keeping their mapping)
+  std::sort(files.begin(),
+            files.end(),
+            [](const CacheFile &a, const CacheFile &b)
+            { return a.mtime < b.mtime; });
+
+  uintmax_t max_size = (uintmax_t)IMPORT_CACHE_MAX_SIZE_MB << 20;
+
+  for (auto &file : files)
+  {
+    if (total_size <= max_size)
+      break;
+
+    LOG_DEBUG("removing import cache file [%s]", file.path.string().c_str());
+
+    std::error_code ec_file;
+    if (fs::remove(file.path, ec_file))
+      total_size -= file.size;
+  }
+}
+
+} // namespace hesiod::io
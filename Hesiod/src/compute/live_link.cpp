@@ -0,0 +1,407 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "macrologger.h"
+
+#include "hesiod/live_link.hpp"
+#include "hesiod/region.hpp"
+
+namespace hesiod::io
+{
+
+// offset of the first slot, slots being page-aligned
+static const size_t slot_alignment = 4096;
+static const size_t data_start = (sizeof(LiveLinkHeader) + slot_alignment -
+                                  1) /
+                                 slot_alignment * slot_alignment;
+
+int64_t live_link_now()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+#ifdef _WIN32
+
+LiveLinkPublisher::LiveLinkPublisher(const std::string &name) : name(name)
+{
+  LOG_ERROR("live link not available on this platform");
+  throw std::runtime_error("live link not available on this platform");
+}
+
+LiveLinkPublisher::~LiveLinkPublisher() {}
+
+uint64_t LiveLinkPublisher::publish(const hmap::HeightMap &)
+{
+  return 0;
+}
+
+uint64_t LiveLinkPublisher::publish(const hmap::HeightMapRGB &)
+{
+  return 0;
+}
+
+LiveLinkReader::LiveLinkReader(const std::string &)
+{
+  LOG_ERROR("live link not available on this platform");
+  throw std::runtime_error("live link not available on this platform");
+}
+
+LiveLinkReader::~LiveLinkReader() {}
+
+uint64_t LiveLinkReader::get_generation() const
+{
+  return 0;
+}
+
+bool LiveLinkReader::read(LiveLinkFrame &, uint64_t)
+{
+  return false;
+}
+
+bool LiveLinkReader::is_stale() const
+{
+  return true;
+}
+
+#else
+
+//----------------------------------------
+// publisher
+//----------------------------------------
+
+LiveLinkPublisher::LiveLinkPublisher(const std::string &name) : name(name)
+{
+  // previous segment (crashed instance) replaced, readers still mapping it
+  // have to reopen the new one
+  shm_unlink(name.c_str());
+  this->fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+
+  if (this->fd < 0)
+  {
+    LOG_ERROR("could not create shared memory segment [%s]", name.c_str());
+    throw std::runtime_error("could not create shared memory segment " + name);
+  }
+
+  // header only, slots allocated with the first publication
+  this->map(data_start);
+
+  new (this->p_header) LiveLinkHeader();
+  this->p_header->magic = LIVE_LINK_MAGIC;
+  this->p_header->version = LIVE_LINK_VERSION;
+  this->p_header->slot_capacity = 0;
+  this->p_header->nslots = LIVE_LINK_NSLOTS;
+
+  for (auto &slot : this->p_header->slots)
+  {
+    slot.generation.store(0);
+    slot.offset = 0;
+  }
+
+  this->p_header->generation.store(0);
+  this->p_header->segment_size.store(data_start, std::memory_order_release);
+
+  LOG_DEBUG("live link [%s] created", name.c_str());
+}
+
+LiveLinkPublisher::~LiveLinkPublisher()
+{
+  if (this->p_header)
+    munmap(this->p_header, this->mapped_size);
+
+  if (this->fd >= 0)
+  {
+    close(this->fd);
+    shm_unlink(this->name.c_str());
+  }
+}
+
+void LiveLinkPublisher::map(size_t size)
+{
+  if (this->p_header)
+    munmap(this->p_header, this->mapped_size);
+
+  this->p_header = nullptr;
+
+  void *p = MAP_FAILED;
+  if (ftruncate(this->fd, (off_t)size) == 0)
+    p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, this->fd, 0);
+
+  if (p == MAP_FAILED)
+  {
+    LOG_ERROR("could not map shared memory segment [%s]", this->name.c_str());
+    throw std::runtime_error("could not map shared memory segment " +
+                             this->name);
+  }
+
+  this->p_header = (LiveLinkHeader *)p;
+  this->mapped_size = size;
+}
+
+float *LiveLinkPublisher::get_data(const LiveLinkSlot &slot)
+{
+  return (float *)((uint8_t *)this->p_header + slot.offset);
+}
+
+LiveLinkSlot &LiveLinkPublisher::begin_slot(int             dtype,
+                                            int             nchannels,
+                                            hmap::Vec2<int> shape,
+                                            uint64_t       &generation)
+{
+  size_t nbytes = sizeof(float) * nchannels * shape.x * shape.y;
+
+  if (nbytes > this->p_header->slot_capacity)
+  {
+    // slots invalidated before the layout changes, the segment never
+    // shrinks so that readers with an older mapping can still complete
+    // (and discard) their copy
+    for (auto &slot : this->p_header->slots)
+      slot.generation.store(0, std::memory_order_release);
+
+    size_t capacity = (nbytes + slot_alignment - 1) / slot_alignment *
+                      slot_alignment;
+    size_t size = data_start + LIVE_LINK_NSLOTS * capacity;
+
+    this->map(size);
+    this->p_header->slot_capacity = capacity;
+
+    for (size_t k = 0; k < LIVE_LINK_NSLOTS; k++)
+      this->p_header->slots[k].offset = data_start + k * capacity;
+
+    this->p_header->segment_size.store(size, std::memory_order_release);
+
+    LOG_DEBUG("live link segment resized (%ld bytes)", size);
+  }
+
+  generation = this->p_header->generation.load(std::memory_order_relaxed) + 1;
+
+  LiveLinkSlot &slot = this->p_header->slots[generation % LIVE_LINK_NSLOTS];
+
+  slot.generation.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  slot.dtype = dtype;
+  slot.nchannels = nchannels;
+  slot.nx = shape.x;
+  slot.ny = shape.y;
+
+  return slot;
+}
+
+void LiveLinkPublisher::end_slot(LiveLinkSlot &slot, uint64_t generation)
+{
+  slot.timestamp = live_link_now();
+  slot.generation.store(generation, std::memory_order_release);
+  this->p_header->generation.store(generation, std::memory_order_release);
+}
+
+uint64_t LiveLinkPublisher::publish(const hmap::HeightMap &h)
+{
+  if (h.shape.x <= 0 || h.shape.y <= 0 || h.tiles.empty())
+    return 0;
+
+  uint64_t      generation;
+  LiveLinkSlot &slot = this->begin_slot(live_heightmap, 1, h.shape, generation);
+
+  float vmin = std::numeric_limits<float>::max();
+  float vmax = -std::numeric_limits<float>::max();
+
+  for (auto &tile : h.tiles)
+  {
+    vmin = std::min(vmin, tile.min());
+    vmax = std::max(vmax, tile.max());
+  }
+
+  slot.vmin = vmin;
+  slot.vmax = vmax;
+
+  hesiod::region::blit_heightmap(h, this->get_data(slot));
+
+  this->end_slot(slot, generation);
+  return generation;
+}
+
+uint64_t LiveLinkPublisher::publish(const hmap::HeightMapRGB &c)
+{
+  if (c.shape.x <= 0 || c.shape.y <= 0 || c.rgb.size() != 3)
+    return 0;
+
+  uint64_t      generation;
+  LiveLinkSlot &slot = this->begin_slot(live_heightmap_rgb,
+                                        3,
+                                        c.shape,
+                                        generation);
+
+  slot.vmin = 0.f;
+  slot.vmax = 1.f;
+
+  // one channel after the other
+  float *data = this->get_data(slot);
+  for (size_t ch = 0; ch < 3; ch++)
+    hesiod::region::blit_heightmap(c.rgb[ch], data + ch * (size_t)c.shape.x * c.shape.y);
+
+  this->end_slot(slot, generation);
+  return generation;
+}
+
+//----------------------------------------
+// reader
+//----------------------------------------
+
+LiveLinkReader::LiveLinkReader(const std::string &name) : name(name)
+{
+  this->fd = shm_open(name.c_str(), O_RDONLY, 0);
+
+  struct stat st;
+  if (this->fd < 0 || fstat(this->fd, &st) != 0 ||
+      (size_t)st.st_size < sizeof(LiveLinkHeader))
+  {
+    if (this->fd >= 0)
+      close(this->fd);
+
+    LOG_ERROR("could not open shared memory segment [%s]", name.c_str());
+    throw std::runtime_error("could not open shared memory segment " + name);
+  }
+
+  this->device = (uint64_t)st.st_dev;
+  this->inode = (uint64_t)st.st_ino;
+  this->map((size_t)st.st_size);
+
+  if (this->p_header->magic != LIVE_LINK_MAGIC ||
+      this->p_header->version != LIVE_LINK_VERSION)
+  {
+    munmap(this->p_header, this->mapped_size);
+    close(this->fd);
+
+    LOG_ERROR("invalid shared memory segment [%s]", name.c_str());
+    throw std::runtime_error("invalid shared memory segment " + name);
+  }
+}
+
+LiveLinkReader::~LiveLinkReader()
+{
+  if (this->p_header)
+    munmap(this->p_header, this->mapped_size);
+
+  if (this->fd >= 0)
+    close(this->fd);
+}
+
+void LiveLinkReader::map(size_t size)
+{
+  if (this->p_header)
+    munmap(this->p_header, this->mapped_size);
+
+  void *p = mmap(nullptr, size, PROT_READ, MAP_SHARED, this->fd, 0);
+
+  if (p == MAP_FAILED)
+  {
+    this->p_header = nullptr;
+    LOG_ERROR("could not map shared memory segment");
+    throw std::runtime_error("could not map shared memory segment");
+  }
+
+  this->p_header = (LiveLinkHeader *)p;
+  this->mapped_size = size;
+}
+
+uint64_t LiveLinkReader::get_generation() const
+{
+  return this->p_header->generation.load(std::memory_order_acquire);
+}
+
+bool LiveLinkReader::is_stale() const
+{
+  // the name refers to another object once the publisher has unlinked and
+  // recreated the segment
+  int fd_current = shm_open(this->name.c_str(), O_RDONLY, 0);
+  if (fd_current < 0)
+    return true;
+
+  struct stat st;
+  bool        stale = true;
+
+  if (fstat(fd_current, &st) == 0)
+    stale = (uint64_t)st.st_dev != this->device ||
+            (uint64_t)st.st_ino != this->inode;
+
+  close(fd_current);
+  return stale;
+}
+
+bool LiveLinkReader::read(LiveLinkFrame &frame, uint64_t last_generation)
+{
+  // a slot is only rewritten LIVE_LINK_NSLOTS generations later, retries
+  // are only needed if the reader is that much behind
+  for (int attempt = 0; attempt < 16; attempt++)
+  {
+    uint64_t generation = this->get_generation();
+
+    if (generation == 0 || generation <= last_generation)
+      return false;
+
+    const LiveLinkSlot &slot =
+        this->p_header->slots[generation % LIVE_LINK_NSLOTS];
+
+    if (slot.generation.load(std::memory_order_acquire) != generation)
+      continue;
+
+    LiveLinkFrame f;
+    f.generation = generation;
+    f.timestamp = slot.timestamp;
+    f.dtype = slot.dtype;
+    f.nchannels = slot.nchannels;
+    f.shape = hmap::Vec2<int>(slot.nx, slot.ny);
+    f.range = hmap::Vec2<float>(slot.vmin, slot.vmax);
+
+    size_t offset = slot.offset;
+    size_t n = (size_t)std::max(0, f.nchannels) * std::max(0, f.shape.x) *
+               std::max(0, f.shape.y);
+
+    // segment grown since it was mapped
+    if (offset + sizeof(float) * n > this->mapped_size)
+    {
+      size_t size = this->p_header->segment_size.load(
+          std::memory_order_acquire);
+
+      if (size <= this->mapped_size)
+        continue;
+
+      this->map(size);
+      continue;
+    }
+
+    f.data.resize(n);
+    std::memcpy(f.data.data(),
+                (const uint8_t *)this->p_header + offset,
+                sizeof(float) * n);
+
+    // slot rewritten during the copy
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.generation.load(std::memory_order_relaxed) != generation)
+      continue;
+
+    frame = std::move(f);
+    return true;
+  }
+
+  return false;
+}
+
+#endif
+
+} // namespace hesiod::io
@@ -0,0 +1,417 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <list>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+#include "highmap.hpp"
+#include "macrologger.h"
+
+#include "hesiod/local_stats.hpp"
+
+// maximum number of values kept in the cache (all entries together)
+#define LOCAL_STATS_CACHE_MAX_SIZE 32 * 1024 * 1024
+
+// number of input values stored with a cache entry to check it on reuse
+#define LOCAL_STATS_CACHE_SAMPLES 256
+
+namespace hesiod::local_stats
+{
+
+// --- HELPERS
+
+// summed-area table, size (nx + 1) * (ny + 1), of the array values
+// raised to the power 'p'
+static void build_sat(const hmap::Array   &array,
+                      int                  p,
+                      std::vector<double> &sat)
+{
+  const int nx = array.shape.x;
+  const int ny = array.shape.y;
+
+  sat.assign((size_t)(nx + 1) * (ny + 1), 0.0);
+
+  for (int i = 0; i < nx; i++)
+  {
+    double row_sum = 0.0;
+    for (int j = 0; j < ny; j++)
+    {
+      double v = (double)array.vector[(size_t)i * ny + j];
+      double vp = p == 1 ? v : (p == 2 ? v * v : v * v * v);
+
+      size_t k = (size_t)(i + 1) * (ny + 1) + j + 1;
+
+      row_sum += vp;
+      sat[k] = sat[k - (ny + 1)] + row_sum;
+    }
+  }
+}
+
+// apply 'fct(i, j, sum_1, ..., count)' for every cell, sums being the window
+// sums retrieved from the summed-area tables
+template <typename F>
+static void sat_windows(const hmap::Vec2<int>                   shape,
+                        int                                     ir,
+                        const std::vector<std::vector<double>> &sats,
+                        F                                       fct)
+{
+  const int    nx = shape.x;
+  const int    ny = shape.y;
+  const size_t stride = ny + 1;
+
+  std::vector<double> sums(sats.size());
+
+  for (int i = 0; i < nx; i++)
+  {
+    int i0 = std::max(0, i - ir);
+    int i1 = std::min(nx, i + ir + 1);
+
+    for (int j = 0; j < ny; j++)
+    {
+      int j0 = std::max(0, j - ir);
+      int j1 = std::min(ny, j + ir + 1);
+
+      for (size_t k = 0; k < sats.size(); k++)
+        sums[k] = sats[k][i1 * stride + j1] - sats[k][i0 * stride + j1] -
+                  sats[k][i1 * stride + j0] + sats[k][i0 * stride + j0];
+
+      fct(i, j, sums, (double)((i1 - i0) * (j1 - j0)));
+    }
+  }
+}
+
+// van Herk/Gil-Werman running min/max over a strided line of 'n' values,
+// window 2 * ir + 1, truncated at the borders ('g' and 'h' are work
+// buffers)
+template <typename Op>
+static void vhgw_line(const float        *in,
+                      float              *out,
+                      int                 n,
+                      int                 stride,
+                      int                 ir,
+                      float               identity,
+                      std::vector<float> &g,
+                      std::vector<float> &h,
+                      Op                  op)
+{
+  const int w = 2 * ir + 1;
+  const int m = ((n + 2 * ir + w - 1) / w) * w; // padded length
+
+  g.resize(m);
+  h.resize(m);
+
+  for (int k = 0; k < m; k++)
+  {
+    int   q = k - ir;
+    float v = (q >= 0 && q < n) ? in[(size_t)q * stride] : identity;
+    g[k] = (k % w == 0) ? v : op(g[k - 1], v);
+  }
+
+  for (int k = m - 1; k >= 0; k--)
+  {
+    int   q = k - ir;
+    float v = (q >= 0 && q < n) ? in[(size_t)q * stride] : identity;
+    h[k] = (k % w == w - 1) ? v : op(h[k + 1], v);
+  }
+
+  // window [k, k + 2 * ir] (padded indices) is centered on value k
+  for (int k = 0; k < n; k++)
+    out[(size_t)k * stride] = op(h[k], g[k + w - 1]);
+}
+
+template <typename Op>
+static hmap::Array vhgw(const hmap::Array &array,
+                        int                ir,
+                        float              identity,
+                        Op                 op)
+{
+  const int nx = array.shape.x;
+  const int ny = array.shape.y;
+
+  if (ir <= 0)
+    return array;
+
+  hmap::Array tmp = hmap::Array(array.shape);
+  hmap::Array out = hmap::Array(array.shape);
+
+  std::vector<float> g, h;
+
+  // along j, then along i (separable filter), arrays are stored
+  // row-major with index i * ny + j
+  for (int i = 0; i < nx; i++)
+    vhgw_line(array.vector.data() + (size_t)i * ny,
+              tmp.vector.data() + (size_t)i * ny,
+              ny,
+              1,
+              ir,
+              identity,
+              g,
+              h,
+              op);
+
+  for (int j = 0; j < ny; j++)
+    vhgw_line(tmp.vector.data() + j,
+              out.vector.data() + j,
+              nx,
+              ny,
+              ir,
+              identity,
+              g,
+              h,
+              op);
+
+  return out;
+}
+
+static uint64_t array_checksum(const hmap::Array &array)
+{
+  uint64_t hash = 0xcbf29ce484222325ULL;
+
+  hash ^= (uint64_t)array.shape.x * 0x9e3779b97f4a7c15ULL;
+  hash ^= (uint64_t)array.shape.y * 0xbf58476d1ce4e5b9ULL;
+
+  for (auto &v : array.vector)
+  {
+    uint32_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    hash = (hash ^ bits) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+// --- statistics
+
+hmap::Array mean_local(const hmap::Array &array, int ir)
+{
+  if (ir <= 0)
+    return array;
+
+  hmap::Array                      out = hmap::Array(array.shape);
+  std::vector<std::vector<double>> sats(1);
+
+  build_sat(array, 1, sats[0]);
+
+  sat_windows(array.shape,
+              ir,
+              sats,
+              [&out](int i, int j, std::vector<double> &sums, double count)
+              { out(i, j) = (float)(sums[0] / count); });
+
+  return out;
+}
+
+hmap::Array variance_local(const hmap::Array &array, int ir)
+{
+  if (ir <= 0)
+    return hmap::Array(array.shape);
+
+  hmap::Array                      out = hmap::Array(array.shape);
+  std::vector<std::vector<double>> sats(2);
+
+  build_sat(array, 1, sats[0]);
+  build_sat(array, 2, sats[1]);
+
+  sat_windows(array.shape,
+              ir,
+              sats,
+              [&out](int i, int j, std::vector<double> &sums, double count)
+              {
+                double m1 = sums[0] / count;
+                double m2 = sums[1] / count;
+                out(i, j) = (float)std::max(0.0, m2 - m1 * m1);
+              });
+
+  return out;
+}
+
+hmap::Array skewness_local(const hmap::Array &array, int ir)
+{
+  if (ir <= 0)
+    return hmap::Array(array.shape);
+
+  hmap::Array                      out = hmap::Array(array.shape);
+  std::vector<std::vector<double>> sats(3);
+
+  // work with values centered on the global mean to limit cancellation
+  // errors in the raw moments
+  hmap::Array centered = array;
+  double      avg = 0.0;
+  for (auto &v : centered.vector)
+    avg += v;
+  avg /= std::max((size_t)1, centered.vector.size());
+  for (auto &v : centered.vector)
+    v -= (float)avg;
+
+  build_sat(centered, 1, sats[0]);
+  build_sat(centered, 2, sats[1]);
+  build_sat(centered, 3, sats[2]);
+
+  sat_windows(array.shape,
+              ir,
+              sats,
+              [&out](int i, int j, std::vector<double> &sums, double count)
+              {
+                double m1 = sums[0] / count;
+                double m2 = sums[1] / count;
+                double m3 = sums[2] / count;
+                double var = m2 - m1 * m1;
+                double mu3 = m3 - 3.0 * m1 * m2 + 2.0 * m1 * m1 * m1;
+
+                out(i, j) = var > 1e-12 ? (float)(mu3 / std::pow(var, 1.5))
+                                        : 0.f;
+              });
+
+  return out;
+}
+
+hmap::Array minimum_local(const hmap::Array &array, int ir)
+{
+  return vhgw(array,
+              ir,
+              std::numeric_limits<float>::max(),
+              [](float a, float b) { return std::min(a, b); });
+}
+
+hmap::Array maximum_local(const hmap::Array &array, int ir)
+{
+  return vhgw(array,
+              ir,
+              -std::numeric_limits<float>::max(),
+              [](float a, float b) { return std::max(a, b); });
+}
+
+// --- cache
+
+typedef std::tuple<int, int, int, int, uint64_t> CacheKey;
+
+struct CacheEntry
+{
+  hmap::Vec2<int>    shape;
+  std::vector<float> sample; // input values, regularly spaced
+  hmap::Array        out;
+};
+
+static std::mutex                     cache_mutex;
+static std::map<CacheKey, CacheEntry> cache = {};
+static std::list<CacheKey>            cache_order = {};
+static size_t                         cache_size = 0;
+
+// regularly spaced input values, checked on reuse so that a checksum
+// collision does not return the statistic of another array
+static std::vector<float> get_sample(const hmap::Array &array)
+{
+  size_t n = array.vector.size();
+  size_t step = std::max((size_t)1, n / LOCAL_STATS_CACHE_SAMPLES);
+
+  std::vector<float> sample = {};
+  for (size_t k = 0; k < n; k += step)
+    sample.push_back(array.vector[k]);
+
+  return sample;
+}
+
+static bool is_matching(const CacheEntry &entry, const hmap::Array &array)
+{
+  if (entry.shape.x != array.shape.x || entry.shape.y != array.shape.y)
+    return false;
+
+  std::vector<float> sample = get_sample(array);
+
+  return sample.size() == entry.sample.size() &&
+         std::memcmp(sample.data(),
+                     entry.sample.data(),
+                     sizeof(float) * sample.size()) == 0;
+}
+
+static hmap::Array compute_stat(int stat, const hmap::Array &array, int ir)
+{
+  switch (stat)
+  {
+  case stat_type::mean: return mean_local(array, ir);
+  case stat_type::variance: return variance_local(array, ir);
+  case stat_type::skewness: return skewness_local(array, ir);
+  case stat_type::minimum: return minimum_local(array, ir);
+  case stat_type::maximum: return maximum_local(array, ir);
+  default:
+    LOG_ERROR("unknown local statistic type [%d]", stat);
+    throw std::runtime_error("unknown local statistic type");
+  }
+}
+
+hmap::Array get_cached(int stat, const hmap::Array &array, int ir)
+{
+  CacheKey key = {stat,
+                  ir,
+                  array.shape.x,
+                  array.shape.y,
+                  array_checksum(array)};
+
+  bool collision = false;
+
+  {
+    const std::lock_guard<std::mutex> lock(cache_mutex);
+    auto                              it = cache.find(key);
+    if (it != cache.end())
+    {
+      if (is_matching(it->second, array))
+      {
+        LOG_DEBUG("local stats, cache hit (stat: %d, ir: %d)", stat, ir);
+        return it->second.out;
+      }
+
+      LOG_DEBUG("local stats, checksum collision (stat: %d, ir: %d)",
+                stat,
+                ir);
+      collision = true;
+    }
+  }
+
+  // compute outside the lock, tiles are usually processed
+  // concurrently
+  hmap::Array out = compute_stat(stat, array, ir);
+
+  // the entry already cached is kept
+  if (collision)
+    return out;
+
+  {
+    const std::lock_guard<std::mutex> lock(cache_mutex);
+
+    if (!cache.contains(key))
+    {
+      cache[key] = CacheEntry{array.shape, get_sample(array), out};
+      cache_order.push_back(key);
+      cache_size += out.vector.size();
+
+      // evict the oldest entries
+      while (cache_size > LOCAL_STATS_CACHE_MAX_SIZE && cache_order.size() > 1)
+      {
+        CacheKey oldest = cache_order.front();
+        cache_size -= cache[oldest].out.vector.size();
+        cache.erase(oldest);
+        cache_order.pop_front();
+      }
+    }
+  }
+
+  return out;
+}
+
+void clear_cache()
+{
+  const std::lock_guard<std::mutex> lock(cache_mutex);
+  cache.clear();
+  cache_order.clear();
+  cache_size = 0;
+}
+
+} // namespace hesiod::local_stats
@@ -0,0 +1,969 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "highmap.hpp"
+#include "macrologger.h"
+
+#include "hesiod/noise.hpp"
+#include "hesiod/parallel.hpp"
+
+// each batch kernel is compiled for several instruction sets, the dispatch
+// is done once at load time (GNU indirect functions)
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) &&        \
+    defined(__linux__)
+#define NOISE_TARGET_CLONES                                                    \
+  __attribute__((target_clones("arch=x86-64-v4",                               \
+                               "arch=x86-64-v3",                               \
+                               "arch=x86-64-v2",                               \
+                               "default")))
+#else
+#define NOISE_TARGET_CLONES
+#endif
+
+#define NOISE_PRIME_X 501125321u
+#define NOISE_PRIME_Y 1136930381u
+
+#define NOISE_PERLIN_SCALING 1.4247691104677813f
+#define NOISE_SIMPLEX_SCALING 99.83685446303647f
+
+// feature point jitter (fraction of the cell size), the closest feature
+// point is guaranteed to lie within the 3 x 3 neighboring cells as long as
+// sqrt(2) * (1 + jitter) / 2 <= 1 + (1 - jitter) / 2, i.e. jitter <= 0.657
+#define NOISE_WORLEY_JITTER 0.65f
+
+namespace hesiod::noise
+{
+
+// --- HELPERS
+
+// FastNoiseLite 2D gradients (24 unit directions repeated up to 128 entries),
+// x and y components are stored in separate arrays so that the lookups can be
+// done with vector gathers
+struct GradientTable
+{
+  alignas(64) float x[128] = {
+    0.130526192220052f, 0.38268343236509f, 0.608761429008721f, 0.793353340291235f,
+    0.923879532511287f, 0.99144486137381f, 0.99144486137381f, 0.923879532511287f,
+    0.793353340291235f, 0.608761429008721f, 0.38268343236509f, 0.130526192220052f,
+    -0.130526192220051f, -0.38268343236509f, -0.608761429008721f, -0.793353340291235f,
+    -0.923879532511287f, -0.99144486137381f, -0.99144486137381f, -0.923879532511287f,
+    -0.793353340291235f, -0.608761429008721f, -0.38268343236509f, -0.130526192220052f,
+    0.130526192220052f, 0.38268343236509f, 0.608761429008721f, 0.793353340291235f,
+    0.923879532511287f, 0.99144486137381f, 0.99144486137381f, 0.923879532511287f,
+    0.793353340291235f, 0.608761429008721f, 0.38268343236509f, 0.130526192220052f,
+    -0.130526192220051f, -0.38268343236509f, -0.608761429008721f, -0.793353340291235f,
+    -0.923879532511287f, -0.99144486137381f, -0.99144486137381f, -0.923879532511287f,
+    -0.793353340291235f, -0.608761429008721f, -0.38268343236509f, -0.130526192220052f,
+    0.130526192220052f, 0.38268343236509f, 0.608761429008721f, 0.793353340291235f,
+    0.923879532511287f, 0.99144486137381f, 0.99144486137381f, 0.923879532511287f,
+    0.793353340291235f, 0.608761429008721f, 0.38268343236509f, 0.130526192220052f,
+    -0.130526192220051f, -0.38268343236509f, -0.608761429008721f, -0.793353340291235f,
+    -0.923879532511287f, -0.99144486137381f, -0.99144486137381f, -0.923879532511287f,
+    -0.793353340291235f, -0.608761429008721f, -0.38268343236509f, -0.130526192220052f,
+    0.130526192220052f, 0.38268343236509f, 0.608761429008721f, 0.793353340291235f,
+    0.923879532511287f, 0.99144486137381f, 0.99144486137381f, 0.923879532511287f,
+    0.793353340291235f, 0.608761429008721f, 0.38268343236509f, 0.130526192220052f,
+    -0.130526192220051f, -0.38268343236509f, -0.608761429008721f, -0.793353340291235f,
+    -0.923879532511287f, -0.99144486137381f, -0.99144486137381f, -0.923879532511287f,
+    -0.793353340291235f, -0.608761429008721f, -0.38268343236509f, -0.130526192220052f,
+    0.130526192220052f, 0.38268343236509f, 0.608761429008721f, 0.793353340291235f,
+    0.923879532511287f, 0.99144486137381f, 0.99144486137381f, 0.923879532511287f,
+    0.793353340291235f, 0.608761429008721f, 0.38268343236509f, 0.130526192220052f,
+    -0.130526192220051f, -0.38268343236509f, -0.608761429008721f, -0.793353340291235f,
+    -0.923879532511287f, -0.99144486137381f, -0.99144486137381f, -0.923879532511287f,
+    -0.793353340291235f, -0.608761429008721f, -0.38268343236509f, -0.130526192220052f,
+    0.38268343236509f, 0.923879532511287f, 0.923879532511287f, 0.38268343236509f,
+    -0.38268343236509f, -0.923879532511287f, -0.923879532511287f, -0.38268343236509f};
+
+  alignas(64) float y[128] = {
+    0.99144486137381f, 0.923879532511287f, 0.793353340291235f, 0.608761429008721f,
+    0.38268343236509f, 0.130526192220052f, -0.130526192220052f, -0.38268343236509f,
+    -0.608761429008721f, -0.793353340291235f, -0.923879532511287f, -0.99144486137381f,
+    -0.99144486137381f, -0.923879532511287f, -0.793353340291235f, -0.608761429008721f,
+    -0.38268343236509f, -0.130526192220052f, 0.130526192220051f, 0.38268343236509f,
+    0.608761429008721f, 0.793353340291235f, 0.923879532511287f, 0.99144486137381f,
+    0.99144486137381f, 0.923879532511287f, 0.793353340291235f, 0.608761429008721f,
+    0.38268343236509f, 0.130526192220052f, -0.130526192220052f, -0.38268343236509f,
+    -0.608761429008721f, -0.793353340291235f, -0.923879532511287f, -0.99144486137381f,
+    -0.99144486137381f, -0.923879532511287f, -0.793353340291235f, -0.608761429008721f,
+    -0.38268343236509f, -0.130526192220052f, 0.130526192220051f, 0.38268343236509f,
+    0.608761429008721f, 0.793353340291235f, 0.923879532511287f, 0.99144486137381f,
+    0.99144486137381f, 0.923879532511287f, 0.793353340291235f, 0.608761429008721f,
+    0.38268343236509f, 0.130526192220052f, -0.130526192220052f, -0.38268343236509f,
+    -0.608761429008721f, -0.793353340291235f, -0.923879532511287f, -0.99144486137381f,
+    -0.99144486137381f, -0.923879532511287f, -0.793353340291235f, -0.608761429008721f,
+    -0.38268343236509f, -0.130526192220052f, 0.130526192220051f, 0.38268343236509f,
+    0.608761429008721f, 0.793353340291235f, 0.923879532511287f, 0.99144486137381f,
+    0.99144486137381f, 0.923879532511287f, 0.793353340291235f, 0.608761429008721f,
+    0.38268343236509f, 0.130526192220052f, -0.130526192220052f, -0.38268343236509f,
+    -0.608761429008721f, -0.793353340291235f, -0.923879532511287f, -0.99144486137381f,
+    -0.99144486137381f, -0.923879532511287f, -0.793353340291235f, -0.608761429008721f,
+    -0.38268343236509f, -0.130526192220052f, 0.130526192220051f, 0.38268343236509f,
+    0.608761429008721f, 0.793353340291235f, 0.923879532511287f, 0.99144486137381f,
+    0.99144486137381f, 0.923879532511287f, 0.793353340291235f, 0.608761429008721f,
+    0.38268343236509f, 0.130526192220052f, -0.130526192220052f, -0.38268343236509f,
+    -0.608761429008721f, -0.793353340291235f, -0.923879532511287f, -0.99144486137381f,
+    -0.99144486137381f, -0.923879532511287f, -0.793353340291235f, -0.608761429008721f,
+    -0.38268343236509f, -0.130526192220052f, 0.130526192220051f, 0.38268343236509f,
+    0.608761429008721f, 0.793353340291235f, 0.923879532511287f, 0.99144486137381f,
+    0.923879532511287f, 0.38268343236509f, -0.38268343236509f, -0.923879532511287f,
+    -0.923879532511287f, -0.38268343236509f, 0.38268343236509f, 0.923879532511287f};
+};
+
+static const GradientTable grad;
+
+// per-row buffers
+struct Workspace
+{
+  std::vector<float> xk, yk, v, amp, dvx, dvy, gx, gy;
+
+  void resize(int n, bool with_derivatives)
+  {
+    for (auto *p : {&xk, &yk, &v, &amp})
+      p->resize(n);
+
+    if (with_derivatives)
+      for (auto *p : {&dvx, &dvy, &gx, &gy})
+        p->resize(n);
+  }
+};
+
+static inline int fast_floor(float x)
+{
+  int i = (int)x;
+  return i - (int)(x < (float)i);
+}
+
+// FastNoiseLite rounding (negative integers are shifted by one cell), kept
+// for the coherent noises so that they match the HighMap ones
+static inline int fnl_floor(float x)
+{
+  return x >= 0.f ? (int)x : (int)x - 1;
+}
+
+static inline uint32_t hash(uint32_t seed, uint32_t xp, uint32_t yp)
+{
+  return (seed ^ xp ^ yp) * 0x27d4eb2du;
+}
+
+// gradient pair index, bits 1 to 7 as in FastNoiseLite (interleaved table)
+static inline uint32_t grad_index(uint32_t h)
+{
+  return ((h ^ (h >> 15)) >> 1) & 127u;
+}
+
+static inline float value_coord(uint32_t h)
+{
+  h *= h;
+  h ^= h << 19;
+  return (float)(int32_t)h * (1.f / 2147483648.f);
+}
+
+static inline float quintic(float t)
+{
+  return t * t * t * (t * (t * 6.f - 15.f) + 10.f);
+}
+
+static inline float quintic_derivative(float t)
+{
+  return 30.f * t * t * (t * (t - 2.f) + 1.f);
+}
+
+static inline float lerp(float a, float b, float t)
+{
+  return a + t * (b - a);
+}
+
+// sine of 2 * pi * t for t in [0, 1), odd polynomial on the folded range
+// [-pi / 2, pi / 2] (absolute error below 1e-6)
+static inline float sin_2pi_fract(float t)
+{
+  float a = 2.f * (float)M_PI * (0.5f - t); // sin(2 pi t) = sin(a)
+  a = a > 0.5f * (float)M_PI ? (float)M_PI - a : a;
+  a = a < -0.5f * (float)M_PI ? -(float)M_PI - a : a;
+
+  float a2 = a * a;
+  return a * (1.f +
+              a2 * (-1.f / 6.f +
+                    a2 * (1.f / 120.f +
+                          a2 * (-1.f / 5040.f +
+                                a2 * (1.f / 362880.f -
+                                      a2 * (1.f / 39916800.f))))));
+}
+
+static inline uint32_t mix(uint32_t h)
+{
+  h ^= h >> 15;
+  h *= 0x2c1b3c6du;
+  h ^= h >> 12;
+  return h;
+}
+
+// squared distance to the closest feature point and value attached to this
+// point, feature points are generated on the fly from the cell indices
+static inline void worley_search(float     x,
+                                 float     y,
+                                 uint32_t  seed,
+                                 float    &d2_min,
+                                 float    &value)
+{
+  const int xc = fast_floor(x);
+  const int yc = fast_floor(y);
+
+  d2_min = 1e9f;
+  value = 0.f;
+
+  // single loop fully unrolled, so that the caller loop can be vectorized
+#pragma GCC unroll 9
+  for (int c = 0; c < 9; c++)
+  {
+    int ic = xc + c / 3 - 1;
+    int jc = yc + c % 3 - 1;
+
+    uint32_t h = mix(hash(seed,
+                          (uint32_t)ic * NOISE_PRIME_X,
+                          (uint32_t)jc * NOISE_PRIME_Y));
+
+    float rx = (float)(h & 0xffffu) * (1.f / 65536.f) - 0.5f;
+    float ry = (float)(h >> 16) * (1.f / 65536.f) - 0.5f;
+    float px = (float)ic + 0.5f + NOISE_WORLEY_JITTER * rx;
+    float py = (float)jc + 0.5f + NOISE_WORLEY_JITTER * ry;
+    float d2 = (px - x) * (px - x) + (py - y) * (py - y);
+
+    float closer = d2 < d2_min ? 1.f : 0.f;
+
+    value += closer * (value_coord(h) - value);
+    d2_min = std::min(d2, d2_min);
+  }
+}
+
+// cell positions of a tile in the unit square (end point excluded), derived
+// from the global cell indices when the tile is aligned with the global
+// grid, so that they do not depend on the tiling
+static std::vector<float> tile_positions(float shift,
+                                         float scale,
+                                         int   n,
+                                         int   n_global)
+{
+  std::vector<float> pos(n);
+
+  double i0 = (double)shift * n_global;
+  bool   aligned = std::abs(i0 - std::round(i0)) < 1e-3 &&
+                 std::abs((double)scale * n_global - n) < 1e-3;
+
+  for (int k = 0; k < n; k++)
+    if (aligned)
+      pos[k] = (float)((double)(std::lround(i0) + k) / (double)n_global);
+    else
+      pos[k] = shift + scale * (float)k / (float)n;
+
+  return pos;
+}
+
+// --- BASE NOISE KERNELS
+
+NOISE_TARGET_CLONES
+static void perlin_kernel(const float *__restrict x,
+                          const float *__restrict y,
+                          float *__restrict out,
+                          int      n,
+                          uint32_t seed)
+{
+  for (int r = 0; r < n; r++)
+  {
+    int   x0 = fnl_floor(x[r]);
+    int   y0 = fnl_floor(y[r]);
+    float xd0 = x[r] - (float)x0;
+    float yd0 = y[r] - (float)y0;
+    float xd1 = xd0 - 1.f;
+    float yd1 = yd0 - 1.f;
+    float xs = quintic(xd0);
+    float ys = quintic(yd0);
+
+    uint32_t xp0 = (uint32_t)x0 * NOISE_PRIME_X;
+    uint32_t yp0 = (uint32_t)y0 * NOISE_PRIME_Y;
+    uint32_t xp1 = xp0 + NOISE_PRIME_X;
+    uint32_t yp1 = yp0 + NOISE_PRIME_Y;
+
+    uint32_t k00 = grad_index(hash(seed, xp0, yp0));
+    uint32_t k10 = grad_index(hash(seed, xp1, yp0));
+    uint32_t k01 = grad_index(hash(seed, xp0, yp1));
+    uint32_t k11 = grad_index(hash(seed, xp1, yp1));
+
+    float v00 = xd0 * grad.x[k00] + yd0 * grad.y[k00];
+    float v10 = xd1 * grad.x[k10] + yd0 * grad.y[k10];
+    float v01 = xd0 * grad.x[k01] + yd1 * grad.y[k01];
+    float v11 = xd1 * grad.x[k11] + yd1 * grad.y[k11];
+
+    out[r] = lerp(lerp(v00, v10, xs), lerp(v01, v11, xs), ys) *
+             NOISE_PERLIN_SCALING;
+  }
+}
+
+// Perlin noise with its analytical derivatives
+NOISE_TARGET_CLONES
+static void perlin_derivatives_kernel(const float *__restrict x,
+                                      const float *__restrict y,
+                                      float *__restrict out,
+                                      float *__restrict dout_x,
+                                      float *__restrict dout_y,
+                                      int      n,
+                                      uint32_t seed)
+{
+  for (int r = 0; r < n; r++)
+  {
+    int   x0 = fnl_floor(x[r]);
+    int   y0 = fnl_floor(y[r]);
+    float xd0 = x[r] - (float)x0;
+    float yd0 = y[r] - (float)y0;
+    float xd1 = xd0 - 1.f;
+    float yd1 = yd0 - 1.f;
+    float u = quintic(xd0);
+    float v = quintic(yd0);
+    float du = quintic_derivative(xd0);
+    float dv = quintic_derivative(yd0);
+
+    uint32_t xp0 = (uint32_t)x0 * NOISE_PRIME_X;
+    uint32_t yp0 = (uint32_t)y0 * NOISE_PRIME_Y;
+    uint32_t xp1 = xp0 + NOISE_PRIME_X;
+    uint32_t yp1 = yp0 + NOISE_PRIME_Y;
+
+    uint32_t ka = grad_index(hash(seed, xp0, yp0));
+    uint32_t kb = grad_index(hash(seed, xp1, yp0));
+    uint32_t kc = grad_index(hash(seed, xp0, yp1));
+    uint32_t kd = grad_index(hash(seed, xp1, yp1));
+
+    float a = xd0 * grad.x[ka] + yd0 * grad.y[ka];
+    float b = xd1 * grad.x[kb] + yd0 * grad.y[kb];
+    float c = xd0 * grad.x[kc] + yd1 * grad.y[kc];
+    float d = xd1 * grad.x[kd] + yd1 * grad.y[kd];
+
+    float k1 = b - a;
+    float k2 = c - a;
+    float k3 = a - b - c + d;
+
+    out[r] = (a + u * k1 + v * k2 + u * v * k3) * NOISE_PERLIN_SCALING;
+
+    dout_x[r] = (grad.x[ka] + u * (grad.x[kb] - grad.x[ka]) +
+                 v * (grad.x[kc] - grad.x[ka]) +
+                 u * v * (grad.x[ka] - grad.x[kb] - grad.x[kc] + grad.x[kd]) +
+                 du * (k1 + v * k3)) *
+                NOISE_PERLIN_SCALING;
+
+    dout_y[r] = (grad.y[ka] + u * (grad.y[kb] - grad.y[ka]) +
+                 v * (grad.y[kc] - grad.y[ka]) +
+                 u * v * (grad.y[ka] - grad.y[kb] - grad.y[kc] + grad.y[kd]) +
+                 dv * (k2 + u * k3)) *
+                NOISE_PERLIN_SCALING;
+  }
+}
+
+// coordinates are expected to be skewed (see transform_coordinates), the
+// operations follow the FastNoiseLite OpenSimplex2 2D evaluation
+NOISE_TARGET_CLONES
+static void simplex_kernel(const float *__restrict x,
+                           const float *__restrict y,
+                           float *__restrict out,
+                           int      n,
+                           uint32_t seed)
+{
+  const float sqrt3 = 1.7320508075688772935274463415059f;
+  const float g2 = (3.f - sqrt3) / 6.f;
+  const float c0 = (float)(2.f * (1.f - 2.f * g2) * (1.f / g2 - 2.f));
+  const float c1 = (float)(-2.f * (1.f - 2.f * g2) * (1.f - 2.f * g2));
+
+  for (int r = 0; r < n; r++)
+  {
+    int   i = fnl_floor(x[r]);
+    int   j = fnl_floor(y[r]);
+    float xi = x[r] - (float)i;
+    float yi = y[r] - (float)j;
+    float t = (xi + yi) * g2;
+    float x0 = xi - t;
+    float y0 = yi - t;
+
+    uint32_t ip = (uint32_t)i * NOISE_PRIME_X;
+    uint32_t jp = (uint32_t)j * NOISE_PRIME_Y;
+
+    // middle corner
+    bool     upper = y0 > x0;
+    float    x1 = upper ? x0 + g2 : x0 + (g2 - 1.f);
+    float    y1 = upper ? y0 + (g2 - 1.f) : y0 + g2;
+    uint32_t ip1 = upper ? ip : ip + NOISE_PRIME_X;
+    uint32_t jp1 = upper ? jp + NOISE_PRIME_Y : jp;
+
+    float x2 = x0 + (2.f * g2 - 1.f);
+    float y2 = y0 + (2.f * g2 - 1.f);
+
+    uint32_t k0 = grad_index(hash(seed, ip, jp));
+    uint32_t k1 = grad_index(hash(seed, ip1, jp1));
+    uint32_t k2 = grad_index(
+        hash(seed, ip + NOISE_PRIME_X, jp + NOISE_PRIME_Y));
+
+    float a = 0.5f - x0 * x0 - y0 * y0;
+    float b = 0.5f - x1 * x1 - y1 * y1;
+    float c = c0 * t + (c1 + a);
+
+    a = std::max(a, 0.f);
+    b = std::max(b, 0.f);
+    c = std::max(c, 0.f);
+
+    float n0 = (a * a) * (a * a) * (x0 * grad.x[k0] + y0 * grad.y[k0]);
+    float n1 = (b * b) * (b * b) * (x1 * grad.x[k1] + y1 * grad.y[k1]);
+    float n2 = (c * c) * (c * c) * (x2 * grad.x[k2] + y2 * grad.y[k2]);
+
+    out[r] = (n0 + n1 + n2) * NOISE_SIMPLEX_SCALING;
+  }
+}
+
+NOISE_TARGET_CLONES
+static void value_linear_kernel(const float *__restrict x,
+                                const float *__restrict y,
+                                float *__restrict out,
+                                int      n,
+                                uint32_t seed)
+{
+  for (int r = 0; r < n; r++)
+  {
+    int   x0 = fnl_floor(x[r]);
+    int   y0 = fnl_floor(y[r]);
+    float xs = x[r] - (float)x0;
+    float ys = y[r] - (float)y0;
+
+    uint32_t xp0 = (uint32_t)x0 * NOISE_PRIME_X;
+    uint32_t yp0 = (uint32_t)y0 * NOISE_PRIME_Y;
+    uint32_t xp1 = xp0 + NOISE_PRIME_X;
+    uint32_t yp1 = yp0 + NOISE_PRIME_Y;
+
+    float v00 = value_coord(hash(seed, xp0, yp0));
+    float v10 = value_coord(hash(seed, xp1, yp0));
+    float v01 = value_coord(hash(seed, xp0, yp1));
+    float v11 = value_coord(hash(seed, xp1, yp1));
+
+    out[r] = lerp(lerp(v00, v10, xs), lerp(v01, v11, xs), ys);
+  }
+}
+
+// values are mapped to [-1, 1], a distance of one noise cell giving 1
+NOISE_TARGET_CLONES
+static void worley_kernel(const float *__restrict x,
+                          const float *__restrict y,
+                          float *__restrict out,
+                          int      n,
+                          uint32_t seed)
+{
+  for (int r = 0; r < n; r++)
+  {
+    float d2, value;
+    worley_search(x[r], y[r], seed, d2, value);
+    out[r] = 2.f * std::sqrt(d2) - 1.f;
+  }
+}
+
+NOISE_TARGET_CLONES
+static void worley_double_kernel(const float *__restrict x,
+                                 const float *__restrict y,
+                                 float *__restrict out,
+                                 int      n,
+                                 uint32_t seed,
+                                 float    ratio,
+                                 float    k)
+{
+  const uint32_t seed2 = mix(seed + 0x9e3779b9u);
+  const float    norm = 1.f / std::max(ratio, 1.f - ratio);
+  const float    ks = std::max(k, 1e-6f);
+
+  for (int r = 0; r < n; r++)
+  {
+    float d2a, d2b, value;
+    worley_search(x[r], y[r], seed, d2a, value);
+    worley_search(x[r], y[r], seed2, d2b, value);
+
+    // polynomial smooth maximum
+    float a = ratio * std::sqrt(d2a);
+    float b = (1.f - ratio) * std::sqrt(d2b);
+    float h = std::max(ks - std::abs(a - b), 0.f) / ks;
+    float vmax = std::max(a, b) + h * h * h * ks / 6.f;
+
+    out[r] = 2.f * vmax * norm - 1.f;
+  }
+}
+
+NOISE_TARGET_CLONES
+static void worley_value_kernel(const float *__restrict x,
+                                const float *__restrict y,
+                                float *__restrict out,
+                                int      n,
+                                uint32_t seed)
+{
+  for (int r = 0; r < n; r++)
+  {
+    float d2, value;
+    worley_search(x[r], y[r], seed, d2, value);
+    out[r] = value;
+  }
+}
+
+// --- FRACTAL ACCUMULATION KERNELS
+
+// amplitude weighting by the octave value, 'p' in [0, 1] (same operations as
+// FastNoiseLite)
+static inline float weighted_amp(float amp, float p, float weight, float pers)
+{
+  return amp * lerp(1.f, p, weight) * pers;
+}
+
+NOISE_TARGET_CLONES
+static void fbm_accumulate(const float *__restrict v,
+                           float *__restrict amp,
+                           float *__restrict sum,
+                           int   n,
+                           float weight,
+                           float persistence)
+{
+  for (int r = 0; r < n; r++)
+  {
+    sum[r] += v[r] * amp[r];
+    amp[r] = weighted_amp(amp[r],
+                          std::min(v[r] + 1.f, 2.f) * 0.5f,
+                          weight,
+                          persistence);
+  }
+}
+
+NOISE_TARGET_CLONES
+static void ridged_accumulate(const float *__restrict v,
+                              float *__restrict amp,
+                              float *__restrict sum,
+                              int   n,
+                              float weight,
+                              float persistence)
+{
+  for (int r = 0; r < n; r++)
+  {
+    float a = std::abs(v[r]);
+    sum[r] += (a * -2.f + 1.f) * amp[r];
+    amp[r] = weighted_amp(amp[r], 1.f - a, weight, persistence);
+  }
+}
+
+NOISE_TARGET_CLONES
+static void pingpong_accumulate(const float *__restrict v,
+                                float *__restrict amp,
+                                float *__restrict sum,
+                                int   n,
+                                float weight,
+                                float persistence)
+{
+  for (int r = 0; r < n; r++)
+  {
+    float t = (v[r] + 1.f) * 2.f;
+    t -= (float)((int)(t * 0.5f) * 2);
+    float p = t < 1.f ? t : 2.f - t;
+
+    sum[r] += (p - 0.5f) * 2.f * amp[r];
+    amp[r] = weighted_amp(amp[r], p, weight, persistence);
+  }
+}
+
+// octaves are damped by the norm of the gradient accumulated so far and by
+// their own magnitude
+NOISE_TARGET_CLONES
+static void iq_accumulate(const float *__restrict v,
+                          const float *__restrict dvx,
+                          const float *__restrict dvy,
+                          float *__restrict gx,
+                          float *__restrict gy,
+                          float *__restrict amp,
+                          float *__restrict sum,
+                          int   n,
+                          float weight,
+                          float persistence,
+                          float gradient_weight,
+                          float value_weight)
+{
+  for (int r = 0; r < n; r++)
+  {
+    gx[r] += dvx[r];
+    gy[r] += dvy[r];
+
+    float damping = 1.f + gradient_weight * (gx[r] * gx[r] + gy[r] * gy[r]) +
+                    value_weight * std::abs(v[r]);
+
+    sum[r] += v[r] * amp[r] / damping;
+    amp[r] = weighted_amp(amp[r],
+                          std::min(v[r] + 1.f, 2.f) * 0.5f,
+                          weight,
+                          persistence);
+  }
+}
+
+// --- BATCH FUNCTIONS
+
+// noise coordinates transform applied once before the octaves (skewing of
+// the simplex grid, as done by FastNoiseLite)
+static void transform_coordinates(noise_type type, float *x, float *y, int n)
+{
+  if (type != noise_type::simplex)
+    return;
+
+  const float sqrt3 = 1.7320508075688772935274463415059f;
+  const float f2 = 0.5f * (sqrt3 - 1.f);
+
+  for (int r = 0; r < n; r++)
+  {
+    float t = (x[r] + y[r]) * f2;
+    x[r] += t;
+    y[r] += t;
+  }
+}
+
+// base noise of transformed coordinates
+static void base_batch(noise_type                type,
+                       const float              *x,
+                       const float              *y,
+                       float                    *out,
+                       int                       n,
+                       uint                      seed,
+                       const CellularParameters &cellular)
+{
+  switch (type)
+  {
+  case noise_type::perlin: perlin_kernel(x, y, out, n, seed); break;
+  case noise_type::simplex: simplex_kernel(x, y, out, n, seed); break;
+  case noise_type::value_linear: value_linear_kernel(x, y, out, n, seed); break;
+  case noise_type::worley: worley_kernel(x, y, out, n, seed); break;
+  case noise_type::worley_double:
+    worley_double_kernel(x, y, out, n, seed, cellular.ratio, cellular.k);
+    break;
+  case noise_type::worley_value: worley_value_kernel(x, y, out, n, seed); break;
+  default:
+    LOG_ERROR("unknown noise type [%d]", type);
+    throw std::runtime_error("unknown noise type");
+  }
+}
+
+void noise_batch(noise_type                type,
+                 const float              *x,
+                 const float              *y,
+                 float                    *out,
+                 int                       n,
+                 uint                      seed,
+                 const CellularParameters &cellular)
+{
+  if (type != noise_type::simplex)
+  {
+    base_batch(type, x, y, out, n, seed, cellular);
+    return;
+  }
+
+  std::vector<float> xt(x, x + n);
+  std::vector<float> yt(y, y + n);
+
+  transform_coordinates(type, xt.data(), yt.data(), n);
+  base_batch(type, xt.data(), yt.data(), out, n, seed, cellular);
+}
+
+static void fractal_batch(noise_type                type,
+                          fractal_type              fractal,
+                          const float              *x,
+                          const float              *y,
+                          float                    *out,
+                          int                       n,
+                          uint                      seed,
+                          const FractalParameters  &params,
+                          const CellularParameters &cellular,
+                          Workspace                &ws)
+{
+  if (fractal == fractal_type::none)
+  {
+    noise_batch(type, x, y, out, n, seed, cellular);
+    return;
+  }
+
+  if (fractal == fractal_type::billow)
+  {
+    noise_batch(type, x, y, out, n, seed, cellular);
+    for (int r = 0; r < n; r++)
+      out[r] = 2.f * std::abs(out[r]) - 1.f;
+    return;
+  }
+
+  // normalization of the octave sum
+  float amp_sum = 0.f;
+  float amp_k = 1.f;
+  for (int k = 0; k < params.octaves; k++)
+  {
+    amp_sum += amp_k;
+    amp_k *= params.persistence;
+  }
+  float amp0 = amp_sum > 0.f ? 1.f / amp_sum : 0.f;
+
+  ws.resize(n, fractal == fractal_type::iq);
+
+  std::copy(x, x + n, ws.xk.begin());
+  std::copy(y, y + n, ws.yk.begin());
+  transform_coordinates(type, ws.xk.data(), ws.yk.data(), n);
+  std::fill(ws.amp.begin(), ws.amp.begin() + n, amp0);
+  std::fill(out, out + n, 0.f);
+
+  if (fractal == fractal_type::iq)
+  {
+    std::fill(ws.gx.begin(), ws.gx.begin() + n, 0.f);
+    std::fill(ws.gy.begin(), ws.gy.begin() + n, 0.f);
+  }
+
+  for (int k = 0; k < params.octaves; k++)
+  {
+    uint32_t seed_k = (uint32_t)seed + (uint32_t)k;
+
+    switch (fractal)
+    {
+    case fractal_type::fbm:
+      base_batch(type,
+                 ws.xk.data(),
+                 ws.yk.data(),
+                 ws.v.data(),
+                 n,
+                 seed_k,
+                 cellular);
+      fbm_accumulate(ws.v.data(),
+                     ws.amp.data(),
+                     out,
+                     n,
+                     params.weight,
+                     params.persistence);
+      break;
+
+    case fractal_type::ridged:
+      base_batch(type,
+                 ws.xk.data(),
+                 ws.yk.data(),
+                 ws.v.data(),
+                 n,
+                 seed_k,
+                 cellular);
+      ridged_accumulate(ws.v.data(),
+                        ws.amp.data(),
+                        out,
+                        n,
+                        params.weight,
+                        params.persistence);
+      break;
+
+    case fractal_type::pingpong:
+      base_batch(type,
+                 ws.xk.data(),
+                 ws.yk.data(),
+                 ws.v.data(),
+                 n,
+                 seed_k,
+                 cellular);
+      pingpong_accumulate(ws.v.data(),
+                          ws.amp.data(),
+                          out,
+                          n,
+                          params.weight,
+                          params.persistence);
+      break;
+
+    case fractal_type::iq:
+      perlin_derivatives_kernel(ws.xk.data(),
+                                ws.yk.data(),
+                                ws.v.data(),
+                                ws.dvx.data(),
+                                ws.dvy.data(),
+                                n,
+                                seed_k);
+      iq_accumulate(ws.v.data(),
+                    ws.dvx.data(),
+                    ws.dvy.data(),
+                    ws.gx.data(),
+                    ws.gy.data(),
+                    ws.amp.data(),
+                    out,
+                    n,
+                    params.weight,
+                    params.persistence,
+                    params.gradient_weight,
+                    params.value_weight);
+      break;
+
+    default:
+      LOG_ERROR("unknown fractal type [%d]", fractal);
+      throw std::runtime_error("unknown fractal type");
+    }
+
+    for (int r = 0; r < n; r++)
+    {
+      ws.xk[r] *= params.lacunarity;
+      ws.yk[r] *= params.lacunarity;
+    }
+  }
+}
+
+void fractal_batch(noise_type                type,
+                   fractal_type              fractal,
+                   const float              *x,
+                   const float              *y,
+                   float                    *out,
+                   int                       n,
+                   uint                      seed,
+                   const FractalParameters  &params,
+                   const CellularParameters &cellular)
+{
+  Workspace ws;
+  fractal_batch(type, fractal, x, y, out, n, seed, params, cellular, ws);
+}
+
+// --- HEIGHTMAP FILLING
+
+void fill_noise(hmap::HeightMap          &h,
+                noise_type                type,
+                fractal_type              fractal,
+                hmap::Vec2<float>         kw,
+                uint                      seed,
+                const FractalParameters  &params,
+                hmap::HeightMap          *p_dx,
+                hmap::HeightMap          *p_dy,
+                hmap::HeightMap          *p_stretching,
+                const CellularParameters &cellular)
+{
+  for (size_t k = 0; k < h.tiles.size(); k++)
+  {
+    hmap::Tile  &tile = h.tiles[k];
+    hmap::Array *p_dx_tile = p_dx ? &p_dx->tiles[k] : nullptr;
+    hmap::Array *p_dy_tile = p_dy ? &p_dy->tiles[k] : nullptr;
+    hmap::Array *p_st_tile = p_stretching ? &p_stretching->tiles[k] : nullptr;
+
+    const int nx = tile.shape.x;
+    const int ny = tile.shape.y;
+
+    std::vector<float> xu = tile_positions(tile.shift.x,
+                                           tile.scale.x,
+                                           nx,
+                                           h.shape.x);
+    std::vector<float> yu = tile_positions(tile.shift.y,
+                                           tile.scale.y,
+                                           ny,
+                                           h.shape.y);
+
+    parallel_for(
+        nx,
+        [&](int i_start, int i_end)
+        {
+          std::vector<float> xr(ny), yr(ny);
+          Workspace          ws;
+
+          for (int i = i_start; i < i_end; i++)
+          {
+            const size_t offset = (size_t)i * ny;
+
+            for (int j = 0; j < ny; j++)
+            {
+              xr[j] = kw.x * xu[i];
+              yr[j] = kw.y * yu[j];
+            }
+
+            if (p_st_tile)
+              for (int j = 0; j < ny; j++)
+              {
+                xr[j] *= p_st_tile->vector[offset + j];
+                yr[j] *= p_st_tile->vector[offset + j];
+              }
+
+            if (p_dx_tile)
+              for (int j = 0; j < ny; j++)
+                xr[j] += p_dx_tile->vector[offset + j];
+
+            if (p_dy_tile)
+              for (int j = 0; j < ny; j++)
+                yr[j] += p_dy_tile->vector[offset + j];
+
+            fractal_batch(type,
+                          fractal,
+                          xr.data(),
+                          yr.data(),
+                          tile.vector.data() + offset,
+                          ny,
+                          seed,
+                          params,
+                          cellular,
+                          ws);
+          }
+        });
+  }
+}
+
+// cosine profile (crest at phase 0, as the HighMap waves), i.e. a sine
+// shifted by a quarter of period
+NOISE_TARGET_CLONES
+static void wave_sine_kernel(const float *__restrict phase,
+                             float *__restrict out,
+                             int n)
+{
+  for (int r = 0; r < n; r++)
+  {
+    float p = phase[r] + 0.25f;
+    float t = p - (float)fast_floor(p);
+    out[r] = sin_2pi_fract(t);
+  }
+}
+
+void fill_wave_sine(hmap::HeightMap &h,
+                    float            kw,
+                    float            angle,
+                    float            phase_shift,
+                    hmap::HeightMap *p_dx)
+{
+  const float ca = std::cos(angle / 180.f * (float)M_PI);
+  const float sa = std::sin(angle / 180.f * (float)M_PI);
+  const float phase0 = phase_shift / 360.f;
+
+  for (size_t k = 0; k < h.tiles.size(); k++)
+  {
+    hmap::Tile  &tile = h.tiles[k];
+    hmap::Array *p_dx_tile = p_dx ? &p_dx->tiles[k] : nullptr;
+
+    const int nx = tile.shape.x;
+    const int ny = tile.shape.y;
+
+    std::vector<float> xu = tile_positions(tile.shift.x,
+                                           tile.scale.x,
+                                           nx,
+                                           h.shape.x);
+    std::vector<float> yu = tile_positions(tile.shift.y,
+                                           tile.scale.y,
+                                           ny,
+                                           h.shape.y);
+
+    parallel_for(
+        nx,
+        [&](int i_start, int i_end)
+        {
+          std::vector<float> phase(ny);
+
+          for (int i = i_start; i < i_end; i++)
+          {
+            const size_t offset = (size_t)i * ny;
+
+            for (int j = 0; j < ny; j++)
+              phase[j] = kw * (ca * xu[i] + sa * yu[j]) + phase0;
+
+            if (p_dx_tile)
+              for (int j = 0; j < ny; j++)
+                phase[j] += p_dx_tile->vector[offset + j];
+
+            wave_sine_kernel(phase.data(), tile.vector.data() + offset, ny);
+          }
+        });
+  }
+}
+
+} // namespace hesiod::noise
@@ -0,0 +1,308 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "macrologger.h"
+
+#include "hesiod/output_cache.hpp"
+
+// cache file signature
+#define OUTPUT_CACHE_MAGIC "HSOC"
+
+namespace hesiod::io
+{
+
+// FNV-1a 64 bit parameters
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+// file header, followed by the shape (2 int32) and the values of each tile
+struct CacheHeader
+{
+  char    magic[4];
+  int32_t version;
+  char    key[16]; // hexadecimal digits, not null-terminated
+  int32_t shape[2];
+  int32_t tiling[2];
+  float   overlap;
+  int32_t ntiles;
+};
+
+std::string hash_string(const std::string &str)
+{
+  std::string salted = "hesiod_output_cache_v" +
+                       std::to_string(OUTPUT_CACHE_VERSION) + "|" + str;
+
+  uint64_t hash = FNV_OFFSET_BASIS;
+  for (unsigned char c : salted)
+  {
+    hash ^= (uint64_t)c;
+    hash *= FNV_PRIME;
+  }
+
+  char buffer[17];
+  std::snprintf(buffer, sizeof(buffer), "%016llx", (unsigned long long)hash);
+  return std::string(buffer);
+}
+
+std::string hash_heightmap(const hmap::HeightMap &h)
+{
+  uint64_t hash = FNV_OFFSET_BASIS;
+
+  // hashed by 32 bit words
+  auto add = [&hash](uint32_t word)
+  {
+    hash ^= (uint64_t)word;
+    hash *= FNV_PRIME;
+  };
+
+  add((uint32_t)h.shape.x);
+  add((uint32_t)h.shape.y);
+  add((uint32_t)h.tiling.x);
+  add((uint32_t)h.tiling.y);
+
+  for (auto &tile : h.tiles)
+    for (float v : tile.vector)
+    {
+      uint32_t word;
+      std::memcpy(&word, &v, sizeof(word));
+      add(word);
+    }
+
+  char buffer[17];
+  std::snprintf(buffer, sizeof(buffer), "%016llx", (unsigned long long)hash);
+  return hash_string(std::string(buffer));
+}
+
+// key stored in the header (zero padded)
+static void set_header_key(CacheHeader &header, const std::string &key)
+{
+  std::memset(header.key, 0, sizeof(header.key));
+  std::memcpy(header.key, key.data(), std::min(key.size(), sizeof(header.key)));
+}
+
+std::string output_cache_fname(const std::string &dir,
+                               const std::string &key,
+                               const std::string &port_id)
+{
+  return (std::filesystem::path(dir) / (key + "_" + port_id + ".bin"))
+      .string();
+}
+
+void write_heightmap_cache(const std::string     &fname,
+                           const std::string     &key,
+                           const hmap::HeightMap &h)
+{
+  // the key identifies the content, an existing file is up-to-date
+  if (std::filesystem::exists(fname))
+    return;
+
+  std::string   fname_tmp = fname + ".tmp";
+  std::ofstream f(fname_tmp, std::ios::binary);
+
+  CacheHeader header;
+  std::memcpy(header.magic, OUTPUT_CACHE_MAGIC, 4);
+  header.version = OUTPUT_CACHE_VERSION;
+  set_header_key(header, key);
+  header.shape[0] = h.shape.x;
+  header.shape[1] = h.shape.y;
+  header.tiling[0] = h.tiling.x;
+  header.tiling[1] = h.tiling.y;
+  header.overlap = h.overlap;
+  header.ntiles = (int32_t)h.tiles.size();
+
+  f.write((const char *)&header, sizeof(header));
+
+  for (auto &tile : h.tiles)
+  {
+    int32_t shape[2] = {tile.shape.x, tile.shape.y};
+    f.write((const char *)shape, sizeof(shape));
+    f.write((const char *)tile.vector.data(),
+            sizeof(float) * tile.vector.size());
+  }
+
+  f.close();
+
+  if (!f.good())
+  {
+    LOG_ERROR("could not write output cache file [%s]", fname_tmp.c_str());
+    std::error_code ec;
+    std::filesystem::remove(fname_tmp, ec);
+    throw std::runtime_error("could not write file " + fname_tmp);
+  }
+
+  std::filesystem::rename(fname_tmp, fname);
+}
+
+// parse the mapped file and copy the tiles, false if the content does not
+// match the key or the heightmap storage
+static bool copy_tiles(const char        *p,
+                       size_t             size,
+                       const std::string &key,
+                       hmap::HeightMap   &h)
+{
+  CacheHeader header;
+  CacheHeader expected;
+
+  if (size < sizeof(header))
+    return false;
+
+  std::memcpy(&header, p, sizeof(header));
+  set_header_key(expected, key);
+
+  if (std::strncmp(header.magic, OUTPUT_CACHE_MAGIC, 4) != 0 ||
+      header.version != OUTPUT_CACHE_VERSION ||
+      std::memcmp(header.key, expected.key, sizeof(header.key)) != 0 ||
+      header.shape[0] != h.shape.x || header.shape[1] != h.shape.y ||
+      header.tiling[0] != h.tiling.x || header.tiling[1] != h.tiling.y ||
+      header.overlap != h.overlap || header.ntiles != (int32_t)h.tiles.size())
+    return false;
+
+  // check the whole file before modifying the heightmap
+  std::vector<size_t> offsets = {};
+  size_t              offset = sizeof(header);
+
+  for (auto &tile : h.tiles)
+  {
+    int32_t shape[2];
+
+    if (offset + sizeof(shape) > size)
+      return false;
+
+    std::memcpy(shape, p + offset, sizeof(shape));
+    offset += sizeof(shape);
+
+    if (shape[0] != tile.shape.x || shape[1] != tile.shape.y ||
+        offset + sizeof(float) * tile.vector.size() > size)
+      return false;
+
+    offsets.push_back(offset);
+    offset += sizeof(float) * tile.vector.size();
+  }
+
+  for (size_t k = 0; k < h.tiles.size(); k++)
+    std::memcpy(h.tiles[k].vector.data(),
+                p + offsets[k],
+                sizeof(float) * h.tiles[k].vector.size());
+
+  return true;
+}
+
+bool read_heightmap_cache(const std::string &fname,
+                          const std::string &key,
+                          hmap::HeightMap   &h)
+{
+#ifdef _WIN32
+  std::ifstream f(fname, std::ios::binary | std::ios::ate);
+  if (!f.is_open())
+    return false;
+
+  std::vector<char> buffer((size_t)f.tellg());
+  f.seekg(0);
+  f.read(buffer.data(), buffer.size());
+
+  bool success = f.good() && copy_tiles(buffer.data(), buffer.size(), key, h);
+#else
+  int fd = open(fname.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  off_t size = lseek(fd, 0, SEEK_END);
+  void *p_map = size > 0 ? mmap(nullptr,
+                                (size_t)size,
+                                PROT_READ,
+                                MAP_PRIVATE,
+                                fd,
+                                0)
+                         : MAP_FAILED;
+  close(fd);
+
+  if (p_map == MAP_FAILED)
+    return false;
+
+  // sequential read of the whole file
+  madvise(p_map, (size_t)size, MADV_SEQUENTIAL);
+
+  bool success = copy_tiles((const char *)p_map, (size_t)size, key, h);
+  munmap(p_map, (size_t)size);
+#endif
+
+  if (!success)
+    LOG_DEBUG("output cache file [%s] not matching", fname.c_str());
+
+  return success;
+}
+
+std::string statistics_cache_fname(const std::string &dir,
+                                   const std::string &key)
+{
+  return (std::filesystem::path(dir) / (key + "_statistics.json")).string();
+}
+
+void write_statistics_cache(const std::string    &fname,
+                            const std::string    &key,
+                            const nlohmann::json &data)
+{
+  // the key identifies the content, an existing file is up-to-date
+  if (std::filesystem::exists(fname))
+    return;
+
+  nlohmann::json file_data = nlohmann::json();
+  file_data["version"] = OUTPUT_CACHE_VERSION;
+  file_data["key"] = key;
+  file_data["statistics"] = data;
+
+  std::string   fname_tmp = fname + ".tmp";
+  std::ofstream f(fname_tmp, std::ios::trunc);
+
+  f << file_data.dump() << std::endl;
+  f.close();
+
+  if (!f.good())
+  {
+    LOG_ERROR("could not write output cache file [%s]", fname_tmp.c_str());
+    std::error_code ec;
+    std::filesystem::remove(fname_tmp, ec);
+    throw std::runtime_error("could not write file " + fname_tmp);
+  }
+
+  std::filesystem::rename(fname_tmp, fname);
+}
+
+bool read_statistics_cache(const std::string &fname,
+                           const std::string &key,
+                           nlohmann::json    &data)
+{
+  std::ifstream f(fname);
+  if (!f.is_open())
+    return false;
+
+  nlohmann::json file_data = nlohmann::json::parse(f, nullptr, false);
+
+  if (file_data.is_discarded() || !file_data.is_object() ||
+      file_data.value("version", 0) != OUTPUT_CACHE_VERSION ||
+      file_data.value("key", "") != key || !file_data.contains("statistics"))
+  {
+    LOG_DEBUG("output cache file [%s] not matching", fname.c_str());
+    return false;
+  }
+
+  data = file_data["statistics"];
+  return true;
+}
+
+} // namespace hesiod::io
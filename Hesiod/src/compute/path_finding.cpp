@@ -0,0 +1,543 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <unordered_map>
+
+#include "highmap.hpp"
+#include "macrologger.h"
+
+#include "hesiod/parallel.hpp"
+#include "hesiod/path_finding.hpp"
+#include "hesiod/region.hpp"
+
+// corridor half-width (in cells) used to refine a path found at a
+// coarser level
+#define PATH_FINDING_CORRIDOR_RADIUS 4
+
+namespace hesiod::path_finding
+{
+
+// --- HELPERS
+
+static uint64_t hash_combine(uint64_t hash, const hmap::Array &array)
+{
+  hash ^= (uint64_t)array.shape.x * 0x9e3779b97f4a7c15ULL;
+  hash ^= (uint64_t)array.shape.y * 0xbf58476d1ce4e5b9ULL;
+
+  for (auto &v : array.vector)
+  {
+    uint32_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    hash = (hash ^ bits) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+// 2x2 box downsampling (the last row / column is kept as is for odd
+// shapes)
+static hmap::Array downsample(const hmap::Array &array)
+{
+  hmap::Vec2<int> shape = {(array.shape.x + 1) / 2, (array.shape.y + 1) / 2};
+  hmap::Array     out = hmap::Array(shape);
+
+  for (int i = 0; i < shape.x; i++)
+    for (int j = 0; j < shape.y; j++)
+    {
+      float sum = 0.f;
+      int   count = 0;
+
+      for (int p = 2 * i; p < std::min(2 * i + 2, array.shape.x); p++)
+        for (int q = 2 * j; q < std::min(2 * j + 2, array.shape.y); q++)
+        {
+          sum += array.vector[(size_t)p * array.shape.y + q];
+          count++;
+        }
+
+      out.vector[(size_t)i * shape.y + j] = sum / (float)count;
+    }
+
+  return out;
+}
+
+// map cell (i, j) from one level to another using the unit square
+// coordinates
+static hmap::Vec2<int> map_cell(hmap::Vec2<int> ij,
+                                hmap::Vec2<int> shape_from,
+                                hmap::Vec2<int> shape_to)
+{
+  float rx = shape_from.x > 1 ? (float)(shape_to.x - 1) / (shape_from.x - 1)
+                              : 0.f;
+  float ry = shape_from.y > 1 ? (float)(shape_to.y - 1) / (shape_from.y - 1)
+                              : 0.f;
+
+  return hmap::Vec2<int>(
+      std::clamp((int)std::round(ij.x * rx), 0, shape_to.x - 1),
+      std::clamp((int)std::round(ij.y * ry), 0, shape_to.y - 1));
+}
+
+// length of a cell of a level, in cells of the reference shape (the
+// shape the single-resolution search used to work on)
+static float cell_length(hmap::Vec2<int> shape, hmap::Vec2<int> shape_ref)
+{
+  int n = std::max(shape.x, shape.y);
+  int n_ref = std::max(shape_ref.x, shape_ref.y);
+  return n > 1 ? (float)std::max(1, n_ref - 1) / (float)(n - 1) : 1.f;
+}
+
+// A* over the cells of a domain: 'to_local' returns the local index
+// of the cell (i, j), or -1 if the cell does not belong to the domain
+static std::vector<hmap::Vec2<int>> astar(
+    const hmap::Array                  &z,
+    const hmap::Array                  *p_mask,
+    hmap::Vec2<int>                     ij_start,
+    hmap::Vec2<int>                     ij_end,
+    float                               elevation_ratio,
+    float                               distance_exponent,
+    float                               length,
+    size_t                              domain_size,
+    std::function<int(int, int)>        to_local,
+    std::function<hmap::Vec2<int>(int)> to_global)
+{
+  const int   nx = z.shape.x;
+  const int   ny = z.shape.y;
+  const float cd = (1.f - elevation_ratio) * length;
+  const float diag = std::pow(std::sqrt(2.f), distance_exponent);
+
+  auto zv = [&z, &ny](int i, int j) { return z.vector[(size_t)i * ny + j]; };
+
+  auto is_nogo = [&](int i, int j)
+  {
+    if (!p_mask)
+      return false;
+    if ((i == ij_start.x && j == ij_start.y) ||
+        (i == ij_end.x && j == ij_end.y))
+      return false;
+    return p_mask->vector[(size_t)i * ny + j] > 0.5f;
+  };
+
+  // admissible heuristic: octile distance (diagonal steps cost
+  // 'diag' <= 2) and elevation difference to the goal
+  const float z_end = zv(ij_end.x, ij_end.y);
+
+  auto heuristic = [&](int i, int j)
+  {
+    int   di = std::abs(i - ij_end.x);
+    int   dj = std::abs(j - ij_end.y);
+    float d = (float)std::max(di, dj) +
+              (diag - 1.f) * (float)std::min(di, dj);
+    return cd * d + elevation_ratio * std::abs(z_end - zv(i, j));
+  };
+
+  int k_start = to_local(ij_start.x, ij_start.y);
+  int k_end = to_local(ij_end.x, ij_end.y);
+
+  if (k_start < 0 || k_end < 0)
+    return {};
+
+  std::vector<float> g(domain_size, std::numeric_limits<float>::max());
+  std::vector<int>   parent(domain_size, -1);
+
+  typedef std::pair<float, int> Item;
+  std::priority_queue<Item, std::vector<Item>, std::greater<Item>> queue;
+
+  g[k_start] = 0.f;
+  queue.push({heuristic(ij_start.x, ij_start.y), k_start});
+
+  const int di[8] = {-1, 0, 0, 1, -1, -1, 1, 1};
+  const int dj[8] = {0, 1, -1, 0, -1, 1, -1, 1};
+
+  while (!queue.empty())
+  {
+    auto [f, k] = queue.top();
+    queue.pop();
+
+    if (k == k_end)
+      break;
+
+    hmap::Vec2<int> ij = to_global(k);
+
+    // outdated queue entry
+    if (f > g[k] + heuristic(ij.x, ij.y) + 1e-6f)
+      continue;
+
+    for (int n = 0; n < 8; n++)
+    {
+      int p = ij.x + di[n];
+      int q = ij.y + dj[n];
+
+      if (p < 0 || p >= nx || q < 0 || q >= ny || is_nogo(p, q))
+        continue;
+
+      int kn = to_local(p, q);
+      if (kn < 0)
+        continue;
+
+      float cost = cd * (n < 4 ? 1.f : diag) +
+                   elevation_ratio * std::abs(zv(p, q) - zv(ij.x, ij.y));
+
+      if (g[k] + cost < g[kn])
+      {
+        g[kn] = g[k] + cost;
+        parent[kn] = k;
+        queue.push({g[kn] + heuristic(p, q), kn});
+      }
+    }
+  }
+
+  if (k_start != k_end && parent[k_end] < 0)
+    return {};
+
+  std::vector<hmap::Vec2<int>> cells = {};
+  for (int k = k_end; k >= 0; k = parent[k])
+    cells.push_back(to_global(k));
+  std::reverse(cells.begin(), cells.end());
+
+  return cells;
+}
+
+static std::vector<hmap::Vec2<int>> astar_full(
+    const hmap::Array &z,
+    const hmap::Array *p_mask,
+    hmap::Vec2<int>    ij_start,
+    hmap::Vec2<int>    ij_end,
+    float              elevation_ratio,
+    float              distance_exponent,
+    float              length)
+{
+  const int ny = z.shape.y;
+
+  return astar(
+      z,
+      p_mask,
+      ij_start,
+      ij_end,
+      elevation_ratio,
+      distance_exponent,
+      length,
+      z.vector.size(),
+      [ny](int i, int j) { return i * ny + j; },
+      [ny](int k) { return hmap::Vec2<int>(k / ny, k % ny); });
+}
+
+static std::vector<hmap::Vec2<int>> astar_corridor(
+    const hmap::Array                  &z,
+    const hmap::Array                  *p_mask,
+    hmap::Vec2<int>                     ij_start,
+    hmap::Vec2<int>                     ij_end,
+    float                               elevation_ratio,
+    float                               distance_exponent,
+    float                               length,
+    const std::vector<hmap::Vec2<int>> &centers)
+{
+  const int nx = z.shape.x;
+  const int ny = z.shape.y;
+  const int ir = PATH_FINDING_CORRIDOR_RADIUS;
+
+  // compact indexing of the corridor cells
+  std::unordered_map<int64_t, int> local_index = {};
+  std::vector<hmap::Vec2<int>>     global_index = {};
+
+  for (auto &c : centers)
+    for (int p = std::max(0, c.x - ir); p <= std::min(nx - 1, c.x + ir); p++)
+      for (int q = std::max(0, c.y - ir); q <= std::min(ny - 1, c.y + ir); q++)
+      {
+        int64_t key = (int64_t)p * ny + q;
+        if (local_index.emplace(key, (int)global_index.size()).second)
+          global_index.push_back(hmap::Vec2<int>(p, q));
+      }
+
+  return astar(
+      z,
+      p_mask,
+      ij_start,
+      ij_end,
+      elevation_ratio,
+      distance_exponent,
+      length,
+      global_index.size(),
+      [&local_index, ny](int i, int j)
+      {
+        auto it = local_index.find((int64_t)i * ny + j);
+        return it == local_index.end() ? -1 : it->second;
+      },
+      [&global_index](int k) { return global_index[k]; });
+}
+
+// --- cost field
+
+uint64_t heightmap_checksum(hmap::HeightMap &h)
+{
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (auto &tile : h.tiles)
+    hash = hash_combine(hash, tile);
+  return hash;
+}
+
+void update_cost_field(CostField       &field,
+                       hmap::HeightMap &h,
+                       hmap::HeightMap *p_mask,
+                       hmap::Vec2<int>  shape_coarse)
+{
+  uint64_t checksum = heightmap_checksum(h);
+  if (p_mask)
+    checksum ^= 0x9e3779b97f4a7c15ULL * (heightmap_checksum(*p_mask) | 1);
+  checksum ^= (uint64_t)shape_coarse.x * 0xbf58476d1ce4e5b9ULL +
+              (uint64_t)shape_coarse.y;
+
+  const std::lock_guard<std::mutex> lock(field.mutex);
+
+  if (checksum == field.checksum && field.z_levels.size())
+  {
+    LOG_DEBUG("path finding, cost field is up to date");
+    return;
+  }
+
+  LOG_DEBUG("path finding, building cost field");
+
+  field.z_levels.clear();
+  field.mask_levels.clear();
+  field.segments.clear();
+  field.checksum = checksum;
+  field.shape_reference = hmap::Vec2<int>(std::min(shape_coarse.x, h.shape.x),
+                                          std::min(shape_coarse.y, h.shape.y));
+
+  // full resolution level, normalized elevation, filled tile by tile without
+  // gathering the heightmap in a temporary array
+  float zmin = std::numeric_limits<float>::max();
+  float zmax = -std::numeric_limits<float>::max();
+  for (auto &tile : h.tiles)
+  {
+    zmin = std::min(zmin, tile.min());
+    zmax = std::max(zmax, tile.max());
+  }
+
+  hmap::Array &z = field.z_levels.emplace_back(h.shape);
+  hesiod::region::blit_heightmap(h, z.vector.data());
+
+  if (zmax > zmin)
+    for (auto &v : z.vector)
+      v = (v - zmin) / (zmax - zmin);
+
+  if (p_mask)
+  {
+    if (p_mask->shape == h.shape)
+    {
+      hmap::Array &mask = field.mask_levels.emplace_back(h.shape);
+      hesiod::region::blit_heightmap(*p_mask, mask.vector.data());
+    }
+    else
+      field.mask_levels.push_back(p_mask->to_array(h.shape));
+  }
+
+  // pyramid
+  while (field.z_levels.back().shape.x > std::max(2, shape_coarse.x) ||
+         field.z_levels.back().shape.y > std::max(2, shape_coarse.y))
+  {
+    field.z_levels.push_back(downsample(field.z_levels.back()));
+    if (p_mask)
+      field.mask_levels.push_back(downsample(field.mask_levels.back()));
+  }
+}
+
+// --- path finding
+
+std::vector<hmap::Vec2<int>> find_path(const CostField &field,
+                                       hmap::Vec2<int>  ij_start,
+                                       hmap::Vec2<int>  ij_end,
+                                       float            elevation_ratio,
+                                       float            distance_exponent)
+{
+  if (field.z_levels.empty())
+    return {};
+
+  const bool      use_mask = field.mask_levels.size() > 0;
+  int             nlevels = (int)field.z_levels.size();
+  hmap::Vec2<int> shape0 = field.z_levels[0].shape;
+
+  // coarsest level, whole domain
+  const hmap::Array &z_top = field.z_levels[nlevels - 1];
+
+  std::vector<hmap::Vec2<int>> cells = astar_full(
+      z_top,
+      use_mask ? &field.mask_levels[nlevels - 1] : nullptr,
+      map_cell(ij_start, shape0, z_top.shape),
+      map_cell(ij_end, shape0, z_top.shape),
+      elevation_ratio,
+      distance_exponent,
+      cell_length(z_top.shape, field.shape_reference));
+
+  // refine down to the full resolution within a corridor around the
+  // coarser path
+  for (int k = nlevels - 2; k >= 0; k--)
+  {
+    const hmap::Array &z = field.z_levels[k];
+    const hmap::Array *p_mask = use_mask ? &field.mask_levels[k] : nullptr;
+    hmap::Vec2<int>    shape_coarser = field.z_levels[k + 1].shape;
+    hmap::Vec2<int>    ij0 = map_cell(ij_start, shape0, z.shape);
+    hmap::Vec2<int>    ij1 = map_cell(ij_end, shape0, z.shape);
+    float              length = cell_length(z.shape, field.shape_reference);
+
+    std::vector<hmap::Vec2<int>> centers = {ij0, ij1};
+    for (auto &c : cells)
+      centers.push_back(map_cell(c, shape_coarser, z.shape));
+
+    std::vector<hmap::Vec2<int>> fine_cells = {};
+
+    if (cells.size())
+      fine_cells = astar_corridor(z,
+                                  p_mask,
+                                  ij0,
+                                  ij1,
+                                  elevation_ratio,
+                                  distance_exponent,
+                                  length,
+                                  centers);
+
+    // the corridor may be blocked at this resolution (thin no-go
+    // structures for instance), fall back to a search on the whole
+    // level
+    if (fine_cells.empty())
+    {
+      LOG_DEBUG("path finding, corridor search failed at level %d", k);
+      fine_cells = astar_full(z,
+                              p_mask,
+                              ij0,
+                              ij1,
+                              elevation_ratio,
+                              distance_exponent,
+                              length);
+    }
+
+    cells = fine_cells;
+  }
+
+  return cells;
+}
+
+void find_path(CostField  &field,
+               hmap::Path &path,
+               float       elevation_ratio,
+               float       distance_exponent)
+{
+  if (field.z_levels.empty() || path.get_npoints() < 2)
+    return;
+
+  const hmap::Array &z = field.z_levels[0];
+  hmap::Vec2<int>    shape = z.shape;
+
+  typedef std::tuple<int, int, int, int> SegmentKey;
+
+  // segments start / end cells at full resolution
+  std::vector<SegmentKey> keys = {};
+  {
+    std::vector<hmap::Vec2<int>> ij = {};
+    for (auto &p : path.points)
+      ij.push_back(hmap::Vec2<int>(
+          std::clamp((int)std::round(p.x * (shape.x - 1)), 0, shape.x - 1),
+          std::clamp((int)std::round(p.y * (shape.y - 1)), 0, shape.y - 1)));
+
+    if (path.closed)
+      ij.push_back(ij.front());
+
+    for (size_t k = 0; k < ij.size() - 1; k++)
+      keys.push_back({ij[k].x, ij[k].y, ij[k + 1].x, ij[k + 1].y});
+  }
+
+  // solve unknown segments in parallel
+  {
+    const std::lock_guard<std::mutex> lock(field.mutex);
+
+    if (elevation_ratio != field.elevation_ratio ||
+        distance_exponent != field.distance_exponent)
+    {
+      field.segments.clear();
+      field.elevation_ratio = elevation_ratio;
+      field.distance_exponent = distance_exponent;
+    }
+
+    std::vector<SegmentKey> missing = {};
+    for (auto &key : keys)
+      if (!field.segments.contains(key) &&
+          std::find(missing.begin(), missing.end(), key) == missing.end())
+        missing.push_back(key);
+
+    LOG_DEBUG("path finding, %ld segment(s) to solve, %ld cached",
+              missing.size(),
+              keys.size() - missing.size());
+
+    // at most one search per worker at a time, which also bounds the memory
+    // used by the searches
+    std::vector<std::vector<hmap::Vec2<int>>> solved(missing.size());
+
+    hesiod::parallel_for(
+        (int)missing.size(),
+        [&field, &missing, &solved, elevation_ratio, distance_exponent](
+            int k0,
+            int k1)
+        {
+          for (int k = k0; k < k1; k++)
+          {
+            auto [i0, j0, i1, j1] = missing[k];
+            solved[k] = find_path(field,
+                                  {i0, j0},
+                                  {i1, j1},
+                                  elevation_ratio,
+                                  distance_exponent);
+          }
+        });
+
+    for (size_t k = 0; k < missing.size(); k++)
+      field.segments[missing[k]] = std::move(solved[k]);
+
+    // only keep the segments of the current path
+    std::map<SegmentKey, std::vector<hmap::Vec2<int>>> segments = {};
+    for (auto &key : keys)
+      segments[key] = field.segments[key];
+    field.segments.swap(segments);
+  }
+
+  // assemble the path
+  std::vector<hmap::Point> points = {};
+
+  for (size_t s = 0; s < keys.size(); s++)
+  {
+    std::vector<hmap::Vec2<int>> &cells = field.segments[keys[s]];
+
+    if (cells.empty())
+    {
+      auto [i0, j0, i1, j1] = keys[s];
+      LOG_ERROR("path finding, no path found between cells (%d, %d) and (%d, "
+                "%d)",
+                i0,
+                j0,
+                i1,
+                j1);
+      continue;
+    }
+
+    // avoid duplicating the junction points between segments
+    size_t k0 = points.empty() ? 0 : 1;
+    size_t k1 = (path.closed && s == keys.size() - 1) ? cells.size() - 1
+                                                       : cells.size();
+
+    for (size_t k = k0; k < k1; k++)
+    {
+      int i = cells[k].x;
+      int j = cells[k].y;
+      points.push_back(
+          hmap::Point(shape.x > 1 ? (float)i / (shape.x - 1) : 0.f,
+                      shape.y > 1 ? (float)j / (shape.y - 1) : 0.f,
+                      z.vector[(size_t)i * shape.y + j]));
+    }
+  }
+
+  path.points = points;
+}
+
+} // namespace hesiod::path_finding
@@ -0,0 +1,547 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include "highmap.hpp"
+#include "macrologger.h"
+
+#include "hesiod/parallel.hpp"
+#include "hesiod/region.hpp"
+
+namespace hesiod::region
+{
+
+hmap::Vec4<float> full()
+{
+  return hmap::Vec4<float>(0.f, 1.f, 0.f, 1.f);
+}
+
+hmap::Vec4<float> empty()
+{
+  return hmap::Vec4<float>(1.f, 0.f, 1.f, 0.f);
+}
+
+bool is_empty(const hmap::Vec4<float> &region)
+{
+  return region.a >= region.b || region.c >= region.d;
+}
+
+bool is_full(const hmap::Vec4<float> &region)
+{
+  return region.a <= 0.f && region.b >= 1.f && region.c <= 0.f &&
+         region.d >= 1.f;
+}
+
+hmap::Vec4<float> merge(const hmap::Vec4<float> &a, const hmap::Vec4<float> &b)
+{
+  if (is_empty(a))
+    return b;
+  if (is_empty(b))
+    return a;
+
+  return hmap::Vec4<float>(std::min(a.a, b.a),
+                           std::max(a.b, b.b),
+                           std::min(a.c, b.c),
+                           std::max(a.d, b.d));
+}
+
+bool intersects(const hmap::Vec4<float> &a, const hmap::Vec4<float> &b)
+{
+  return !is_empty(a) && !is_empty(b) && a.a < b.b && b.a < a.b &&
+         a.c < b.d && b.c < a.d;
+}
+
+bool contains(const hmap::Vec4<float> &a, const hmap::Vec4<float> &b)
+{
+  if (is_empty(b))
+    return true;
+
+  return !is_empty(a) && a.a <= b.a && a.b >= b.b && a.c <= b.c && a.d >= b.d;
+}
+
+hmap::Vec4<float> grow(const hmap::Vec4<float> &region,
+                       const Halo              &halo,
+                       hmap::Vec2<int>          shape)
+{
+  if (is_empty(region))
+    return region;
+
+  if (halo.type == halo_type::global)
+    return full();
+
+  float rx = (float)halo.ir / (float)shape.x;
+  float ry = (float)halo.ir / (float)shape.y;
+
+  return hmap::Vec4<float>(std::max(0.f, region.a - rx),
+                           std::min(1.f, region.b + rx),
+                           std::max(0.f, region.c - ry),
+                           std::min(1.f, region.d + ry));
+}
+
+Halo combine(const Halo &a, const Halo &b)
+{
+  if (a.type == halo_type::global || b.type == halo_type::global)
+    return Halo({halo_type::global, 0});
+
+  int ir = a.ir + b.ir;
+  return Halo({ir > 0 ? halo_type::radius : halo_type::pointwise, ir});
+}
+
+Halo widest(const Halo &a, const Halo &b)
+{
+  if (a.type == halo_type::global || b.type == halo_type::global)
+    return Halo({halo_type::global, 0});
+
+  int ir = std::max(a.ir, b.ir);
+  return Halo({ir > 0 ? halo_type::radius : halo_type::pointwise, ir});
+}
+
+hmap::Vec4<int> to_cells(const hmap::Vec4<float> &region,
+                         hmap::Vec2<int>          shape)
+{
+  return hmap::Vec4<int>(
+      std::clamp((int)std::floor(region.a * shape.x) - 1, 0, shape.x),
+      std::clamp((int)std::ceil(region.b * shape.x) + 1, 0, shape.x),
+      std::clamp((int)std::floor(region.c * shape.y) - 1, 0, shape.y),
+      std::clamp((int)std::ceil(region.d * shape.y) + 1, 0, shape.y));
+}
+
+hmap::Vec4<float> to_region(const hmap::Vec4<int> &cells,
+                            hmap::Vec2<int>        shape)
+{
+  return hmap::Vec4<float>((float)cells.a / shape.x,
+                           (float)cells.b / shape.x,
+                           (float)cells.c / shape.y,
+                           (float)cells.d / shape.y);
+}
+
+// region covering the points of index 'k' of both clouds
+static hmap::Vec4<float> point_region(const hmap::Cloud &before,
+                                      const hmap::Cloud &after,
+                                      size_t             k)
+{
+  float xmin = std::min(before.points[k].x, after.points[k].x);
+  float xmax = std::max(before.points[k].x, after.points[k].x);
+  float ymin = std::min(before.points[k].y, after.points[k].y);
+  float ymax = std::max(before.points[k].y, after.points[k].y);
+
+  // empty regions are not merged, make sure the region has a non-zero size
+  float eps = 1e-6f;
+  return hmap::Vec4<float>(xmin - eps, xmax + eps, ymin - eps, ymax + eps);
+}
+
+static bool point_changed(const hmap::Cloud &before,
+                          const hmap::Cloud &after,
+                          size_t             k)
+{
+  return before.points[k].x != after.points[k].x ||
+         before.points[k].y != after.points[k].y ||
+         before.points[k].v != after.points[k].v;
+}
+
+hmap::Vec4<float> changed_region(const hmap::Cloud &before,
+                                 const hmap::Cloud &after)
+{
+  if (before.get_npoints() != after.get_npoints())
+    return full();
+
+  hmap::Vec4<float> region = empty();
+
+  for (size_t k = 0; k < after.get_npoints(); k++)
+    if (point_changed(before, after, k))
+      region = merge(region, point_region(before, after, k));
+
+  return region;
+}
+
+hmap::Vec4<float> changed_region(const hmap::Path &before,
+                                 const hmap::Path &after)
+{
+  if (before.get_npoints() != after.get_npoints() ||
+      before.closed != after.closed)
+    return full();
+
+  // a point change modifies the two segments sharing the point
+  hmap::Vec4<float> region = empty();
+  size_t            n = after.get_npoints();
+
+  for (size_t k = 0; k < n; k++)
+    if (point_changed(before, after, k))
+    {
+      region = merge(region, point_region(before, after, k));
+
+      if (k > 0 || after.closed)
+        region = merge(region, point_region(before, after, (k + n - 1) % n));
+      if (k < n - 1 || after.closed)
+        region = merge(region, point_region(before, after, (k + 1) % n));
+    }
+
+  return region;
+}
+
+bool tile_range(float shift,
+                float scale,
+                int   n,
+                int   n_global,
+                int  &start,
+                int  &end)
+{
+  double i0 = (double)shift * n_global;
+  if (std::abs(i0 - std::round(i0)) > 1e-3 ||
+      std::abs((double)scale * n_global - n) > 1e-3)
+    return false;
+
+  start = (int)std::lround(i0);
+  end = start + n;
+  return true;
+}
+
+std::vector<int> tiles_in_region(const hmap::HeightMap   &h,
+                                 const hmap::Vec4<float> &region)
+{
+  std::vector<int> tiles = {};
+
+  for (size_t k = 0; k < h.tiles.size(); k++)
+  {
+    const hmap::Tile &tile = h.tiles[k];
+    hmap::Vec4<float> bbox = hmap::Vec4<float>(tile.shift.x,
+                                               tile.shift.x + tile.scale.x,
+                                               tile.shift.y,
+                                               tile.shift.y + tile.scale.y);
+    if (intersects(bbox, region))
+      tiles.push_back((int)k);
+  }
+
+  return tiles;
+}
+
+std::vector<hmap::Vec4<int>> partition(hmap::Vec2<int> shape, int block_size)
+{
+  std::vector<hmap::Vec4<int>> blocks = {};
+
+  int nbx = (shape.x + block_size - 1) / block_size;
+  int nby = (shape.y + block_size - 1) / block_size;
+
+  for (int bj = nby - 1; bj >= 0; bj--)
+    for (int bi = 0; bi < nbx; bi++)
+      blocks.push_back(
+          hmap::Vec4<int>(bi * block_size,
+                          std::min(shape.x, (bi + 1) * block_size),
+                          bj * block_size,
+                          std::min(shape.y, (bj + 1) * block_size)));
+
+  return blocks;
+}
+
+// --- TileLookup
+
+TileLookup::TileLookup(const hmap::HeightMap &h) : p_h(&h)
+{
+  this->ny_tiles = h.tiling.y;
+
+  // partition index of each cell along each direction, a tile owns the cells
+  // of the partition element containing its center
+  this->kx.resize(h.shape.x);
+  this->ky.resize(h.shape.y);
+
+  for (int k = 0; k < h.tiling.x; k++)
+    for (int i = k * h.shape.x / h.tiling.x;
+         i < (k + 1) * h.shape.x / h.tiling.x;
+         i++)
+      this->kx[i] = k;
+
+  for (int k = 0; k < h.tiling.y; k++)
+    for (int j = k * h.shape.y / h.tiling.y;
+         j < (k + 1) * h.shape.y / h.tiling.y;
+         j++)
+      this->ky[j] = k;
+
+  this->tile_of.assign((size_t)h.tiling.x * h.tiling.y, -1);
+  this->ti.resize(h.tiles.size());
+  this->tj.resize(h.tiles.size());
+  this->tpx.resize(h.tiles.size());
+  this->tpy.resize(h.tiles.size());
+
+  for (size_t k = 0; k < h.tiles.size(); k++)
+  {
+    const hmap::Tile &tile = h.tiles[k];
+    int               i0, i1, j0, j1;
+
+    if (!tile_range(tile.shift.x,
+                    tile.scale.x,
+                    tile.shape.x,
+                    h.shape.x,
+                    i0,
+                    i1) ||
+        !tile_range(tile.shift.y,
+                    tile.scale.y,
+                    tile.shape.y,
+                    h.shape.y,
+                    j0,
+                    j1))
+    {
+      this->valid = false;
+      return;
+    }
+
+    int px = this->kx[std::clamp((i0 + i1) / 2, 0, h.shape.x - 1)];
+    int py = this->ky[std::clamp((j0 + j1) / 2, 0, h.shape.y - 1)];
+
+    this->tile_of[(size_t)px * h.tiling.y + py] = (int)k;
+    this->ti[k] = i0;
+    this->tj[k] = j0;
+    this->tpx[k] = px;
+    this->tpy[k] = py;
+  }
+
+  if (std::find(this->tile_of.begin(), this->tile_of.end(), -1) !=
+      this->tile_of.end())
+    this->valid = false;
+}
+
+bool TileLookup::is_valid() const
+{
+  return this->valid;
+}
+
+void TileLookup::get_tile_cells(int              k,
+                                hmap::Vec4<int> &cells,
+                                hmap::Vec2<int> &ij0) const
+{
+  hmap::Vec2<int> shape = this->p_h->shape;
+  hmap::Vec2<int> tiling = this->p_h->tiling;
+
+  cells = hmap::Vec4<int>(this->tpx[k] * shape.x / tiling.x,
+                          (this->tpx[k] + 1) * shape.x / tiling.x,
+                          this->tpy[k] * shape.y / tiling.y,
+                          (this->tpy[k] + 1) * shape.y / tiling.y);
+  ij0 = hmap::Vec2<int>(this->ti[k], this->tj[k]);
+}
+
+void blit_heightmap(const hmap::HeightMap &h, float *data)
+{
+  TileLookup lookup = TileLookup(h);
+
+  if (!lookup.is_valid())
+  {
+    LOG_DEBUG("tiles not aligned, heightmap gathered before copying");
+    hmap::Array array = hmap::HeightMap(h).to_array();
+    std::memcpy(data, array.vector.data(), sizeof(float) * array.vector.size());
+    return;
+  }
+
+  int ny = h.shape.y;
+
+  hesiod::parallel_for(
+      (int)h.tiles.size(),
+      [&h, &lookup, data, ny](int k0, int k1)
+      {
+        for (int k = k0; k < k1; k++)
+        {
+          const hmap::Tile &tile = h.tiles[k];
+          hmap::Vec4<int>   cells;
+          hmap::Vec2<int>   ij0;
+
+          lookup.get_tile_cells(k, cells, ij0);
+
+          // one contiguous run of the tile per i index
+          for (int i = cells.a; i < cells.b; i++)
+            std::memcpy(data + (size_t)i * ny + cells.c,
+                        tile.vector.data() +
+                            (size_t)(i - ij0.x) * tile.shape.y + cells.c -
+                            ij0.y,
+                        sizeof(float) * (cells.d - cells.c));
+        }
+      });
+}
+
+// --- extraction / insertion
+
+bool tile_extent(const hmap::Tile &tile,
+                 hmap::Vec2<int>   shape,
+                 hmap::Vec4<int>  &extent)
+{
+  int i0, i1, j0, j1;
+
+  if (!tile_range(tile.shift.x, tile.scale.x, tile.shape.x, shape.x, i0, i1) ||
+      !tile_range(tile.shift.y, tile.scale.y, tile.shape.y, shape.y, j0, j1))
+    return false;
+
+  extent = hmap::Vec4<int>(i0, i1, j0, j1);
+  return true;
+}
+
+// tile of 'h' with the same position and shape as the tile of a block of
+// tiles of extent 'extent', -1 if none (cut tile)
+static int matching_tile(const hmap::HeightMap &h,
+                         const TileLookup      &lookup,
+                         const hmap::Tile      &tile_sub,
+                         const hmap::Vec4<int> &extent)
+{
+  int k = lookup.get_tile((extent.a + extent.b) / 2, (extent.c + extent.d) / 2);
+
+  hmap::Vec4<int> extent_k;
+
+  if (h.tiles[k].shape != tile_sub.shape ||
+      !tile_extent(h.tiles[k], h.shape, extent_k) || extent_k.a != extent.a ||
+      extent_k.c != extent.c)
+    return -1;
+
+  return k;
+}
+
+bool extract_tiles(const hmap::HeightMap &h,
+                   const hmap::Vec4<int> &block,
+                   hmap::HeightMap       &h_sub)
+{
+  TileLookup lookup = TileLookup(h);
+  if (!lookup.is_valid() || h.shape.x % h.tiling.x != 0 ||
+      h.shape.y % h.tiling.y != 0)
+    return false;
+
+  hmap::Vec2<int> tile_cells = {h.shape.x / h.tiling.x,
+                                h.shape.y / h.tiling.y};
+  hmap::Vec4<int> cells = {block.a * tile_cells.x,
+                           block.b * tile_cells.x,
+                           block.c * tile_cells.y,
+                           block.d * tile_cells.y};
+
+  h_sub.set_sto(hmap::Vec2<int>(cells.b - cells.a, cells.d - cells.c),
+                hmap::Vec2<int>(block.b - block.a, block.d - block.c),
+                h.overlap);
+  remap_domain(h_sub, full(), to_region(cells, h.shape));
+
+  for (auto &tile : h_sub.tiles)
+  {
+    hmap::Vec4<int> extent;
+    if (!tile_extent(tile, h.shape, extent))
+      return false;
+
+    int k = matching_tile(h, lookup, tile, extent);
+
+    if (k >= 0)
+    {
+      tile.vector = h.tiles[k].vector;
+      tile.shift = h.tiles[k].shift;
+      tile.scale = h.tiles[k].scale;
+      tile.bbox = h.tiles[k].bbox;
+    }
+    else
+      for (int i = extent.a; i < extent.b; i++)
+        for (int j = extent.c; j < extent.d; j++)
+          tile(i - extent.a, j - extent.c) = lookup.get(i, j);
+  }
+
+  return true;
+}
+
+void paste_tiles(hmap::HeightMap       &h,
+                 const hmap::HeightMap &h_sub,
+                 const hmap::Vec4<int> &cells)
+{
+  TileLookup lookup = TileLookup(h);
+  if (!lookup.is_valid())
+  {
+    LOG_ERROR("tiles not aligned with the global grid");
+    throw std::runtime_error("tiles not aligned with the global grid");
+  }
+
+  for (auto &tile_sub : h_sub.tiles)
+  {
+    hmap::Vec4<int> extent;
+    if (!tile_extent(tile_sub, h.shape, extent))
+      continue;
+
+    int k = matching_tile(h, lookup, tile_sub, extent);
+    if (k < 0)
+      continue;
+
+    hmap::Tile &tile = h.tiles[k];
+
+    int ia = std::max(extent.a, cells.a);
+    int ib = std::min(extent.b, cells.b);
+    int ja = std::max(extent.c, cells.c);
+    int jb = std::min(extent.d, cells.d);
+
+    for (int i = ia; i < ib; i++)
+      for (int j = ja; j < jb; j++)
+        tile(i - extent.a, j - extent.c) = tile_sub(i - extent.a,
+                                                    j - extent.c);
+  }
+}
+
+// --- domain mapping
+
+void remap_domain(hmap::HeightMap         &h,
+                  const hmap::Vec4<float> &from,
+                  const hmap::Vec4<float> &to)
+{
+  float sx = (to.b - to.a) / (from.b - from.a);
+  float sy = (to.d - to.c) / (from.d - from.c);
+
+  auto map_x = [&](float x) { return to.a + (x - from.a) * sx; };
+  auto map_y = [&](float y) { return to.c + (y - from.c) * sy; };
+
+  for (auto &tile : h.tiles)
+  {
+    tile.shift = {map_x(tile.shift.x), map_y(tile.shift.y)};
+    tile.scale = {tile.scale.x * sx, tile.scale.y * sy};
+    tile.bbox = hmap::Vec4<float>(map_x(tile.bbox.a),
+                                  map_x(tile.bbox.b),
+                                  map_y(tile.bbox.c),
+                                  map_y(tile.bbox.d));
+  }
+}
+
+void resample(const hmap::HeightMap &h_src, hmap::HeightMap &h_dst)
+{
+  // random access to the source cells, through the tiles when possible
+  TileLookup  lookup = TileLookup(h_src);
+  hmap::Array array;
+
+  if (!lookup.is_valid())
+    array = const_cast<hmap::HeightMap &>(h_src).to_array();
+
+  auto get = [&lookup, &array](int i, int j)
+  { return array.vector.empty() ? lookup.get(i, j) : array(i, j); };
+
+  hmap::Vec2<int> shape = h_src.shape;
+
+  parallel_for(
+      (int)h_dst.tiles.size(),
+      [&](int k_start, int k_end)
+      {
+        for (int k = k_start; k < k_end; k++)
+        {
+          hmap::Tile &tile = h_dst.tiles[k];
+
+          for (int i = 0; i < tile.shape.x; i++)
+          {
+            float x = tile.shift.x + tile.scale.x * i / tile.shape.x;
+            float fx = std::clamp(x * shape.x, 0.f, (float)(shape.x - 1));
+            int   i0 = std::min((int)fx, shape.x - 1);
+            int   i1 = std::min(i0 + 1, shape.x - 1);
+            float u = fx - i0;
+
+            for (int j = 0; j < tile.shape.y; j++)
+            {
+              float y = tile.shift.y + tile.scale.y * j / tile.shape.y;
+              float fy = std::clamp(y * shape.y, 0.f, (float)(shape.y - 1));
+              int   j0 = std::min((int)fy, shape.y - 1);
+              int   j1 = std::min(j0 + 1, shape.y - 1);
+              float v = fy - j0;
+
+              tile(i, j) = (1.f - u) * ((1.f - v) * get(i0, j0) +
+                                        v * get(i0, j1)) +
+                           u * ((1.f - v) * get(i1, j0) + v * get(i1, j1));
+            }
+          }
+        }
+      });
+}
+
+} // namespace hesiod::region
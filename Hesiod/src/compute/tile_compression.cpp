@@ -0,0 +1,269 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include <zlib.h>
+
+#include "macrologger.h"
+
+#include "hesiod/parallel.hpp"
+#include "hesiod/tile_compression.hpp"
+
+namespace hesiod::io
+{
+
+CompressedArray compress_array(const hmap::Array &array, float max_error)
+{
+  CompressedArray compressed;
+  compressed.shape = array.shape;
+  compressed.lossy = max_error > 0.f;
+
+  size_t                n = array.vector.size();
+  std::vector<uint32_t> words(n);
+
+  if (compressed.lossy)
+  {
+    // quantization, values reconstructed within half a step (slightly
+    // reduced to absorb the float rounding of the reconstruction)
+    compressed.vmin = n > 0 ? array.min() : 0.f;
+    compressed.step = 1.998f * max_error;
+
+    for (size_t k = 0; k < n; k++)
+      words[k] = (uint32_t)std::clamp(
+          std::llround((array.vector[k] - compressed.vmin) / compressed.step),
+          0LL,
+          (long long)UINT32_MAX);
+  }
+  else
+    std::memcpy(words.data(), array.vector.data(), sizeof(float) * n);
+
+  // XOR with the previous value (lossless) or delta (lossy), then byte planes
+  std::vector<uint8_t> planes(4 * n);
+  uint32_t             previous = 0;
+
+  for (size_t k = 0; k < n; k++)
+  {
+    uint32_t r = compressed.lossy ? words[k] - previous : words[k] ^ previous;
+    previous = words[k];
+
+    for (size_t b = 0; b < 4; b++)
+      planes[b * n + k] = (uint8_t)(r >> (8 * b));
+  }
+
+  uLongf size = compressBound((uLong)planes.size());
+  compressed.data.resize(size);
+
+  if (compress2(compressed.data.data(),
+                &size,
+                planes.data(),
+                (uLong)planes.size(),
+                TILE_COMPRESSION_LEVEL) != Z_OK)
+  {
+    LOG_ERROR("tile compression failed");
+    throw std::runtime_error("tile compression failed");
+  }
+
+  compressed.data.resize(size);
+  compressed.data.shrink_to_fit();
+
+  return compressed;
+}
+
+void decompress_array(const CompressedArray &compressed, hmap::Array &array)
+{
+  size_t n = (size_t)compressed.shape.x * compressed.shape.y;
+
+  std::vector<uint8_t> planes(4 * n);
+  uLongf               size = (uLongf)planes.size();
+
+  if (uncompress(planes.data(),
+                 &size,
+                 compressed.data.data(),
+                 (uLong)compressed.data.size()) != Z_OK ||
+      size != planes.size())
+  {
+    LOG_ERROR("tile decompression failed");
+    throw std::runtime_error("tile decompression failed");
+  }
+
+  array.shape = compressed.shape;
+  array.vector.resize(n);
+
+  uint32_t previous = 0;
+
+  for (size_t k = 0; k < n; k++)
+  {
+    uint32_t r = 0;
+    for (size_t b = 0; b < 4; b++)
+      r |= (uint32_t)planes[b * n + k] << (8 * b);
+
+    uint32_t word = compressed.lossy ? previous + r : previous ^ r;
+    previous = word;
+
+    if (compressed.lossy)
+      array.vector[k] = compressed.vmin + (float)word * compressed.step;
+    else
+      std::memcpy(&array.vector[k], &word, sizeof(float));
+  }
+}
+
+// --- TileStore
+
+TileStore &TileStore::get_instance()
+{
+  static TileStore instance;
+  return instance;
+}
+
+bool TileStore::compress(hmap::HeightMap *p_h, float max_error)
+{
+  if (!p_h || p_h->tiles.empty() || this->is_compressed(p_h))
+    return false;
+
+  std::vector<CompressedArray> compressed(p_h->tiles.size());
+
+  hesiod::parallel_for(
+      (int)p_h->tiles.size(),
+      [p_h, &compressed, max_error](int k0, int k1)
+      {
+        for (int k = k0; k < k1; k++)
+          compressed[k] = compress_array(p_h->tiles[k], max_error);
+      });
+
+  // tile buffers released, shapes and positions kept
+  for (auto &tile : p_h->tiles)
+    std::vector<float>().swap(tile.vector);
+
+  const std::lock_guard<std::mutex> lock(this->mutex);
+  this->tiles[p_h] = std::move(compressed);
+
+  if (max_error > 0.f)
+    this->lossy.insert(p_h);
+
+  return true;
+}
+
+void TileStore::ensure(hmap::HeightMap *p_h)
+{
+  if (!p_h)
+    return;
+
+  std::vector<CompressedArray> compressed = {};
+
+  {
+    const std::lock_guard<std::mutex> lock(this->mutex);
+
+    this->access[p_h] = std::chrono::steady_clock::now();
+
+    auto it = this->tiles.find(p_h);
+    if (it == this->tiles.end())
+      return;
+
+    compressed = std::move(it->second);
+    this->tiles.erase(it);
+  }
+
+  // storage changed in the meantime (new tiling), the data are obsolete
+  if (compressed.size() != p_h->tiles.size())
+  {
+    LOG_DEBUG("compressed tiles discarded, storage changed");
+    return;
+  }
+
+  hesiod::parallel_for((int)p_h->tiles.size(),
+                       [p_h, &compressed](int k0, int k1)
+                       {
+                         for (int k = k0; k < k1; k++)
+                           decompress_array(compressed[k], p_h->tiles[k]);
+                       });
+}
+
+void TileStore::ensure_all()
+{
+  std::vector<hmap::HeightMap *> p_hs = {};
+
+  {
+    const std::lock_guard<std::mutex> lock(this->mutex);
+    for (auto &[p_h, compressed] : this->tiles)
+      p_hs.push_back((hmap::HeightMap *)p_h);
+  }
+
+  for (auto p_h : p_hs)
+    this->ensure(p_h);
+}
+
+void TileStore::touch(const hmap::HeightMap *p_h)
+{
+  const std::lock_guard<std::mutex> lock(this->mutex);
+  this->access[p_h] = std::chrono::steady_clock::now();
+}
+
+float TileStore::get_idle_time(const hmap::HeightMap *p_h)
+{
+  const std::lock_guard<std::mutex> lock(this->mutex);
+
+  auto now = std::chrono::steady_clock::now();
+  auto it = this->access.find(p_h);
+
+  if (it == this->access.end())
+  {
+    this->access[p_h] = now;
+    return 0.f;
+  }
+
+  return 1e-3f *
+         (float)std::chrono::duration_cast<std::chrono::microseconds>(
+             now - it->second)
+             .count();
+}
+
+bool TileStore::is_compressed(const hmap::HeightMap *p_h)
+{
+  const std::lock_guard<std::mutex> lock(this->mutex);
+  return this->tiles.contains(p_h);
+}
+
+bool TileStore::is_lossy(const hmap::HeightMap *p_h)
+{
+  const std::lock_guard<std::mutex> lock(this->mutex);
+  return this->lossy.contains(p_h);
+}
+
+void TileStore::set_lossy(const hmap::HeightMap *p_h, bool lossy)
+{
+  const std::lock_guard<std::mutex> lock(this->mutex);
+
+  if (lossy)
+    this->lossy.insert(p_h);
+  else
+    this->lossy.erase(p_h);
+}
+
+void TileStore::forget(const hmap::HeightMap *p_h)
+{
+  const std::lock_guard<std::mutex> lock(this->mutex);
+  this->tiles.erase(p_h);
+  this->access.erase(p_h);
+  this->lossy.erase(p_h);
+}
+
+void TileStore::get_memory_usage(size_t &compressed_bytes, size_t &raw_bytes)
+{
+  const std::lock_guard<std::mutex> lock(this->mutex);
+
+  compressed_bytes = 0;
+  raw_bytes = 0;
+
+  for (auto &[p_h, compressed] : this->tiles)
+    for (auto &array : compressed)
+    {
+      compressed_bytes += array.data.size();
+      raw_bytes += sizeof(float) * array.shape.x * array.shape.y;
+    }
+}
+
+} // namespace hesiod::io
@@ -17,7 +17,10 @@ void glfw_error_callback(int error, const char *description)
   std::cout << "GLFW Error " << error << " " << description << std::endl;
 }
 
-GLFWwindow *init_gui(int width, int height, std::string window_title)
+GLFWwindow *init_gui(int         width,
+                     int         height,
+                     std::string window_title,
+                     bool        visible)
 {
   glfwSetErrorCallback(glfw_error_callback);
   if (!glfwInit())
@@ -46,6 +49,8 @@ GLFWwindow *init_gui(int width, int height, std::string window_title)
   // only glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // 3.0+ only
 #endif
 
+  glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
+
   GLFWwindow *window =
       glfwCreateWindow(width, height, window_title.c_str(), nullptr, nullptr);
   glfwMakeContextCurrent(window);
@@ -76,6 +81,29 @@ GLFWwindow *init_gui(int width, int height, std::string window_title)
   return window;
 }
 
+void request_redraw()
+{
+  glfwPostEmptyEvent();
+}
+
+void wait_events(bool animated)
+{
+  // frames remaining before going idle
+  static int frames_left = GUI_IDLE_FRAMES;
+
+  if (animated || frames_left > 0)
+  {
+    glfwPollEvents();
+    frames_left = animated ? GUI_IDLE_FRAMES : frames_left - 1;
+  }
+  else
+  {
+    // any event (or the timeout) triggers a few frames
+    glfwWaitEventsTimeout(GUI_IDLE_TIMEOUT);
+    frames_left = GUI_IDLE_FRAMES - 1;
+  }
+}
+
 void flip_vertically(int width, int height, uint8_t *data)
 {
   char rgb[3];
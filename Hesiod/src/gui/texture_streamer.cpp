@@ -0,0 +1,264 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+#include <algorithm>
+
+#include <GL/glew.h>
+
+#include "macrologger.h"
+
+#include "hesiod/texture_streamer.hpp"
+
+namespace hesiod::viewer
+{
+
+void TextureStreamer::init()
+{
+  // persistent mapping requires immutable buffer storage and fences to know
+  // when the GPU is done reading a buffer
+  this->persistent = GLEW_ARB_buffer_storage && GLEW_ARB_sync;
+  this->initialized = true;
+
+  LOG_DEBUG("texture streamer, persistent mapping: %d", this->persistent);
+}
+
+void TextureStreamer::allocate(Slot &slot, size_t nbytes)
+{
+  if (slot.pbo == 0)
+    glGenBuffers(1, &slot.pbo);
+
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+
+  if (this->persistent)
+  {
+    if (slot.capacity < nbytes)
+    {
+      // immutable storage, the buffer is recreated
+      if (slot.ptr)
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+      glDeleteBuffers(1, &slot.pbo);
+
+      glGenBuffers(1, &slot.pbo);
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+
+      GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT |
+                         GL_MAP_COHERENT_BIT;
+      glBufferStorage(GL_PIXEL_UNPACK_BUFFER, nbytes, nullptr, flags);
+      slot.ptr = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, nbytes, flags);
+      slot.capacity = nbytes;
+    }
+  }
+  else
+  {
+    // orphan the previous storage and map the new one
+    if (slot.ptr)
+      glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    if (slot.capacity < nbytes)
+      slot.capacity = nbytes;
+
+    glBufferData(GL_PIXEL_UNPACK_BUFFER,
+                 slot.capacity,
+                 nullptr,
+                 GL_STREAM_DRAW);
+    slot.ptr = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER,
+                                0,
+                                slot.capacity,
+                                GL_MAP_WRITE_BIT |
+                                    GL_MAP_INVALIDATE_BUFFER_BIT);
+  }
+
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+int TextureStreamer::acquire(size_t nbytes)
+{
+  const std::lock_guard<std::mutex> lock(this->mutex);
+
+  if (!this->initialized)
+    this->init();
+
+  this->recycle();
+
+  // prefer a free slot large enough, then any free slot, then a new one
+  int k_free = -1;
+
+  for (size_t k = 0; k < this->slots.size(); k++)
+    if (this->slots[k].state == slot_state::free)
+    {
+      if (this->slots[k].capacity >= nbytes)
+      {
+        k_free = (int)k;
+        break;
+      }
+      if (k_free < 0)
+        k_free = (int)k;
+    }
+
+  if (k_free < 0)
+  {
+    if (this->slots.size() >= TEXTURE_STREAMER_SLOTS)
+      return -1;
+
+    this->slots.push_back(Slot());
+    k_free = (int)this->slots.size() - 1;
+  }
+
+  Slot &slot = this->slots[k_free];
+  this->allocate(slot, nbytes);
+
+  if (!slot.ptr)
+  {
+    LOG_ERROR("pixel buffer mapping failed");
+    return -1;
+  }
+
+  slot.nbytes = nbytes;
+  slot.state = slot_state::writing;
+  return k_free;
+}
+
+void *TextureStreamer::get_ptr(int slot)
+{
+  const std::lock_guard<std::mutex> lock(this->mutex);
+  return this->slots[slot].ptr;
+}
+
+void TextureStreamer::commit(int                   slot,
+                             const void           *owner,
+                             std::function<void()> upload_fct)
+{
+  const std::lock_guard<std::mutex> lock(this->mutex);
+
+  Slot &s = this->slots[slot];
+  s.owner = owner;
+  s.upload_fct = upload_fct;
+  s.order = this->order_count++;
+  s.state = slot_state::ready;
+}
+
+void TextureStreamer::release(int slot)
+{
+  const std::lock_guard<std::mutex> lock(this->mutex);
+
+  // non-persistent buffers stay mapped until their next allocation
+  Slot &s = this->slots[slot];
+  s.owner = nullptr;
+  s.upload_fct = nullptr;
+  s.state = slot_state::free;
+}
+
+void TextureStreamer::cancel(const void *owner)
+{
+  const std::lock_guard<std::mutex> lock(this->mutex);
+
+  for (auto &s : this->slots)
+    if (s.state == slot_state::ready && (!owner || s.owner == owner))
+    {
+      s.owner = nullptr;
+      s.upload_fct = nullptr;
+      s.state = slot_state::free;
+    }
+}
+
+void TextureStreamer::process(size_t max_bytes)
+{
+  const std::lock_guard<std::mutex> lock(this->mutex);
+
+  if (!this->initialized)
+    return;
+
+  this->recycle();
+
+  std::vector<Slot *> ready = {};
+  for (auto &s : this->slots)
+    if (s.state == slot_state::ready)
+      ready.push_back(&s);
+
+  std::sort(ready.begin(),
+            ready.end(),
+            [](const Slot *a, const Slot *b) { return a->order < b->order; });
+
+  size_t nbytes = 0;
+
+  for (auto p_slot : ready)
+  {
+    if (nbytes > 0 && nbytes + p_slot->nbytes > max_bytes)
+      break;
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, p_slot->pbo);
+
+    if (!this->persistent)
+    {
+      glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+      p_slot->ptr = nullptr;
+    }
+
+    // the upload function reads the data from the bound buffer
+    if (p_slot->upload_fct)
+      p_slot->upload_fct();
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (GLEW_ARB_sync)
+      p_slot->fence = (void *)glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    p_slot->owner = nullptr;
+    p_slot->upload_fct = nullptr;
+    p_slot->state = p_slot->fence ? slot_state::in_flight : slot_state::free;
+
+    nbytes += p_slot->nbytes;
+  }
+}
+
+void TextureStreamer::recycle()
+{
+  for (auto &s : this->slots)
+    if (s.state == slot_state::in_flight)
+    {
+      GLenum status = glClientWaitSync((GLsync)s.fence, 0, 0);
+
+      if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+      {
+        glDeleteSync((GLsync)s.fence);
+        s.fence = nullptr;
+        s.state = slot_state::free;
+      }
+    }
+}
+
+bool TextureStreamer::has_pending()
+{
+  const std::lock_guard<std::mutex> lock(this->mutex);
+
+  for (auto &s : this->slots)
+    if (s.state == slot_state::ready)
+      return true;
+  return false;
+}
+
+void TextureStreamer::clear()
+{
+  const std::lock_guard<std::mutex> lock(this->mutex);
+
+  for (auto &s : this->slots)
+  {
+    if (s.fence)
+      glDeleteSync((GLsync)s.fence);
+
+    if (s.ptr)
+    {
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, s.pbo);
+      glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glDeleteBuffers(1, &s.pbo);
+  }
+
+  this->slots.clear();
+  this->initialized = false;
+}
+
+} // namespace hesiod::viewer
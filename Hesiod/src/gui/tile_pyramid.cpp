@@ -0,0 +1,422 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+
+#include "highmap.hpp"
+#include "macrologger.h"
+
+#include "hesiod/parallel.hpp"
+#include "hesiod/region.hpp"
+#include "hesiod/tile_pyramid.hpp"
+
+namespace hesiod::viewer
+{
+
+void TilePyramid::build(hmap::HeightMap &h)
+{
+  this->clear();
+
+  auto p_lookup = std::make_unique<hesiod::region::TileLookup>(h);
+
+  if (p_lookup->is_valid())
+  {
+    // each cell is read from the tile owning it when needed, the level only
+    // holds its shape
+    hmap::Array a0;
+    a0.shape = h.shape;
+
+    this->p_h = &h;
+    this->p_lookup = std::move(p_lookup);
+    this->levels.push_back(std::move(a0));
+  }
+  else
+  {
+    // fallback on the (interpolating) heightmap method for tiles that are
+    // not aligned with the global grid
+    LOG_DEBUG("tiles not aligned with the global grid, using interpolation");
+    this->levels.push_back(h.to_array());
+  }
+
+  this->build_levels();
+}
+
+void TilePyramid::build(const hmap::Array &array)
+{
+  this->clear();
+  this->levels.push_back(array);
+  this->build_levels();
+}
+
+float TilePyramid::get_value(int level, int i, int j) const
+{
+  if (level == 0 && this->p_lookup)
+    return this->p_lookup->get(i, j);
+
+  return this->levels[level](i, j);
+}
+
+void TilePyramid::build_levels()
+{
+  const hmap::Array &a0 = this->levels.front();
+
+  if (a0.shape.x <= 0 || a0.shape.y <= 0 ||
+      (!this->p_lookup && a0.vector.empty()))
+  {
+    this->clear();
+    return;
+  }
+
+  if (this->p_lookup)
+  {
+    this->range = {std::numeric_limits<float>::max(),
+                   -std::numeric_limits<float>::max()};
+
+    for (auto &tile : this->p_h->tiles)
+    {
+      auto [vmin, vmax] = std::minmax_element(tile.vector.begin(),
+                                              tile.vector.end());
+      this->range.x = std::min(this->range.x, *vmin);
+      this->range.y = std::max(this->range.y, *vmax);
+    }
+  }
+  else
+  {
+    auto [vmin, vmax] = std::minmax_element(a0.vector.begin(),
+                                            a0.vector.end());
+    this->range = {*vmin, *vmax};
+  }
+
+  // 2 x 2 box average down to a single page, odd sizes are handled by
+  // clamping the source indices
+  while (std::max(this->levels.back().shape.x, this->levels.back().shape.y) >
+         TILE_PYRAMID_PAGE_SIZE)
+  {
+    const hmap::Array &src = this->levels.back();
+    hmap::Vec2<int>    shape = {(src.shape.x + 1) / 2, (src.shape.y + 1) / 2};
+
+    this->levels.push_back(hmap::Array(shape));
+    this->downsample_level(this->get_nlevels() - 1, 0, shape.x, 0, shape.y);
+  }
+}
+
+void TilePyramid::downsample_level(int level, int i0, int i1, int j0, int j1)
+{
+  hmap::Vec2<int> shape_src = this->get_shape(level - 1);
+  hmap::Array    &dst = this->levels[level];
+
+  // native resolution read from the tiles
+  if (level == 1 && this->p_lookup)
+  {
+    const hesiod::region::TileLookup &lookup = *this->p_lookup;
+
+    parallel_for(
+        i1 - i0,
+        [&](int k_start, int k_end)
+        {
+          for (int i = i0 + k_start; i < i0 + k_end; i++)
+          {
+            int ia = 2 * i;
+            int ib = std::min(2 * i + 1, shape_src.x - 1);
+
+            for (int j = j0; j < j1; j++)
+            {
+              int ja = 2 * j;
+              int jb = std::min(2 * j + 1, shape_src.y - 1);
+              dst(i, j) = 0.25f * (lookup.get(ia, ja) + lookup.get(ia, jb) +
+                                   lookup.get(ib, ja) + lookup.get(ib, jb));
+            }
+          }
+        });
+    return;
+  }
+
+  const hmap::Array &src = this->levels[level - 1];
+
+  parallel_for(
+      i1 - i0,
+      [&](int k_start, int k_end)
+      {
+        for (int i = i0 + k_start; i < i0 + k_end; i++)
+        {
+          const float *r0 = &src.vector[(size_t)(2 * i) * src.shape.y];
+          const float *r1 = &src.vector[(size_t)std::min(2 * i + 1,
+                                                         src.shape.x - 1) *
+                                        src.shape.y];
+          float       *out = &dst.vector[(size_t)i * dst.shape.y];
+
+          for (int j = j0; j < j1; j++)
+          {
+            int ja = 2 * j;
+            int jb = std::min(2 * j + 1, src.shape.y - 1);
+            out[j] = 0.25f * (r0[ja] + r0[jb] + r1[ja] + r1[jb]);
+          }
+        }
+      });
+}
+
+bool TilePyramid::update(hmap::HeightMap &h, const hmap::Vec4<float> &region)
+{
+  if (this->is_empty() || h.shape != this->get_shape(0))
+    return false;
+
+  // level 0 read from the tiles of another heightmap
+  if (this->p_lookup && &h != this->p_h)
+    return false;
+
+  if (hesiod::region::is_empty(region))
+    return true;
+
+  auto p_lookup = std::make_unique<hesiod::region::TileLookup>(h);
+  if (!p_lookup->is_valid())
+    return false;
+
+  // native resolution, only the value range needs to be updated if it is read
+  // from the tiles (the tiles may have been reallocated, the lookup is
+  // rebuilt)
+  hmap::Vec4<int> cells = hesiod::region::to_cells(region, h.shape);
+
+  for (int i = cells.a; i < cells.b; i++)
+    for (int j = cells.c; j < cells.d; j++)
+    {
+      float v = p_lookup->get(i, j);
+      if (!this->p_lookup)
+        this->levels.front()(i, j) = v;
+      this->range.x = std::min(this->range.x, v);
+      this->range.y = std::max(this->range.y, v);
+    }
+
+  if (this->p_lookup)
+    this->p_lookup = std::move(p_lookup);
+
+  // coarser levels, the cell range is halved at each level
+  for (int level = 1; level < this->get_nlevels(); level++)
+  {
+    hmap::Vec2<int> shape = this->get_shape(level);
+
+    cells = hmap::Vec4<int>(cells.a / 2,
+                            std::min((cells.b + 1) / 2, shape.x),
+                            cells.c / 2,
+                            std::min((cells.d + 1) / 2, shape.y));
+
+    this->downsample_level(level, cells.a, cells.b, cells.c, cells.d);
+  }
+
+  return true;
+}
+
+void TilePyramid::clear()
+{
+  this->levels.clear();
+  this->range = {0.f, 0.f};
+  this->p_h = nullptr;
+  this->p_lookup = nullptr;
+}
+
+bool TilePyramid::is_empty() const
+{
+  return this->levels.empty();
+}
+
+int TilePyramid::get_nlevels() const
+{
+  return (int)this->levels.size();
+}
+
+hmap::Vec2<int> TilePyramid::get_shape(int level) const
+{
+  return this->levels[level].shape;
+}
+
+hmap::Vec2<int> TilePyramid::get_npages(int level) const
+{
+  hmap::Vec2<int> shape = this->get_shape(level);
+  return {(shape.x + TILE_PYRAMID_PAGE_SIZE - 1) / TILE_PYRAMID_PAGE_SIZE,
+          (shape.y + TILE_PYRAMID_PAGE_SIZE - 1) / TILE_PYRAMID_PAGE_SIZE};
+}
+
+hmap::Vec2<float> TilePyramid::get_range() const
+{
+  return this->range;
+}
+
+int TilePyramid::select_level(hmap::Vec2<float> pixels) const
+{
+  if (this->is_empty())
+    return 0;
+
+  hmap::Vec2<int> shape = this->get_shape(0);
+  float ratio = std::min((float)shape.x / std::max(pixels.x, 1.f),
+                         (float)shape.y / std::max(pixels.y, 1.f));
+
+  int level = ratio > 1.f ? (int)std::floor(std::log2(ratio)) : 0;
+  return std::clamp(level, 0, this->get_nlevels() - 1);
+}
+
+std::vector<PageKey> TilePyramid::visible_pages(int   level,
+                                                float xmin,
+                                                float xmax,
+                                                float ymin,
+                                                float ymax) const
+{
+  std::vector<PageKey> keys = {};
+  hmap::Vec2<int>      shape = this->get_shape(level);
+  hmap::Vec2<int>      npages = this->get_npages(level);
+
+  auto page_range = [](float vmin, float vmax, int n, int np, int &p0, int &p1)
+  {
+    p0 = std::clamp((int)std::floor(vmin * n) / TILE_PYRAMID_PAGE_SIZE,
+                    0,
+                    np - 1);
+    p1 = std::clamp(((int)std::ceil(vmax * n) - 1) / TILE_PYRAMID_PAGE_SIZE,
+                    0,
+                    np - 1);
+  };
+
+  if (xmax <= 0.f || xmin >= 1.f || ymax <= 0.f || ymin >= 1.f)
+    return keys;
+
+  int pi0, pi1, pj0, pj1;
+  page_range(xmin, xmax, shape.x, npages.x, pi0, pi1);
+  page_range(ymin, ymax, shape.y, npages.y, pj0, pj1);
+
+  for (int pi = pi0; pi <= pi1; pi++)
+    for (int pj = pj0; pj <= pj1; pj++)
+      keys.push_back({level, pi, pj});
+
+  return keys;
+}
+
+hmap::Vec4<float> TilePyramid::get_page_bbox(const PageKey &key) const
+{
+  hmap::Vec2<int> shape = this->get_shape(key[0]);
+
+  int i0 = key[1] * TILE_PYRAMID_PAGE_SIZE;
+  int j0 = key[2] * TILE_PYRAMID_PAGE_SIZE;
+  int i1 = std::min(i0 + TILE_PYRAMID_PAGE_SIZE, shape.x);
+  int j1 = std::min(j0 + TILE_PYRAMID_PAGE_SIZE, shape.y);
+
+  return hmap::Vec4<float>((float)i0 / shape.x,
+                           (float)i1 / shape.x,
+                           (float)j0 / shape.y,
+                           (float)j1 / shape.y);
+}
+
+hmap::Array TilePyramid::get_page(const PageKey &key) const
+{
+  hmap::Vec2<int> shape = this->get_shape(key[0]);
+
+  int i0 = key[1] * TILE_PYRAMID_PAGE_SIZE;
+  int j0 = key[2] * TILE_PYRAMID_PAGE_SIZE;
+  int ni = std::min(TILE_PYRAMID_PAGE_SIZE, shape.x - i0);
+  int nj = std::min(TILE_PYRAMID_PAGE_SIZE, shape.y - j0);
+
+  hmap::Array page = hmap::Array(hmap::Vec2<int>(ni + 2, nj + 2));
+
+  for (int p = 0; p < ni + 2; p++)
+  {
+    int i = std::clamp(i0 + p - 1, 0, shape.x - 1);
+    for (int q = 0; q < nj + 2; q++)
+    {
+      int j = std::clamp(j0 + q - 1, 0, shape.y - 1);
+      page(p, q) = this->get_value(key[0], i, j);
+    }
+  }
+
+  return page;
+}
+
+hmap::Vec4<int> TilePyramid::get_page_cells(
+    const PageKey           &key,
+    const hmap::Vec4<float> &region) const
+{
+  hmap::Vec2<int> shape = this->get_shape(key[0]);
+  hmap::Vec4<int> cells = hesiod::region::to_cells(region, shape);
+
+  // page origin, border included
+  int i0 = key[1] * TILE_PYRAMID_PAGE_SIZE - 1;
+  int j0 = key[2] * TILE_PYRAMID_PAGE_SIZE - 1;
+  int ni = std::min(TILE_PYRAMID_PAGE_SIZE, shape.x - i0 - 1) + 2;
+  int nj = std::min(TILE_PYRAMID_PAGE_SIZE, shape.y - j0 - 1) + 2;
+
+  // clamped borders are included at the domain boundaries
+  if (cells.a == 0)
+    cells.a = -1;
+  if (cells.b == shape.x)
+    cells.b = shape.x + 1;
+  if (cells.c == 0)
+    cells.c = -1;
+  if (cells.d == shape.y)
+    cells.d = shape.y + 1;
+
+  return hmap::Vec4<int>(std::clamp(cells.a - i0, 0, ni),
+                         std::clamp(cells.b - i0, 0, ni),
+                         std::clamp(cells.c - j0, 0, nj),
+                         std::clamp(cells.d - j0, 0, nj));
+}
+
+// average of the samples of 'fct(i, j)' over the footprint of each output
+// cell
+static hmap::Array box_filter(hmap::Vec2<int>                shape_in,
+                              hmap::Vec2<int>                shape,
+                              std::function<float(int, int)> fct)
+{
+  hmap::Array out = hmap::Array(shape);
+
+  // sample indices along one direction, for each output index
+  auto samples = [](int n_in, int n_out)
+  {
+    std::vector<std::vector<int>> idx(n_out);
+
+    for (int p = 0; p < n_out; p++)
+    {
+      int a = (int)((int64_t)p * n_in / n_out);
+      int b = std::max(a + 1, (int)((int64_t)(p + 1) * n_in / n_out));
+      int ns = std::min(b - a, BOX_DOWNSAMPLE_MAX_SAMPLES);
+
+      for (int s = 0; s < ns; s++)
+        idx[p].push_back(
+            std::min(n_in - 1, a + ((2 * s + 1) * (b - a)) / (2 * ns)));
+    }
+    return idx;
+  };
+
+  std::vector<std::vector<int>> si = samples(shape_in.x, shape.x);
+  std::vector<std::vector<int>> sj = samples(shape_in.y, shape.y);
+
+  for (int p = 0; p < shape.x; p++)
+    for (int q = 0; q < shape.y; q++)
+    {
+      float sum = 0.f;
+      for (int i : si[p])
+        for (int j : sj[q])
+          sum += fct(i, j);
+      out(p, q) = sum / (float)(si[p].size() * sj[q].size());
+    }
+
+  return out;
+}
+
+hmap::Array box_downsample(hmap::HeightMap &h, hmap::Vec2<int> shape)
+{
+  hesiod::region::TileLookup lookup = hesiod::region::TileLookup(h);
+
+  if (!lookup.is_valid())
+    return h.to_array(shape);
+
+  return box_filter(h.shape,
+                    shape,
+                    [&lookup](int i, int j) { return lookup.get(i, j); });
+}
+
+hmap::Array box_downsample(const hmap::Array &array, hmap::Vec2<int> shape)
+{
+  return box_filter(array.shape,
+                    shape,
+                    [&array](int i, int j) { return array(i, j); });
+}
+
+} // namespace hesiod::viewer
@@ -0,0 +1,56 @@
+R""(
+#version 330 core
+
+in vec2 uv;
+out vec4 color;
+
+uniform sampler2D data;      // elevation page (red channel) or RGB colors
+uniform sampler1D cmap;      // colormap lookup table
+uniform vec2      zrange;    // elevation range mapped to the colormap
+uniform vec2      core;      // page size in texels, one-texel border excluded
+uniform float     talus_ref; // reference talus of the hillshading
+uniform bool      rgb;
+uniform bool      hillshade;
+
+const float azimuth = radians(180.0);
+const float zenith = radians(45.0);
+
+void main()
+{
+    // RGB images are stored in display order
+    if (rgb)
+    {
+        color = vec4(texture(data, uv).rgb, 1.0);
+        return;
+    }
+
+    // elevations are stored row-major with index i * ny + j, x <-> i
+    // and y <-> j pointing upward, pages have a one-texel border so that
+    // filtering and gradients are seamless across pages
+    vec2  texel = 1.0 / (core + 2.0);
+    vec2  st = (1.0 + vec2(1.0 - uv.y, uv.x) * core) * texel;
+    float z = texture(data, st).r;
+    float dz = max(zrange.y - zrange.x, 1e-30);
+
+    vec3 c = texture(cmap, clamp((z - zrange.x) / dz, 0.0, 1.0)).rgb;
+
+    if (hillshade)
+    {
+        // gradients in elevation per cell, normalized by the reference
+        // talus
+        float gx = 0.5 * (texture(data, st + vec2(0.0, texel.y)).r -
+                          texture(data, st - vec2(0.0, texel.y)).r);
+        float gy = 0.5 * (texture(data, st + vec2(texel.x, 0.0)).r -
+                          texture(data, st - vec2(texel.x, 0.0)).r);
+
+        float slope = atan(length(vec2(gx, gy)) / talus_ref);
+        float aspect = atan(-gy, -gx);
+        float hs = cos(zenith) * cos(slope) +
+                   sin(zenith) * sin(slope) * cos(azimuth - aspect);
+
+        c *= pow(clamp(hs, 0.0, 1.0), 1.5);
+    }
+
+    color = vec4(c, 1.0);
+}
+)""
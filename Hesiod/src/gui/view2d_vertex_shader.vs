@@ -0,0 +1,20 @@
+R""(
+#version 330 core
+
+// unit quad mapped onto a rectangle of the data domain, 'uv' is the position
+// within the rectangle, (0, 0) at its top-left corner
+layout(location = 0) in vec2 vertexPosition;
+
+uniform vec2  uv0;      // view origin in the data domain
+uniform float uv_scale; // view extent in the data domain
+uniform vec4  rect;     // rectangle in the data domain (top-left, bottom-right)
+
+out vec2 uv;
+
+void main(){
+    uv = vec2(0.5 * (vertexPosition.x + 1.0), 0.5 * (1.0 - vertexPosition.y));
+
+    vec2 p = (mix(rect.xy, rect.zw, uv) - uv0) / uv_scale;
+    gl_Position = vec4(2.0 * p.x - 1.0, 1.0 - 2.0 * p.y, 0.0, 1.0);
+}
+)""
@@ -1,11 +1,17 @@
 /* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
  * Public License. The full license is in the file LICENSE, distributed with
  * this software. */
+#include <algorithm>
+#include <cstring>
+
 #include <GL/glew.h>
 
 #include "highmap.hpp"
 #include "macrologger.h"
 
+#include "hesiod/parallel.hpp"
+#include "hesiod/viewer.hpp"
+
 namespace hesiod::viewer
 {
 
@@ -244,6 +250,52 @@ void update_vertex_colors(hmap::Array          &z,
     }
 }
 
+void upload_array_buffer(GLuint buffer, const std::vector<GLfloat> &data)
+{
+  GLint  size = 0;
+  size_t nbytes = sizeof(GLfloat) * data.size();
+
+  glBindBuffer(GL_ARRAY_BUFFER, buffer);
+  glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &size);
+
+  if ((size_t)size != nbytes)
+    glBufferData(GL_ARRAY_BUFFER, nbytes, nullptr, GL_DYNAMIC_DRAW);
+
+  if (nbytes == 0)
+    return;
+
+  // the previous content is discarded, no synchronization with the draw
+  // calls still using it
+  GLfloat *ptr = (GLfloat *)glMapBufferRange(GL_ARRAY_BUFFER,
+                                             0,
+                                             nbytes,
+                                             GL_MAP_WRITE_BIT |
+                                                 GL_MAP_INVALIDATE_BUFFER_BIT);
+
+  if (ptr)
+  {
+    int nchunks = 64;
+    int chunk = (int)((data.size() + nchunks - 1) / nchunks);
+
+    parallel_for(nchunks,
+                 [&data, ptr, chunk](int k_start, int k_end)
+                 {
+                   size_t i0 = std::min(data.size(), (size_t)k_start * chunk);
+                   size_t i1 = std::min(data.size(), (size_t)k_end * chunk);
+                   std::memcpy(ptr + i0,
+                               data.data() + i0,
+                               sizeof(GLfloat) * (i1 - i0));
+                 });
+
+    // the content is undefined if the mapping was lost in between
+    if (glUnmapBuffer(GL_ARRAY_BUFFER))
+      return;
+  }
+
+  LOG_DEBUG("buffer mapping failed, using a plain copy");
+  glBufferSubData(GL_ARRAY_BUFFER, 0, nbytes, data.data());
+}
+
 //----------------------------------------
 // frame buffers
 //----------------------------------------
@@ -345,31 +397,16 @@ void rescale_framebuffer(GLuint &RBO,
                             RBO);
 }
 
-GLuint load_shaders(const char *vertex_file_path,
-                    const char *fragment_file_path)
+// compile and link a shader program from its sources
+static GLuint compile_program(const std::string &vertex_shader_code,
+                              const std::string &fragment_shader_code,
+                              const char        *vertex_file_path,
+                              const char        *fragment_file_path)
 {
-
   // Create the shaders
   GLuint vertex_shader_id = glCreateShader(GL_VERTEX_SHADER);
   GLuint fragment_shader_id = glCreateShader(GL_FRAGMENT_SHADER);
 
-  // read shader sources
-  std::string vertex_shader_code;
-  {
-    const std::string code =
-#include "vertex_shader.vs"
-        ;
-    vertex_shader_code = code.c_str();
-  }
-
-  std::string fragment_shader_code;
-  {
-    const std::string code =
-#include "fragment_shader.vs"
-        ;
-    fragment_shader_code = code.c_str();
-  }
-
   GLint result = GL_FALSE;
   int   info_log_length;
 
@@ -440,4 +477,170 @@ GLuint load_shaders(const char *vertex_file_path,
   return program_id;
 }
 
+GLuint load_shaders(const char *vertex_file_path,
+                    const char *fragment_file_path)
+{
+  // read shader sources
+  const std::string vertex_shader_code =
+#include "vertex_shader.vs"
+      ;
+
+  const std::string fragment_shader_code =
+#include "fragment_shader.vs"
+      ;
+
+  return compile_program(vertex_shader_code,
+                         fragment_shader_code,
+                         vertex_file_path,
+                         fragment_file_path);
+}
+
+GLuint load_shaders_view2d()
+{
+  const std::string vertex_shader_code =
+#include "view2d_vertex_shader.vs"
+      ;
+
+  const std::string fragment_shader_code =
+#include "view2d_fragment_shader.vs"
+      ;
+
+  return compile_program(vertex_shader_code,
+                         fragment_shader_code,
+                         "view2d_vertex_shader.vs",
+                         "view2d_fragment_shader.vs");
+}
+
+//----------------------------------------
+// textures
+//----------------------------------------
+
+void create_quad(GLuint &vertex_array_id, GLuint &vertex_buffer)
+{
+  const GLfloat quad[] = {-1.f, -1.f, 1.f, -1.f, 1.f, 1.f,
+                          -1.f, -1.f, 1.f, 1.f,  -1.f, 1.f};
+
+  GLint last_vertex_array;
+  glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &last_vertex_array);
+
+  glGenVertexArrays(1, &vertex_array_id);
+  glBindVertexArray(vertex_array_id);
+
+  glGenBuffers(1, &vertex_buffer);
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void *)0);
+
+  glBindVertexArray(last_vertex_array);
+}
+
+void upload_array_texture(GLuint &texture_id, const hmap::Array &array)
+{
+  if (!texture_id)
+    glGenTextures(1, &texture_id);
+
+  glBindTexture(GL_TEXTURE_2D, texture_id);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+  // row-major storage, one texture row per index i
+  glTexImage2D(GL_TEXTURE_2D,
+               0,
+               GL_R32F,
+               array.shape.y,
+               array.shape.x,
+               0,
+               GL_RED,
+               GL_FLOAT,
+               array.vector.data());
+}
+
+void update_array_texture(GLuint             texture_id,
+                          const hmap::Array &array,
+                          hmap::Vec4<int>    cells)
+{
+  if (!texture_id || cells.a >= cells.b || cells.c >= cells.d)
+    return;
+
+  glBindTexture(GL_TEXTURE_2D, texture_id);
+
+  // the sub-rectangle is read in place from the full array
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, array.shape.y);
+
+  glTexSubImage2D(GL_TEXTURE_2D,
+                  0,
+                  cells.c,
+                  cells.a,
+                  cells.d - cells.c,
+                  cells.b - cells.a,
+                  GL_RED,
+                  GL_FLOAT,
+                  &array.vector[(size_t)cells.a * array.shape.y + cells.c]);
+
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
+
+void upload_rgb_texture(GLuint                     &texture_id,
+                        const std::vector<uint8_t> &img,
+                        hmap::Vec2<int>             shape)
+{
+  if (!texture_id)
+    glGenTextures(1, &texture_id);
+
+  glBindTexture(GL_TEXTURE_2D, texture_id);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+  glTexImage2D(GL_TEXTURE_2D,
+               0,
+               GL_RGB8,
+               shape.x,
+               shape.y,
+               0,
+               GL_RGB,
+               GL_UNSIGNED_BYTE,
+               img.data());
+}
+
+void upload_cmap_texture(GLuint &texture_id, int cmap)
+{
+  // colorize a linear ramp to get exactly the same colors as on the CPU
+  hmap::Array ramp = hmap::Array(hmap::Vec2<int>(VIEWER_CMAP_LUT_SIZE, 1));
+  for (int i = 0; i < VIEWER_CMAP_LUT_SIZE; i++)
+    ramp(i, 0) = (float)i / (float)(VIEWER_CMAP_LUT_SIZE - 1);
+
+  std::vector<uint8_t> img = hmap::colorize(ramp, 0.f, 1.f, cmap, false);
+
+  if (!texture_id)
+    glGenTextures(1, &texture_id);
+
+  glBindTexture(GL_TEXTURE_1D, texture_id);
+  glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexImage1D(GL_TEXTURE_1D,
+               0,
+               GL_RGB8,
+               VIEWER_CMAP_LUT_SIZE,
+               0,
+               GL_RGB,
+               GL_UNSIGNED_BYTE,
+               img.data());
+}
+
 } // namespace hesiod::viewer
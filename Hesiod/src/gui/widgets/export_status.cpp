@@ -0,0 +1,46 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+#include "hesiod/export_queue.hpp"
+#include "hesiod/gui.hpp"
+
+namespace hesiod::gui
+{
+
+void export_status(std::string fname, float width)
+{
+  hesiod::io::ExportStatus status =
+      hesiod::io::ExportQueue::get_instance().get_status(fname);
+
+  switch (status.state)
+  {
+  case hesiod::io::export_state::queued:
+    ImGui::TextDisabled("queued");
+    break;
+
+  case hesiod::io::export_state::writing:
+    ImGui::ProgressBar(status.progress, ImVec2(width, 0.f), "writing...");
+    break;
+
+  case hesiod::io::export_state::done:
+    ImGui::TextDisabled("written (%.0f ms)", status.elapsed);
+    break;
+
+  case hesiod::io::export_state::failed:
+    ImGui::TextColored(ImVec4(1.f, 0.3f, 0.3f, 1.f), "export failed");
+    if (ImGui::BeginItemTooltip())
+    {
+      ImGui::TextUnformatted(status.message.c_str());
+      ImGui::EndTooltip();
+    }
+    break;
+  }
+
+  if (status.coalesced > 0 && ImGui::BeginItemTooltip())
+  {
+    ImGui::Text("%d superseded export(s) skipped", status.coalesced);
+    ImGui::EndTooltip();
+  }
+}
+
+} // namespace hesiod::gui
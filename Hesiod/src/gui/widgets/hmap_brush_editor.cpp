@@ -1,6 +1,7 @@
 /* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
  * Public License. The full license is in the file LICENSE, distributed with
  * this software. */
+#include <cmath>
 #include <cstdio>
 #include <iostream>
 
@@ -9,34 +10,87 @@
 #include "macrologger.h"
 
 #include "hesiod/gui.hpp"
+#include "hesiod/parallel.hpp"
+#include "hesiod/region.hpp"
 
 #define IMGUI_ID_BRUSH_RADIUS 0
+#define IMGUI_ID_BRUSH_FLOW 1
+#define IMGUI_ID_BRUSH_STROKE 2
+#define IMGUI_ID_BRUSH_X 3
+#define IMGUI_ID_BRUSH_Y 4
 
 namespace hesiod::gui
 {
 
 // HELPER
 
-void add_brush(hmap::HeightMap &h, hmap::Array &kernel, float x, float y)
+// apply all the stamps of a frame at once, only the tiles intersecting the
+// stamps are modified (in parallel)
+hmap::Vec4<float> add_brush_stamps(hmap::HeightMap                      &h,
+                                   const hmap::Array                    &kernel,
+                                   const std::vector<hmap::Vec2<float>> &stamps)
 {
-  hmap::transform(h,
-                  [&kernel, &x, &y](hmap::Array      &z,
-                                    hmap::Vec2<float> shift,
-                                    hmap::Vec2<float> scale)
-                  {
-                    int ic = (int)((x - shift.x) / scale.x * (z.shape.x - 1));
-                    int jc = (int)((y - shift.y) / scale.y * (z.shape.y - 1));
-                    add_kernel(z, kernel, ic, jc);
-                  });
+  // kernel half-extent in the unit square, with a one-cell margin
+  float rx = (float)(kernel.shape.x / 2 + 1) / (float)h.shape.x;
+  float ry = (float)(kernel.shape.y / 2 + 1) / (float)h.shape.y;
+
+  std::vector<hmap::Vec4<float>> bboxes = {};
+  hmap::Vec4<float>              region = hesiod::region::empty();
+
+  for (auto &s : stamps)
+  {
+    bboxes.push_back(hmap::Vec4<float>(s.x - rx, s.x + rx, s.y - ry, s.y + ry));
+    region = hesiod::region::merge(region, bboxes.back());
+  }
+
+  region = hmap::Vec4<float>(std::max(0.f, region.a),
+                             std::min(1.f, region.b),
+                             std::max(0.f, region.c),
+                             std::min(1.f, region.d));
+
+  std::vector<int> tiles = hesiod::region::tiles_in_region(h, region);
+
+  hesiod::parallel_for(
+      (int)tiles.size(),
+      [&](int k_start, int k_end)
+      {
+        for (int k = k_start; k < k_end; k++)
+        {
+          hmap::Tile       &tile = h.tiles[tiles[k]];
+          hmap::Vec4<float> bbox_tile = hmap::Vec4<float>(
+              tile.shift.x,
+              tile.shift.x + tile.scale.x,
+              tile.shift.y,
+              tile.shift.y + tile.scale.y);
+
+          for (size_t r = 0; r < stamps.size(); r++)
+            if (hesiod::region::intersects(bboxes[r], bbox_tile))
+            {
+              int ic = (int)((stamps[r].x - tile.shift.x) / tile.scale.x *
+                             (tile.shape.x - 1));
+              int jc = (int)((stamps[r].y - tile.shift.y) / tile.scale.y *
+                             (tile.shape.y - 1));
+              hmap::add_kernel(tile, kernel, ic, jc);
+            }
+        }
+      });
+
+  return region;
 }
 
-bool hmap_brush_editor(hmap::HeightMap &h, float width)
+bool hmap_brush_editor(hmap::HeightMap   &h,
+                       float              width,
+                       hmap::Vec4<float> *p_region)
 {
   ImGuiStorage *imgui_storage = ImGui::GetStateStorage();
   float brush_radius = imgui_storage->GetFloat(IMGUI_ID_BRUSH_RADIUS, 16.f);
+  float brush_flow = imgui_storage->GetFloat(IMGUI_ID_BRUSH_FLOW, 0.25f);
 
   bool ret = false;
 
+  if (p_region)
+    *p_region = hesiod::region::empty();
+
   ImGui::PushID((void *)&h);
   ImGui::BeginGroup();
 
@@ -89,21 +143,56 @@ bool hmap_brush_editor(hmap::HeightMap &h, float width)
     // brush radius in pixels
     int ir = (int)(brush_radius / canvas_size.x * h.shape.x);
 
-    if (ImGui::IsMouseDown(ImGuiMouseButton_Left)) // move
+    // continuous stroke, stamps are spaced by half the brush radius along the
+    // mouse path and applied once per frame
+    std::vector<hmap::Vec2<float>> stamps = {};
+    int stroke = imgui_storage->GetInt(IMGUI_ID_BRUSH_STROKE, 0);
+
+    if (ImGui::IsMouseClicked(ImGuiMouseButton_Left) ||
+        ImGui::IsMouseClicked(ImGuiMouseButton_Right))
     {
+      stroke = ImGui::IsMouseClicked(ImGuiMouseButton_Left) ? 1 : -1;
+      stamps.push_back({x, y});
+      imgui_storage->SetFloat(IMGUI_ID_BRUSH_X, x);
+      imgui_storage->SetFloat(IMGUI_ID_BRUSH_Y, y);
     }
-    else if (ImGui::IsMouseReleased(ImGuiMouseButton_Left))
+    else if (stroke != 0 &&
+             ImGui::IsMouseDown(stroke > 0 ? ImGuiMouseButton_Left
+                                           : ImGuiMouseButton_Right))
     {
-      hmap::Array kernel = hmap::cubic_pulse(
-          hmap::Vec2<int>(2 * ir + 1, 2 * ir + 1));
-      add_brush(h, kernel, x, y);
-      ret = true;
+      float x_prev = imgui_storage->GetFloat(IMGUI_ID_BRUSH_X, x);
+      float y_prev = imgui_storage->GetFloat(IMGUI_ID_BRUSH_Y, y);
+      float spacing = std::max(0.5f * brush_radius / canvas_size.x,
+                               1.f / (float)h.shape.x);
+      float dist = std::hypot(x - x_prev, y - y_prev);
+      int   nstamps = (int)(dist / spacing);
+
+      for (int k = 1; k <= nstamps; k++)
+      {
+        float t = (float)k * spacing / dist;
+        stamps.push_back({x_prev + t * (x - x_prev), y_prev + t * (y - y_prev)});
+      }
+
+      if (nstamps > 0)
+      {
+        imgui_storage->SetFloat(IMGUI_ID_BRUSH_X, stamps.back().x);
+        imgui_storage->SetFloat(IMGUI_ID_BRUSH_Y, stamps.back().y);
+      }
     }
-    else if (ImGui::IsMouseReleased(ImGuiMouseButton_Right))
+    else
+      stroke = 0;
+
+    imgui_storage->SetInt(IMGUI_ID_BRUSH_STROKE, stroke);
+
+    if (!stamps.empty())
     {
-      hmap::Array kernel = -hmap::cubic_pulse(
-          hmap::Vec2<int>(2 * ir + 1, 2 * ir + 1));
-      add_brush(h, kernel, x, y);
+      hmap::Array kernel = (float)stroke * brush_flow *
+                           hmap::cubic_pulse(
+                               hmap::Vec2<int>(2 * ir + 1, 2 * ir + 1));
+      hmap::Vec4<float> region = add_brush_stamps(h, kernel, stamps);
+
+      if (p_region)
+        *p_region = region;
       ret = true;
     }
 
@@ -114,15 +203,16 @@ bool hmap_brush_editor(hmap::HeightMap &h, float width)
       if (ImGui::IsKeyPressed(ImGuiKey_LeftShift))
         step *= 0.1f;
       brush_radius = std::max(1.f, brush_radius + io.MouseWheel * step);
-      ret = true;
     }
   }
 
   ImGui::Text("Brush radius: %d pixels",
               (int)(brush_radius / canvas_size.x * h.shape.x));
+  ImGui::SliderFloat("Brush flow", &brush_flow, 0.01f, 1.f, "%.2f");
 
   ImGui::EndGroup();
   imgui_storage->SetFloat(IMGUI_ID_BRUSH_RADIUS, brush_radius);
+  imgui_storage->SetFloat(IMGUI_ID_BRUSH_FLOW, brush_flow);
 
   return ret;
 }
@@ -14,6 +14,8 @@ typedef unsigned int uint;
 #include "hesiod/viewer.hpp"
 
 #include "hesiod/control_node.hpp"
+#include "hesiod/distributed.hpp"
+#include "hesiod/export_queue.hpp"
 #include "hesiod/fonts.hpp"
 #include "hesiod/gui.hpp"
 #include "hesiod/view_node.hpp"
@@ -26,6 +28,10 @@ typedef unsigned int uint;
 #include "generate_node_snapshot.hpp"
 #endif
 
+#if ENABLE_DISTRIBUTED_TEST
+#include "distributed_test.hpp"
+#endif
+
 int main(int argc, char *argv[])
 {
 
@@ -37,6 +43,11 @@ int main(int argc, char *argv[])
   }
 #endif
 
+#if ENABLE_DISTRIBUTED_TEST
+  if (argc >= 3 && strcmp(argv[1], "--distributed-test") == 0)
+    return distributed_test(argv[0], argv[2]);
+#endif
+
   if (argc >= 2 && strcmp(argv[1], "--test") == 0)
   {
     nlohmann::json data = nlohmann::json();
@@ -48,6 +59,43 @@ int main(int argc, char *argv[])
   hmap::Vec2<int> tiling = {4, 4};
   float           overlap = 0.25f;
 
+  // ----------------------------------- Distributed rendering
+
+  if (argc >= 2 && strcmp(argv[1], "--render") == 0)
+  {
+    hesiod::distributed::RenderSettings settings;
+
+    if (!hesiod::distributed::parse_arguments(argc, argv, settings))
+    {
+      std::cout << "usage: hesiod --render state.json [--shape nx ny] "
+                   "[--super-tile n] [--overlap n] [--workers n] [--dir path] "
+                   "[--run-id id] [--no-spawn] [--rank k]"
+                << std::endl;
+      return 1;
+    }
+
+    // invisible window, the nodes still need an OpenGL context
+    GLFWwindow *window = hesiod::gui::init_gui(64, 64, "Hesiod", false);
+    if (!window)
+      return 1;
+
+    hesiod::vnode::ViewTree tree =
+        hesiod::vnode::ViewTree("tree_1", shape, tiling, overlap);
+    tree.load_state(settings.state_fname);
+
+    bool success = false;
+
+    if (settings.rank >= 0)
+      success = tree.render_tiles(settings);
+    else
+      success = tree.render_distributed(argv[0], settings);
+
+    glfwDestroyWindow(window);
+    glfwTerminate();
+
+    return success ? 0 : 1;
+  }
+
   // ----------------------------------- Main GUI
 
   GLFWwindow *window =
@@ -72,9 +120,15 @@ int main(int argc, char *argv[])
   tree.add_view_node("FbmSimplex");
   tree.add_view_node("Perlin");
 
+  // exports and autosaves completing while the loop is idle
+  hesiod::io::ExportQueue::get_instance().set_on_job_done(
+      hesiod::gui::request_redraw);
+
   while (!glfwWindowShouldClose(window))
   {
-    glfwPollEvents();
+    // idle mode, the loop blocks until something happens
+    hesiod::gui::wait_events(tree.is_animated());
+
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
@@ -100,6 +154,8 @@ int main(int argc, char *argv[])
   }
 
   // --- Cleanup
+  hesiod::io::ExportQueue::get_instance().set_on_job_done(nullptr);
+
   ImGui_ImplOpenGL3_Shutdown();
   ImGui_ImplGlfw_Shutdown();
   ImGui::DestroyContext();
@@ -13,6 +13,7 @@ Abs::Abs(std::string id) : ControlNode(id), Unary(id)
   LOG_DEBUG("Abs::Abs()");
   this->node_type = "Abs";
   this->category = category_mapping.at(this->node_type);
+  this->halo = {hesiod::region::halo_type::pointwise, 0};
 }
 
 void Abs::compute_in_out(hmap::HeightMap &h_out, hmap::HeightMap *p_h_in)
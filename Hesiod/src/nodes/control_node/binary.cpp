@@ -32,6 +32,17 @@ void Binary::compute()
   hmap::HeightMap *p_hmap1 = CAST_PORT_REF(hmap::HeightMap, "input##1");
   hmap::HeightMap *p_hmap2 = CAST_PORT_REF(hmap::HeightMap, "input##2");
 
+  // incremental update
+  if (this->compute_in_region(
+          this->value_out,
+          {p_hmap1, p_hmap2},
+          [this](hmap::HeightMap &h, std::vector<hmap::HeightMap *> &p_in)
+          {
+            this->compute_in_out(h, p_in[0], p_in[1]);
+            this->post_process_heightmap(h);
+          }))
+    return;
+
   this->value_out.set_sto(p_hmap1->shape, p_hmap1->tiling, p_hmap1->overlap);
 
   this->compute_in_out(this->value_out, p_hmap1, p_hmap2);
@@ -12,6 +12,8 @@ Blend::Blend(std::string id) : ControlNode(id), Binary(id)
 {
   this->node_type = "Blend";
   this->category = category_mapping.at(this->node_type);
+  this->halo = {hesiod::region::halo_type::radius, 2};
+  this->halo_ir_attr = "ir";
 
   this->attr["blending_method"] = NEW_ATTR_MAPENUM(this->blending_method_map);
   this->attr["k"] = NEW_ATTR_FLOAT(0.1f, 0.01f, 1.f);
@@ -20,9 +20,26 @@ Brush::Brush(std::string     id,
   this->add_port(
       gnode::Port("output", gnode::direction::out, dtype::dHeightMap));
   this->value_out.set_sto(shape, tiling, overlap);
+  this->halo = {hesiod::region::halo_type::pointwise, 0};
   this->update_inner_bindings();
 }
 
+hesiod::region::Halo Brush::get_effective_halo()
+{
+  // remapping depends on the global min/max
+  if (this->remap)
+    return {hesiod::region::halo_type::global, 0};
+  else
+    return this->halo;
+}
+
+hesiod::region::Halo Brush::get_roi_halo()
+{
+  // the painted data are not procedural, and the remapping range is not
+  // recorded
+  return this->get_effective_halo();
+}
+
 void Brush::update_inner_bindings()
 {
   this->set_p_data("output", (void *)&this->value_out);
@@ -13,6 +13,7 @@ Clamp::Clamp(std::string id) : ControlNode(id), Unary(id)
   LOG_DEBUG("Clamp::Clamp()");
   this->node_type = "Clamp";
   this->category = category_mapping.at(this->node_type);
+  this->halo = {hesiod::region::halo_type::pointwise, 0};
 
   this->attr["clamp"] = NEW_ATTR_RANGE(true);
   this->attr["smooth_min"] = NEW_ATTR_BOOL(false);
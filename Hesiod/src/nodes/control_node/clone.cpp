@@ -13,6 +13,7 @@ Clone::Clone(std::string id) : ControlNode(id)
   LOG_DEBUG("Unary::Unary()");
   this->node_type = "Clone";
   this->category = category_mapping.at(this->node_type);
+  this->halo = {hesiod::region::halo_type::pointwise, 0};
   this->add_port(gnode::Port("input", gnode::direction::in, dtype::dHeightMap));
   this->add_port(gnode::Port("thru##" + std::to_string(this->id_count++),
                              gnode::direction::out,
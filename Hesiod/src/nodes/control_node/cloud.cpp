@@ -16,6 +16,7 @@ Cloud::Cloud(std::string id) : ControlNode(id)
   this->attr["cloud"] = NEW_ATTR_CLOUD();
 
   this->category = category_mapping.at(this->node_type);
+  this->halo = {hesiod::region::halo_type::pointwise, 0};
   this->add_port(gnode::Port("output", gnode::direction::out, dtype::dCloud));
   this->update_inner_bindings();
 }
@@ -26,6 +27,12 @@ void Cloud::compute()
   this->value_out = GET_ATTR_CLOUD("cloud");
 }
 
+hmap::Vec4<float> Cloud::get_changed_region()
+{
+  return hesiod::region::changed_region(this->value_out,
+                                        GET_ATTR_CLOUD("cloud"));
+}
+
 void Cloud::update_inner_bindings()
 {
   this->set_p_data("output", (void *)&this->value_out);
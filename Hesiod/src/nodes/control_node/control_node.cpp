@@ -1,6 +1,8 @@
 /* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
  * Public License. The full license is in the file LICENSE, distributed with
  * this software. */
+#include <algorithm>
+#include <cmath>
 #include <map>
 #include <memory>
 #include <vector>
@@ -53,8 +55,6 @@ bool ControlNode::deserialize_json_v2(std::string     field_name,
     return false;
   }
 
-  attr.clear();
-
   this->id = input_data[field_name]["id"].get<std::string>();
 
   for (nlohmann::json currentAttributeIteratorJsonData :
@@ -76,10 +76,34 @@ bool ControlNode::deserialize_json_v2(std::string     field_name,
     std::string currentAttributeKey =
         currentAttributeIteratorJsonData["key"].get<std::string>();
 
+    // attributes set by the node constructor are kept with their
+    // default value when missing in the file (file saved with an older
+    // version of the node), attributes no longer used by the node are
+    // skipped
+    if (!attr.contains(currentAttributeKey))
+    {
+      LOG_DEBUG("skipping unknown attribute [%s] for node [%s]",
+                currentAttributeKey.c_str(),
+                this->id.c_str());
+      continue;
+    }
+
+    // type changed since the file was saved, the default value set by the
+    // node constructor is kept
+    if (attr.at(currentAttributeKey)->get_type() !=
+        currentAttributeIteratorType)
+    {
+      LOG_ERROR("attribute [%s] of node [%s] does not have the expected type, "
+                "default value kept",
+                currentAttributeKey.c_str(),
+                this->id.c_str());
+      continue;
+    }
+
     currentAttribute->deserialize_json_v2("value",
                                           currentAttributeIteratorJsonData);
 
-    attr.emplace(currentAttributeKey, std::move(currentAttribute));
+    attr[currentAttributeKey] = std::move(currentAttribute);
   }
 
   return true;
@@ -108,8 +132,11 @@ void ControlNode::post_process_heightmap(hmap::HeightMap &h)
       hmap::Vec2<float> srange = GET_ATTR_RANGE("saturate");
       float             k = GET_ATTR_FLOAT("k_saturate");
 
-      float hmin = h.min();
-      float hmax = h.max();
+      if (!this->roi_evaluation)
+        this->range_saturate_in = {h.min(), h.max()};
+
+      float hmin = this->range_saturate_in.x;
+      float hmax = this->range_saturate_in.y;
 
       // node parameters are assumed normalized and thus in [0, 1],
       // they need to be rescaled
@@ -122,15 +149,270 @@ void ControlNode::post_process_heightmap(hmap::HeightMap &h)
                       { hmap::clamp_smooth(array, smin_n, smax_n, k_n); });
 
       // keep original amplitude
-      h.remap(hmin, hmax);
+      if (!this->roi_evaluation)
+        this->range_saturate_out = {h.min(), h.max()};
+
+      h.remap(hmin,
+              hmax,
+              this->range_saturate_out.x,
+              this->range_saturate_out.y);
     }
 
   if (this->attr.contains("remap"))
     if (GET_ATTR_REF_RANGE("remap")->is_activated())
     {
       hmap::Vec2<float> vrange = GET_ATTR_RANGE("remap");
-      h.remap(vrange.x, vrange.y);
+
+      if (!this->roi_evaluation)
+        this->range_remap_in = {h.min(), h.max()};
+
+      h.remap(vrange.x,
+              vrange.y,
+              this->range_remap_in.x,
+              this->range_remap_in.y);
+    }
+}
+
+hesiod::region::Halo ControlNode::get_effective_halo()
+{
+  // saturation and remapping depend on the global min/max
+  if (this->attr.contains("saturate"))
+    if (GET_ATTR_REF_RANGE("saturate")->is_activated())
+      return {hesiod::region::halo_type::global, 0};
+
+  if (this->attr.contains("remap"))
+    if (GET_ATTR_REF_RANGE("remap")->is_activated())
+      return {hesiod::region::halo_type::global, 0};
+
+  return ControlNode::get_roi_halo();
+}
+
+hesiod::region::Halo ControlNode::get_roi_halo()
+{
+  hesiod::region::Halo node_halo = this->halo;
+
+  if (node_halo.type == hesiod::region::halo_type::radius &&
+      this->halo_ir_attr != "")
+    node_halo.ir *= GET_ATTR_INT(this->halo_ir_attr);
+
+  // saturation and remapping use the ranges recorded during the last whole
+  // domain update, only the smoothing extends the halo
+  hesiod::region::Halo post = {hesiod::region::halo_type::pointwise, 0};
+
+  if (this->attr.contains("smoothing"))
+    if (GET_ATTR_BOOL("smoothing"))
+      post = {hesiod::region::halo_type::radius, GET_ATTR_INT("ir_smoothing")};
+
+  return hesiod::region::combine(node_halo, post);
+}
+
+bool ControlNode::records_statistics()
+{
+  if (this->attr.contains("saturate"))
+    if (GET_ATTR_REF_RANGE("saturate")->is_activated())
+      return true;
+
+  if (this->attr.contains("remap"))
+    if (GET_ATTR_REF_RANGE("remap")->is_activated())
+      return true;
+
+  return false;
+}
+
+void ControlNode::serialize_statistics(nlohmann::json &data)
+{
+  data["range_saturate_in"] = {this->range_saturate_in.x,
+                               this->range_saturate_in.y};
+  data["range_saturate_out"] = {this->range_saturate_out.x,
+                                this->range_saturate_out.y};
+  data["range_remap_in"] = {this->range_remap_in.x, this->range_remap_in.y};
+}
+
+bool ControlNode::deserialize_statistics(const nlohmann::json &data)
+{
+  for (auto &key :
+       {"range_saturate_in", "range_saturate_out", "range_remap_in"})
+    if (!data.contains(key) || !data[key].is_array() || data[key].size() != 2)
+      return false;
+
+  this->range_saturate_in = {data["range_saturate_in"][0].get<float>(),
+                             data["range_saturate_in"][1].get<float>()};
+  this->range_saturate_out = {data["range_saturate_out"][0].get<float>(),
+                              data["range_saturate_out"][1].get<float>()};
+  this->range_remap_in = {data["range_remap_in"][0].get<float>(),
+                          data["range_remap_in"][1].get<float>()};
+  return true;
+}
+
+hmap::Vec4<float> ControlNode::get_changed_region()
+{
+  return hesiod::region::full();
+}
+
+bool ControlNode::compute_in_region(
+    hmap::HeightMap                &h_out,
+    std::vector<hmap::HeightMap *>  p_inputs,
+    std::function<void(hmap::HeightMap &, std::vector<hmap::HeightMap *> &)>
+        fct)
+{
+  if (hesiod::region::is_full(this->dirty_region) || p_inputs.empty() ||
+      !p_inputs[0])
+    return false;
+
+  hesiod::region::Halo halo_eff = this->get_effective_halo();
+  if (halo_eff.type == hesiod::region::halo_type::global)
+    return false;
+
+  // the output must have been computed beforehand with the same storage
+  hmap::HeightMap *p_ref = p_inputs[0];
+  if (h_out.shape != p_ref->shape || h_out.tiling != p_ref->tiling ||
+      h_out.overlap != p_ref->overlap || h_out.tiles.empty())
+    return false;
+
+  if (hesiod::region::is_empty(this->dirty_region))
+    return true;
+
+  for (auto p_h : p_inputs)
+    if (p_h && (p_h->shape != h_out.shape || p_h->tiling != h_out.tiling ||
+                p_h->overlap != h_out.overlap))
+      return false;
+
+  // the whole domain computation is applied tile by tile and the overlap
+  // buffers are then smoothed: the tiles whose extent (overlap buffers
+  // included) intersects the dirty region change, and so do the overlap
+  // buffers they share with their neighbors
+  hesiod::region::TileLookup lookup = hesiod::region::TileLookup(h_out);
+  if (!lookup.is_valid())
+    return false;
+
+  hmap::Vec4<int> cells = hesiod::region::to_cells(this->dirty_region,
+                                                   h_out.shape);
+  hmap::Vec4<int> tiles = {h_out.tiling.x, 0, h_out.tiling.y, 0};
+  hmap::Vec4<int> cells_changed = {h_out.shape.x, 0, h_out.shape.y, 0};
+
+  for (int k = 0; k < (int)h_out.tiles.size(); k++)
+  {
+    hmap::Vec4<int> extent, cells_k;
+    hmap::Vec2<int> ij0;
+
+    if (!hesiod::region::tile_extent(h_out.tiles[k], h_out.shape, extent))
+      return false;
+
+    if (extent.b <= cells.a || extent.a >= cells.b || extent.d <= cells.c ||
+        extent.c >= cells.d)
+      continue;
+
+    lookup.get_tile_cells(k, cells_k, ij0);
+
+    int p = cells_k.a * h_out.tiling.x / h_out.shape.x;
+    int q = cells_k.c * h_out.tiling.y / h_out.shape.y;
+
+    tiles = {std::min(tiles.a, p),
+             std::max(tiles.b, p + 1),
+             std::min(tiles.c, q),
+             std::max(tiles.d, q + 1)};
+    cells_changed = {std::min(cells_changed.a, extent.a),
+                     std::max(cells_changed.b, extent.b),
+                     std::min(cells_changed.c, extent.c),
+                     std::max(cells_changed.d, extent.d)};
+  }
+
+  // changed tiles with two rings of neighbors: the first ring is smoothed
+  // with the changed tiles, and keeps its layout thanks to the second one
+  hmap::Vec4<int> block = {std::max(0, tiles.a - 2),
+                           std::min(h_out.tiling.x, tiles.b + 2),
+                           std::max(0, tiles.c - 2),
+                           std::min(h_out.tiling.y, tiles.d + 2)};
+
+  if (block.b - block.a == h_out.tiling.x &&
+      block.d - block.c == h_out.tiling.y)
+    return false;
+
+  std::vector<hmap::HeightMap>   crops(p_inputs.size());
+  std::vector<hmap::HeightMap *> p_crops(p_inputs.size(), nullptr);
+
+  for (size_t k = 0; k < p_inputs.size(); k++)
+    if (p_inputs[k])
+    {
+      if (!hesiod::region::extract_tiles(*p_inputs[k], block, crops[k]))
+        return false;
+      p_crops[k] = &crops[k];
     }
+
+  LOG_DEBUG("incremental update, node [%s], tiles [%d, %d[ x [%d, %d[",
+            this->id.c_str(),
+            block.a,
+            block.b,
+            block.c,
+            block.d);
+
+  hmap::HeightMap h_crop = crops[0];
+  fct(h_crop, p_crops);
+
+  hesiod::region::paste_tiles(h_out, h_crop, cells_changed);
+  return true;
+}
+
+bool ControlNode::get_dirty_tiles(hmap::HeightMap  &h_out,
+                                  hmap::HeightMap  *p_ref,
+                                  std::vector<int> &tiles)
+{
+  if (hesiod::region::is_full(this->dirty_region) || h_out.tiles.empty())
+    return false;
+
+  if (this->get_effective_halo().type == hesiod::region::halo_type::global)
+    return false;
+
+  if (p_ref)
+    if (h_out.shape != p_ref->shape || h_out.tiling != p_ref->tiling ||
+        h_out.overlap != p_ref->overlap)
+      return false;
+
+  tiles = hesiod::region::tiles_in_region(h_out, this->dirty_region);
+
+  LOG_DEBUG("incremental update, node [%s], %ld tile(s)",
+            this->id.c_str(),
+            tiles.size());
+  return true;
+}
+
+bool ControlNode::set_roi_scale(float scale)
+{
+  for (auto &[key, value] : this->cell_attr_values)
+    this->attr.at(key)->get_ref<IntAttribute>()->value = value;
+
+  this->cell_attr_values.clear();
+
+  if (scale == 1.f)
+    return true;
+
+  bool is_rescaled = true;
+
+  for (auto &[key, p_attr] : this->attr)
+  {
+    if (p_attr->get_type() != AttributeType::INT_ATTRIBUTE)
+      continue;
+
+    IntAttribute *p_int = p_attr->get_ref<IntAttribute>();
+
+    if (std::find(this->cell_attrs.begin(), this->cell_attrs.end(), key) !=
+        this->cell_attrs.end())
+    {
+      // non-zero lengths are kept at least one cell long
+      int value = (int)std::round((float)p_int->value * scale);
+      if (p_int->value > 0)
+        value = std::max(1, value);
+
+      this->cell_attr_values[key] = p_int->value;
+      p_int->value = value;
+    }
+    else if (std::find(this->iteration_attrs.begin(),
+                       this->iteration_attrs.end(),
+                       key) != this->iteration_attrs.end())
+      is_rescaled = false;
+  }
+
+  return is_rescaled;
 }
 
 } // namespace hesiod::cnode
@@ -4,6 +4,7 @@
 #include "macrologger.h"
 
 #include "hesiod/control_node.hpp"
+#include "hesiod/parallel.hpp"
 
 namespace hesiod::cnode
 {
@@ -30,9 +31,30 @@ DigPath::DigPath(std::string id) : ControlNode(id)
   this->add_port(gnode::Port("input", gnode::direction::in, dtype::dHeightMap));
   this->add_port(
       gnode::Port("output", gnode::direction::out, dtype::dHeightMap));
+  this->halo = {hesiod::region::halo_type::radius, 0};
+  this->cell_attrs.insert(this->cell_attrs.end(),
+                          {"width", "decay", "flattening_radius"});
   this->update_inner_bindings();
 }
 
+hesiod::region::Halo DigPath::get_effective_halo()
+{
+  // downhill enforcement depends on the whole path
+  if (GET_ATTR_BOOL("force_downhill"))
+    return {hesiod::region::halo_type::global, 0};
+
+  // the path footprint (digging and elevation smoothing along the path)
+  int ir = GET_ATTR_INT("width") + GET_ATTR_INT("decay") +
+           GET_ATTR_INT("flattening_radius");
+
+  return {hesiod::region::halo_type::radius, ir};
+}
+
+hesiod::region::Halo DigPath::get_roi_halo()
+{
+  return this->get_effective_halo();
+}
+
 void DigPath::compute()
 {
   LOG_DEBUG("computing DigPath node [%s]", this->id.c_str());
@@ -42,6 +64,35 @@ void DigPath::compute()
 
   if (p_path->get_npoints() > 1)
   {
+    // incremental update, only the tiles within the dirty region are dug again
+    std::vector<int> tiles = {};
+
+    if (this->get_dirty_tiles(this->value_out, p_hmap, tiles))
+    {
+      hesiod::parallel_for(
+          (int)tiles.size(),
+          [this, &tiles, p_hmap, p_path](int k_start, int k_end)
+          {
+            for (int k = k_start; k < k_end; k++)
+            {
+              hmap::Tile &tile = this->value_out.tiles[tiles[k]];
+              tile.vector = p_hmap->tiles[tiles[k]].vector;
+
+              hmap::dig_path(tile,
+                             *p_path,
+                             GET_ATTR_INT("width"),
+                             GET_ATTR_INT("decay"),
+                             GET_ATTR_INT("flattening_radius"),
+                             false, // force_downhill
+                             tile.bbox,
+                             GET_ATTR_FLOAT("depth"));
+            }
+          });
+
+      this->value_out.smooth_overlap_buffers();
+      return;
+    }
+
     // work on a copy of the input
     this->value_out = *p_hmap;
 
@@ -4,6 +4,7 @@
 #include "macrologger.h"
 
 #include "hesiod/control_node.hpp"
+#include "hesiod/distance_transform.hpp"
 
 namespace hesiod::cnode
 {
@@ -14,11 +15,17 @@ DistanceTransform::DistanceTransform(std::string id) : ControlNode(id)
   this->node_type = "DistanceTransform";
   this->category = category_mapping.at(this->node_type);
 
+  this->attr["full_resolution"] = NEW_ATTR_BOOL(true);
   this->attr["shape"] = NEW_ATTR_SHAPE();
   this->attr["reverse"] = NEW_ATTR_BOOL(false);
+  this->attr["signed"] = NEW_ATTR_BOOL(false);
   this->attr["remap"] = NEW_ATTR_RANGE(true);
 
-  this->attr_ordered_key = {"shape", "reverse", "remap"};
+  this->attr_ordered_key = {"full_resolution",
+                            "shape",
+                            "reverse",
+                            "signed",
+                            "remap"};
 
   this->add_port(gnode::Port("input", gnode::direction::in, dtype::dHeightMap));
   this->add_port(
@@ -35,26 +42,43 @@ void DistanceTransform::compute()
   // work on a copy of the input
   this->value_out = *p_hmap;
 
+  // exact transform at full resolution, or faster approximation at a
+  // reduced working resolution
   GET_ATTR_REF_SHAPE("shape")->set_value_max(this->value_out.shape);
-  hmap::Vec2<int> shape_working = GET_ATTR_SHAPE("shape");
 
-  // work on a subset of the data, make sure the shapes are compatible
-  if (shape_working.x > this->value_out.shape.x ||
-      shape_working.y > this->value_out.shape.y)
-    shape_working = this->value_out.shape;
+  hmap::Vec2<int> shape_working = {0, 0};
+  if (!GET_ATTR_BOOL("full_resolution"))
+    shape_working = GET_ATTR_SHAPE("shape");
 
-  hmap::Array z = this->value_out.to_array(shape_working);
+  distance_transform::edt(this->value_out,
+                          GET_ATTR_BOOL("reverse"),
+                          GET_ATTR_BOOL("signed"),
+                          shape_working);
 
-  if (GET_ATTR_BOOL("reverse"))
+  this->post_process_heightmap(this->value_out);
+}
+
+bool DistanceTransform::deserialize_json_v2(std::string     field_name,
+                                            nlohmann::json &input_data)
+{
+  if (ControlNode::deserialize_json_v2(field_name, input_data) == false)
+    return false;
+
+  // projects saved before the 'full_resolution' attribute was introduced
+  // always used the working shape, kept as is
+  bool has_shape = false;
+  bool has_full_resolution = false;
+
+  for (auto &attr_data : input_data[field_name]["attributes"])
   {
-    make_binary(z);
-    z = 1.f - z;
+    has_shape |= attr_data["key"] == "shape";
+    has_full_resolution |= attr_data["key"] == "full_resolution";
   }
 
-  z = hmap::distance_transform(z);
+  if (has_shape && !has_full_resolution)
+    this->attr["full_resolution"] = NEW_ATTR_BOOL(false);
 
-  this->value_out.from_array_interp(z);
-  this->post_process_heightmap(this->value_out);
+  return true;
 }
 
 void DistanceTransform::update_inner_bindings()
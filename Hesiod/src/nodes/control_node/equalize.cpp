@@ -1,10 +1,15 @@
 /* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
  * Public License. The full license is in the file LICENSE, distributed with
  * this software. */
+#include <algorithm>
+
 #include "macrologger.h"
 
 #include "hesiod/control_node.hpp"
 
+// number of value bins sampling the equalization transfer function
+#define EQUALIZE_TRANSFER_BINS 1024
+
 namespace hesiod::cnode
 {
 
@@ -14,6 +19,41 @@ Equalize::Equalize(std::string id) : ControlNode(id), Filter(id)
   this->category = category_mapping.at(this->node_type);
 }
 
+hesiod::region::Halo Equalize::get_roi_halo()
+{
+  // the transfer function is only recorded without mask
+  if (this->get_port_ref_by_id("mask")->is_connected)
+    return {hesiod::region::halo_type::global, 0};
+
+  return ControlNode::get_roi_halo();
+}
+
+bool Equalize::records_statistics()
+{
+  return true;
+}
+
+void Equalize::serialize_statistics(nlohmann::json &data)
+{
+  ControlNode::serialize_statistics(data);
+  data["transfer_in"] = this->transfer_in;
+  data["transfer_out"] = this->transfer_out;
+}
+
+bool Equalize::deserialize_statistics(const nlohmann::json &data)
+{
+  if (!data.contains("transfer_in") || !data.contains("transfer_out") ||
+      data["transfer_in"].size() != data["transfer_out"].size())
+    return false;
+
+  if (!ControlNode::deserialize_statistics(data))
+    return false;
+
+  this->transfer_in = data["transfer_in"].get<std::vector<float>>();
+  this->transfer_out = data["transfer_out"].get<std::vector<float>>();
+  return true;
+}
+
 void Equalize::compute_filter(hmap::HeightMap &h, hmap::HeightMap *p_mask)
 {
   LOG_DEBUG("computing filter node [%s]", this->id.c_str());
@@ -38,8 +78,102 @@ void Equalize::compute_filter(hmap::HeightMap &h, hmap::HeightMap *p_mask)
     p_mask_array = &mask_array;
   }
 
+  if (this->roi_evaluation)
+  {
+    // the equalization depends on the value distribution over the whole
+    // domain, the transfer function of the last whole domain evaluation is
+    // applied instead
+    this->apply_transfer(z_array, p_mask_array);
+    h.from_array_interp(z_array);
+    return;
+  }
+
+  hmap::Array z_in = z_array;
   hmap::equalize(z_array, p_mask_array);
+
+  if (!p_mask)
+    this->record_transfer(z_in, z_array);
+  else
+  {
+    hmap::Array z_eq = z_in;
+    hmap::equalize(z_eq, nullptr);
+    this->record_transfer(z_in, z_eq);
+  }
+
   h.from_array_interp(z_array);
 }
 
+void Equalize::record_transfer(const hmap::Array &z_in,
+                               const hmap::Array &z_out)
+{
+  // the equalization being monotonic, the transfer function is sampled by
+  // averaging the input and output values over bins of input values
+  float vmin = z_in.min();
+  float vmax = z_in.max();
+  float norm = vmax > vmin ? (float)EQUALIZE_TRANSFER_BINS / (vmax - vmin)
+                           : 0.f;
+
+  std::vector<double> sum_in(EQUALIZE_TRANSFER_BINS, 0.0);
+  std::vector<double> sum_out(EQUALIZE_TRANSFER_BINS, 0.0);
+  std::vector<int>    count(EQUALIZE_TRANSFER_BINS, 0);
+
+  for (size_t k = 0; k < z_in.vector.size(); k++)
+  {
+    int b = std::min(EQUALIZE_TRANSFER_BINS - 1,
+                     (int)((z_in.vector[k] - vmin) * norm));
+    sum_in[b] += z_in.vector[k];
+    sum_out[b] += z_out.vector[k];
+    count[b]++;
+  }
+
+  this->transfer_in.clear();
+  this->transfer_out.clear();
+
+  for (int b = 0; b < EQUALIZE_TRANSFER_BINS; b++)
+    if (count[b] > 0)
+    {
+      this->transfer_in.push_back((float)(sum_in[b] / count[b]));
+      this->transfer_out.push_back((float)(sum_out[b] / count[b]));
+    }
+}
+
+void Equalize::apply_transfer(hmap::Array &z, hmap::Array *p_mask)
+{
+  if (this->transfer_in.empty())
+  {
+    LOG_DEBUG("no transfer function, region equalized locally");
+    hmap::equalize(z, p_mask);
+    return;
+  }
+
+  const std::vector<float> &xp = this->transfer_in;
+  const std::vector<float> &yp = this->transfer_out;
+
+  for (size_t k = 0; k < z.vector.size(); k++)
+  {
+    float v = z.vector[k];
+    float eq;
+
+    // piecewise linear interpolation, clamped
+    auto it = std::upper_bound(xp.begin(), xp.end(), v);
+
+    if (it == xp.begin())
+      eq = yp.front();
+    else if (it == xp.end())
+      eq = yp.back();
+    else
+    {
+      size_t i = it - xp.begin();
+      float  t = (v - xp[i - 1]) / (xp[i] - xp[i - 1]);
+      eq = yp[i - 1] + t * (yp[i] - yp[i - 1]);
+    }
+
+    // masked equalization blends the input and the equalized values
+    if (p_mask)
+      z.vector[k] = v + p_mask->vector[k] * (eq - v);
+    else
+      z.vector[k] = eq;
+  }
+}
+
 } // namespace hesiod::cnode
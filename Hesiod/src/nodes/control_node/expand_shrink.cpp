@@ -13,6 +13,8 @@ ExpandShrink::ExpandShrink(std::string id) : ControlNode(id), Filter(id)
   LOG_DEBUG("ExpandShrink::ExpandShrink()");
   this->node_type = "ExpandShrink";
   this->category = category_mapping.at(this->node_type);
+  this->halo = {hesiod::region::halo_type::radius, 1};
+  this->halo_ir_attr = "ir";
 
   this->attr["kernel"] = NEW_ATTR_MAPENUM(this->kernel_map);
   this->attr["ir"] = NEW_ATTR_INT(4, 1, 128);
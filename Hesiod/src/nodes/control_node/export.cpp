@@ -1,9 +1,14 @@
 /* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
  * Public License. The full license is in the file LICENSE, distributed with
  * this software. */
+#include <algorithm>
+#include <memory>
+
 #include "macrologger.h"
 
 #include "hesiod/control_node.hpp"
+#include "hesiod/export_queue.hpp"
+#include "hesiod/heightmap_writer.hpp"
 
 namespace hesiod::cnode
 {
@@ -17,8 +22,12 @@ Export::Export(std::string id) : ControlNode(id)
   this->attr["auto_export"] = NEW_ATTR_BOOL(false);
   this->attr["fname"] = NEW_ATTR_FILENAME("export.png");
   this->attr["export_format"] = NEW_ATTR_MAPENUM(this->format_map);
+  this->attr["lod_levels"] = NEW_ATTR_INT(0, 0, 12);
 
-  this->attr_ordered_key = {"auto_export", "fname", "export_format"};
+  this->attr_ordered_key = {"auto_export",
+                            "fname",
+                            "export_format",
+                            "lod_levels"};
 
   this->add_port(gnode::Port("input", gnode::direction::in, dtype::dHeightMap));
 }
@@ -33,23 +42,63 @@ void Export::write_file()
 {
   if (this->get_p_data("input"))
   {
-    hmap::HeightMap *p_h = (hmap::HeightMap *)this->get_p_data("input");
-
     int         export_format = GET_ATTR_MAPENUM("export_format");
     std::string fname = GET_ATTR_FILENAME("fname");
+    int         lod_levels = GET_ATTR_INT("lod_levels");
+
+    // the input is snapshotted (tile copies), the file being written by the
+    // I/O thread directly from the tiles
+    auto p_h = std::make_shared<hmap::HeightMap>(
+        *(hmap::HeightMap *)this->get_p_data("input"));
+
+    auto job = [p_h, fname, export_format, lod_levels](
+                   std::function<void(float)> progress)
+    {
+      // downsampled levels ('fname_lod1.png'...) written along with the full
+      // resolution, in a single pass
+      if (lod_levels > 0)
+      {
+        int nlevels = std::min(lod_levels + 1,
+                               hesiod::io::mip_chain_length(p_h->shape));
+
+        std::vector<int> levels = {};
+        for (int l = 0; l < nlevels; l++)
+          levels.push_back(l);
 
-    if (export_format == hesiod::cnode::png8bit)
-      p_h->to_array().to_png_grayscale_8bit(fname);
+        hesiod::io::write_mip_chain(*p_h,
+                                    fname,
+                                    export_format,
+                                    levels,
+                                    progress);
+      }
 
-    else if (export_format == hesiod::cnode::png16bit)
-      p_h->to_array().to_png_grayscale_16bit(fname);
+      else if (export_format == hesiod::cnode::png8bit)
+        hesiod::io::write_png_grayscale(*p_h, fname, 8, progress);
 
-    else if (export_format == hesiod::cnode::binary)
-      p_h->to_array().to_file(fname);
+      else if (export_format == hesiod::cnode::png16bit)
+        hesiod::io::write_png_grayscale(*p_h, fname, 16, progress);
 
-    else if (export_format == hesiod::cnode::raw16bit)
-      p_h->to_array().to_raw_16bit(fname);
+      else if (export_format == hesiod::cnode::binary)
+        hesiod::io::write_binary(*p_h, fname, progress);
+
+      else if (export_format == hesiod::cnode::raw16bit)
+        hesiod::io::write_raw_16bit(*p_h, fname, progress);
+    };
+
+    hesiod::io::ExportQueue::get_instance().push(fname, job);
   }
 }
 
+std::unique_ptr<hesiod::io::BlockWriter> Export::create_block_writer(
+    hmap::Vec2<int>   shape,
+    hmap::Vec2<float> range)
+{
+  // export formats and writer formats share the same values
+  return std::make_unique<hesiod::io::BlockWriter>(
+      GET_ATTR_FILENAME("fname"),
+      GET_ATTR_MAPENUM("export_format"),
+      shape,
+      range);
+}
+
 } // namespace hesiod::cnode
@@ -1,9 +1,12 @@
 /* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
  * Public License. The full license is in the file LICENSE, distributed with
  * this software. */
+#include <memory>
+
 #include "macrologger.h"
 
 #include "hesiod/control_node.hpp"
+#include "hesiod/export_queue.hpp"
 
 namespace hesiod::cnode
 {
@@ -33,8 +36,16 @@ void ExportRGB::write_file()
 {
   if (this->get_p_data("RGB"))
   {
-    hmap::HeightMapRGB *p_h = (hmap::HeightMapRGB *)this->get_p_data("RGB");
-    p_h->to_png_16bit(GET_ATTR_FILENAME("fname"));
+    std::string fname = GET_ATTR_FILENAME("fname");
+
+    // snapshot of the input, written by the I/O thread
+    auto p_h = std::make_shared<hmap::HeightMapRGB>(
+        *(hmap::HeightMapRGB *)this->get_p_data("RGB"));
+
+    auto job = [p_h, fname](std::function<void(float)>)
+    { p_h->to_png_16bit(fname); };
+
+    hesiod::io::ExportQueue::get_instance().push(fname, job);
   }
 }
 
@@ -4,6 +4,7 @@
 #include "macrologger.h"
 
 #include "hesiod/control_node.hpp"
+#include "hesiod/noise.hpp"
 
 namespace hesiod::cnode
 {
@@ -44,30 +45,53 @@ void FbmSimplex::compute()
 {
   LOG_DEBUG("computing FbmSimplex node [%s]", this->id.c_str());
 
-  hmap::fill(this->value_out,
-             (hmap::HeightMap *)this->get_p_data("dx"),
-             (hmap::HeightMap *)this->get_p_data("dy"),
-             (hmap::HeightMap *)this->get_p_data("stretching"),
-             [this](hmap::Vec2<int>   shape,
-                    hmap::Vec2<float> shift,
-                    hmap::Vec2<float> scale,
-                    hmap::Array      *p_noise_x,
-                    hmap::Array      *p_noise_y,
-                    hmap::Array      *p_stretching)
-             {
-               return hmap::fbm_simplex(shape,
-                                        GET_ATTR_WAVENB("kw"),
-                                        GET_ATTR_SEED("seed"),
-                                        GET_ATTR_INT("octaves"),
-                                        GET_ATTR_FLOAT("weight"),
-                                        GET_ATTR_FLOAT("persistence"),
-                                        GET_ATTR_FLOAT("lacunarity"),
-                                        p_noise_x,
-                                        p_noise_y,
-                                        p_stretching,
-                                        shift,
-                                        scale);
-             });
+  // nodes saved before the batched kernels keep the HighMap functions, so
+  // that existing projects are unchanged (see PRIMITIVE_KERNEL_VERSION)
+  if (this->kernel_version == 0)
+  {
+    hmap::fill(this->value_out,
+               (hmap::HeightMap *)this->get_p_data("dx"),
+               (hmap::HeightMap *)this->get_p_data("dy"),
+               (hmap::HeightMap *)this->get_p_data("stretching"),
+               [this](hmap::Vec2<int>   shape,
+                      hmap::Vec2<float> shift,
+                      hmap::Vec2<float> scale,
+                      hmap::Array      *p_noise_x,
+                      hmap::Array      *p_noise_y,
+                      hmap::Array      *p_stretching)
+               {
+                 return hmap::fbm_simplex(shape,
+                                          GET_ATTR_WAVENB("kw"),
+                                          GET_ATTR_SEED("seed"),
+                                          GET_ATTR_INT("octaves"),
+                                          GET_ATTR_FLOAT("weight"),
+                                          GET_ATTR_FLOAT("persistence"),
+                                          GET_ATTR_FLOAT("lacunarity"),
+                                          p_noise_x,
+                                          p_noise_y,
+                                          p_stretching,
+                                          shift,
+                                          scale);
+               });
+  }
+  else
+  {
+    noise::FractalParameters params;
+    params.octaves = GET_ATTR_INT("octaves");
+    params.weight = GET_ATTR_FLOAT("weight");
+    params.persistence = GET_ATTR_FLOAT("persistence");
+    params.lacunarity = GET_ATTR_FLOAT("lacunarity");
+
+    noise::fill_noise(this->value_out,
+                      noise::noise_type::simplex,
+                      noise::fractal_type::fbm,
+                      GET_ATTR_WAVENB("kw"),
+                      GET_ATTR_SEED("seed"),
+                      params,
+                      (hmap::HeightMap *)this->get_p_data("dx"),
+                      (hmap::HeightMap *)this->get_p_data("dy"),
+                      (hmap::HeightMap *)this->get_p_data("stretching"));
+  }
 
   this->post_process_heightmap(this->value_out);
 }
@@ -33,6 +33,17 @@ void Filter::compute()
   hmap::HeightMap *p_input_hmap = CAST_PORT_REF(hmap::HeightMap, "input");
   hmap::HeightMap *p_input_mask = CAST_PORT_REF(hmap::HeightMap, "mask");
 
+  // incremental update
+  if (this->compute_in_region(
+          this->value_out,
+          {p_input_hmap, p_input_mask},
+          [this](hmap::HeightMap &h, std::vector<hmap::HeightMap *> &p_in)
+          {
+            this->compute_filter(h, p_in[1]);
+            this->post_process_heightmap(h);
+          }))
+    return;
+
   // work on a copy of the input
   this->value_out = *p_input_hmap;
   this->compute_filter(this->value_out, p_input_mask);
@@ -29,6 +29,9 @@ GaborNoise::GaborNoise(std::string     id,
   this->remove_port("dx");
   this->remove_port("dy");
   this->update_inner_bindings();
+
+  // kernels drawn per tile, not a function of the cell positions
+  this->halo = {hesiod::region::halo_type::global, 0};
 }
 
 void GaborNoise::update_inner_bindings()
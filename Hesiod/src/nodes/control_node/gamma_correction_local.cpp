@@ -1,9 +1,13 @@
 /* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
  * Public License. The full license is in the file LICENSE, distributed with
  * this software. */
+#include <algorithm>
+#include <cmath>
+
 #include "macrologger.h"
 
 #include "hesiod/control_node.hpp"
+#include "hesiod/local_stats.hpp"
 
 namespace hesiod::cnode
 {
@@ -32,11 +36,37 @@ void GammaCorrectionLocal::compute_filter(hmap::HeightMap &h,
                   p_mask,
                   [this](hmap::Array &x, hmap::Array *p_mask)
                   {
-                    hmap::gamma_correction_local(x,
-                                                 GET_ATTR_FLOAT("gamma"),
-                                                 GET_ATTR_INT("ir"),
-                                                 p_mask,
-                                                 GET_ATTR_FLOAT("k"));
+                    int   ir = GET_ATTR_INT("ir");
+                    float gamma = GET_ATTR_FLOAT("gamma");
+                    float k = GET_ATTR_FLOAT("k");
+
+                    hmap::Array amin =
+                        local_stats::get_cached(local_stats::minimum, x, ir);
+                    hmap::Array amax =
+                        local_stats::get_cached(local_stats::maximum, x, ir);
+                    hmap::smooth_cpulse(amin, ir);
+                    hmap::smooth_cpulse(amax, ir);
+
+                    for (size_t r = 0; r < x.vector.size(); r++)
+                    {
+                      float dv = amax.vector[r] - amin.vector[r];
+                      float xn = x.vector[r] - amin.vector[r];
+
+                      // smooth absolute value
+                      if (k > 0.f)
+                        xn = std::sqrt(xn * xn + k * k * dv * dv) - k * dv;
+                      else
+                        xn = std::abs(xn);
+
+                      xn = std::clamp(xn / (dv + 1e-30f), 0.f, 1.f);
+                      xn = amin.vector[r] + dv * std::pow(xn, gamma);
+
+                      if (p_mask)
+                        x.vector[r] += p_mask->vector[r] *
+                                       (xn - x.vector[r]);
+                      else
+                        x.vector[r] = xn;
+                    }
                   });
   h.remap(hmin, hmax, 0.f, 1.f);
   h.smooth_overlap_buffers();
@@ -1,11 +1,10 @@
 /* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
  * Public License. The full license is in the file LICENSE, distributed with
  * this software. */
-#include <fstream>
-
 #include "macrologger.h"
 
 #include "hesiod/control_node.hpp"
+#include "hesiod/import_cache.hpp"
 
 namespace hesiod::cnode
 {
@@ -22,8 +21,9 @@ Import::Import(std::string     id,
 
   this->attr["fname"] = NEW_ATTR_FILENAME("");
   this->attr["remap"] = NEW_ATTR_RANGE(true);
+  this->attr["watch_file"] = NEW_ATTR_BOOL(false);
 
-  this->attr_ordered_key = {"fname", "remap"};
+  this->attr_ordered_key = {"fname", "remap", "watch_file"};
 
   this->add_port(
       gnode::Port("output", gnode::direction::out, dtype::dHeightMap));
@@ -39,14 +39,30 @@ void Import::update_inner_bindings()
 
 void Import::compute()
 {
-  // check if the file exist before loading
-  std::ifstream f(GET_ATTR_FILENAME("fname").c_str());
-  if (f.good())
+  // decoded image shared through the cache, only decoded again if the file
+  // changed on disk
+  this->image = hesiod::io::ImageCache::get_instance().get(
+      GET_ATTR_FILENAME("fname"),
+      this->file_key);
+
+  if (this->image)
   {
-    hmap::Array z = hmap::Array(GET_ATTR_FILENAME("fname"));
-    this->value_out.from_array_interp(z);
+    this->image->resample(this->value_out);
     this->post_process_heightmap(this->value_out);
   }
 }
 
+bool Import::has_file_changed()
+{
+  if (!GET_ATTR_BOOL("watch_file"))
+    return false;
+
+  hesiod::io::FileKey key;
+  if (!hesiod::io::get_file_key(GET_ATTR_FILENAME("fname"), key))
+    return false;
+
+  // not loaded yet or modified since
+  return !this->image || !(key == this->file_key);
+}
+
 } // namespace hesiod::cnode
@@ -12,6 +12,8 @@ Laplace::Laplace(std::string id) : ControlNode(id), Filter(id)
 {
   this->node_type = "Laplace";
   this->category = category_mapping.at(this->node_type);
+  this->halo = {hesiod::region::halo_type::radius, 1};
+  this->halo_ir_attr = "iterations";
   this->attr["sigma"] = NEW_ATTR_FLOAT(0.2f, 0.f, 1.f);
   this->attr["iterations"] = NEW_ATTR_INT(3, 1, 10);
 }
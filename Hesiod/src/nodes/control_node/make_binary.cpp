@@ -12,6 +12,7 @@ MakeBinary::MakeBinary(std::string id) : ControlNode(id), Unary(id)
 {
   this->node_type = "MakeBinary";
   this->category = category_mapping.at(this->node_type);
+  this->halo = {hesiod::region::halo_type::pointwise, 0};
   this->attr["threshold"] = NEW_ATTR_FLOAT(0.f, -1.f, 1.f);
 }
 
@@ -36,6 +36,18 @@ void Mask::compute()
   LOG_DEBUG("computing node [%s]", this->id.c_str());
   hmap::HeightMap *p_input = CAST_PORT_REF(hmap::HeightMap, "input");
 
+  // incremental update
+  if (this->compute_in_region(
+          this->value_out,
+          {p_input},
+          [this](hmap::HeightMap &h, std::vector<hmap::HeightMap *> &p_in)
+          {
+            this->compute_mask(h, p_in[0]);
+            h.smooth_overlap_buffers();
+            this->post_process_heightmap(h);
+          }))
+    return;
+
   this->value_out.set_sto(p_input->shape, p_input->tiling, p_input->overlap);
 
   this->compute_mask(this->value_out, p_input);
@@ -4,6 +4,7 @@
 #include "macrologger.h"
 
 #include "hesiod/control_node.hpp"
+#include "hesiod/local_stats.hpp"
 
 namespace hesiod::cnode
 {
@@ -13,6 +14,8 @@ MeanLocal::MeanLocal(std::string id) : ControlNode(id), Filter(id)
   LOG_DEBUG("MeanLocal::MeanLocal()");
   this->node_type = "MeanLocal";
   this->category = category_mapping.at(this->node_type);
+  this->halo = {hesiod::region::halo_type::radius, 1};
+  this->halo_ir_attr = "ir";
   this->attr["ir"] = NEW_ATTR_INT(8, 1, 128);
 }
 
@@ -25,7 +28,11 @@ void MeanLocal::compute_filter(hmap::HeightMap &h, hmap::HeightMap *p_mask)
   hmap::transform(h,
                   p_mask,
                   [this](hmap::Array &x, hmap::Array *p_mask)
-                  { x = hmap::mean_local(x, GET_ATTR_INT("ir")); });
+                  {
+                    x = local_stats::get_cached(local_stats::mean,
+                                                x,
+                                                GET_ATTR_INT("ir"));
+                  });
   h.smooth_overlap_buffers();
 }
 
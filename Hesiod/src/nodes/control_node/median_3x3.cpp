@@ -13,6 +13,7 @@ Median3x3::Median3x3(std::string id) : ControlNode(id), Filter(id)
   LOG_DEBUG("Median3x3::Median3x3()");
   this->node_type = "Median3x3";
   this->category = category_mapping.at(this->node_type);
+  this->halo = {hesiod::region::halo_type::radius, 1};
 }
 
 void Median3x3::compute_filter(hmap::HeightMap &h, hmap::HeightMap *p_mask)
@@ -4,6 +4,7 @@
 #include "macrologger.h"
 
 #include "hesiod/control_node.hpp"
+#include "hesiod/local_stats.hpp"
 
 namespace hesiod::cnode
 {
@@ -13,6 +14,8 @@ MinimumLocal::MinimumLocal(std::string id) : ControlNode(id), Unary(id)
   LOG_DEBUG("MinimumLocal::MinimumLocal()");
   this->node_type = "MinimumLocal";
   this->category = category_mapping.at(this->node_type);
+  this->halo = {hesiod::region::halo_type::radius, 1};
+  this->halo_ir_attr = "ir";
   this->attr["ir"] = NEW_ATTR_INT(8, 1, 128);
 }
 
@@ -25,7 +28,11 @@ void MinimumLocal::compute_in_out(hmap::HeightMap &h_out,
   hmap::transform(h_out,
                   *p_h_in,
                   [this](hmap::Array &x, hmap::Array &y)
-                  { x = hmap::minimum_local(y, GET_ATTR_INT("ir")); });
+                  {
+                    x = local_stats::get_cached(local_stats::minimum,
+                                                y,
+                                                GET_ATTR_INT("ir"));
+                  });
   h_out.smooth_overlap_buffers();
 }
 
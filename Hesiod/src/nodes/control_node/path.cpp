@@ -13,6 +13,7 @@ Path::Path(std::string id) : ControlNode(id)
   LOG_DEBUG("Path::Path()");
   this->node_type = "Path";
   this->category = category_mapping.at(this->node_type);
+  this->halo = {hesiod::region::halo_type::pointwise, 0};
 
   this->attr["path"] = NEW_ATTR_PATH();
 
@@ -25,6 +26,11 @@ void Path::compute()
   this->value_out = GET_ATTR_PATH("path");
 }
 
+hmap::Vec4<float> Path::get_changed_region()
+{
+  return hesiod::region::changed_region(this->value_out, GET_ATTR_PATH("path"));
+}
+
 void Path::update_inner_bindings()
 {
   this->set_p_data("output", (void *)&this->value_out);
@@ -46,29 +46,16 @@ void PathFinding::compute()
   hmap::Vec2<int> wshape = GET_ATTR_SHAPE("shape");
 
   if (p_path->get_npoints() > 1)
-  // work on a subset of the data
   {
-    if (wshape.x > (*p_hmap).shape.x || wshape.y > (*p_hmap).shape.y)
-      wshape = (*p_hmap).shape;
-
-    hmap::Array z = (*p_hmap).to_array(wshape);
-    hmap::remap(z);
-
-    hmap::Array *p_mask_array = nullptr;
-    hmap::Array  mask_array;
-
-    if (p_mask)
-    {
-      mask_array = p_mask->to_array(wshape);
-      p_mask_array = &mask_array;
-    }
-
-    this->value_out.dijkstra(z,
-                             {0.f, 1.f, 0.f, 1.f},
-                             0,
-                             GET_ATTR_FLOAT("elevation_ratio"),
-                             GET_ATTR_FLOAT("distance_exponent"),
-                             p_mask_array);
+    // the path is solved on a coarse level of shape 'wshape' and then
+    // refined up to the full resolution, the cost field is only
+    // rebuilt when the heightmap or the mask change
+    path_finding::update_cost_field(this->cost_field, *p_hmap, p_mask, wshape);
+
+    path_finding::find_path(this->cost_field,
+                            this->value_out,
+                            GET_ATTR_FLOAT("elevation_ratio"),
+                            GET_ATTR_FLOAT("distance_exponent"));
   }
 }
 
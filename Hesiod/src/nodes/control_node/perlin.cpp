@@ -4,6 +4,7 @@
 #include "macrologger.h"
 
 #include "hesiod/control_node.hpp"
+#include "hesiod/noise.hpp"
 
 namespace hesiod::cnode
 {
@@ -28,24 +29,40 @@ void Perlin::compute()
 {
   LOG_DEBUG("computing Perlin node [%s]", this->id.c_str());
 
-  hmap::fill(this->value_out,
-             (hmap::HeightMap *)this->get_p_data("dx"),
-             (hmap::HeightMap *)this->get_p_data("dy"),
-             [this](hmap::Vec2<int>   shape,
-                    hmap::Vec2<float> shift,
-                    hmap::Vec2<float> scale,
-                    hmap::Array      *p_noise_x,
-                    hmap::Array      *p_noise_y)
-             {
-               return hmap::perlin(shape,
-                                   GET_ATTR_WAVENB("kw"),
-                                   GET_ATTR_SEED("seed"),
-                                   p_noise_x,
-                                   p_noise_y,
-                                   nullptr,
-                                   shift,
-                                   scale);
-             });
+  // nodes saved before the batched kernels keep the HighMap functions, so
+  // that existing projects are unchanged (see PRIMITIVE_KERNEL_VERSION)
+  if (this->kernel_version == 0)
+  {
+    hmap::fill(this->value_out,
+               (hmap::HeightMap *)this->get_p_data("dx"),
+               (hmap::HeightMap *)this->get_p_data("dy"),
+               [this](hmap::Vec2<int>   shape,
+                      hmap::Vec2<float> shift,
+                      hmap::Vec2<float> scale,
+                      hmap::Array      *p_noise_x,
+                      hmap::Array      *p_noise_y)
+               {
+                 return hmap::perlin(shape,
+                                     GET_ATTR_WAVENB("kw"),
+                                     GET_ATTR_SEED("seed"),
+                                     p_noise_x,
+                                     p_noise_y,
+                                     nullptr,
+                                     shift,
+                                     scale);
+               });
+  }
+  else
+  {
+    noise::fill_noise(this->value_out,
+                      noise::noise_type::perlin,
+                      noise::fractal_type::none,
+                      GET_ATTR_WAVENB("kw"),
+                      GET_ATTR_SEED("seed"),
+                      noise::FractalParameters(),
+                      (hmap::HeightMap *)this->get_p_data("dx"),
+                      (hmap::HeightMap *)this->get_p_data("dy"));
+  }
 
   this->post_process_heightmap(this->value_out);
 }
@@ -12,6 +12,8 @@ Plateau::Plateau(std::string id) : ControlNode(id), Filter(id)
 {
   this->node_type = "Plateau";
   this->category = category_mapping.at(this->node_type);
+  this->halo = {hesiod::region::halo_type::radius, 2};
+  this->halo_ir_attr = "ir";
 
   this->attr["ir"] = NEW_ATTR_INT(32, 1, 256);
   this->attr["factor"] = NEW_ATTR_FLOAT(4.f, 0.01f, 10.f);
@@ -17,6 +17,9 @@ Primitive::Primitive(std::string     id,
   LOG_DEBUG("Primitive::Primitive()");
   this->value_out.set_sto(shape, tiling, overlap);
 
+  // functions of the cell positions (and of the optional displacements)
+  this->halo = {hesiod::region::halo_type::pointwise, 0};
+
   // parameters
   this->attr["remap"] = NEW_ATTR_RANGE();
   this->attr["inverse"] = NEW_ATTR_BOOL(false);
@@ -35,6 +38,27 @@ Primitive::Primitive(std::string     id,
   this->update_inner_bindings();
 }
 
+bool Primitive::serialize_json_v2(std::string     field_name,
+                                  nlohmann::json &output_data)
+{
+  if (ControlNode::serialize_json_v2(field_name, output_data) == false)
+    return false;
+
+  output_data[field_name]["kernel_version"] = this->kernel_version;
+  return true;
+}
+
+bool Primitive::deserialize_json_v2(std::string     field_name,
+                                    nlohmann::json &input_data)
+{
+  if (ControlNode::deserialize_json_v2(field_name, input_data) == false)
+    return false;
+
+  // missing for files saved before the batched kernels
+  this->kernel_version = input_data[field_name].value("kernel_version", 0);
+  return true;
+}
+
 void Primitive::update_inner_bindings()
 {
   this->set_p_data("output", (void *)&this->value_out);
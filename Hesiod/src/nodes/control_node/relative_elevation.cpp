@@ -4,6 +4,7 @@
 #include "macrologger.h"
 
 #include "hesiod/control_node.hpp"
+#include "hesiod/local_stats.hpp"
 
 namespace hesiod::cnode
 {
@@ -22,11 +23,26 @@ void RelativeElevation::compute_in_out(hmap::HeightMap &h_out,
 {
   LOG_DEBUG("computing filter node [%s]", this->id.c_str());
 
-  h_out = *p_h_in; // copy the input
-
-  hmap::transform(h_out,
-                  [this](hmap::Array &x)
-                  { x = hmap::relative_elevation(x, GET_ATTR_INT("ir")); });
+  int ir = GET_ATTR_INT("ir");
+
+  hmap::transform(
+      h_out,
+      *p_h_in,
+      [&ir](hmap::Array &out, hmap::Array &in)
+      {
+        // smoothed local envelope of the input, the cubic pulse
+        // smoothing is separable
+        hmap::Array amin = local_stats::get_cached(local_stats::minimum,
+                                                   in,
+                                                   ir);
+        hmap::Array amax = local_stats::get_cached(local_stats::maximum,
+                                                   in,
+                                                   ir);
+        hmap::smooth_cpulse(amin, ir);
+        hmap::smooth_cpulse(amax, ir);
+
+        out = (in - amin) / (amax - amin + 1e-30f);
+      });
 
   h_out.smooth_overlap_buffers();
 }
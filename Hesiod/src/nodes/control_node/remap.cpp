@@ -16,13 +16,47 @@ Remap::Remap(std::string id) : ControlNode(id), Unary(id)
   this->attr["remap"] = NEW_ATTR_RANGE(true);
 }
 
+bool Remap::records_statistics()
+{
+  return true;
+}
+
+void Remap::serialize_statistics(nlohmann::json &data)
+{
+  ControlNode::serialize_statistics(data);
+  data["range_in"] = {this->range_in.x, this->range_in.y};
+}
+
+bool Remap::deserialize_statistics(const nlohmann::json &data)
+{
+  if (!data.contains("range_in") || !data["range_in"].is_array() ||
+      data["range_in"].size() != 2)
+    return false;
+
+  if (!ControlNode::deserialize_statistics(data))
+    return false;
+
+  this->range_in = {data["range_in"][0].get<float>(),
+                    data["range_in"][1].get<float>()};
+  return true;
+}
+
 void Remap::compute_in_out(hmap::HeightMap &h_out, hmap::HeightMap *p_h_in)
 {
   LOG_DEBUG("computing node [%s]", this->id.c_str());
 
   // make a copy of the input and applied range remapping
   h_out = *p_h_in;
-  h_out.remap(GET_ATTR_RANGE("remap").x, GET_ATTR_RANGE("remap").y);
+
+  // the remapping depends on the input range, which is not known from a
+  // region of the domain
+  if (!this->roi_evaluation)
+    this->range_in = {h_out.min(), h_out.max()};
+
+  h_out.remap(GET_ATTR_RANGE("remap").x,
+              GET_ATTR_RANGE("remap").y,
+              this->range_in.x,
+              this->range_in.y);
 }
 
 } // namespace hesiod::cnode
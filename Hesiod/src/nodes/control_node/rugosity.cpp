@@ -4,6 +4,7 @@
 #include "macrologger.h"
 
 #include "hesiod/control_node.hpp"
+#include "hesiod/local_stats.hpp"
 
 namespace hesiod::cnode
 {
@@ -12,6 +13,8 @@ Rugosity::Rugosity(std::string id) : ControlNode(id), Mask(id)
 {
   this->node_type = "Rugosity";
   this->category = category_mapping.at(this->node_type);
+  this->halo = {hesiod::region::halo_type::radius, 2};
+  this->halo_ir_attr = "ir";
 
   this->attr["ir"] = NEW_ATTR_INT(32, 1, 256);
   this->attr["clamp_max"] = NEW_ATTR_BOOL(false);
@@ -32,11 +35,17 @@ void Rugosity::compute_mask(hmap::HeightMap &h_out, hmap::HeightMap *p_h_in)
 {
   LOG_DEBUG("computing node [%s]", this->id.c_str());
 
-  // make a copy of the input and applied range remapping
+  // rugosity is estimated by the (positive) local skewness of the
+  // elevation
   hmap::transform(h_out,
                   *p_h_in,
                   [this](hmap::Array &out, hmap::Array &in)
-                  { out = hmap::rugosity(in, GET_ATTR_INT("ir")); });
+                  {
+                    out = local_stats::get_cached(local_stats::skewness,
+                                                  in,
+                                                  GET_ATTR_INT("ir"));
+                    hmap::clamp_min(out, 0.f);
+                  });
 
   if (GET_ATTR_BOOL("clamp_max"))
     hmap::transform(h_out,
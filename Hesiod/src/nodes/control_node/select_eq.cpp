@@ -12,6 +12,7 @@ SelectEq::SelectEq(std::string id) : ControlNode(id), Mask(id)
 {
   this->node_type = "SelectEq";
   this->category = category_mapping.at(this->node_type);
+  this->halo = {hesiod::region::halo_type::pointwise, 0};
 
   this->attr["value"] = NEW_ATTR_FLOAT(0.f, -1.f, 1.f);
 
@@ -12,6 +12,7 @@ SelectInterval::SelectInterval(std::string id) : ControlNode(id), Mask(id)
 {
   this->node_type = "SelectInterval";
   this->category = category_mapping.at(this->node_type);
+  this->halo = {hesiod::region::halo_type::pointwise, 0};
 
   this->attr["value_low"] = NEW_ATTR_FLOAT(0.f, -1.f, 2.f);
   this->attr["value_high"] = NEW_ATTR_FLOAT(0.5f, -1.f, 2.f);
@@ -12,6 +12,8 @@ SmoothCpulse::SmoothCpulse(std::string id) : ControlNode(id), Filter(id)
 {
   this->node_type = "SmoothCpulse";
   this->category = category_mapping.at(this->node_type);
+  this->halo = {hesiod::region::halo_type::radius, 1};
+  this->halo_ir_attr = "ir";
   this->attr["ir"] = NEW_ATTR_INT(8, 1, 128);
 }
 
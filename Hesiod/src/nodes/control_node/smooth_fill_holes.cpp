@@ -13,6 +13,10 @@ SmoothFillHoles::SmoothFillHoles(std::string id) : ControlNode(id), Filter(id)
   LOG_DEBUG("SmoothFillHoles::SmoothFillHoles()");
   this->node_type = "SmoothFillHoles";
   this->category = category_mapping.at(this->node_type);
+  // smoothing (ir), curvature of the smoothed data (1 cell) and smoothing of
+  // the resulting mask (ir / 2), within 2 * ir cells
+  this->halo = {hesiod::region::halo_type::radius, 2};
+  this->halo_ir_attr = "ir";
   this->attr["ir"] = NEW_ATTR_INT(8, 1, 128);
 }
 
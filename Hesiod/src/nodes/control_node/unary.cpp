@@ -28,6 +28,17 @@ void Unary::compute()
   LOG_DEBUG("computing node [%s]", this->id.c_str());
   hmap::HeightMap *p_input_hmap = CAST_PORT_REF(hmap::HeightMap, "input");
 
+  // incremental update
+  if (this->compute_in_region(
+          this->value_out,
+          {p_input_hmap},
+          [this](hmap::HeightMap &h, std::vector<hmap::HeightMap *> &p_in)
+          {
+            this->compute_in_out(h, p_in[0]);
+            this->post_process_heightmap(h);
+          }))
+    return;
+
   this->value_out.set_sto(p_input_hmap->shape,
                           p_input_hmap->tiling,
                           p_input_hmap->overlap);
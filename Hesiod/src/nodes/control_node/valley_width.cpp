@@ -28,6 +28,8 @@ void ValleyWidth::compute_mask(hmap::HeightMap &h_out, hmap::HeightMap *p_h_in)
 {
   LOG_DEBUG("computing node [%s]", this->id.c_str());
 
+  // TODO move to the local statistics module, the HighMap kernel is kept
+  // for now since it is not a window statistic
   hmap::transform(h_out,
                   *p_h_in,
                   [this](hmap::Array &out, hmap::Array &in)
@@ -4,6 +4,7 @@
 #include "macrologger.h"
 
 #include "hesiod/control_node.hpp"
+#include "hesiod/noise.hpp"
 
 namespace hesiod::cnode
 {
@@ -32,21 +33,34 @@ void WaveSine::compute()
 {
   LOG_DEBUG("computing WaveSine node [%s]", this->id.c_str());
 
-  hmap::fill(this->value_out,
-             (hmap::HeightMap *)this->get_p_data("dx"),
-             [this](hmap::Vec2<int>   shape,
-                    hmap::Vec2<float> shift,
-                    hmap::Vec2<float> scale,
-                    hmap::Array      *p_noise_x)
-             {
-               return hmap::wave_sine(shape,
-                                      GET_ATTR_FLOAT("kw"),
-                                      GET_ATTR_FLOAT("angle"),
-                                      GET_ATTR_FLOAT("phase_shift"),
-                                      p_noise_x,
-                                      shift,
-                                      scale);
-             });
+  // nodes saved before the batched kernels keep the HighMap functions, so
+  // that existing projects are unchanged (see PRIMITIVE_KERNEL_VERSION)
+  if (this->kernel_version == 0)
+  {
+    hmap::fill(this->value_out,
+               (hmap::HeightMap *)this->get_p_data("dx"),
+               [this](hmap::Vec2<int>   shape,
+                      hmap::Vec2<float> shift,
+                      hmap::Vec2<float> scale,
+                      hmap::Array      *p_noise_x)
+               {
+                 return hmap::wave_sine(shape,
+                                        GET_ATTR_FLOAT("kw"),
+                                        GET_ATTR_FLOAT("angle"),
+                                        GET_ATTR_FLOAT("phase_shift"),
+                                        p_noise_x,
+                                        shift,
+                                        scale);
+               });
+  }
+  else
+  {
+    noise::fill_wave_sine(this->value_out,
+                          GET_ATTR_FLOAT("kw"),
+                          GET_ATTR_FLOAT("angle"),
+                          GET_ATTR_FLOAT("phase_shift"),
+                          (hmap::HeightMap *)this->get_p_data("dx"));
+  }
 
   this->post_process_heightmap(this->value_out);
 }
@@ -28,8 +28,12 @@ bool ViewBrush::render_settings()
 
   has_changed |= this->render_settings_header();
 
-  if (hesiod::gui::hmap_brush_editor(this->value_out))
-    this->force_update();
+  // painting only modifies the stroke region, which is handed over to the
+  // tree for an incremental update of the downstream nodes
+  hmap::Vec4<float> region;
+
+  if (hesiod::gui::hmap_brush_editor(this->value_out, 0.f, &region))
+    this->edited_region = hesiod::region::merge(this->edited_region, region);
 
   if (this->remap)
   {
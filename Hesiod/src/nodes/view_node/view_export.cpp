@@ -13,6 +13,9 @@ void ViewExport::render_node_specific_content()
 {
   if (ImGui::Button("export!"))
     this->write_file();
+
+  // background write of the file
+  hesiod::gui::export_status(GET_ATTR_FILENAME("fname"), this->node_width);
 }
 
 } // namespace hesiod::vnode
@@ -1,6 +1,7 @@
 /* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
  * Public License. The full license is in the file LICENSE, distributed with
  * this software. */
+#include <algorithm>
 #include <list>
 
 #include "gnode.hpp"
@@ -8,6 +9,7 @@
 #include <imgui_node_editor.h>
 
 #include "hesiod/gui.hpp"
+#include "hesiod/tile_pyramid.hpp"
 #include "hesiod/view_node.hpp"
 
 // --- HELPERS
@@ -44,11 +46,34 @@ ViewNode::ViewNode(std::string id) : hesiod::cnode::ControlNode(id)
                                  { this->post_control_node_update(); });
 }
 
+ViewNode::~ViewNode()
+{
+  // the data pointers are only used as keys, the data may already be gone
+  for (auto &[port_id, port] : this->get_ports())
+    if (port.direction == gnode::direction::out &&
+        port.dtype == hesiod::cnode::dtype::dHeightMap)
+      hesiod::io::TileStore::get_instance().forget(
+          (hmap::HeightMap *)this->get_p_data(port_id));
+}
+
+void ViewNode::ensure_data()
+{
+  for (auto &[port_id, port] : this->get_ports())
+    if (port.dtype == hesiod::cnode::dtype::dHeightMap)
+      hesiod::io::TileStore::get_instance().ensure(
+          (hmap::HeightMap *)this->get_p_data(port_id));
+}
+
 std::string ViewNode::get_preview_port_id()
 {
   return this->preview_port_id;
 }
 
+hmap::Vec2<int> ViewNode::get_shape_preview()
+{
+  return this->shape_preview;
+}
+
 std::string ViewNode::get_view3d_elevation_port_id()
 {
   return this->view3d_elevation_port_id;
@@ -107,6 +132,10 @@ void ViewNode::pre_control_node_update()
 {
   LOG_DEBUG("pre-update, node [%s]", this->id.c_str());
 
+  // inputs and outputs (regional updates reuse the outputs) compressed while
+  // idle
+  this->ensure_data();
+
   this->timer.reset();
 }
 
@@ -115,6 +144,26 @@ void ViewNode::post_control_node_update()
   LOG_DEBUG("post-update, node [%s]", this->id.c_str());
 
   this->update_time = this->timer.stop();
+  this->autosave_stale = true;
+
+  hesiod::io::TileStore &store = hesiod::io::TileStore::get_instance();
+
+  // outputs computed from lossy inputs are approximations as well
+  bool lossy = false;
+
+  for (auto &[port_id, port] : this->get_ports())
+    if (port.direction == gnode::direction::in &&
+        port.dtype == hesiod::cnode::dtype::dHeightMap)
+      lossy = lossy || store.is_lossy(
+                           (hmap::HeightMap *)this->get_p_data(port_id));
+
+  for (auto &[port_id, port] : this->get_ports())
+    if (port.direction == gnode::direction::out &&
+        port.dtype == hesiod::cnode::dtype::dHeightMap)
+    {
+      store.touch((hmap::HeightMap *)this->get_p_data(port_id));
+      store.set_lossy((hmap::HeightMap *)this->get_p_data(port_id), lossy);
+    }
 
   if (this->preview_port_id != "")
     this->update_preview();
@@ -227,6 +276,10 @@ void ViewNode::render_node()
 
   // title bar background
   ImRect node_content_rect = ImGui_GetItemRect();
+
+  // previews are only regenerated for the nodes visible in the editor
+  this->preview_visible = ImGui::IsRectVisible(node_content_rect.Min,
+                                               node_content_rect.Max);
   float  height = text_content_rect.GetBR().y - text_content_rect.GetTL().y;
 
   ImDrawList *draw_list = ax::NodeEditor::GetNodeBackgroundDrawList(
@@ -243,6 +296,66 @@ void ViewNode::render_node()
   ImGui::PopID();
 }
 
+void ViewNode::render_node_placeholder()
+{
+  ImGui::PushID((void *)this);
+
+  ax::NodeEditor::NodeId node_id = ax::NodeEditor::NodeId(this->hash_id);
+  ImVec4                 padding = ax::NodeEditor::GetStyle().NodePadding;
+  ImVec2                 size = ax::NodeEditor::GetNodeSize(node_id);
+  ImVec2 content_size = ImVec2(std::max(0.f, size.x - padding.x - padding.z),
+                               std::max(0.f, size.y - padding.y - padding.w));
+
+  ax::NodeEditor::BeginNode(node_id);
+  ImVec2 pos0 = ImGui::GetCursorPos();
+
+  // pins are still needed for the links to be drawn, inputs on the left side
+  // and outputs on the right side
+  ImGui::TextUnformatted("");
+  ImGui::Spacing();
+
+  for (auto &[port_id, port] : this->get_ports())
+    if (port.direction == gnode::direction::in)
+    {
+      ax::NodeEditor::BeginPin(ax::NodeEditor::PinId(port.hash_id),
+                               ax::NodeEditor::PinKind::Input);
+      ImGui::Dummy(ImVec2(10.f, 10.f));
+      ax::NodeEditor::EndPin();
+    }
+
+  for (auto &[port_id, port] : this->get_ports())
+    if (port.direction == gnode::direction::out)
+    {
+      ImGui::SetCursorPosX(pos0.x + std::max(0.f, content_size.x - 10.f));
+      ax::NodeEditor::BeginPin(ax::NodeEditor::PinId(port.hash_id),
+                               ax::NodeEditor::PinKind::Output);
+      ImGui::Dummy(ImVec2(10.f, 10.f));
+      ax::NodeEditor::EndPin();
+    }
+
+  // keep the node size of the last full rendering
+  ImGui::SetCursorPos(pos0);
+  ImGui::Dummy(content_size);
+
+  ax::NodeEditor::EndNode();
+
+  this->preview_visible = false;
+
+  ImGui::PopID();
+}
+
+bool ViewNode::is_visible_in_editor()
+{
+  ax::NodeEditor::NodeId node_id = ax::NodeEditor::NodeId(this->hash_id);
+  ImVec2                 size = ax::NodeEditor::GetNodeSize(node_id);
+
+  if (size.x <= 0.f || size.y <= 0.f)
+    return true;
+
+  ImVec2 pos = ax::NodeEditor::GetNodePosition(node_id);
+  return ImGui::IsRectVisible(pos, ImVec2(pos.x + size.x, pos.y + size.y));
+}
+
 void ViewNode::render_node_minimalist()
 {
   ImGui::PushID((void *)this);
@@ -376,10 +489,22 @@ bool ViewNode::render_settings()
       has_changed |= this->attr.at(k)->render_settings(k.c_str());
   }
 
+  // local edits are handed over to the tree for an incremental update
   if (has_changed)
-    this->force_update();
+  {
+    hmap::Vec4<float> region = this->get_changed_region();
+
+    if (hesiod::region::is_full(region))
+      this->force_update();
+    else
+      this->edited_region = hesiod::region::merge(this->edited_region, region);
+  }
 
   has_changed |= this->render_settings_footer();
+
+  if (has_changed)
+    this->autosave_stale = true;
+
   return has_changed;
 }
 
@@ -399,6 +524,9 @@ bool ViewNode::render_settings_header()
   ImGui::SameLine();
   if (ImGui::Checkbox("Frozen outputs", &this->frozen_outputs))
   {
+    // the frozen content is hashed again when the output cache is saved
+    this->frozen_key = "";
+
     // ignite force update when the node is unfrozzen to update
     // downstream nodes
     if (!this->frozen_outputs)
@@ -486,141 +614,147 @@ bool ViewNode::trigger_update_after_edit()
 
 void ViewNode::update_preview()
 {
-  if (this->preview_port_id != "" && this->show_preview)
-  {
-    void *p_data = this->get_p_data(this->preview_port_id);
-    if (p_data)
-    {
-      int port_dtype = this->get_port_ref_by_id(preview_port_id)->dtype;
+  this->preview_stale = true;
+}
 
-      switch (port_dtype)
-      {
+bool ViewNode::is_preview_requested()
+{
+  return this->preview_stale && this->preview_visible && this->show_preview &&
+         this->preview_port_id != "";
+}
 
-      case hesiod::cnode::dArray:
-      {
-        hmap::Array         *p_a = (hmap::Array *)p_data;
-        std::vector<uint8_t> img = {};
-
-        hmap::Array array = p_a->resample_to_shape(this->shape_preview);
-
-        if (this->preview_type == preview_type::grayscale)
-        {
-          img = hmap::colorize_grayscale(array);
-          img_to_texture(img, this->shape_preview, this->image_texture_preview);
-        }
-        else if (this->preview_type == preview_type::jet)
-        {
-          img = hmap::colorize(array,
-                               array.min(),
-                               array.max(),
-                               hmap::cmap::jet,
-                               false);
-          img_to_texture_rgb(img,
-                             this->shape_preview,
-                             this->image_texture_preview);
-        }
-        else if (this->preview_type == preview_type::histogram)
-        {
-          img = hmap::colorize_histogram(array);
-          img_to_texture(img, this->shape_preview, this->image_texture_preview);
-        }
-      }
-      break;
+bool ViewNode::is_preview_shown()
+{
+  return this->preview_visible && this->show_preview &&
+         this->preview_port_id != "";
+}
 
-      case hesiod::cnode::dCloud:
-      {
-        hmap::Cloud          cloud = *(hmap::Cloud *)p_data;
-        std::vector<uint8_t> img = {};
+PreviewImage ViewNode::compute_preview_image()
+{
+  PreviewImage preview;
 
-        hmap::Array       array = hmap::Array(this->shape_preview);
-        hmap::Vec4<float> bbox = hmap::Vec4<float>(0.f, 1.f, 0.f, 1.f);
+  this->preview_stale = false;
 
-        if (cloud.get_npoints() > 0)
-        {
-          cloud.set_values(1.f);
-          cloud.to_array(array, bbox);
-        }
+  if (this->preview_port_id == "")
+    return preview;
 
-        img = hmap::colorize_grayscale(array);
-        img_to_texture(img, this->shape_preview, this->image_texture_preview);
-      }
-      break;
+  void *p_data = this->get_p_data(this->preview_port_id);
+  if (!p_data)
+    return preview;
 
-      case hesiod::cnode::dHeightMap:
-      {
-        hmap::HeightMap     *p_h = (hmap::HeightMap *)p_data;
-        std::vector<uint8_t> img = {};
-
-        hmap::Array array = p_h->to_array(this->shape_preview);
-
-        if (this->preview_type == preview_type::grayscale)
-        {
-          img = hmap::colorize_grayscale(array);
-          img_to_texture(img, this->shape_preview, this->image_texture_preview);
-        }
-        else if (this->preview_type == preview_type::jet)
-        {
-          img = hmap::colorize(array,
-                               array.min(),
-                               array.max(),
-                               hmap::cmap::jet,
-                               false);
-          img_to_texture_rgb(img,
-                             this->shape_preview,
-                             this->image_texture_preview);
-        }
-        else if (this->preview_type == preview_type::histogram)
-        {
-          img = hmap::colorize_histogram(array);
-          img_to_texture(img, this->shape_preview, this->image_texture_preview);
-        }
-      }
-      break;
+  int port_dtype = this->get_port_ref_by_id(preview_port_id)->dtype;
 
-      case hesiod::cnode::dHeightMapRGB:
-      {
-        hmap::HeightMapRGB  *p_c = (hmap::HeightMapRGB *)p_data;
-        std::vector<uint8_t> img = {};
+  // scalar data are box-filtered down to the preview resolution, directly
+  // from the tiles for heightmaps
+  auto colorize_array = [this, &preview](hmap::Array &array)
+  {
+    if (this->preview_type == preview_type::grayscale)
+      preview.img = hmap::colorize_grayscale(array);
+    else if (this->preview_type == preview_type::jet)
+    {
+      preview.img = hmap::colorize(array,
+                                   array.min(),
+                                   array.max(),
+                                   hmap::cmap::jet,
+                                   false);
+      preview.rgb = true;
+    }
+    else if (this->preview_type == preview_type::histogram)
+      preview.img = hmap::colorize_histogram(array);
+  };
 
-        if (p_c->shape.x > 0)
-          img = p_c->to_img_8bit(this->shape_preview);
+  switch (port_dtype)
+  {
 
-        img_to_texture_rgb(img,
-                           this->shape_preview,
-                           this->image_texture_preview);
-      }
-      break;
+  case hesiod::cnode::dArray:
+  {
+    hmap::Array array = hesiod::viewer::box_downsample(*(hmap::Array *)p_data,
+                                                       this->shape_preview);
+    colorize_array(array);
+  }
+  break;
 
-      case hesiod::cnode::dPath:
-      {
-        hmap::Path           path = *(hmap::Path *)p_data;
-        std::vector<uint8_t> img = {};
+  case hesiod::cnode::dCloud:
+  {
+    hmap::Cloud cloud = *(hmap::Cloud *)p_data;
 
-        hmap::Array       array = hmap::Array(this->shape_preview);
-        hmap::Vec4<float> bbox = hmap::Vec4<float>(0.f, 1.f, 0.f, 1.f);
+    hmap::Array       array = hmap::Array(this->shape_preview);
+    hmap::Vec4<float> bbox = hmap::Vec4<float>(0.f, 1.f, 0.f, 1.f);
 
-        if (path.get_npoints() > 1)
-        {
-          path.set_values(1.f);
-          path.to_array(array, bbox);
-        }
+    if (cloud.get_npoints() > 0)
+    {
+      cloud.set_values(1.f);
+      cloud.to_array(array, bbox);
+    }
 
-        img = hmap::colorize_grayscale(array);
-        img_to_texture(img, this->shape_preview, this->image_texture_preview);
-      }
-      break;
-      }
+    preview.img = hmap::colorize_grayscale(array);
+  }
+  break;
+
+  case hesiod::cnode::dHeightMap:
+  {
+    hmap::Array array = hesiod::viewer::box_downsample(
+        *(hmap::HeightMap *)p_data,
+        this->shape_preview);
+    colorize_array(array);
+  }
+  break;
+
+  case hesiod::cnode::dHeightMapRGB:
+  {
+    hmap::HeightMapRGB *p_c = (hmap::HeightMapRGB *)p_data;
+
+    if (p_c->shape.x > 0)
+      preview.img = p_c->to_img_8bit(this->shape_preview);
+    preview.rgb = true;
+  }
+  break;
+
+  case hesiod::cnode::dPath:
+  {
+    hmap::Path path = *(hmap::Path *)p_data;
+
+    hmap::Array       array = hmap::Array(this->shape_preview);
+    hmap::Vec4<float> bbox = hmap::Vec4<float>(0.f, 1.f, 0.f, 1.f);
+
+    if (path.get_npoints() > 1)
+    {
+      path.set_values(1.f);
+      path.to_array(array, bbox);
     }
+
+    preview.img = hmap::colorize_grayscale(array);
+  }
+  break;
   }
+
+  return preview;
+}
+
+void ViewNode::upload_preview_image(const PreviewImage &preview,
+                                    bool                from_pixel_buffer)
+{
+  if (!from_pixel_buffer && preview.img.empty())
+    return;
+
+  const uint8_t *p_data = from_pixel_buffer ? nullptr : preview.img.data();
+
+  if (preview.rgb)
+    img_to_texture_rgb(p_data,
+                       this->shape_preview,
+                       this->image_texture_preview);
+  else
+    img_to_texture(p_data, this->shape_preview, this->image_texture_preview);
 }
 
 // HELPERS
 
-void img_to_texture(std::vector<uint8_t> img,
-                    hmap::Vec2<int>      shape,
-                    GLuint              &image_texture)
+void img_to_texture(const uint8_t  *p_data,
+                    hmap::Vec2<int> shape,
+                    GLuint         &image_texture)
 {
-  glGenTextures(1, &image_texture);
+  if (!image_texture)
+    glGenTextures(1, &image_texture);
   glBindTexture(GL_TEXTURE_2D, image_texture);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -640,14 +774,15 @@ void img_to_texture(std::vector<uint8_t> img,
                0,
                GL_LUMINANCE,
                GL_UNSIGNED_BYTE,
-               img.data());
+               p_data);
 }
 
-void img_to_texture_rgb(std::vector<uint8_t> img,
-                        hmap::Vec2<int>      shape,
-                        GLuint              &image_texture)
+void img_to_texture_rgb(const uint8_t  *p_data,
+                        hmap::Vec2<int> shape,
+                        GLuint         &image_texture)
 {
-  glGenTextures(1, &image_texture);
+  if (!image_texture)
+    glGenTextures(1, &image_texture);
   glBindTexture(GL_TEXTURE_2D, image_texture);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -667,7 +802,7 @@ void img_to_texture_rgb(std::vector<uint8_t> img,
                0,
                GL_RGB,
                GL_UNSIGNED_BYTE,
-               img.data());
+               p_data);
 }
 
 } // namespace hesiod::vnode
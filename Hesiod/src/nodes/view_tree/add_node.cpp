@@ -450,6 +450,7 @@ std::string ViewTree::add_view_node(std::string control_node_type,
     }
   }
 
+  this->draw_lists_stale = true;
   return id;
 }
 
@@ -0,0 +1,80 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+#include <memory>
+
+#include "gnode.hpp"
+#include "macrologger.h"
+
+#include "hesiod/autosave.hpp"
+#include "hesiod/export_queue.hpp"
+#include "hesiod/view_node.hpp"
+#include "hesiod/view_tree.hpp"
+
+namespace hesiod::vnode
+{
+
+void ViewTree::update_autosave()
+{
+  if (!this->autosave ||
+      this->autosave_timer.stop() < 1e3f * this->autosave_interval)
+    return;
+
+  // serialized data of the nodes, only for the nodes modified since the
+  // previous snapshot and within the frame budget, the snapshot being
+  // completed over the next frames if needed
+  Timer timer = Timer();
+  bool  has_changed = false;
+
+  std::erase_if(this->autosave_nodes,
+                [this](const auto &item)
+                { return !this->is_node_id_in_keys(item.first); });
+
+  for (auto &[id, node] : this->get_nodes_map())
+  {
+    ViewNode *p_vnode = this->get_node_ref_by_id<ViewNode>(id);
+
+    if (!p_vnode->autosave_stale && this->autosave_nodes.contains(id))
+      continue;
+
+    if (timer.stop() > AUTOSAVE_FRAME_BUDGET_MS)
+      return;
+
+    this->autosave_nodes[id] = std::make_shared<const nlohmann::json>(
+        this->serialize_node_json_v2(id));
+    p_vnode->autosave_stale = false;
+    has_changed = true;
+  }
+
+  hesiod::io::StateSnapshot snapshot;
+  snapshot.header = this->serialize_header_json_v2();
+
+  // nothing to save (node positions and links included)
+  if (!has_changed && snapshot.header == this->autosave_header &&
+      this->autosave_nodes.size() == this->autosave_nnodes)
+  {
+    this->autosave_timer.reset();
+    return;
+  }
+
+  for (auto &[id, p_data] : this->autosave_nodes)
+    snapshot.nodes.push_back(p_data);
+
+  this->autosave_header = snapshot.header;
+  this->autosave_nnodes = this->autosave_nodes.size();
+  this->autosave_timer.reset();
+
+  LOG_DEBUG("autosave, snapshot taken (%f ms)", timer.stop());
+
+  // serialization, disk write and sync on the I/O thread
+  auto p_snapshot = std::make_shared<const hesiod::io::StateSnapshot>(
+      std::move(snapshot));
+  std::string fname = this->autosave_fname;
+
+  hesiod::io::ExportQueue::get_instance().push(
+      fname,
+      [p_snapshot, fname](std::function<void(float)>)
+      { hesiod::io::write_state_snapshot(fname, *p_snapshot); });
+}
+
+} // namespace hesiod::vnode
@@ -0,0 +1,206 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+#include <algorithm>
+#include <functional>
+#include <set>
+
+#include "gnode.hpp"
+#include "macrologger.h"
+
+#include "hesiod/tile_compression.hpp"
+#include "hesiod/timer.hpp"
+#include "hesiod/view_node.hpp"
+#include "hesiod/view_tree.hpp"
+
+namespace hesiod::vnode
+{
+
+bool ViewTree::is_preview_only(std::string node_id)
+{
+  std::vector<std::string> queue = {node_id};
+  std::set<std::string>    visited = {node_id};
+
+  while (!queue.empty())
+  {
+    std::string id = queue.back();
+    queue.pop_back();
+
+    std::string type = this->get_node_type(id);
+    if (type == "Export" || type == "ExportRGB")
+      return false;
+
+    for (auto &[link_id, link] : this->links)
+      if (link.node_id_from == id && visited.insert(link.node_id_to).second)
+        queue.push_back(link.node_id_to);
+  }
+
+  return true;
+}
+
+std::set<std::string> ViewTree::get_lossy_nodes()
+{
+  hesiod::io::TileStore &store = hesiod::io::TileStore::get_instance();
+
+  std::vector<std::string> queue = {};
+  std::set<std::string>    lossy_ids = {};
+
+  for (auto &[id, node] : this->get_nodes_map())
+    for (auto &[port_id, port] : node->get_ports())
+      if (port.direction == gnode::direction::out &&
+          port.dtype == hesiod::cnode::dtype::dHeightMap &&
+          store.is_lossy((hmap::HeightMap *)node->get_p_data(port_id)))
+      {
+        if (lossy_ids.insert(id).second)
+          queue.push_back(id);
+      }
+
+  // downstream nodes, whatever their outputs (clouds or paths computed from
+  // lossy data are not marked)
+  while (!queue.empty())
+  {
+    std::string id = queue.back();
+    queue.pop_back();
+
+    for (auto &[link_id, link] : this->links)
+      if (link.node_id_from == id && lossy_ids.insert(link.node_id_to).second)
+        queue.push_back(link.node_id_to);
+  }
+
+  return lossy_ids;
+}
+
+void ViewTree::restore_exact_data()
+{
+  std::set<std::string> lossy_ids = this->get_lossy_nodes();
+
+  if (lossy_ids.empty())
+    return;
+
+  // upstream-first order of the lossy nodes
+  std::vector<std::string> order = {};
+  std::set<std::string>    visited = {};
+
+  std::function<void(const std::string &)> visit =
+      [this, &lossy_ids, &order, &visited, &visit](const std::string &id)
+  {
+    if (!visited.insert(id).second)
+      return;
+
+    for (auto &[link_id, link] : this->links)
+      if (link.node_id_to == id && lossy_ids.contains(link.node_id_from))
+        visit(link.node_id_from);
+
+    order.push_back(id);
+  };
+
+  for (auto &id : lossy_ids)
+    visit(id);
+
+  Timer timer = Timer();
+
+  for (auto &id : order)
+  {
+    ViewNode *p_vnode = this->get_node_ref_by_id<ViewNode>(id);
+
+    if (p_vnode->frozen_outputs || !p_vnode->is_up_to_date)
+      continue;
+
+    p_vnode->pre_control_node_update();
+    p_vnode->compute();
+    p_vnode->post_control_node_update();
+  }
+
+  LOG_DEBUG("%ld node(s) with lossy data computed again (%f ms)",
+            order.size(),
+            timer.stop());
+}
+
+void ViewTree::update_idle_compression()
+{
+  if (!this->idle_compression)
+    return;
+
+  hesiod::io::TileStore &store = hesiod::io::TileStore::get_instance();
+
+  // data read by the viewers (viewer node ports, inputs included since they
+  // can be previewed or displayed in 3D), never compressed
+  std::set<hmap::HeightMap *> p_viewed = {};
+
+  if (this->is_node_id_in_keys(this->viewer_node_id))
+  {
+    gnode::Node *p_viewer = this->get_node_ref_by_id(this->viewer_node_id);
+
+    for (auto &[port_id, port] : p_viewer->get_ports())
+      if (port.dtype == hesiod::cnode::dtype::dHeightMap)
+        p_viewed.insert((hmap::HeightMap *)p_viewer->get_p_data(port_id));
+  }
+
+  // at most one node per frame, the first one found idle
+  for (auto &[id, node] : this->get_nodes_map())
+  {
+    if (id == this->viewer_node_id || !node->is_up_to_date)
+      continue;
+
+    std::vector<hmap::HeightMap *> p_outputs = {};
+    bool                           heightmaps_only = true;
+
+    for (auto &[port_id, port] : node->get_ports())
+      if (port.direction == gnode::direction::out)
+      {
+        if (port.dtype != hesiod::cnode::dtype::dHeightMap)
+          heightmaps_only = false;
+        else
+          p_outputs.push_back((hmap::HeightMap *)node->get_p_data(port_id));
+      }
+
+    if (!heightmaps_only || p_outputs.empty() ||
+        std::any_of(p_outputs.begin(),
+                    p_outputs.end(),
+                    [&p_viewed](hmap::HeightMap *p_h)
+                    { return p_viewed.contains(p_h); }))
+      continue;
+
+    bool is_idle = std::all_of(
+        p_outputs.begin(),
+        p_outputs.end(),
+        [&store](hmap::HeightMap *p_h)
+        {
+          return store.is_compressed(p_h) ||
+                 store.get_idle_time(p_h) > TILE_COMPRESSION_IDLE_MS;
+        });
+
+    if (!is_idle)
+      continue;
+
+    // frozen outputs cannot be computed again
+    bool lossy = this->compression_max_error > 0.f && !node->frozen_outputs &&
+                 this->is_preview_only(id);
+    bool has_compressed = false;
+    Timer timer = Timer();
+
+    for (auto p_h : p_outputs)
+    {
+      if (store.is_compressed(p_h))
+        continue;
+
+      // error bound relative to the data amplitude
+      float max_error = lossy ? this->compression_max_error *
+                                    (p_h->max() - p_h->min())
+                              : 0.f;
+
+      has_compressed = store.compress(p_h, max_error) || has_compressed;
+    }
+
+    if (has_compressed)
+    {
+      LOG_DEBUG("node [%s] outputs compressed (%f ms, lossy: %d)",
+                id.c_str(),
+                timer.stop(),
+                lossy);
+      return;
+    }
+  }
+}
+
+} // namespace hesiod::vnode
@@ -0,0 +1,246 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+#include <filesystem>
+#include <map>
+#include <memory>
+
+#include "gnode.hpp"
+#include "macrologger.h"
+
+#include "hesiod/attribute.hpp"
+#include "hesiod/control_node.hpp"
+#include "hesiod/distributed.hpp"
+#include "hesiod/heightmap_writer.hpp"
+#include "hesiod/region.hpp"
+#include "hesiod/timer.hpp"
+#include "hesiod/view_tree.hpp"
+
+namespace hesiod::vnode
+{
+
+bool ViewTree::render_tiles(const hesiod::distributed::RenderSettings &settings)
+{
+  // the workers share the export files with the coordinator, the exports of
+  // the whole domain pass are not written
+  for (auto &[id, node] : this->get_nodes_map())
+    if (this->get_node_type(id) == "Export" ||
+        this->get_node_type(id) == "ExportRGB")
+      this->get_node_ref_by_id<hesiod::cnode::ControlNode>(id)
+          ->attr.at("auto_export")
+          ->get_ref<BoolAttribute>()
+          ->value = false;
+
+  std::vector<hesiod::cnode::Export *>             exports = {};
+  std::vector<std::pair<std::string, std::string>> targets = {};
+  std::vector<hmap::Vec2<float>>                   ranges = {};
+
+  if (!this->prepare_exports(exports, targets, ranges))
+    return false;
+
+  std::vector<hmap::Vec4<int>> tiles = hesiod::region::partition(
+      settings.shape,
+      settings.super_tile);
+
+  // workers started by hand may start before the coordinator
+  std::filesystem::create_directories(hesiod::distributed::run_dir(settings));
+
+  Timer timer = Timer();
+
+  try
+  {
+    for (size_t k = settings.rank; k < tiles.size(); k += settings.nworkers)
+    {
+      hmap::Vec4<int> cells = hesiod::distributed::grow_cells(tiles[k],
+                                                              settings.overlap,
+                                                              settings.shape);
+      std::vector<hmap::Array> arrays = {};
+
+      if (!this->evaluate_roi(targets,
+                              hesiod::region::to_region(cells, settings.shape),
+                              {cells.b - cells.a, cells.d - cells.c},
+                              arrays,
+                              true))
+      {
+        LOG_ERROR("worker %d, evaluation of super-tile %ld failed",
+                  settings.rank,
+                  k);
+        return false;
+      }
+
+      for (size_t e = 0; e < arrays.size(); e++)
+        hesiod::distributed::write_tile(
+            hesiod::distributed::tile_fname(settings, (int)e, (int)k),
+            arrays[e],
+            cells);
+
+      LOG_DEBUG("worker %d, super-tile %ld done", settings.rank, k);
+    }
+  }
+  catch (const std::exception &e)
+  {
+    LOG_ERROR("worker %d failed: %s", settings.rank, e.what());
+    return false;
+  }
+
+  LOG_DEBUG("worker %d done (%f ms)", settings.rank, timer.stop());
+
+  return true;
+}
+
+bool ViewTree::stitch_tiles(const hesiod::distributed::RenderSettings &settings,
+                            bool wait_for_tiles)
+{
+  std::vector<hesiod::cnode::Export *>             exports = {};
+  std::vector<std::pair<std::string, std::string>> targets = {};
+  std::vector<hmap::Vec2<float>>                   ranges = {};
+
+  if (!this->prepare_exports(exports, targets, ranges))
+    return false;
+
+  std::vector<hmap::Vec4<int>> tiles = hesiod::region::partition(
+      settings.shape,
+      settings.super_tile);
+
+  if (wait_for_tiles)
+    hesiod::distributed::wait_tiles(settings,
+                                    (int)exports.size(),
+                                    (int)tiles.size());
+
+  // grid of super-tiles, a core block being covered by the grown tiles of
+  // its neighbours only
+  int nbx = (settings.shape.x + settings.super_tile - 1) / settings.super_tile;
+
+  Timer timer = Timer();
+
+  try
+  {
+    for (size_t e = 0; e < exports.size(); e++)
+    {
+      std::unique_ptr<hesiod::io::BlockWriter> writer =
+          exports[e]->create_block_writer(settings.shape, ranges[e]);
+
+      // tiles read once and dropped when out of reach (tiles listed band by
+      // band from the top, a core block only overlapping the adjacent bands)
+      std::map<int, std::pair<hmap::Array, hmap::Vec4<int>>> cache = {};
+
+      for (int k = 0; k < (int)tiles.size(); k++)
+      {
+        hmap::Vec4<int> core = tiles[k];
+        int             bi = k % nbx;
+        int             bj = k / nbx;
+
+        hmap::Array block = hmap::Array(
+            hmap::Vec2<int>(core.b - core.a, core.d - core.c));
+        hmap::Array weights = hmap::Array(block.shape);
+
+        for (int r = bj - 1; r <= bj + 1; r++)
+          for (int c = bi - 1; c <= bi + 1; c++)
+          {
+            int n = r * nbx + c;
+            if (c < 0 || c >= nbx || n < 0 || n >= (int)tiles.size())
+              continue;
+
+            if (!cache.contains(n))
+            {
+              auto &entry = cache[n];
+              if (!hesiod::distributed::read_tile(
+                      hesiod::distributed::tile_fname(settings, (int)e, n),
+                      entry.first,
+                      entry.second))
+                throw std::runtime_error("missing super-tile " +
+                                         std::to_string(n));
+            }
+
+            hmap::Array     &tile = cache.at(n).first;
+            hmap::Vec4<int> &cells = cache.at(n).second;
+
+            for (int i = std::max(core.a, cells.a);
+                 i < std::min(core.b, cells.b);
+                 i++)
+              for (int j = std::max(core.c, cells.c);
+                   j < std::min(core.d, cells.d);
+                   j++)
+              {
+                float w = hesiod::distributed::blending_weight(
+                    cells,
+                    settings.overlap,
+                    settings.shape,
+                    i,
+                    j);
+
+                block(i - core.a, j - core.c) += w * tile(i - cells.a,
+                                                          j - cells.c);
+                weights(i - core.a, j - core.c) += w;
+              }
+          }
+
+        for (size_t p = 0; p < block.vector.size(); p++)
+          if (weights.vector[p] > 0.f)
+            block.vector[p] /= weights.vector[p];
+
+        writer->write_block(block, {core.a, core.c});
+
+        // the tiles two bands above are not needed anymore
+        std::erase_if(cache,
+                      [bj, nbx](const auto &item)
+                      { return item.first / nbx < bj - 1; });
+      }
+
+      writer->close();
+    }
+  }
+  catch (const std::exception &e)
+  {
+    LOG_ERROR("stitching failed: %s", e.what());
+    return false;
+  }
+
+  for (size_t e = 0; e < exports.size(); e++)
+    for (int k = 0; k < (int)tiles.size(); k++)
+      std::filesystem::remove(
+          hesiod::distributed::tile_fname(settings, (int)e, k));
+
+  LOG_DEBUG("stitching done (%f ms)", timer.stop());
+
+  return true;
+}
+
+bool ViewTree::render_distributed(const std::string                  &executable,
+                                  hesiod::distributed::RenderSettings settings)
+{
+  // spawned workers render in a fresh directory of their own
+  if (settings.spawn)
+  {
+    if (settings.run_id.empty())
+      settings.run_id = hesiod::distributed::new_run_id();
+
+    std::error_code ec;
+    std::filesystem::remove_all(hesiod::distributed::run_dir(settings), ec);
+  }
+
+  std::string dir = hesiod::distributed::run_dir(settings);
+  std::filesystem::create_directories(dir);
+
+  LOG_DEBUG("distributed rendering, run directory [%s]", dir.c_str());
+
+  bool success = false;
+
+  if (settings.spawn)
+    success = hesiod::distributed::run_workers(executable, settings) &&
+              this->stitch_tiles(settings);
+  else
+    success = this->stitch_tiles(settings, true);
+
+  // the tiles of a failed '--no-spawn' run are kept, the stitching can be
+  // run again once the missing tiles are rendered
+  if (success || settings.spawn)
+  {
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+  }
+
+  return success;
+}
+
+} // namespace hesiod::vnode
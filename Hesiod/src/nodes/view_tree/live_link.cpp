@@ -0,0 +1,80 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+#include <stdexcept>
+
+#include "gnode.hpp"
+#include "macrologger.h"
+
+#include "hesiod/live_link.hpp"
+#include "hesiod/timer.hpp"
+#include "hesiod/view_node.hpp"
+#include "hesiod/view_tree.hpp"
+
+namespace hesiod::vnode
+{
+
+void ViewTree::set_live_link(bool state)
+{
+  if (!state)
+  {
+    this->live_link = nullptr;
+    return;
+  }
+
+  if (this->live_link)
+    return;
+
+  try
+  {
+    this->live_link = std::make_unique<hesiod::io::LiveLinkPublisher>(
+        this->live_link_name);
+  }
+  catch (const std::runtime_error &)
+  {
+    // error already logged, the live link remains disabled
+    this->live_link = nullptr;
+    return;
+  }
+
+  this->publish_live_link();
+}
+
+void ViewTree::publish_live_link()
+{
+  if (!this->live_link || !this->is_node_id_in_keys(this->viewer_node_id))
+    return;
+
+  ViewNode   *p_vnode = this->get_node_ref_by_id<ViewNode>(this->viewer_node_id);
+  std::string port_id = p_vnode->get_preview_port_id();
+
+  p_vnode->ensure_data();
+
+  if (port_id == "" || !p_vnode->get_p_data(port_id))
+    return;
+
+  Timer    timer = Timer();
+  uint64_t generation = 0;
+
+  // the data are copied from the tiles straight to the shared memory
+  switch (p_vnode->get_port_ref_by_id(port_id)->dtype)
+  {
+  case hesiod::cnode::dtype::dHeightMap:
+    generation = this->live_link->publish(
+        *(hmap::HeightMap *)p_vnode->get_p_data(port_id));
+    break;
+
+  case hesiod::cnode::dtype::dHeightMapRGB:
+    generation = this->live_link->publish(
+        *(hmap::HeightMapRGB *)p_vnode->get_p_data(port_id));
+    break;
+  }
+
+  if (generation > 0)
+    LOG_DEBUG("live link, node [%s] published (generation %ld, %f ms)",
+              this->viewer_node_id.c_str(),
+              generation,
+              timer.stop());
+}
+
+} // namespace hesiod::vnode
@@ -1,6 +1,7 @@
 /* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
  * Public License. The full license is in the file LICENSE, distributed with
  * this software. */
+#include <filesystem>
 #include <fstream>
 
 #include "gnode.hpp"
@@ -8,6 +9,7 @@
 #include "macrologger.h"
 #include <vector>
 
+#include "hesiod/local_stats.hpp"
 #include "hesiod/view_node.hpp"
 #include "hesiod/view_tree.hpp"
 #include "nlohmann/json_fwd.hpp"
@@ -51,15 +53,21 @@ bool Link::deserialize_json_v2(std::string     field_name,
 
 void ViewTree::load_state(std::string fname)
 {
+  this->texture_streamer.cancel(nullptr);
+  this->deferred_nodes.clear();
   this->remove_all_nodes();
   this->links.clear();
+  this->draw_lists_stale = true;
+  hesiod::local_stats::clear_cache();
 
   std::ifstream  inputFileStream = std::ifstream(fname);
   nlohmann::json inputSerializedData = nlohmann::json();
 
   inputFileStream >> inputSerializedData;
 
+  this->output_cache_dir = fname + OUTPUT_CACHE_SUFFIX;
   this->deserialize_json_v2("data", inputSerializedData);
+  this->output_cache_dir = "";
 
   inputFileStream.close();
 }
@@ -74,18 +82,23 @@ void ViewTree::save_state(std::string fname)
   outputFileStream << outputSerializedData.dump(1) << std::endl;
 
   outputFileStream.close();
+
+  if (this->output_cache)
+    this->save_output_cache(fname + OUTPUT_CACHE_SUFFIX);
 }
 
-bool ViewTree::serialize_json_v2(std::string     field_name,
-                                 nlohmann::json &output_data)
+nlohmann::json ViewTree::serialize_header_json_v2()
 {
-  output_data[field_name]["id"] = id;
-  output_data[field_name]["overlap"] = overlap;
-  output_data[field_name]["shape.x"] = shape.x;
-  output_data[field_name]["shape.y"] = shape.y;
-  output_data[field_name]["tiling.x"] = tiling.x;
-  output_data[field_name]["tiling.y"] = tiling.y;
-  output_data[field_name]["id_counter"] = id_counter;
+  nlohmann::json output_data = nlohmann::json();
+
+  output_data["id"] = id;
+  output_data["overlap"] = overlap;
+  output_data["shape.x"] = shape.x;
+  output_data["shape.y"] = shape.y;
+  output_data["tiling.x"] = tiling.x;
+  output_data["tiling.y"] = tiling.y;
+  output_data["id_counter"] = id_counter;
+  output_data["output_cache"] = output_cache;
 
   // node ids and positions
   {
@@ -104,34 +117,9 @@ bool ViewTree::serialize_json_v2(std::string     field_name,
 
     ax::NodeEditor::SetCurrentEditor(nullptr);
 
-    output_data[field_name]["node_ids"] = node_ids;
-    output_data[field_name]["pos_x"] = pos_x;
-    output_data[field_name]["pos_y"] = pos_y;
-  }
-
-  std::vector<nlohmann::json> nodesArraySerialized = {};
-
-  // nodes parameters
-  for (auto &[id, node] : this->get_nodes_map())
-  {
-    nlohmann::json currentNodeSerialized = nlohmann::json();
-
-    currentNodeSerialized["id"] = id;
-    currentNodeSerialized["type"] = this->get_node_type(id);
-
-    if (this->get_node_type(id) != "Clone")
-    {
-      this->get_node_ref_by_id<hesiod::cnode::ControlNode>(id)
-          ->serialize_json_v2("data", currentNodeSerialized);
-    }
-    else
-    {
-      this->get_node_ref_by_id<hesiod::cnode::Clone>(id)->serialize_json_v2(
-          "data",
-          currentNodeSerialized);
-    }
-
-    nodesArraySerialized.push_back(currentNodeSerialized);
+    output_data["node_ids"] = node_ids;
+    output_data["pos_x"] = pos_x;
+    output_data["pos_y"] = pos_y;
   }
 
   std::vector<nlohmann::json> linksArraySerialized = {};
@@ -146,8 +134,50 @@ bool ViewTree::serialize_json_v2(std::string     field_name,
     linksArraySerialized.push_back(currentLinkSerialized);
   }
 
+  output_data["links"] = linksArraySerialized;
+
+  return output_data;
+}
+
+nlohmann::json ViewTree::serialize_node_json_v2(std::string node_id)
+{
+  nlohmann::json currentNodeSerialized = nlohmann::json();
+
+  currentNodeSerialized["id"] = node_id;
+  currentNodeSerialized["type"] = this->get_node_type(node_id);
+  currentNodeSerialized["frozen_outputs"] =
+      this->get_node_ref_by_id(node_id)->frozen_outputs;
+  currentNodeSerialized["frozen_key"] =
+      this->get_node_ref_by_id<hesiod::cnode::ControlNode>(node_id)
+          ->frozen_key;
+
+  if (this->get_node_type(node_id) != "Clone")
+  {
+    this->get_node_ref_by_id<hesiod::cnode::ControlNode>(node_id)
+        ->serialize_json_v2("data", currentNodeSerialized);
+  }
+  else
+  {
+    this->get_node_ref_by_id<hesiod::cnode::Clone>(node_id)->serialize_json_v2(
+        "data",
+        currentNodeSerialized);
+  }
+
+  return currentNodeSerialized;
+}
+
+bool ViewTree::serialize_json_v2(std::string     field_name,
+                                 nlohmann::json &output_data)
+{
+  output_data[field_name] = this->serialize_header_json_v2();
+
+  // nodes parameters
+  std::vector<nlohmann::json> nodesArraySerialized = {};
+
+  for (auto &[id, node] : this->get_nodes_map())
+    nodesArraySerialized.push_back(this->serialize_node_json_v2(id));
+
   output_data[field_name]["nodes"] = nodesArraySerialized;
-  output_data[field_name]["links"] = linksArraySerialized;
 
   return true;
 }
@@ -168,6 +198,9 @@ bool ViewTree::deserialize_json_v2(std::string     field_name,
   tiling.y = input_data[field_name]["tiling.y"].get<int>();
   id_counter = input_data[field_name]["id_counter"].get<int>();
 
+  // optional fields (files saved with an older version)
+  output_cache = input_data[field_name].value("output_cache", false);
+
   {
     std::vector<std::string> node_ids =
         input_data[field_name]["node_ids"].get<std::vector<std::string>>();
@@ -194,6 +227,11 @@ bool ViewTree::deserialize_json_v2(std::string     field_name,
   {
     std::string id = currentNodeSerializedData["data"]["id"].get<std::string>();
 
+    this->get_node_ref_by_id(id)->frozen_outputs =
+        currentNodeSerializedData.value("frozen_outputs", false);
+    this->get_node_ref_by_id<hesiod::cnode::ControlNode>(id)->frozen_key =
+        currentNodeSerializedData.value("frozen_key", "");
+
     if (this->get_node_type(id) != "Clone")
     {
       this->get_node_ref_by_id<hesiod::cnode::ControlNode>(id)
@@ -224,7 +262,11 @@ bool ViewTree::deserialize_json_v2(std::string     field_name,
                link.node_id_to,
                link.port_id_to);
 
-  this->update();
+  if (this->output_cache && this->output_cache_dir != "" &&
+      std::filesystem::is_directory(this->output_cache_dir))
+    this->update_from_output_cache(this->output_cache_dir);
+  else
+    this->update();
 
   return true;
 }
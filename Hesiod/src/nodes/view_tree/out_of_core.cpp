@@ -0,0 +1,149 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+#include <memory>
+
+#include "gnode.hpp"
+#include "macrologger.h"
+
+#include "hesiod/control_node.hpp"
+#include "hesiod/export_queue.hpp"
+#include "hesiod/heightmap_writer.hpp"
+#include "hesiod/region.hpp"
+#include "hesiod/tile_compression.hpp"
+#include "hesiod/timer.hpp"
+#include "hesiod/view_tree.hpp"
+
+namespace hesiod::vnode
+{
+
+bool ViewTree::prepare_exports(
+    std::vector<hesiod::cnode::Export *>             &exports,
+    std::vector<std::pair<std::string, std::string>> &targets,
+    std::vector<hmap::Vec2<float>>                   &ranges)
+{
+  // export nodes, the data being evaluated at the output of the node
+  // connected to their input
+  exports.clear();
+  targets.clear();
+  ranges.clear();
+
+  for (auto &[id, node] : this->get_nodes_map())
+    if (this->get_node_type(id) == "Export")
+      for (auto &[link_id, link] : this->links)
+        if (link.node_id_to == id && link.port_id_to == "input")
+        {
+          exports.push_back(
+              this->get_node_ref_by_id<hesiod::cnode::Export>(id));
+          targets.push_back({link.node_id_from, link.port_id_from});
+        }
+
+  if (exports.empty())
+  {
+    LOG_ERROR("no connected Export node");
+    return false;
+  }
+
+  // idle data compressed (lossy data computed again)
+  this->restore_exact_data();
+  hesiod::io::TileStore::get_instance().ensure_all();
+
+  // first pass, whole domain at the tree resolution: value ranges of the
+  // global operations (recorded by the nodes) and of the exports
+  for (auto &[id, node] : this->get_nodes_map())
+    if (!node->is_up_to_date)
+    {
+      this->update();
+      break;
+    }
+
+  for (auto &[node_id, port_id] : targets)
+  {
+    hmap::HeightMap *p_h = (hmap::HeightMap *)this->get_node_ref_by_id(node_id)
+                               ->get_p_data(port_id);
+    if (!p_h)
+    {
+      LOG_ERROR("no data for node [%s]", node_id.c_str());
+      return false;
+    }
+
+    ranges.push_back({p_h->min(), p_h->max()});
+  }
+
+  // exports of the whole domain pass still being written to the same files
+  hesiod::io::ExportQueue::get_instance().wait();
+
+  return true;
+}
+
+bool ViewTree::export_out_of_core(hmap::Vec2<int> shape, int super_tile_size)
+{
+  if (shape.x <= 0 || shape.y <= 0 || super_tile_size <= 0)
+    return false;
+
+  std::vector<hesiod::cnode::Export *>             exports = {};
+  std::vector<std::pair<std::string, std::string>> targets = {};
+  std::vector<hmap::Vec2<float>>                   ranges = {};
+
+  if (!this->prepare_exports(exports, targets, ranges))
+    return false;
+
+  // second pass, super-tile by super-tile, from the top (largest j) to the
+  // bottom so that images can be written row by row
+  std::vector<hmap::Vec4<int>> blocks = hesiod::region::partition(
+      shape,
+      super_tile_size);
+
+  LOG_DEBUG("out-of-core export, shape {%d, %d}, %ld super-tile(s)",
+            shape.x,
+            shape.y,
+            blocks.size());
+
+  Timer timer = Timer();
+
+  try
+  {
+    std::vector<std::unique_ptr<hesiod::io::BlockWriter>> writers = {};
+
+    for (size_t k = 0; k < exports.size(); k++)
+      writers.push_back(exports[k]->create_block_writer(shape, ranges[k]));
+
+    for (size_t b = 0; b < blocks.size(); b++)
+    {
+      hmap::Vec4<int>          cells = blocks[b];
+      std::vector<hmap::Array> arrays = {};
+
+      if (!this->evaluate_roi(targets,
+                              hesiod::region::to_region(cells, shape),
+                              {cells.b - cells.a, cells.d - cells.c},
+                              arrays,
+                              true))
+      {
+        LOG_ERROR("out-of-core export, evaluation of super-tile %ld failed",
+                  b);
+        return false;
+      }
+
+      for (size_t k = 0; k < writers.size(); k++)
+        writers[k]->write_block(arrays[k], {cells.a, cells.c});
+
+      LOG_DEBUG("out-of-core export, super-tile %ld/%ld done",
+                b + 1,
+                blocks.size());
+    }
+
+    for (auto &writer : writers)
+      writer->close();
+  }
+  catch (const std::exception &e)
+  {
+    LOG_ERROR("out-of-core export failed: %s", e.what());
+    return false;
+  }
+
+  LOG_DEBUG("out-of-core export done (%f ms)", timer.stop());
+
+  return true;
+}
+
+} // namespace hesiod::vnode
@@ -0,0 +1,312 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+#include <algorithm>
+#include <filesystem>
+#include <functional>
+#include <set>
+
+#include "gnode.hpp"
+#include "macrologger.h"
+
+#include "hesiod/attribute.hpp"
+#include "hesiod/control_node.hpp"
+#include "hesiod/import_cache.hpp"
+#include "hesiod/output_cache.hpp"
+#include "hesiod/tile_compression.hpp"
+#include "hesiod/timer.hpp"
+#include "hesiod/view_node.hpp"
+#include "hesiod/view_tree.hpp"
+
+namespace hesiod::vnode
+{
+
+// upstream-first order of all the nodes
+static std::vector<std::string> evaluation_order(
+    const std::vector<std::string> &node_ids,
+    const std::map<int, Link>      &links)
+{
+  std::vector<std::string> order = {};
+  std::set<std::string>    visited = {};
+
+  std::function<void(const std::string &)> visit =
+      [&links, &order, &visited, &visit](const std::string &id)
+  {
+    if (!visited.insert(id).second)
+      return;
+
+    for (auto &[link_id, link] : links)
+      if (link.node_id_to == id)
+        visit(link.node_id_from);
+
+    order.push_back(id);
+  };
+
+  for (auto &id : node_ids)
+    visit(id);
+
+  return order;
+}
+
+// true if the node has outputs, all heightmaps (only heightmaps are cached,
+// nodes without outputs, exports for instance, always have to be run)
+static bool is_cacheable(hesiod::cnode::ControlNode *p_node)
+{
+  bool has_outputs = false;
+
+  for (auto &[port_id, port] : p_node->get_ports())
+    if (port.direction == gnode::direction::out)
+    {
+      if (port.dtype != hesiod::cnode::dtype::dHeightMap)
+        return false;
+      has_outputs = true;
+    }
+
+  return has_outputs;
+}
+
+std::map<std::string, std::string> ViewTree::get_output_cache_keys()
+{
+  std::map<std::string, std::string> keys = {};
+
+  std::string storage = std::to_string(this->shape.x) + "," +
+                        std::to_string(this->shape.y) + "," +
+                        std::to_string(this->tiling.x) + "," +
+                        std::to_string(this->tiling.y) + "," +
+                        std::to_string(this->overlap);
+
+  for (auto &id : evaluation_order(this->get_node_ids(), this->links))
+  {
+    hesiod::cnode::ControlNode *p_node =
+        this->get_node_ref_by_id<hesiod::cnode::ControlNode>(id);
+    std::string type = this->get_node_type(id);
+
+    // frozen data do not depend on the graph anymore, they are identified by
+    // their content (hashed once, the key being saved with the project)
+    if (p_node->frozen_outputs)
+    {
+      if (p_node->frozen_key == "" && p_node->is_up_to_date)
+      {
+        std::string content = "";
+
+        for (auto &[port_id, port] : p_node->get_ports())
+          if (port.direction == gnode::direction::out &&
+              port.dtype == hesiod::cnode::dtype::dHeightMap &&
+              p_node->get_p_data(port_id))
+            content += port_id + ":" +
+                       hesiod::io::hash_heightmap(
+                           *(hmap::HeightMap *)p_node->get_p_data(port_id)) +
+                       "|";
+
+        p_node->frozen_key = hesiod::io::hash_string(content);
+      }
+
+      keys[id] = hesiod::io::hash_string(type + "|" + id + "|frozen|" +
+                                         p_node->frozen_key + "|" + storage);
+      continue;
+    }
+
+    nlohmann::json attr_data = nlohmann::json();
+    p_node->serialize_json_v2("data", attr_data);
+    attr_data["data"].erase("id");
+
+    // inputs identified by the key of the node they are connected to
+    std::vector<std::string> inputs = {};
+
+    for (auto &[link_id, link] : this->links)
+      if (link.node_id_to == id)
+        inputs.push_back(link.port_id_to + "<" + keys.at(link.node_id_from) +
+                         ":" + link.port_id_from);
+
+    std::sort(inputs.begin(), inputs.end());
+
+    std::string description = type + "|" + attr_data.dump() + "|" + storage;
+    for (auto &input : inputs)
+      description += "|" + input;
+
+    // imported file content
+    if (type == "Import")
+    {
+      hesiod::io::FileKey file_key;
+      if (hesiod::io::get_file_key(p_node->attr.at("fname")
+                                       ->get_ref<FilenameAttribute>()
+                                       ->get(),
+                                   file_key))
+        description += "|" + file_key.path + ":" +
+                       std::to_string(file_key.size) + ":" +
+                       std::to_string(file_key.mtime);
+    }
+
+    keys[id] = hesiod::io::hash_string(description);
+  }
+
+  return keys;
+}
+
+std::vector<std::string> ViewTree::get_node_ids()
+{
+  std::vector<std::string> node_ids = {};
+  for (auto &[id, node] : this->get_nodes_map())
+    node_ids.push_back(id);
+  return node_ids;
+}
+
+void ViewTree::save_output_cache(std::string dir)
+{
+  Timer timer = Timer();
+
+  std::filesystem::create_directories(dir);
+  hesiod::io::TileStore::get_instance().ensure_all();
+
+  std::set<std::string> fnames = {};
+
+  // approximations (lossy compression) not stored under the key of the exact
+  // outputs
+  std::set<std::string> lossy_ids = this->get_lossy_nodes();
+
+  for (auto &[id, key] : this->get_output_cache_keys())
+  {
+    hesiod::cnode::ControlNode *p_node =
+        this->get_node_ref_by_id<hesiod::cnode::ControlNode>(id);
+
+    if (!p_node->is_up_to_date || !is_cacheable(p_node) ||
+        lossy_ids.contains(id))
+      continue;
+
+    for (auto &[port_id, port] : p_node->get_ports())
+    {
+      if (port.direction != gnode::direction::out)
+        continue;
+
+      hmap::HeightMap *p_h = (hmap::HeightMap *)p_node->get_p_data(port_id);
+      if (!p_h)
+        continue;
+
+      std::string fname = hesiod::io::output_cache_fname(dir, key, port_id);
+
+      try
+      {
+        hesiod::io::write_heightmap_cache(fname, key, *p_h);
+        fnames.insert(std::filesystem::path(fname).filename().string());
+      }
+      catch (const std::exception &e)
+      {
+        LOG_ERROR("output cache, node [%s]: %s", id.c_str(), e.what());
+      }
+    }
+
+    // statistics needed by the downstream region evaluations
+    if (p_node->records_statistics())
+    {
+      std::string    fname = hesiod::io::statistics_cache_fname(dir, key);
+      nlohmann::json data = nlohmann::json();
+      p_node->serialize_statistics(data);
+
+      try
+      {
+        hesiod::io::write_statistics_cache(fname, key, data);
+        fnames.insert(std::filesystem::path(fname).filename().string());
+      }
+      catch (const std::exception &e)
+      {
+        LOG_ERROR("output cache, node [%s]: %s", id.c_str(), e.what());
+      }
+    }
+  }
+
+  // outputs of previous versions of the graph
+  std::error_code ec;
+  for (auto &entry : std::filesystem::directory_iterator(dir, ec))
+    if ((entry.path().extension() == ".bin" ||
+         entry.path().extension() == ".json") &&
+        !fnames.contains(entry.path().filename().string()))
+      std::filesystem::remove(entry.path(), ec);
+
+  LOG_DEBUG("output cache saved, %ld file(s) (%f ms)",
+            fnames.size(),
+            timer.stop());
+}
+
+void ViewTree::update_from_output_cache(std::string dir)
+{
+  Timer timer = Timer();
+
+  std::map<std::string, std::string> keys = this->get_output_cache_keys();
+  int                                nrestored = 0;
+
+  for (auto &id : evaluation_order(this->get_node_ids(), this->links))
+  {
+    hesiod::cnode::ControlNode *p_node =
+        this->get_node_ref_by_id<hesiod::cnode::ControlNode>(id);
+
+    // all the outputs (and the recorded statistics) restored, or none
+    bool restored = is_cacheable(p_node);
+
+    if (restored && p_node->records_statistics())
+    {
+      nlohmann::json data = nlohmann::json();
+
+      restored = hesiod::io::read_statistics_cache(
+                     hesiod::io::statistics_cache_fname(dir, keys.at(id)),
+                     keys.at(id),
+                     data) &&
+                 p_node->deserialize_statistics(data);
+    }
+
+    if (restored)
+      for (auto &[port_id, port] : p_node->get_ports())
+        if (port.direction == gnode::direction::out)
+        {
+          std::string fname = hesiod::io::output_cache_fname(dir,
+                                                             keys.at(id),
+                                                             port_id);
+          hmap::HeightMap *p_h = (hmap::HeightMap *)p_node->get_p_data(
+              port_id);
+
+          if (!p_h ||
+              !hesiod::io::read_heightmap_cache(fname, keys.at(id), *p_h))
+          {
+            restored = false;
+            break;
+          }
+        }
+
+    if (restored)
+      nrestored++;
+    else
+    {
+      // computed as during a regular update, inputs being up-to-date
+      bool is_ready = true;
+
+      for (auto &[port_id, port] : p_node->get_ports())
+        if (port.direction == gnode::direction::in && !port.is_optional &&
+            !port.is_connected)
+          is_ready = false;
+
+      for (auto &[link_id, link] : this->links)
+        if (link.node_id_to == id &&
+            !this->get_node_ref_by_id(link.node_id_from)->is_up_to_date)
+          is_ready = false;
+
+      if (!is_ready)
+        continue;
+
+      p_node->compute();
+
+      // frozen outputs computed again, their content has to be hashed again
+      p_node->frozen_key = "";
+    }
+
+    p_node->is_up_to_date = true;
+    this->get_node_ref_by_id<ViewNode>(id)->post_control_node_update();
+  }
+
+  this->post_update();
+
+  LOG_DEBUG("update from the output cache, %d/%ld node(s) restored (%f ms)",
+            nrestored,
+            keys.size(),
+            timer.stop());
+}
+
+} // namespace hesiod::vnode
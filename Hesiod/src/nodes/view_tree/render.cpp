@@ -1,6 +1,8 @@
 /* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
  * Public License. The full license is in the file LICENSE, distributed with
  * this software. */
+#include <chrono>
+#include <cstring>
 #include <functional>
 
 #include "gnode.hpp"
@@ -8,6 +10,7 @@
 #include <imgui_node_editor.h>
 
 #include "hesiod/gui.hpp"
+#include "hesiod/parallel.hpp"
 #include "hesiod/view_node.hpp"
 #include "hesiod/view_tree.hpp"
 
@@ -30,37 +33,168 @@ void ViewTree::automatic_node_layout()
 
 void ViewTree::render_links()
 {
-  for (auto &[link_id, link] : this->links)
+  this->update_draw_lists();
+
+  for (auto &data : this->draw_list_links)
+    ax::NodeEditor::Link(ax::NodeEditor::LinkId(data.link_id),
+                         ax::NodeEditor::PinId(data.port_hash_id_from),
+                         ax::NodeEditor::PinId(data.port_hash_id_to),
+                         data.color);
+}
+
+void ViewTree::render_view_node(std::string node_id)
+{
+  this->get_node_ref_by_id<ViewNode>(node_id)->render_node();
+}
+
+void ViewTree::render_view_nodes()
+{
+  this->update_draw_lists();
+
+  size_t n = this->draw_list_nodes.size();
+  this->render_nodes_over_budget = false;
+  if (n == 0)
+    return;
+
+  // nodes outside the viewport are only rendered as placeholders, and so are
+  // the visible nodes once the frame budget is exhausted (rendering starts
+  // with these nodes during the next frame)
+  auto   t0 = std::chrono::high_resolution_clock::now();
+  bool   over_budget = false;
+  size_t start = this->render_nodes_start % n;
+
+  for (size_t r = 0; r < n; r++)
   {
-    // change color of "dead" links when a node upstream is frozen
-    bool is_link_frozen =
-        this->get_node_ref_by_id(link.node_id_from)->frozen_outputs;
+    size_t    k = (start + r) % n;
+    ViewNode *p_vnode = this->draw_list_nodes[k];
 
-    int dtype = this->get_node_ref_by_id(link.node_id_from)
-                    ->get_port_ref_by_id(link.port_id_from)
-                    ->dtype;
+    bool full = !over_budget &&
+                (p_vnode->is_visible_in_editor() ||
+                 ax::NodeEditor::IsNodeSelected(
+                     ax::NodeEditor::NodeId(p_vnode->hash_id)));
 
-    ImVec4 color = ImColor(dtype_colors.at(dtype).hovered);
+    if (!full)
+    {
+      p_vnode->render_node_placeholder();
+      continue;
+    }
 
-    if (is_link_frozen)
-      color = ImVec4(0.6f, 0.2f, 0.2f, 1.f);
+    p_vnode->render_node();
 
-    ax::NodeEditor::Link(ax::NodeEditor::LinkId(link_id),
-                         ax::NodeEditor::PinId(link.port_hash_id_from),
-                         ax::NodeEditor::PinId(link.port_hash_id_to),
-                         color);
+    std::chrono::duration<float, std::milli> elapsed =
+        std::chrono::high_resolution_clock::now() - t0;
+
+    if (elapsed.count() > NODE_EDITOR_FRAME_BUDGET_MS)
+    {
+      over_budget = true;
+      this->render_nodes_over_budget = true;
+      this->render_nodes_start = k + 1;
+    }
   }
 }
 
-void ViewTree::render_view_node(std::string node_id)
+void ViewTree::update_draw_lists()
 {
-  this->get_node_ref_by_id<ViewNode>(node_id)->render_node();
+  // safety net for the mutations not flagged explicitly
+  if (this->draw_list_nodes.size() != this->get_nodes_map().size() ||
+      this->draw_list_links.size() != this->links.size())
+    this->draw_lists_stale = true;
+
+  if (!this->draw_lists_stale)
+    return;
+
+  this->draw_list_nodes.clear();
+  for (auto &[id, node] : this->get_nodes_map())
+    this->draw_list_nodes.push_back(this->get_node_ref_by_id<ViewNode>(id));
+
+  this->draw_list_links.clear();
+  for (auto &[link_id, link] : this->links)
+  {
+    gnode::Node *p_node_from = this->get_node_ref_by_id(link.node_id_from);
+    int dtype = p_node_from->get_port_ref_by_id(link.port_id_from)->dtype;
+
+    ImVec4 color = ImColor(dtype_colors.at(dtype).hovered);
+
+    // change color of "dead" links when a node upstream is frozen
+    if (p_node_from->frozen_outputs)
+      color = ImVec4(0.6f, 0.2f, 0.2f, 1.f);
+
+    this->draw_list_links.push_back(
+        {link_id, link.port_hash_id_from, link.port_hash_id_to, color});
+  }
+
+  this->draw_lists_stale = false;
 }
 
-void ViewTree::render_view_nodes()
+void ViewTree::update_previews()
 {
-  for (auto &[id, node] : this->get_nodes_map())
-    this->get_node_ref_by_id<ViewNode>(id)->render_node();
+  std::vector<ViewNode *> p_nodes = {};
+
+  this->update_draw_lists();
+
+  for (ViewNode *p_vnode : this->draw_list_nodes)
+    if (p_vnode->is_preview_requested())
+    {
+      p_vnode->ensure_data();
+      p_nodes.push_back(p_vnode);
+    }
+
+  if (!p_nodes.empty())
+  {
+    // staging buffers are reserved from the main thread (RGB size, the
+    // largest one), nodes without one are uploaded synchronously
+    std::vector<int> slots(p_nodes.size());
+
+    for (size_t k = 0; k < p_nodes.size(); k++)
+    {
+      hmap::Vec2<int> shape = p_nodes[k]->get_shape_preview();
+      slots[k] = this->texture_streamer.acquire((size_t)shape.x * shape.y * 3);
+    }
+
+    // images are generated concurrently (no OpenGL calls) and copied to the
+    // staging buffers by the worker threads, the main thread only issuing the
+    // uploads
+    std::vector<PreviewImage> previews(p_nodes.size());
+
+    hesiod::parallel_for(
+        (int)p_nodes.size(),
+        [this, &p_nodes, &previews, &slots](int k_start, int k_end)
+        {
+          for (int k = k_start; k < k_end; k++)
+          {
+            previews[k] = p_nodes[k]->compute_preview_image();
+
+            if (slots[k] < 0)
+              continue;
+
+            if (previews[k].img.empty())
+            {
+              this->texture_streamer.release(slots[k]);
+              continue;
+            }
+
+            std::memcpy(this->texture_streamer.get_ptr(slots[k]),
+                        previews[k].img.data(),
+                        previews[k].img.size());
+
+            // only the image format is needed for the upload
+            PreviewImage meta = {{}, previews[k].rgb};
+            ViewNode    *p_vnode = p_nodes[k];
+
+            this->texture_streamer.commit(
+                slots[k],
+                p_vnode,
+                [p_vnode, meta]()
+                { p_vnode->upload_preview_image(meta, true); });
+          }
+        });
+
+    for (size_t k = 0; k < p_nodes.size(); k++)
+      if (slots[k] < 0)
+        p_nodes[k]->upload_preview_image(previews[k]);
+  }
+
+  this->texture_streamer.process();
 }
 
 } // namespace hesiod::vnode
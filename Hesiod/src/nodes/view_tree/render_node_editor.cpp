@@ -8,6 +8,7 @@
 #include <imgui_node_editor.h>
 
 #include "hesiod/gui.hpp"
+#include "hesiod/tile_compression.hpp"
 #include "hesiod/view_node.hpp"
 #include "hesiod/view_tree.hpp"
 
@@ -97,6 +98,90 @@ void ViewTree::render_node_editor()
 
   if (ImGui::Button("3D viewer"))
     this->open_view3d_window = !this->open_view3d_window;
+  ImGui::SameLine();
+
+  if (ImGui::Button("Out-of-core export"))
+    ImGui::OpenPopup("out-of-core export");
+  ImGui::SameLine();
+
+  if (ImGui::BeginPopup("out-of-core export"))
+  {
+    hesiod::gui::select_shape("shape (export)",
+                              this->out_of_core_shape,
+                              {32768, 32768});
+    ImGui::SliderInt("super-tile", &this->out_of_core_super_tile, 256, 8192);
+    ImGui::SameLine();
+    hesiod::gui::help_marker(
+        "The graph is evaluated super-tile by super-tile, the results being "
+        "streamed to the files of the Export nodes.");
+
+    if (ImGui::Button("Export"))
+    {
+      this->export_out_of_core(this->out_of_core_shape,
+                               this->out_of_core_super_tile);
+      ImGui::CloseCurrentPopup();
+    }
+    ImGui::EndPopup();
+  }
+
+  ImGui::Checkbox("Autosave", &this->autosave);
+  ImGui::SameLine();
+
+  ImGui::Checkbox("Output cache", &this->output_cache);
+  ImGui::SameLine();
+  hesiod::gui::help_marker(
+      "Node outputs are saved with the project and restored when it is "
+      "loaded, instead of being recomputed.");
+  ImGui::SameLine();
+
+  bool live_link = this->live_link != nullptr;
+  if (ImGui::Checkbox("Live link", &live_link))
+    this->set_live_link(live_link);
+  ImGui::SameLine();
+  hesiod::gui::help_marker(
+      "The data of the viewer node are published in a shared-memory segment "
+      "after each update, to be read by external tools.");
+  ImGui::SameLine();
+
+  if (ImGui::Button("Memory"))
+    ImGui::OpenPopup("memory");
+  ImGui::SameLine();
+
+  if (ImGui::BeginPopup("memory"))
+  {
+    size_t compressed_bytes, raw_bytes;
+    hesiod::io::TileStore::get_instance().get_memory_usage(compressed_bytes,
+                                                           raw_bytes);
+
+    ImGui::Checkbox("Compress idle outputs", &this->idle_compression);
+    ImGui::SliderFloat("max. error (preview-only)",
+                       &this->compression_max_error,
+                       0.f,
+                       0.01f,
+                       "%.4f");
+    ImGui::SameLine();
+    hesiod::gui::help_marker(
+        "Outputs not accessed for a while are compressed in memory and "
+        "restored when needed (the compression may briefly stall the "
+        "interface). Nodes without any downstream Export node can use a lossy "
+        "compression, the error being relative to the data amplitude "
+        "(lossless if zero), such outputs being computed again before being "
+        "exported or cached.");
+    ImGui::Text("compressed: %.1f MB (%.1f MB uncompressed)",
+                (float)compressed_bytes / 1048576.f,
+                (float)raw_bytes / 1048576.f);
+
+    if (ImGui::Button("Restore all"))
+      hesiod::io::TileStore::get_instance().ensure_all();
+    ImGui::EndPopup();
+  }
+
+  ImGui::Checkbox("Viewer priority", &this->priority_update);
+  if (!this->deferred_nodes.empty())
+  {
+    ImGui::SameLine();
+    ImGui::Text("(%ld deferred)", this->deferred_nodes.size());
+  }
 
   if (this->show_settings)
   {
@@ -130,6 +215,10 @@ void ViewTree::render_node_editor()
     ax::NodeEditor::Begin(id.c_str(), ImVec2(0.0, 0.0f));
     this->render_view_nodes();
     this->render_links();
+    this->update_previews();
+    this->update_deferred_nodes();
+    this->update_watched_files();
+    this->update_idle_compression();
 
     // --- panning
     if (fit_to_content)
@@ -252,6 +341,10 @@ void ViewTree::render_node_editor()
   ax::NodeEditor::End();
   ax::NodeEditor::SetCurrentEditor(nullptr);
 
+  // outside of the editor frame, node positions being read through the
+  // editor context
+  this->update_autosave();
+
   ImGui::End();
 
   // --- 2D viewer
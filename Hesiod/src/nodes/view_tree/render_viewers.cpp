@@ -1,6 +1,8 @@
 /* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
  * Public License. The full license is in the file LICENSE, distributed with
  * this software. */
+#include <algorithm>
+#include <cmath>
 #include <functional>
 
 #include "gnode.hpp"
@@ -25,6 +27,9 @@ void ViewTree::render_view2d()
 {
   ImGui::PushID((void *)this);
 
+  if (this->update_pending_view2d)
+    this->update_image_texture_view2d();
+
   ImGui::Text("%s", this->viewer_node_id.c_str());
 
   hesiod::vnode::ViewNode *p_vnode = this->get_node_ref_by_id<ViewNode>(
@@ -36,15 +41,18 @@ void ViewTree::render_view2d()
     {
       this->view2d_zoom = 100.f;
       this->view2d_uv0 = {0.f, 0.f};
+      this->redraw_view2d = true;
     }
     ImGui::SameLine();
 
+    // colormap and hillshading are applied by the shader, no data upload
+    // needed
     if (hesiod::gui::listbox_map_enum(this->cmap_map, this->cmap_view2d, 128.f))
-      this->update_image_texture_view2d();
+      this->redraw_view2d = true;
 
     ImGui::SameLine();
     if (ImGui::Checkbox("Hillshading", &this->hillshade_view2d))
-      this->update_image_texture_view2d();
+      this->redraw_view2d = true;
 
     if (hesiod::gui::select_shape("shape (render)",
                                   this->shape_view2d,
@@ -54,27 +62,98 @@ void ViewTree::render_view2d()
       this->update_image_texture_view2d();
     }
 
+    // region of interest, selected by dragging the mouse over the view and
+    // evaluated at a higher resolution than the tree
+    ImGui::Checkbox("Select ROI", &this->roi_select_view2d);
+    ImGui::SameLine();
+    ImGui::PushItemWidth(96.f);
+    ImGui::SliderInt("ROI factor", &this->roi_factor_view2d, 2, 16);
+    ImGui::PopItemWidth();
+    ImGui::SameLine();
+    if (ImGui::Button("Evaluate ROI"))
+      this->update_roi_view2d();
+    ImGui::SameLine();
+    if (ImGui::Button("Clear ROI"))
+    {
+      this->roi_view2d = hesiod::region::empty();
+      this->roi_shape_view2d = {0, 0};
+      this->redraw_view2d = true;
+    }
+
     float  window_width = ImGui::GetContentRegionAvail().x;
     ImVec2 pos = ImGui::GetCursorScreenPos();
 
-    ImVec2 uv1 = {this->view2d_uv0[0] + 100.f / this->view2d_zoom,
-                  this->view2d_uv0[1] + 100.f / this->view2d_zoom};
+    // the view is rendered at the resolution of the display
+    ImVec2          fb_scale = ImGui::GetIO().DisplayFramebufferScale;
+    hmap::Vec2<int> shape_fbo = {(int)(window_width * fb_scale.x),
+                                 (int)(window_width * fb_scale.y)};
+
+    if (this->redraw_view2d || shape_fbo != this->shape_fbo_view2d)
+      this->render_image_view2d(shape_fbo);
 
     ImVec2 p0 = ImVec2(pos.x, pos.y);
     ImVec2 p1 = ImVec2(pos.x + window_width, pos.y + window_width);
 
     ImDrawList *draw_list = ImGui::GetWindowDrawList();
 
-    draw_list->AddRectFilled(p0, p1, IM_COL32(50, 50, 50, 255));
     draw_list->AddImage((void *)(intptr_t)this->image_texture_view2d,
                         p0,
                         p1,
-                        this->view2d_uv0,
-                        uv1);
+                        ImVec2(0, 1),
+                        ImVec2(1, 0));
     draw_list->AddRect(p0, p1, IM_COL32(255, 255, 255, 255));
 
+    // data domain <-> screen
+    float uv_scale = 100.f / this->view2d_zoom;
+
+    auto to_screen = [&](float x, float y)
+    {
+      return ImVec2(pos.x + (x - this->view2d_uv0[0]) / uv_scale * window_width,
+                    pos.y + (1.f - y - this->view2d_uv0[1]) / uv_scale *
+                                window_width);
+    };
+
+    auto to_domain = [&](ImVec2 p)
+    {
+      return hmap::Vec2<float>(
+          this->view2d_uv0[0] + (p.x - pos.x) / window_width * uv_scale,
+          1.f - this->view2d_uv0[1] - (p.y - pos.y) / window_width * uv_scale);
+    };
+
+    if (!hesiod::region::is_empty(this->roi_view2d))
+    {
+      draw_list->PushClipRect(p0, p1, true);
+      draw_list->AddRect(to_screen(this->roi_view2d.a, this->roi_view2d.d),
+                         to_screen(this->roi_view2d.b, this->roi_view2d.c),
+                         IM_COL32(255, 255, 0, 255));
+      draw_list->PopClipRect();
+    }
+
     ImGui::InvisibleButton("##image2d", ImVec2(window_width, window_width));
 
+    if (this->roi_select_view2d && ImGui::IsItemHovered())
+    {
+      hmap::Vec2<float> xy = to_domain(ImGui::GetMousePos());
+      xy = {std::clamp(xy.x, 0.f, 1.f), std::clamp(xy.y, 0.f, 1.f)};
+
+      if (ImGui::IsMouseClicked(0))
+      {
+        this->roi_anchor_view2d = xy;
+        this->roi_shape_view2d = {0, 0};
+        this->redraw_view2d = true;
+      }
+
+      if (ImGui::IsMouseDown(0))
+        this->roi_view2d = hmap::Vec4<float>(
+            std::min(xy.x, this->roi_anchor_view2d.x),
+            std::max(xy.x, this->roi_anchor_view2d.x),
+            std::min(xy.y, this->roi_anchor_view2d.y),
+            std::max(xy.y, this->roi_anchor_view2d.y));
+
+      if (ImGui::IsMouseReleased(0))
+        this->update_roi_view2d();
+    }
+
     // zooming and panning
     ImGuiIO &io = ImGui::GetIO();
     {
@@ -85,9 +164,12 @@ void ViewTree::render_view2d()
       {
         // zoom
         if (io.MouseWheel)
+        {
           this->view2d_zoom = std::max(1.f,
                                        this->view2d_zoom *
                                            (1.f + 0.05f * io.MouseWheel));
+          this->redraw_view2d = true;
+        }
 
         // position
         if (ImGui::IsMouseDown(2))
@@ -97,6 +179,7 @@ void ViewTree::render_view2d()
           float  dv = -io.MouseDelta.y / window_size[1];
           this->view2d_uv0 = {this->view2d_uv0[0] + du,
                               this->view2d_uv0[1] + dv};
+          this->redraw_view2d = true;
         }
       }
     }
@@ -134,7 +217,13 @@ void ViewTree::render_view3d()
 
       ImGui::Checkbox("Auto rotate", &this->auto_rotate);
       if (this->auto_rotate)
+      {
+        // rotation speed independent of the frame rate (and of the idle
+        // periods)
+        float dt = std::min(ImGui::GetIO().DeltaTime, 0.1f);
+        this->alpha_y += VIEWER_AUTO_ROTATE_SPEED * dt;
         this->update_image_texture_view3d(false);
+      }
 
       ImGui::SameLine();
       ImGui::Checkbox("Show on background", &this->show_view3d_on_background);
@@ -152,6 +241,8 @@ void ViewTree::render_view3d()
     }
 
     // --- 3D rendering viewport
+    this->render_image_view3d();
+
     ImGuiIO &io = ImGui::GetIO();
 
     float window_width = ImGui::GetContentRegionAvail().x;
@@ -222,16 +313,247 @@ void ViewTree::render_view3d()
 
 void ViewTree::render_settings(std::string node_id)
 {
-  this->get_node_ref_by_id<ViewNode>(node_id)->render_settings();
+  ViewNode *p_vnode = this->get_node_ref_by_id<ViewNode>(node_id);
+  bool      frozen = p_vnode->frozen_outputs;
+
+  // settings widgets may read the node data
+  p_vnode->ensure_data();
+
+  // the updates triggered by the edit only reach the displayed nodes
+  PriorityUpdateScope scope = PriorityUpdateScope(this);
+
+  p_vnode->render_settings();
+
+  // frozen nodes change the color of their links
+  if (p_vnode->frozen_outputs != frozen)
+    this->draw_lists_stale = true;
+
+  // local in-place edition
+  if (!hesiod::region::is_empty(p_vnode->edited_region))
+  {
+    this->update_node_region(node_id, p_vnode->edited_region);
+    p_vnode->edited_region = hesiod::region::empty();
+  }
+}
+
+void ViewTree::render_image_view2d(hmap::Vec2<int> shape_fbo)
+{
+  if (shape_fbo.x <= 0 || shape_fbo.y <= 0)
+    return;
+
+  if (shape_fbo != this->shape_fbo_view2d)
+  {
+    glDeleteTextures(1, &this->image_texture_view2d);
+    hesiod::viewer::create_framebuffer(this->FBO_view2d,
+                                       this->RBO_view2d,
+                                       this->image_texture_view2d,
+                                       (float)shape_fbo.x,
+                                       (float)shape_fbo.y);
+    this->shape_fbo_view2d = shape_fbo;
+  }
+
+  // colormap lookup tables are generated on first use
+  if (!this->cmap_textures_view2d.contains(this->cmap_view2d))
+  {
+    GLuint texture_id = 0;
+    hesiod::viewer::upload_cmap_texture(texture_id, this->cmap_view2d);
+    this->cmap_textures_view2d[this->cmap_view2d] = texture_id;
+  }
+
+  GLint viewport[4];
+  GLint last_vertex_array;
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &last_vertex_array);
+
+  hesiod::viewer::bind_framebuffer(this->FBO_view2d);
+  glViewport(0, 0, shape_fbo.x, shape_fbo.y);
+  glDisable(GL_DEPTH_TEST);
+  glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+  glClearColor(50.f / 255.f, 50.f / 255.f, 50.f / 255.f, 1.f);
+  glClear(GL_COLOR_BUFFER_BIT);
+
+  if (this->data_view2d)
+  {
+    GLuint id = this->shader_id_view2d;
+    float  uv_scale = 100.f / this->view2d_zoom;
+
+    glUseProgram(id);
+
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_1D, this->cmap_textures_view2d[this->cmap_view2d]);
+    glActiveTexture(GL_TEXTURE0);
+
+    glUniform1i(glGetUniformLocation(id, "data"), 0);
+    glUniform1i(glGetUniformLocation(id, "cmap"), 1);
+    glUniform2f(glGetUniformLocation(id, "uv0"),
+                this->view2d_uv0[0],
+                this->view2d_uv0[1]);
+    glUniform1f(glGetUniformLocation(id, "uv_scale"), uv_scale);
+    glUniform2f(glGetUniformLocation(id, "zrange"),
+                this->zrange_view2d.x,
+                this->zrange_view2d.y);
+    glUniform1i(glGetUniformLocation(id, "rgb"), this->rgb_view2d);
+    glUniform1i(glGetUniformLocation(id, "hillshade"), this->hillshade_view2d);
+
+    glBindVertexArray(this->vertex_array_id_view2d);
+
+    if (this->rgb_view2d)
+    {
+      glBindTexture(GL_TEXTURE_2D, this->data_texture_view2d);
+      glUniform4f(glGetUniformLocation(id, "rect"), 0.f, 0.f, 1.f, 1.f);
+      glDrawArrays(GL_TRIANGLES, 0, 6);
+    }
+    else if (!this->pyramid_view2d.is_empty())
+    {
+      // visible window in the data domain (the display y axis points
+      // downward) and pyramid level matching the display resolution
+      float xmin = this->view2d_uv0[0];
+      float xmax = xmin + uv_scale;
+      float ymax = 1.f - this->view2d_uv0[1];
+      float ymin = ymax - uv_scale;
+
+      int level = this->pyramid_view2d.select_level(
+          {(float)shape_fbo.x / uv_scale, (float)shape_fbo.y / uv_scale});
+      int nlevels = this->pyramid_view2d.get_nlevels();
+      int nuploads = 0;
+
+      this->frame_view2d++;
+
+      // pages are drawn from the coarsest level to the target level, coarser
+      // pages standing in for the target pages that are not uploaded yet.
+      // Only the target level (and the single-page coarsest level) is
+      // streamed, with a limited number of uploads per frame to keep the
+      // view fluid
+      for (int l = nlevels - 1; l >= level; l--)
+        for (auto &key :
+             this->pyramid_view2d.visible_pages(l, xmin, xmax, ymin, ymax))
+        {
+          if (!this->pages_view2d.contains(key))
+          {
+            if (l == nlevels - 1 ||
+                (l == level && nuploads < VIEWER_PAGE_UPLOADS_PER_FRAME))
+            {
+              GLuint texture_id = 0;
+              hesiod::viewer::upload_array_texture(
+                  texture_id,
+                  this->pyramid_view2d.get_page(key));
+              this->pages_view2d[key].texture_id = texture_id;
+              nuploads++;
+            }
+            else
+            {
+              // keep on streaming during the next frames
+              if (l == level)
+                this->redraw_view2d = true;
+              continue;
+            }
+          }
+
+          hesiod::viewer::PageTexture &page = this->pages_view2d[key];
+          hmap::Vec4<float> bbox = this->pyramid_view2d.get_page_bbox(key);
+          hmap::Vec2<int>   shape = this->pyramid_view2d.get_shape(l);
+
+          page.last_used = this->frame_view2d;
+
+          // hillshading reference talus, consistent across levels
+          float talus_ref = 10.f * (this->zrange_view2d.y -
+                                    this->zrange_view2d.x) /
+                            (float)shape.x;
+
+          glBindTexture(GL_TEXTURE_2D, page.texture_id);
+          glUniform4f(glGetUniformLocation(id, "rect"),
+                      bbox.a,
+                      1.f - bbox.d,
+                      bbox.b,
+                      1.f - bbox.c);
+          glUniform2f(glGetUniformLocation(id, "core"),
+                      std::round((bbox.d - bbox.c) * shape.y),
+                      std::round((bbox.b - bbox.a) * shape.x));
+          glUniform1f(glGetUniformLocation(id, "talus_ref"),
+                      std::max(talus_ref, 1e-30f));
+          glDrawArrays(GL_TRIANGLES, 0, 6);
+        }
+
+      // region of interest over the pages, with the same value range
+      if (this->roi_shape_view2d.x > 0)
+      {
+        hmap::Vec4<float> bbox = this->roi_view2d;
+        hmap::Vec2<int>   shape = this->roi_shape_view2d;
+        float             dz = this->zrange_view2d.y - this->zrange_view2d.x;
+        float             talus_ref = 10.f * dz * (bbox.b - bbox.a) /
+                              (float)shape.x;
+
+        glBindTexture(GL_TEXTURE_2D, this->roi_texture_view2d);
+        glUniform4f(glGetUniformLocation(id, "rect"),
+                    bbox.a,
+                    1.f - bbox.d,
+                    bbox.b,
+                    1.f - bbox.c);
+        glUniform2f(glGetUniformLocation(id, "core"),
+                    (float)shape.y,
+                    (float)shape.x);
+        glUniform1f(glGetUniformLocation(id, "talus_ref"),
+                    std::max(talus_ref, 1e-30f));
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+      }
+
+      // evict the least recently drawn pages
+      while ((int)this->pages_view2d.size() > VIEWER_PAGE_CACHE_SIZE)
+      {
+        auto it = std::min_element(
+            this->pages_view2d.begin(),
+            this->pages_view2d.end(),
+            [](const auto &a, const auto &b)
+            { return a.second.last_used < b.second.last_used; });
+
+        if (it->second.last_used == this->frame_view2d)
+          break;
+
+        glDeleteTextures(1, &it->second.texture_id);
+        this->pages_view2d.erase(it);
+      }
+    }
+  }
+
+  hesiod::viewer::unbind_framebuffer();
+  glBindVertexArray(last_vertex_array);
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+  this->redraw_view2d = false;
+}
+
+void ViewTree::clear_pages_view2d()
+{
+  for (auto &[key, page] : this->pages_view2d)
+    glDeleteTextures(1, &page.texture_id);
+  this->pages_view2d.clear();
 }
 
 void ViewTree::update_image_texture_view2d()
 {
+  // the pyramid reads the viewed heightmap tiles, it is released right away
+  // since the data may not be valid anymore
+  this->pyramid_view2d.clear();
+  this->clear_pages_view2d();
+
+  // the pyramid is built at full resolution, this is deferred until the view
+  // is actually displayed
+  this->update_pending_view2d = !this->open_view2d_window;
+  if (this->update_pending_view2d)
+    return;
+
+  this->data_view2d = false;
+  this->redraw_view2d = true;
+  this->roi_shape_view2d = {0, 0};
+
   if (this->is_node_id_in_keys(this->viewer_node_id))
   {
     hesiod::vnode::ViewNode *p_vnode = this->get_node_ref_by_id<ViewNode>(
         this->viewer_node_id);
 
+    // the viewed data may be the (compressed) output of an upstream node
+    p_vnode->ensure_data();
+
     std::string data_pid = p_vnode->get_preview_port_id();
 
     if (data_pid != "")
@@ -240,19 +562,27 @@ void ViewTree::update_image_texture_view2d()
 
       if (p_data)
       {
-        std::vector<uint8_t> img = {};
-
+        // only the data are uploaded, colormapping and hillshading are done
+        // on the GPU
         switch (p_vnode->get_port_ref_by_id(data_pid)->dtype)
         {
         case hesiod::cnode::dtype::dHeightMap:
+        case hesiod::cnode::dtype::dArray:
         {
-          hmap::HeightMap *p_h = (hmap::HeightMap *)p_data;
-          hmap::Array      array = p_h->to_array(this->shape_view2d);
-          img = hmap::colorize(array,
-                               array.min(),
-                               array.max(),
-                               this->cmap_view2d,
-                               this->hillshade_view2d);
+          // elevations are viewed at their native resolution through a mip
+          // pyramid, pages are uploaded on demand when rendering
+          if (p_vnode->get_port_ref_by_id(data_pid)->dtype ==
+              hesiod::cnode::dtype::dHeightMap)
+            this->pyramid_view2d.build(*(hmap::HeightMap *)p_data);
+          else
+            this->pyramid_view2d.build(*(hmap::Array *)p_data);
+
+          if (!this->pyramid_view2d.is_empty())
+          {
+            this->zrange_view2d = this->pyramid_view2d.get_range();
+            this->rgb_view2d = false;
+            this->data_view2d = true;
+          }
         }
         break;
 
@@ -260,30 +590,75 @@ void ViewTree::update_image_texture_view2d()
         {
           hmap::HeightMapRGB *p_c = (hmap::HeightMapRGB *)p_data;
           if (p_c->shape.x > 0)
-            img = p_c->to_img_8bit(this->shape_view2d);
-        }
-        break;
+          {
+            std::vector<uint8_t> img = p_c->to_img_8bit(this->shape_view2d);
 
-        case hesiod::cnode::dtype::dArray:
-        {
-          hmap::Array array =
-              ((hmap::Array *)p_data)->resample_to_shape(this->shape_view2d);
-          img = hmap::colorize(array,
-                               array.min(),
-                               array.max(),
-                               this->cmap_view2d,
-                               this->hillshade_view2d);
+            hesiod::viewer::upload_rgb_texture(this->data_texture_view2d,
+                                               img,
+                                               this->shape_view2d);
+
+            this->rgb_view2d = true;
+            this->data_view2d = true;
+          }
         }
         break;
 
         default:
           LOG_ERROR("data type not suitable for 2d viewer");
         }
+      }
+    }
+  }
+}
+
+void ViewTree::update_image_texture_view2d(hmap::Vec4<float> region)
+{
+  if (hesiod::region::is_empty(region))
+    return;
+
+  bool done = false;
+
+  if (this->open_view2d_window && !this->update_pending_view2d &&
+      this->data_view2d && !this->rgb_view2d &&
+      this->is_node_id_in_keys(this->viewer_node_id))
+  {
+    hesiod::vnode::ViewNode *p_vnode = this->get_node_ref_by_id<ViewNode>(
+        this->viewer_node_id);
+    p_vnode->ensure_data();
+
+    std::string data_pid = p_vnode->get_preview_port_id();
+    void       *p_data = data_pid == "" ? nullptr
+                                        : p_vnode->get_p_data(data_pid);
+
+    if (p_data && p_vnode->get_port_ref_by_id(data_pid)->dtype ==
+                      hesiod::cnode::dtype::dHeightMap)
+      done = this->pyramid_view2d.update(*(hmap::HeightMap *)p_data, region);
 
-        img_to_texture_rgb(img, this->shape_view2d, this->image_texture_view2d);
+    // only the changed cells of the resident pages are re-uploaded, the
+    // region of interest is outdated if it intersects the change
+    if (done)
+    {
+      if (hesiod::region::intersects(region, this->roi_view2d))
+        this->roi_shape_view2d = {0, 0};
+
+      for (auto &[key, page] : this->pages_view2d)
+      {
+        hmap::Vec4<int> cells = this->pyramid_view2d.get_page_cells(key,
+                                                                    region);
+        if (cells.a < cells.b && cells.c < cells.d)
+          hesiod::viewer::update_array_texture(
+              page.texture_id,
+              this->pyramid_view2d.get_page(key),
+              cells);
       }
+
+      this->zrange_view2d = this->pyramid_view2d.get_range();
+      this->redraw_view2d = true;
     }
   }
+
+  if (!done)
+    this->update_image_texture_view2d();
 }
 
 void ViewTree::update_image_texture_view3d(bool vertex_array_update)
@@ -292,6 +667,7 @@ void ViewTree::update_image_texture_view3d(bool vertex_array_update)
   {
     hesiod::vnode::ViewNode *p_vnode = this->get_node_ref_by_id<ViewNode>(
         this->viewer_node_id);
+    p_vnode->ensure_data();
 
     std::string elevation_pid = p_vnode->get_view3d_elevation_port_id();
     std::string color_pid = p_vnode->get_view3d_color_port_id();
@@ -372,105 +748,103 @@ void ViewTree::update_image_texture_view3d(bool vertex_array_update)
             }
           }
 
-          glBindBuffer(GL_ARRAY_BUFFER, this->vertex_buffer);
-          glBufferData(GL_ARRAY_BUFFER,
-                       sizeof(this->vertices[0]) * this->vertices.size(),
-                       (GLvoid *)&this->vertices[0],
-                       GL_STATIC_DRAW);
-
-          glBindBuffer(GL_ARRAY_BUFFER, this->color_buffer);
-          glBufferData(GL_ARRAY_BUFFER,
-                       sizeof(this->colors[0]) * this->colors.size(),
-                       (GLvoid *)&this->colors[0],
-                       GL_STATIC_DRAW);
+          hesiod::viewer::upload_array_buffer(this->vertex_buffer,
+                                              this->vertices);
+          hesiod::viewer::upload_array_buffer(this->color_buffer,
+                                              this->colors);
         }
 
-        hesiod::viewer::bind_framebuffer(this->FBO);
+        // the frame buffer is rendered once per frame at most, when the
+        // viewer is displayed
+        this->redraw_view3d = true;
+      }
+    }
+  }
+}
 
-        glUseProgram(this->shader_id);
-        glClearColor(0.1f, 0.1f, 0.1f, 0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glEnable(GL_DEPTH_TEST);
-        glDisable(GL_CULL_FACE);
+void ViewTree::render_image_view3d()
+{
+  if (!this->redraw_view3d)
+    return;
 
-        // reset glViewport and scale framebuffer
-        glViewport(0, 0, this->shape_view3d.x, this->shape_view3d.y);
+  hesiod::viewer::bind_framebuffer(this->FBO);
 
-        if (this->wireframe)
-          glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        else
-          glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+  glUseProgram(this->shader_id);
+  glClearColor(0.1f, 0.1f, 0.1f, 0);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  glEnable(GL_DEPTH_TEST);
+  glDisable(GL_CULL_FACE);
 
-        // vertices
-        glEnableVertexAttribArray(0);
-        glBindBuffer(GL_ARRAY_BUFFER, this->vertex_buffer);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void *)0);
+  // reset glViewport and scale framebuffer
+  glViewport(0, 0, this->shape_view3d.x, this->shape_view3d.y);
 
-        // colors
-        glEnableVertexAttribArray(1);
-        glBindBuffer(GL_ARRAY_BUFFER, this->color_buffer);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (void *)0);
+  if (this->wireframe)
+    glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+  else
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
-        glm::mat4 combined_matrix;
-        {
-          if (this->auto_rotate)
-            this->alpha_y += 0.1f;
-
-          glm::mat4 scale_matrix = glm::scale(
-              glm::mat4(1.0f),
-              glm::vec3(this->scale, this->scale * this->h_scale, this->scale));
-
-          glm::mat4 rotation_matrix_y = glm::rotate(
-              glm::mat4(1.0f),
-              glm::radians(this->alpha_y),
-              glm::vec3(0.0f, 1.0f, 0.0f));
-
-          glm::mat4 rotation_matrix_x = glm::rotate(
-              glm::mat4(1.0f),
-              glm::radians(this->alpha_x),
-              glm::vec3(1.0f, 0.0f, 0.0f));
-
-          glm::mat4 rotation_matrix = rotation_matrix_x * rotation_matrix_y;
-
-          glm::mat4 transalation_matrix = glm::translate(
-              glm::mat4(1.f),
-              glm::vec3(this->delta_x, this->delta_y, 0.f));
-
-          glm::mat4 view_matrix = glm::translate(glm::mat4(1.f),
-                                                 glm::vec3(0.f, 0.f, -2.f));
-
-          // define perspective projection parameters
-          float     fov = 60.0f;
-          float     aspect_ratio = 1.f;
-          float     near_plane = 0.1f;
-          float     far_plane = 100.0f;
-          glm::mat4 projection_matrix = glm::perspective(glm::radians(fov),
-                                                         aspect_ratio,
-                                                         near_plane,
-                                                         far_plane);
-
-          combined_matrix = projection_matrix * view_matrix *
-                            transalation_matrix * rotation_matrix *
-                            scale_matrix;
-        }
+  // vertices
+  glEnableVertexAttribArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, this->vertex_buffer);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void *)0);
 
-        GLuint model_matrix_location = glGetUniformLocation(shader_id,
-                                                            "modelMatrix");
-        glUniformMatrix4fv(model_matrix_location,
-                           1,
-                           GL_FALSE,
-                           glm::value_ptr(combined_matrix));
+  // colors
+  glEnableVertexAttribArray(1);
+  glBindBuffer(GL_ARRAY_BUFFER, this->color_buffer);
+  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (void *)0);
 
-        glDrawArrays(GL_TRIANGLES, 0, this->vertices.size());
-        glPopMatrix();
+  glm::mat4 combined_matrix;
+  {
+    glm::mat4 scale_matrix = glm::scale(
+        glm::mat4(1.0f),
+        glm::vec3(this->scale, this->scale * this->h_scale, this->scale));
+
+    glm::mat4 rotation_matrix_y = glm::rotate(glm::mat4(1.0f),
+                                              glm::radians(this->alpha_y),
+                                              glm::vec3(0.0f, 1.0f, 0.0f));
+
+    glm::mat4 rotation_matrix_x = glm::rotate(glm::mat4(1.0f),
+                                              glm::radians(this->alpha_x),
+                                              glm::vec3(1.0f, 0.0f, 0.0f));
+
+    glm::mat4 rotation_matrix = rotation_matrix_x * rotation_matrix_y;
+
+    glm::mat4 transalation_matrix = glm::translate(
+        glm::mat4(1.f),
+        glm::vec3(this->delta_x, this->delta_y, 0.f));
+
+    glm::mat4 view_matrix = glm::translate(glm::mat4(1.f),
+                                           glm::vec3(0.f, 0.f, -2.f));
+
+    // define perspective projection parameters
+    float     fov = 60.0f;
+    float     aspect_ratio = 1.f;
+    float     near_plane = 0.1f;
+    float     far_plane = 100.0f;
+    glm::mat4 projection_matrix = glm::perspective(glm::radians(fov),
+                                                   aspect_ratio,
+                                                   near_plane,
+                                                   far_plane);
+
+    combined_matrix = projection_matrix * view_matrix * transalation_matrix *
+                      rotation_matrix * scale_matrix;
+  }
 
-        glDisableVertexAttribArray(0);
-        glDisableVertexAttribArray(1);
+  GLuint model_matrix_location = glGetUniformLocation(shader_id, "modelMatrix");
+  glUniformMatrix4fv(model_matrix_location,
+                     1,
+                     GL_FALSE,
+                     glm::value_ptr(combined_matrix));
 
-        hesiod::viewer::unbind_framebuffer();
-      }
-    }
-  }
+  glDrawArrays(GL_TRIANGLES, 0, this->vertices.size());
+  glPopMatrix();
+
+  glDisableVertexAttribArray(0);
+  glDisableVertexAttribArray(1);
+
+  hesiod::viewer::unbind_framebuffer();
+
+  this->redraw_view3d = false;
 }
 
 void ViewTree::update_view3d_basemesh()
@@ -486,6 +860,7 @@ void ViewTree::update_view3d_basemesh()
                                      this->image_texture_view3d,
                                      (float)this->shape_view3d.x,
                                      (float)this->shape_view3d.y);
+  this->redraw_view3d = true;
 }
 
 } // namespace hesiod::vnode
@@ -0,0 +1,410 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+
+#include "gnode.hpp"
+#include "macrologger.h"
+
+#include "hesiod/control_node.hpp"
+#include "hesiod/region.hpp"
+#include "hesiod/tile_compression.hpp"
+#include "hesiod/view_tree.hpp"
+#include "hesiod/viewer.hpp"
+
+namespace hesiod::vnode
+{
+
+// copy of the data of a port, restored by the returned function
+template <typename T>
+static std::function<void()> backup_data(void *p_data)
+{
+  T                 *p = (T *)p_data;
+  std::shared_ptr<T> saved = std::make_shared<T>(*p);
+  return [p, saved]() { *p = std::move(*saved); };
+}
+
+bool ViewTree::evaluate_roi(std::string       node_id,
+                            std::string       port_id,
+                            hmap::Vec4<float> roi,
+                            hmap::Vec2<int>   shape_roi,
+                            hmap::Array      &array)
+{
+  std::vector<hmap::Array> arrays = {};
+
+  if (!this->evaluate_roi({{node_id, port_id}}, roi, shape_roi, arrays))
+    return false;
+
+  array = std::move(arrays.front());
+  return true;
+}
+
+bool ViewTree::evaluate_roi(
+    std::vector<std::pair<std::string, std::string>> targets,
+    hmap::Vec4<float>                                roi,
+    hmap::Vec2<int>                                  shape_roi,
+    std::vector<hmap::Array>                        &arrays,
+    bool                                             exact)
+{
+  if (targets.empty() || hesiod::region::is_empty(roi) || shape_roi.x <= 0 ||
+      shape_roi.y <= 0)
+    return false;
+
+  for (auto &[node_id, port_id] : targets)
+  {
+    if (!this->is_node_id_in_keys(node_id))
+      return false;
+
+    if (this->get_node_ref_by_id(node_id)
+            ->get_port_ref_by_id(port_id)
+            ->dtype != hesiod::cnode::dtype::dHeightMap)
+    {
+      LOG_ERROR("region of interest only available for heightmaps");
+      return false;
+    }
+  }
+
+  // resolution of the region relative to the tree (rounding errors of the
+  // region bounds aside), the node settings given in cells are scaled
+  // accordingly
+  float roi_scale = 0.5f * ((float)shape_roi.x /
+                                ((roi.b - roi.a) * (float)this->shape.x) +
+                            (float)shape_roi.y /
+                                ((roi.d - roi.c) * (float)this->shape.y));
+
+  if (std::abs(roi_scale - 1.f) < 1e-3f)
+    roi_scale = 1.f;
+
+  // the whole subgraph is read, idle data compressed (lossy data computed
+  // again)
+  this->restore_exact_data();
+  hesiod::io::TileStore::get_instance().ensure_all();
+
+  // upstream subgraph, in evaluation order
+  std::vector<std::string> order = {};
+  std::set<std::string>    visited = {};
+
+  std::function<void(const std::string &)> visit =
+      [this, &order, &visited, &visit](const std::string &id)
+  {
+    if (!visited.insert(id).second)
+      return;
+
+    for (auto &[link_id, link] : this->links)
+      if (link.node_id_to == id)
+        visit(link.node_id_from);
+
+    order.push_back(id);
+  };
+
+  for (auto &[node_id, port_id] : targets)
+    visit(node_id);
+
+  // halo of the subgraph: largest sum of the node halos along the paths
+  // from the sources (nodes without inputs and frozen nodes, exact over any
+  // region), global if a node depends on the whole domain
+  std::map<std::string, hesiod::region::Halo> halos = {};
+  std::string                                 global_id = "";
+  std::string                                 unscaled_id = "";
+
+  auto reset_scale = [this, &order]()
+  {
+    for (auto &id : order)
+      this->get_node_ref_by_id<hesiod::cnode::ControlNode>(id)->set_roi_scale(
+          1.f);
+  };
+
+  for (auto &id : order)
+  {
+    hesiod::cnode::ControlNode *p_node =
+        this->get_node_ref_by_id<hesiod::cnode::ControlNode>(id);
+
+    for (auto &[pid, port] : p_node->get_ports())
+      if (port.direction == gnode::direction::in && !port.is_optional &&
+          !port.is_connected)
+      {
+        LOG_DEBUG("node [%s] not ready, no region of interest", id.c_str());
+        reset_scale();
+        return false;
+      }
+
+    if (p_node->frozen_outputs)
+    {
+      halos[id] = {hesiod::region::halo_type::pointwise, 0};
+      continue;
+    }
+
+    // the halo is then given in cells of the region
+    if (!p_node->set_roi_scale(roi_scale) && unscaled_id == "")
+      unscaled_id = id;
+
+    hesiod::region::Halo upstream = {hesiod::region::halo_type::pointwise, 0};
+
+    for (auto &[link_id, link] : this->links)
+      if (link.node_id_to == id)
+        upstream = hesiod::region::widest(upstream,
+                                          halos.at(link.node_id_from));
+
+    hesiod::region::Halo node_halo = p_node->get_roi_halo();
+
+    if (node_halo.type == hesiod::region::halo_type::global && global_id == "")
+      global_id = id;
+
+    halos[id] = hesiod::region::combine(upstream, node_halo);
+  }
+
+  hesiod::region::Halo halo = {hesiod::region::halo_type::pointwise, 0};
+
+  for (auto &[node_id, port_id] : targets)
+    halo = hesiod::region::widest(halo, halos.at(node_id));
+
+  // evaluation domain: region of interest with a margin covering the halos
+  // (in cells of the region resolution), the storage being compatible with
+  // the tree tiling
+  int margin = halo.ir;
+
+  if (unscaled_id != "")
+  {
+    if (exact)
+    {
+      LOG_ERROR("node [%s] counts iterations in cells, it cannot be evaluated "
+                "at another resolution than the tree one",
+                unscaled_id.c_str());
+      reset_scale();
+      return false;
+    }
+
+    LOG_INFO("node [%s] counts iterations in cells, region of interest "
+             "approximated",
+             unscaled_id.c_str());
+  }
+
+  if (halo.type == hesiod::region::halo_type::global)
+  {
+    if (exact)
+    {
+      LOG_ERROR("node [%s] depends on the whole domain, the regions cannot be "
+                "evaluated independently",
+                global_id.c_str());
+      reset_scale();
+      return false;
+    }
+
+    LOG_INFO("node [%s] depends on the whole domain, region of interest "
+             "approximated",
+             global_id.c_str());
+    margin = 0;
+  }
+
+  hmap::Vec2<float> cell = {(roi.b - roi.a) / shape_roi.x,
+                            (roi.d - roi.c) / shape_roi.y};
+  hmap::Vec2<int>   shape_eval = {shape_roi.x + 2 * margin,
+                                  shape_roi.y + 2 * margin};
+
+  shape_eval.x = (shape_eval.x + this->tiling.x - 1) / this->tiling.x *
+                 this->tiling.x;
+  shape_eval.y = (shape_eval.y + this->tiling.y - 1) / this->tiling.y *
+                 this->tiling.y;
+
+  hmap::Vec4<float> domain = {roi.a - margin * cell.x,
+                              roi.a + (shape_eval.x - margin) * cell.x,
+                              roi.c - margin * cell.y,
+                              roi.c + (shape_eval.y - margin) * cell.y};
+
+  LOG_DEBUG("region of interest, %ld node(s), shape {%d, %d}",
+            order.size(),
+            shape_eval.x,
+            shape_eval.y);
+
+  // the node outputs are swapped with their region counterparts, heightmaps
+  // being initialized by interpolation of the whole domain data (for nodes
+  // not recomputing them, frozen nodes for instance)
+  std::vector<std::function<void()>> restore_fcts = {};
+
+  for (auto &id : order)
+  {
+    hesiod::cnode::ControlNode *p_node =
+        this->get_node_ref_by_id<hesiod::cnode::ControlNode>(id);
+
+    for (auto &[pid, port] : p_node->get_ports())
+    {
+      if (port.direction != gnode::direction::out)
+        continue;
+
+      void *p_data = p_node->get_p_data(pid);
+      if (!p_data)
+        continue;
+
+      switch (port.dtype)
+      {
+      case hesiod::cnode::dtype::dArray:
+        restore_fcts.push_back(backup_data<hmap::Array>(p_data));
+        break;
+
+      case hesiod::cnode::dtype::dCloud:
+        restore_fcts.push_back(backup_data<hmap::Cloud>(p_data));
+        break;
+
+      case hesiod::cnode::dtype::dHeightMap:
+      {
+        hmap::HeightMap *p_h = (hmap::HeightMap *)p_data;
+        auto saved = std::make_shared<hmap::HeightMap>(std::move(*p_h));
+
+        restore_fcts.push_back([p_h, saved]() { *p_h = std::move(*saved); });
+
+        p_h->set_sto(shape_eval, this->tiling, this->overlap);
+        hesiod::region::remap_domain(*p_h, hesiod::region::full(), domain);
+
+        if (saved->shape.x > 0 && !saved->tiles.empty())
+          hesiod::region::resample(*saved, *p_h);
+      }
+      break;
+
+      case hesiod::cnode::dtype::dHeightMapRGB:
+        restore_fcts.push_back(backup_data<hmap::HeightMapRGB>(p_data));
+        break;
+
+      case hesiod::cnode::dtype::dPath:
+        restore_fcts.push_back(backup_data<hmap::Path>(p_data));
+        break;
+      }
+    }
+  }
+
+  auto restore = [this, &order, &restore_fcts, &reset_scale]()
+  {
+    for (auto it = restore_fcts.rbegin(); it != restore_fcts.rend(); it++)
+      (*it)();
+
+    for (auto &id : order)
+      this->get_node_ref_by_id<hesiod::cnode::ControlNode>(id)
+          ->roi_evaluation = false;
+
+    reset_scale();
+  };
+
+  // direct evaluation, no update callbacks are triggered (previews and
+  // viewers still show the whole domain data)
+  try
+  {
+    for (auto &id : order)
+    {
+      hesiod::cnode::ControlNode *p_node =
+          this->get_node_ref_by_id<hesiod::cnode::ControlNode>(id);
+
+      if (p_node->frozen_outputs)
+        continue;
+
+      p_node->roi_evaluation = true;
+      p_node->compute();
+    }
+  }
+  catch (...)
+  {
+    restore();
+    throw;
+  }
+
+  std::vector<hmap::HeightMap> hs = {};
+
+  for (auto &[node_id, port_id] : targets)
+    hs.push_back(*(hmap::HeightMap *)this->get_node_ref_by_id(node_id)
+                      ->get_p_data(port_id));
+
+  restore();
+
+  // region of interest cells, the tiles being given back the layout of the
+  // storage over the unit square (nodes resetting their storage already have
+  // it) so that they can be gathered
+  hmap::HeightMap h_ref = hmap::HeightMap(shape_eval,
+                                          this->tiling,
+                                          this->overlap);
+
+  arrays.clear();
+
+  for (auto &h : hs)
+  {
+    if (h.shape != shape_eval || h.tiles.size() != h_ref.tiles.size())
+    {
+      LOG_ERROR("unexpected storage of the region of interest");
+      return false;
+    }
+
+    for (size_t k = 0; k < h.tiles.size(); k++)
+    {
+      h.tiles[k].shift = h_ref.tiles[k].shift;
+      h.tiles[k].scale = h_ref.tiles[k].scale;
+      h.tiles[k].bbox = h_ref.tiles[k].bbox;
+    }
+
+    hesiod::region::TileLookup lookup = hesiod::region::TileLookup(h);
+    hmap::Array                array_eval;
+
+    if (!lookup.is_valid())
+      array_eval = h.to_array();
+
+    hmap::Array array = hmap::Array(shape_roi);
+
+    for (int i = 0; i < shape_roi.x; i++)
+      for (int j = 0; j < shape_roi.y; j++)
+        array(i, j) = lookup.is_valid()
+                          ? lookup.get(i + margin, j + margin)
+                          : array_eval(i + margin, j + margin);
+
+    arrays.push_back(std::move(array));
+  }
+
+  return true;
+}
+
+void ViewTree::update_roi_view2d()
+{
+  this->roi_shape_view2d = {0, 0};
+  this->redraw_view2d = true;
+
+  if (hesiod::region::is_empty(this->roi_view2d) ||
+      !this->is_node_id_in_keys(this->viewer_node_id))
+    return;
+
+  ViewNode   *p_vnode = this->get_node_ref_by_id<ViewNode>(this->viewer_node_id);
+  std::string data_pid = p_vnode->get_preview_port_id();
+
+  if (data_pid == "")
+    return;
+
+  // tree resolution within the region times the resolution factor
+  hmap::Vec4<float> roi = this->roi_view2d;
+  hmap::Vec2<int>   shape_roi = {
+      (int)std::ceil((roi.b - roi.a) * this->shape.x * this->roi_factor_view2d),
+      (int)std::ceil((roi.d - roi.c) * this->shape.y *
+                     this->roi_factor_view2d)};
+
+  shape_roi.x = std::clamp(shape_roi.x, 2, VIEWER_ROI_MAX_SIZE);
+  shape_roi.y = std::clamp(shape_roi.y, 2, VIEWER_ROI_MAX_SIZE);
+
+  hmap::Array array;
+  if (!this->evaluate_roi(this->viewer_node_id, data_pid, roi, shape_roi, array))
+    return;
+
+  // same layout as the pyramid pages (clamped one-cell border)
+  hmap::Array page = hmap::Array(
+      hmap::Vec2<int>(shape_roi.x + 2, shape_roi.y + 2));
+
+  for (int p = 0; p < shape_roi.x + 2; p++)
+    for (int q = 0; q < shape_roi.y + 2; q++)
+      page(p, q) = array(std::clamp(p - 1, 0, shape_roi.x - 1),
+                         std::clamp(q - 1, 0, shape_roi.y - 1));
+
+  glDeleteTextures(1, &this->roi_texture_view2d);
+  this->roi_texture_view2d = 0;
+  hesiod::viewer::upload_array_texture(this->roi_texture_view2d, page);
+
+  this->roi_shape_view2d = shape_roi;
+}
+
+} // namespace hesiod::vnode
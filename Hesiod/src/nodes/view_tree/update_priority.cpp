@@ -0,0 +1,144 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+#include <algorithm>
+
+#include "gnode.hpp"
+#include "macrologger.h"
+
+#include "hesiod/view_node.hpp"
+#include "hesiod/view_tree.hpp"
+
+namespace hesiod::vnode
+{
+
+std::map<std::string, int> ViewTree::get_update_priorities()
+{
+  std::map<std::string, int> priorities = {};
+
+  for (auto &[id, node] : this->get_nodes_map())
+    priorities[id] = update_priority::deferred;
+
+  // the priority of a node is propagated upstream
+  std::vector<std::string> queue = {};
+
+  auto raise = [&priorities, &queue](const std::string &id, int priority)
+  {
+    if (priority < priorities.at(id))
+    {
+      priorities[id] = priority;
+      queue.push_back(id);
+    }
+  };
+
+  if ((this->open_view2d_window || this->open_view3d_window) &&
+      this->is_node_id_in_keys(this->viewer_node_id))
+    raise(this->viewer_node_id, update_priority::viewer);
+
+  for (ViewNode *p_vnode : this->draw_list_nodes)
+    if (p_vnode->is_preview_shown())
+      raise(p_vnode->id, update_priority::preview);
+
+  while (!queue.empty())
+  {
+    std::string id = queue.back();
+    queue.pop_back();
+
+    for (auto &[link_id, link] : this->links)
+      if (link.node_id_to == id)
+        raise(link.node_id_from, priorities.at(id));
+  }
+
+  return priorities;
+}
+
+void ViewTree::begin_priority_update()
+{
+  // nested edits are part of the outermost one
+  if (this->priority_update_depth++ > 0 || !this->priority_update)
+    return;
+
+  this->update_draw_lists();
+
+  for (auto &[id, priority] : this->get_update_priorities())
+    if (priority == update_priority::deferred)
+    {
+      gnode::Node *p_node = this->get_node_ref_by_id(id);
+
+      this->held_nodes[id] = p_node->auto_update;
+      p_node->auto_update = false;
+    }
+}
+
+void ViewTree::end_priority_update()
+{
+  if (--this->priority_update_depth > 0)
+    return;
+
+  for (auto &[id, auto_update] : this->held_nodes)
+  {
+    // the node may have been removed during the edit
+    if (!this->is_node_id_in_keys(id))
+      continue;
+
+    gnode::Node *p_node = this->get_node_ref_by_id(id);
+    p_node->auto_update = auto_update;
+
+    if (auto_update && !p_node->is_up_to_date &&
+        std::find(this->deferred_nodes.begin(),
+                  this->deferred_nodes.end(),
+                  id) == this->deferred_nodes.end())
+      this->deferred_nodes.push_back(id);
+  }
+
+  this->held_nodes.clear();
+}
+
+PriorityUpdateScope::PriorityUpdateScope(ViewTree *p_tree) : p_tree(p_tree)
+{
+  this->p_tree->begin_priority_update();
+}
+
+PriorityUpdateScope::~PriorityUpdateScope()
+{
+  this->p_tree->end_priority_update();
+}
+
+void ViewTree::update_deferred_nodes()
+{
+  // nodes removed or updated in the meantime
+  std::erase_if(this->deferred_nodes,
+                [this](const std::string &id)
+                {
+                  return !this->is_node_id_in_keys(id) ||
+                         this->get_node_ref_by_id(id)->is_up_to_date;
+                });
+
+  // idle time only, not while a widget is being edited
+  if (this->deferred_nodes.empty() || ImGui::IsAnyItemActive())
+    return;
+
+  for (auto &id : this->deferred_nodes)
+  {
+    bool upstream_deferred = false;
+
+    for (auto &[link_id, link] : this->links)
+      if (link.node_id_to == id &&
+          std::find(this->deferred_nodes.begin(),
+                    this->deferred_nodes.end(),
+                    link.node_id_from) != this->deferred_nodes.end())
+      {
+        upstream_deferred = true;
+        break;
+      }
+
+    if (!upstream_deferred)
+    {
+      LOG_DEBUG("deferred update, node [%s]", id.c_str());
+      this->get_node_ref_by_id(id)->force_update();
+      break;
+    }
+  }
+}
+
+} // namespace hesiod::vnode
@@ -8,7 +8,9 @@
 
 #include "hesiod/viewer.hpp"
 
+#include "hesiod/export_queue.hpp"
 #include "hesiod/gui.hpp"
+#include "hesiod/local_stats.hpp"
 #include "hesiod/view_node.hpp"
 #include "hesiod/view_tree.hpp"
 
@@ -57,17 +59,34 @@ ViewTree::ViewTree(std::string     id,
   glGenVertexArrays(1, &this->vertex_array_id);
   glGenBuffers(1, &this->vertex_buffer);
   glGenBuffers(1, &this->color_buffer);
+
+  this->shader_id_view2d = hesiod::viewer::load_shaders_view2d();
+  hesiod::viewer::create_quad(this->vertex_array_id_view2d,
+                              this->vertex_buffer_view2d);
 }
 
 ViewTree::~ViewTree()
 {
   // shutdown node editor
   ax::NodeEditor::DestroyEditor(this->p_node_editor_context);
+  this->texture_streamer.clear();
   glDeleteBuffers(1, &this->vertex_buffer);
   glDeleteBuffers(1, &this->color_buffer);
   glDeleteVertexArrays(1, &this->vertex_array_id);
   glDeleteFramebuffers(1, &this->FBO);
   glDeleteFramebuffers(1, &this->RBO);
+
+  glDeleteProgram(this->shader_id_view2d);
+  glDeleteBuffers(1, &this->vertex_buffer_view2d);
+  glDeleteVertexArrays(1, &this->vertex_array_id_view2d);
+  glDeleteFramebuffers(1, &this->FBO_view2d);
+  glDeleteRenderbuffers(1, &this->RBO_view2d);
+  glDeleteTextures(1, &this->roi_texture_view2d);
+  glDeleteTextures(1, &this->data_texture_view2d);
+  glDeleteTextures(1, &this->image_texture_view2d);
+  this->clear_pages_view2d();
+  for (auto &[cmap, texture_id] : this->cmap_textures_view2d)
+    glDeleteTextures(1, &texture_id);
 }
 
 Link *ViewTree::get_link_ref_by_id(int link_id)
@@ -113,6 +132,8 @@ void ViewTree::set_sto(hmap::Vec2<int> new_shape,
   this->viewer_node_id = "";
   this->open_view2d_window = false;
   this->open_view3d_window = false;
+  this->pyramid_view2d.clear();
+  this->clear_pages_view2d();
 
   this->shape = new_shape;
   this->tiling = new_tiling;
@@ -121,18 +142,23 @@ void ViewTree::set_sto(hmap::Vec2<int> new_shape,
   this->shape_view2d = this->shape;
   this->shape_view3d = this->shape;
 
+  // cached statistics are only relevant for the previous storage
+  hesiod::local_stats::clear_cache();
+
   this->update_view3d_basemesh();
 }
 
 void ViewTree::clear_links()
 {
   this->links.clear();
+  this->draw_lists_stale = true;
 }
 
 void ViewTree::export_view3d(std::string fname)
 {
   this->update_view3d_basemesh();
   this->update_image_texture_view3d();
+  this->render_image_view3d();
 
   std::vector<uint8_t> img(this->shape_view3d.x * this->shape_view3d.y * 3);
 
@@ -200,8 +226,13 @@ void ViewTree::set_viewer_node_id(std::string node_id)
   if (node_id != this->viewer_node_id)
   {
     this->viewer_node_id = node_id;
+
+    if (this->is_node_id_in_keys(node_id))
+      this->get_node_ref_by_id<ViewNode>(node_id)->ensure_data();
+
     this->update_image_texture_view2d();
     this->update_image_texture_view3d();
+    this->publish_live_link();
   }
 }
 
@@ -306,6 +337,7 @@ void ViewTree::new_link(std::string node_id_from,
 
     int link_id = port_hash_id_to;
     this->links[link_id] = link;
+    this->draw_lists_stale = true;
 
     if (this->is_cyclic())
     {
@@ -315,8 +347,16 @@ void ViewTree::new_link(std::string node_id_from,
       throw std::runtime_error("cyclic graph");
     }
     else
+    {
+      // lossy data (compressed while no Export node was downstream) are not
+      // to be exported
+      if (!this->is_preview_only(node_id_to))
+        this->restore_exact_data();
+
       // not cyclic, carry on and propagate from the source
+      PriorityUpdateScope scope = PriorityUpdateScope(this);
       this->update_node(node_id_to);
+    }
   }
 }
 
@@ -338,8 +378,130 @@ void ViewTree::new_link(int port_hash_id_from, int port_hash_id_to)
 
 void ViewTree::post_update()
 {
-  this->update_image_texture_view2d();
-  this->update_image_texture_view3d();
+  if (hesiod::region::is_full(this->update_region))
+  {
+    this->update_image_texture_view2d();
+    this->update_image_texture_view3d();
+  }
+  else if (!hesiod::region::is_empty(this->update_region))
+  {
+    this->update_image_texture_view2d(this->update_region);
+    this->update_image_texture_view3d();
+  }
+
+  if (!hesiod::region::is_empty(this->update_region))
+    this->publish_live_link();
+}
+
+void ViewTree::update_node_region(std::string node_id, hmap::Vec4<float> region)
+{
+  // changed region of the output of each node downstream, grown by the halo
+  // of each node along the way
+  std::map<std::string, hmap::Vec4<float>> regions = {};
+  std::vector<std::string>                 queue = {node_id};
+
+  // nodes left outdated by a previous edit (deferred update) have missed
+  // other changes, they are recomputed (and change) over the whole domain
+  auto changed_region = [this](hesiod::cnode::ControlNode *p_node,
+                               hmap::Vec4<float>           region_in)
+  {
+    if (!p_node->is_up_to_date)
+      return hesiod::region::full();
+
+    return hesiod::region::grow(region_in,
+                                p_node->get_effective_halo(),
+                                this->shape);
+  };
+
+  hesiod::cnode::ControlNode *p_node =
+      this->get_node_ref_by_id<hesiod::cnode::ControlNode>(node_id);
+
+  regions[node_id] = changed_region(p_node, region);
+
+  while (!queue.empty())
+  {
+    std::string id_from = queue.back();
+    queue.pop_back();
+
+    for (auto &[link_id, link] : this->links)
+      if (link.node_id_from == id_from)
+      {
+        hesiod::cnode::ControlNode *p_to =
+            this->get_node_ref_by_id<hesiod::cnode::ControlNode>(
+                link.node_id_to);
+
+        hmap::Vec4<float> region_to = changed_region(p_to,
+                                                     regions.at(id_from));
+
+        // nodes are revisited as long as their region grows
+        if (!regions.contains(link.node_id_to))
+        {
+          regions[link.node_id_to] = region_to;
+          queue.push_back(link.node_id_to);
+        }
+        else if (!hesiod::region::contains(regions.at(link.node_id_to),
+                                           region_to))
+        {
+          regions[link.node_id_to] = hesiod::region::merge(
+              regions.at(link.node_id_to),
+              region_to);
+          queue.push_back(link.node_id_to);
+        }
+      }
+  }
+
+  for (auto &[id, region_node] : regions)
+    this->get_node_ref_by_id<hesiod::cnode::ControlNode>(id)->dirty_region =
+        region_node;
+
+  if (regions.contains(this->viewer_node_id))
+    this->update_region = regions.at(this->viewer_node_id);
+  else
+    this->update_region = hesiod::region::empty();
+
+  LOG_DEBUG("incremental update from node [%s], %ld nodes",
+            node_id.c_str(),
+            regions.size());
+
+  p_node->force_update();
+
+  // back to full updates
+  for (auto &[id, region_node] : regions)
+    this->get_node_ref_by_id<hesiod::cnode::ControlNode>(id)->dirty_region =
+        hesiod::region::full();
+
+  this->update_region = hesiod::region::full();
+}
+
+void ViewTree::update_watched_files()
+{
+  if (this->file_watch_timer.stop() < FILE_WATCH_INTERVAL_MS)
+    return;
+
+  this->file_watch_timer.reset();
+
+  for (auto &[id, node] : this->get_nodes_map())
+    if (this->get_node_type(id) == "Import" &&
+        this->get_node_ref_by_id<hesiod::cnode::Import>(id)->has_file_changed())
+    {
+      LOG_DEBUG("file of node [%s] modified, reloading", id.c_str());
+
+      PriorityUpdateScope scope = PriorityUpdateScope(this);
+      node->force_update();
+    }
+}
+
+bool ViewTree::is_animated()
+{
+  // auto-rotation, pyramid pages or previews still to be uploaded, nodes not
+  // rendered because of the frame budget, deferred node updates, exports
+  // being written (progress display)
+  return (this->open_view3d_window && this->auto_rotate) ||
+         (this->open_view2d_window && this->redraw_view2d) ||
+         this->render_nodes_over_budget ||
+         this->texture_streamer.has_pending() ||
+         !this->deferred_nodes.empty() ||
+         hesiod::io::ExportQueue::get_instance().is_busy();
 }
 
 void ViewTree::remove_link(int link_id)
@@ -351,10 +513,14 @@ void ViewTree::remove_link(int link_id)
                p_link->port_id_to);
 
   // only nodes downstream "from" node (excluded) are affected
-  this->update_node(p_link->node_id_to);
+  {
+    PriorityUpdateScope scope = PriorityUpdateScope(this);
+    this->update_node(p_link->node_id_to);
+  }
 
   // eventually remove link from the link directory
   this->links.erase(link_id);
+  this->draw_lists_stale = true;
 }
 
 void ViewTree::remove_view_node(std::string node_id)
@@ -371,10 +537,16 @@ void ViewTree::remove_view_node(std::string node_id)
   for (auto &link_id : link_id_to_remove)
     this->remove_link(link_id);
 
+  // the 2D viewer pyramid reads the data of the viewer node
+  if (node_id == this->viewer_node_id)
+    this->set_viewer_node_id("");
+
   // remove view node
   if (this->get_nodes_map().contains(node_id))
   {
     LOG_DEBUG("erase view node");
+    this->texture_streamer.cancel(
+        this->get_node_ref_by_id<ViewNode>(node_id));
     this->get_nodes_map().erase(node_id);
   }
   else
@@ -386,6 +558,10 @@ void ViewTree::remove_view_node(std::string node_id)
   // for the control node handled by GNode, everything is taken care
   // of by this method
   this->remove_node(node_id);
+  this->draw_lists_stale = true;
+
+  // statistics of the node input may be kept for nothing
+  hesiod::local_stats::clear_cache();
 }
 
 // HELPERS